@@ -76,6 +76,10 @@ static const pa_daemon_conf default_conf = {
     .dl_search_path = NULL,
     .load_default_script_file = true,
     .default_script_file = NULL,
+    .startup_trace_file = NULL,
+    .startup_trace_format = PA_STARTUP_TRACE_JSON,
+    .mainloop_stall_threshold_msec = 100,
+    .io_trace_file = NULL,
     .log_target = NULL,
     .log_level = PA_LOG_NOTICE,
     .log_backtrace = 0,
@@ -98,11 +102,15 @@ static const pa_daemon_conf default_conf = {
     .disable_shm = false,
     .disable_memfd = false,
     .lock_memory = false,
+    .tune_dsp_functions = false,
     .deferred_volume = true,
     .default_n_fragments = 4,
     .default_fragment_size_msec = 25,
     .deferred_volume_safety_margin_usec = 8000,
     .deferred_volume_extra_delay_usec = 0,
+    .deferred_volume_coalesce_usec = 0,
+    .rewind_limit_msec = 0,
+    .rewind_on_volume_change = true,
     .default_sample_spec = { .format = PA_SAMPLE_S16NE, .rate = 44100, .channels = 2 },
     .alternate_sample_rate = 48000,
     .default_channel_map = { .channels = 2, .map = { PA_CHANNEL_POSITION_LEFT, PA_CHANNEL_POSITION_RIGHT } },
@@ -179,6 +187,8 @@ void pa_daemon_conf_free(pa_daemon_conf *c) {
     pa_xfree(c->script_commands);
     pa_xfree(c->dl_search_path);
     pa_xfree(c->default_script_file);
+    pa_xfree(c->startup_trace_file);
+    pa_xfree(c->io_trace_file);
 
     if (c->log_target)
         pa_log_target_free(c->log_target);
@@ -540,6 +550,21 @@ static int parse_enable_lfe_remix(pa_config_parser_state *state) {
     return 0;
 }
 
+static int parse_startup_trace_format(pa_config_parser_state *state) {
+    pa_daemon_conf *c;
+
+    pa_assert(state);
+
+    c = state->data;
+
+    if (pa_startup_trace_format_from_string(state->rvalue, &c->startup_trace_format) < 0) {
+        pa_log(_("[%s:%u] Invalid startup trace format '%s'."), state->filename, state->lineno, state->rvalue);
+        return -1;
+    }
+
+    return 0;
+}
+
 #ifdef HAVE_DBUS
 static int parse_server_type(pa_config_parser_state *state) {
     pa_daemon_conf *c;
@@ -583,6 +608,7 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "flat-volumes",               pa_config_parse_bool,     &c->flat_volumes, NULL },
         { "rescue-streams",             pa_config_parse_bool,     &c->rescue_streams, NULL },
         { "lock-memory",                pa_config_parse_bool,     &c->lock_memory, NULL },
+        { "tune-dsp-functions",         pa_config_parse_bool,     &c->tune_dsp_functions, NULL },
         { "enable-deferred-volume",     pa_config_parse_bool,     &c->deferred_volume, NULL },
         { "exit-idle-time",             pa_config_parse_int,      &c->exit_idle_time, NULL },
         { "scache-idle-time",           pa_config_parse_int,      &c->scache_idle_time, NULL },
@@ -604,6 +630,10 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
                                         pa_config_parse_unsigned, &c->deferred_volume_safety_margin_usec, NULL },
         { "deferred-volume-extra-delay-usec",
                                         pa_config_parse_int,      &c->deferred_volume_extra_delay_usec, NULL },
+        { "deferred-volume-coalesce-usec",
+                                        pa_config_parse_unsigned, &c->deferred_volume_coalesce_usec, NULL },
+        { "rewind-limit-msec",          pa_config_parse_unsigned, &c->rewind_limit_msec, NULL },
+        { "rewind-on-volume-change",    pa_config_parse_bool,     &c->rewind_on_volume_change, NULL },
         { "nice-level",                 parse_nice_level,         c, NULL },
         { "avoid-resampling",           pa_config_parse_bool,     &c->avoid_resampling, NULL },
         { "disable-remixing",           pa_config_parse_bool,     &c->disable_remixing, NULL },
@@ -616,6 +646,10 @@ int pa_daemon_conf_load(pa_daemon_conf *c, const char *filename) {
         { "remixing-consume-lfe",       pa_config_parse_bool,     &c->remixing_consume_lfe, NULL },
         { "lfe-crossover-freq",         pa_config_parse_unsigned, &c->lfe_crossover_freq, NULL },
         { "load-default-script-file",   pa_config_parse_bool,     &c->load_default_script_file, NULL },
+        { "startup-trace-file",         pa_config_parse_string,   &c->startup_trace_file, NULL },
+        { "startup-trace-format",       parse_startup_trace_format, c, NULL },
+        { "mainloop-stall-threshold-msec", pa_config_parse_unsigned, &c->mainloop_stall_threshold_msec, NULL },
+        { "io-trace-file",              pa_config_parse_string,   &c->io_trace_file, NULL },
         { "shm-size-bytes",             pa_config_parse_size,     &c->shm_size, NULL },
         { "log-meta",                   pa_config_parse_bool,     &c->log_meta, NULL },
         { "log-time",                   pa_config_parse_bool,     &c->log_time, NULL },
@@ -810,11 +844,16 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "flat-volumes = %s\n", pa_yes_no(c->flat_volumes));
     pa_strbuf_printf(s, "rescue-streams = %s\n", pa_yes_no(c->rescue_streams));
     pa_strbuf_printf(s, "lock-memory = %s\n", pa_yes_no(c->lock_memory));
+    pa_strbuf_printf(s, "tune-dsp-functions = %s\n", pa_yes_no(c->tune_dsp_functions));
     pa_strbuf_printf(s, "exit-idle-time = %i\n", c->exit_idle_time);
     pa_strbuf_printf(s, "scache-idle-time = %i\n", c->scache_idle_time);
     pa_strbuf_printf(s, "dl-search-path = %s\n", pa_strempty(c->dl_search_path));
     pa_strbuf_printf(s, "default-script-file = %s\n", pa_strempty(pa_daemon_conf_get_default_script_file(c)));
     pa_strbuf_printf(s, "load-default-script-file = %s\n", pa_yes_no(c->load_default_script_file));
+    pa_strbuf_printf(s, "startup-trace-file = %s\n", pa_strempty(c->startup_trace_file));
+    pa_strbuf_printf(s, "startup-trace-format = %s\n", c->startup_trace_format == PA_STARTUP_TRACE_CHROME ? "chrome" : "json");
+    pa_strbuf_printf(s, "mainloop-stall-threshold-msec = %u\n", c->mainloop_stall_threshold_msec);
+    pa_strbuf_printf(s, "io-trace-file = %s\n", pa_strempty(c->io_trace_file));
     pa_strbuf_printf(s, "log-target = %s\n", pa_strempty(log_target));
     pa_strbuf_printf(s, "log-level = %s\n", log_level_to_string[c->log_level]);
     pa_strbuf_printf(s, "resample-method = %s\n", pa_resample_method_to_string(c->resample_method));
@@ -834,6 +873,9 @@ char *pa_daemon_conf_dump(pa_daemon_conf *c) {
     pa_strbuf_printf(s, "enable-deferred-volume = %s\n", pa_yes_no(c->deferred_volume));
     pa_strbuf_printf(s, "deferred-volume-safety-margin-usec = %u\n", c->deferred_volume_safety_margin_usec);
     pa_strbuf_printf(s, "deferred-volume-extra-delay-usec = %d\n", c->deferred_volume_extra_delay_usec);
+    pa_strbuf_printf(s, "deferred-volume-coalesce-usec = %u\n", c->deferred_volume_coalesce_usec);
+    pa_strbuf_printf(s, "rewind-limit-msec = %u\n", c->rewind_limit_msec);
+    pa_strbuf_printf(s, "rewind-on-volume-change = %s\n", pa_yes_no(c->rewind_on_volume_change));
     pa_strbuf_printf(s, "shm-size-bytes = %lu\n", (unsigned long) c->shm_size);
     pa_strbuf_printf(s, "log-meta = %s\n", pa_yes_no(c->log_meta));
     pa_strbuf_printf(s, "log-time = %s\n", pa_yes_no(c->log_time));
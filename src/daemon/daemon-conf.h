@@ -79,6 +79,7 @@ typedef struct pa_daemon_conf {
         flat_volumes,
         rescue_streams,
         lock_memory,
+        tune_dsp_functions,
         deferred_volume;
     pa_server_type_t local_server_type;
     int exit_idle_time,
@@ -87,6 +88,10 @@ typedef struct pa_daemon_conf {
         nice_level,
         resample_method;
     char *script_commands, *dl_search_path, *default_script_file;
+    char *startup_trace_file;
+    char *io_trace_file;
+    unsigned mainloop_stall_threshold_msec;
+    pa_startup_trace_format_t startup_trace_format;
     pa_log_target *log_target;
     pa_log_level_t log_level;
     unsigned log_backtrace;
@@ -132,6 +137,9 @@ typedef struct pa_daemon_conf {
     unsigned default_n_fragments, default_fragment_size_msec;
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
+    unsigned deferred_volume_coalesce_usec;
+    unsigned rewind_limit_msec;
+    bool rewind_on_volume_change;
     unsigned lfe_crossover_freq;
     pa_sample_spec default_sample_spec;
     uint32_t alternate_sample_rate;
@@ -79,6 +79,7 @@
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-scache.h>
 #include <pulsecore/core.h>
+#include <pulsecore/io-trace.h>
 #include <pulsecore/module.h>
 #include <pulsecore/cli-command.h>
 #include <pulsecore/log.h>
@@ -514,6 +515,7 @@ int main(int argc, char *argv[]) {
     pa_strbuf *buf = NULL;
     pa_daemon_conf *conf = NULL;
     pa_mainloop *mainloop = NULL;
+    pa_mainloop_watchdog *watchdog = NULL;
     char *s;
     char *configured_address;
     int r = 0, retval = 1, d = 0;
@@ -1185,15 +1187,21 @@ int main(int argc, char *argv[]) {
 
     pa_memtrap_install();
 
+    /* Not fatal, the daemon just runs untraced */
+    if (conf->io_trace_file)
+        pa_io_trace_start(conf->io_trace_file);
+
     pa_assert_se(mainloop = pa_mainloop_new());
+    watchdog = pa_mainloop_watchdog_new(mainloop, conf->mainloop_stall_threshold_msec * PA_USEC_PER_MSEC);
 
-    if (!(c = pa_core_new(pa_mainloop_get_api(mainloop), !conf->disable_shm,
+    if (!(c = pa_core_new(pa_mainloop_watchdog_get_api(watchdog), !conf->disable_shm,
                           !conf->disable_shm && !conf->disable_memfd && pa_memfd_is_locally_supported(),
                           conf->shm_size))) {
         pa_log(_("pa_core_new() failed."));
         goto finish;
     }
 
+    c->mainloop_watchdog = watchdog;
     c->default_sample_spec = conf->default_sample_spec;
     c->alternate_sample_rate = conf->alternate_sample_rate;
     c->default_channel_map = conf->default_channel_map;
@@ -1201,6 +1209,9 @@ int main(int argc, char *argv[]) {
     c->default_fragment_size_msec = conf->default_fragment_size_msec;
     c->deferred_volume_safety_margin_usec = conf->deferred_volume_safety_margin_usec;
     c->deferred_volume_extra_delay_usec = conf->deferred_volume_extra_delay_usec;
+    c->deferred_volume_coalesce_usec = conf->deferred_volume_coalesce_usec;
+    c->rewind_limit_usec = conf->rewind_limit_msec * PA_USEC_PER_MSEC;
+    c->rewind_on_volume_change = conf->rewind_on_volume_change;
     c->lfe_crossover_freq = conf->lfe_crossover_freq;
     c->exit_idle_time = conf->exit_idle_time;
     c->scache_idle_time = conf->scache_idle_time;
@@ -1221,11 +1232,16 @@ int main(int argc, char *argv[]) {
     c->server_type = conf->local_server_type;
 #endif
 
+    if (conf->startup_trace_file)
+        pa_startup_trace_start(c);
+
     pa_core_check_idle(c);
 
     c->state = PA_CORE_RUNNING;
 
     pa_cpu_init(&c->cpu_info);
+    if (conf->tune_dsp_functions)
+        pa_cpu_tune(&c->cpu_info);
 
     pa_assert_se(pa_signal_init(pa_mainloop_get_api(mainloop)) == 0);
     pa_signal_new(SIGINT, signal_callback, c);
@@ -1257,15 +1273,23 @@ int main(int argc, char *argv[]) {
             FILE *f;
 
             if ((f = pa_daemon_conf_open_default_script_file(conf))) {
+                unsigned span = pa_startup_trace_begin("script", pa_daemon_conf_get_default_script_file(conf), NULL);
+
                 r = pa_cli_command_execute_file_stream(c, f, buf, &conf->fail);
                 fclose(f);
                 command_source = pa_daemon_conf_get_default_script_file(conf);
+
+                pa_startup_trace_end(span);
             }
         }
 
         if (r >= 0) {
+            unsigned span = pa_startup_trace_begin("script", "command line arguments", NULL);
+
             r = pa_cli_command_execute(c, conf->script_commands, buf, &conf->fail);
             command_source = _("command line arguments");
+
+            pa_startup_trace_end(span);
         }
 
         pa_log_error("%s", s = pa_strbuf_to_string_free(buf));
@@ -1317,6 +1341,11 @@ int main(int argc, char *argv[]) {
 
     pa_log_info("Daemon startup complete.");
 
+    if (c->startup_trace) {
+        pa_startup_trace_stop(c);
+        pa_startup_trace_save(c->startup_trace, conf->startup_trace_file, conf->startup_trace_format);
+    }
+
 #ifdef HAVE_SYSTEMD_DAEMON
     sd_notify(0, "READY=1");
 #endif
@@ -1334,7 +1363,7 @@ int main(int argc, char *argv[]) {
 #endif
 
     retval = 0;
-    if (pa_mainloop_run(mainloop, &retval) < 0)
+    if (pa_mainloop_watchdog_run(watchdog, &retval) < 0)
         goto finish;
 
     pa_log_info("Daemon shutdown initiated.");
@@ -1382,6 +1411,8 @@ finish:
         pa_log_info("Daemon terminated.");
     }
 
+    pa_io_trace_stop();
+
     if (!conf->no_cpu_limit)
         pa_cpu_limit_done();
 
@@ -1402,6 +1433,9 @@ finish:
     if (mainloop)
         pa_mainloop_free(mainloop);
 
+    if (watchdog)
+        pa_mainloop_watchdog_free(watchdog);
+
     if (conf)
         pa_daemon_conf_free(conf);
 
@@ -23,6 +23,10 @@
 #endif
 
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <stdio.h>
+#include <unistd.h>
 #include <alsa/asoundlib.h>
 #include <math.h>
 
@@ -31,6 +35,7 @@
 #endif
 
 #include <pulse/mainloop-api.h>
+#include <pulse/rtclock.h>
 #include <pulse/sample.h>
 #include <pulse/timeval.h>
 #include <pulse/util.h>
@@ -38,12 +43,15 @@
 #include <pulse/xmalloc.h>
 #include <pulse/utf8.h>
 
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-error.h>
 #include <pulsecore/i18n.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/conf-parser.h>
 #include <pulsecore/strbuf.h>
+#include <pulsecore/thread.h>
 
 #include "alsa-mixer.h"
 #include "alsa-util.h"
@@ -1155,6 +1163,73 @@ static int element_get_nearest_alsa_dB(snd_mixer_elem_t *me, snd_mixer_selem_cha
     return r;
 }
 
+static bool element_has_channel(snd_mixer_elem_t *me, pa_alsa_direction_t d, snd_mixer_selem_channel_id_t c) {
+    if (d == PA_ALSA_DIRECTION_OUTPUT)
+        return snd_mixer_selem_has_playback_channel(me, c);
+    else
+        return snd_mixer_selem_has_capture_channel(me, c);
+}
+
+/* When all channels get the same volume, write them at once. alsa-lib
+ * then updates the control with a single write instead of one write per
+ * channel. */
+static int element_set_volume_all_dB(pa_alsa_element *e, snd_mixer_elem_t *me, const pa_channel_map *cm, pa_cvolume *v) {
+    snd_mixer_selem_channel_id_t c;
+    pa_channel_position_mask_t mask = 0;
+    pa_cvolume rv;
+    pa_volume_t f;
+    long value;
+    unsigned k;
+    int r;
+
+    value = to_alsa_dB(pa_cvolume_max(v));
+
+    if (e->volume_limit >= 0 && value > (e->max_dB * 100))
+        value = e->max_dB * 100;
+
+    for (c = 0; c <= SND_MIXER_SCHN_LAST; c++)
+        if (element_has_channel(me, e->direction, c))
+            break;
+
+    if (c > SND_MIXER_SCHN_LAST)
+        return -1;
+
+    if ((r = element_get_nearest_alsa_dB(me, c, e->direction, &value)) < 0)
+        return r;
+
+    e->path->n_volume_writes++;
+
+    if (e->direction == PA_ALSA_DIRECTION_OUTPUT)
+        r = snd_mixer_selem_set_playback_dB_all(me, value, 0);
+    else
+        r = snd_mixer_selem_set_capture_dB_all(me, value, 0);
+
+    if (r < 0)
+        return r;
+
+    f = from_alsa_dB(value);
+    pa_cvolume_mute(&rv, cm->channels);
+
+    for (c = 0; c <= SND_MIXER_SCHN_LAST; c++) {
+        if (!element_has_channel(me, e->direction, c))
+            continue;
+
+        for (k = 0; k < cm->channels; k++)
+            if (e->masks[c][e->n_channels-1] & PA_CHANNEL_POSITION_MASK(cm->map[k]))
+                if (rv.values[k] < f)
+                    rv.values[k] = f;
+
+        mask |= e->masks[c][e->n_channels-1];
+    }
+
+    for (k = 0; k < cm->channels; k++)
+        if (!(mask & PA_CHANNEL_POSITION_MASK(cm->map[k])))
+            rv.values[k] = PA_VOLUME_NORM;
+
+    *v = rv;
+    return 0;
+}
+
 static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_channel_map *cm, pa_cvolume *v, bool deferred_volume, bool write_to_hw) {
 
     snd_mixer_selem_id_t *sid;
@@ -1178,6 +1253,11 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
         return -1;
     }
 
+    if (deferred_volume && write_to_hw && e->has_dB && !e->db_fix &&
+        pa_cvolume_channels_equal_to(v, v->values[0]) &&
+        element_set_volume_all_dB(e, me, cm, v) >= 0)
+        return 0;
+
     pa_cvolume_mute(&rv, cm->channels);
 
     for (c = 0; c <= SND_MIXER_SCHN_LAST; c++) {
@@ -1213,9 +1293,10 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
                 if (snd_mixer_selem_has_playback_channel(me, c)) {
                     rounding = +1;
                     if (e->db_fix) {
-                        if (write_to_hw)
+                        if (write_to_hw) {
+                            e->path->n_volume_writes++;
                             r = snd_mixer_selem_set_playback_volume(me, c, decibel_fix_get_step(e->db_fix, &value, rounding));
-                        else {
+                        } else {
                             decibel_fix_get_step(e->db_fix, &value, rounding);
                             r = 0;
                         }
@@ -1223,9 +1304,12 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
                     } else {
                         if (write_to_hw) {
                             if (deferred_volume) {
-                                if ((r = element_get_nearest_alsa_dB(me, c, PA_ALSA_DIRECTION_OUTPUT, &value)) >= 0)
+                                if ((r = element_get_nearest_alsa_dB(me, c, PA_ALSA_DIRECTION_OUTPUT, &value)) >= 0) {
+                                    e->path->n_volume_writes++;
                                     r = snd_mixer_selem_set_playback_dB(me, c, value, 0);
+                                }
                             } else {
+                                e->path->n_volume_writes++;
                                 if ((r = snd_mixer_selem_set_playback_dB(me, c, value, rounding)) >= 0)
                                     r = snd_mixer_selem_get_playback_dB(me, c, &value);
                            }
@@ -1241,9 +1325,10 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
                 if (snd_mixer_selem_has_capture_channel(me, c)) {
                     rounding = -1;
                     if (e->db_fix) {
-                        if (write_to_hw)
+                        if (write_to_hw) {
+                            e->path->n_volume_writes++;
                             r = snd_mixer_selem_set_capture_volume(me, c, decibel_fix_get_step(e->db_fix, &value, rounding));
-                        else {
+                        } else {
                             decibel_fix_get_step(e->db_fix, &value, rounding);
                             r = 0;
                         }
@@ -1251,9 +1336,12 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
                     } else {
                         if (write_to_hw) {
                             if (deferred_volume) {
-                                if ((r = element_get_nearest_alsa_dB(me, c, PA_ALSA_DIRECTION_INPUT, &value)) >= 0)
+                                if ((r = element_get_nearest_alsa_dB(me, c, PA_ALSA_DIRECTION_INPUT, &value)) >= 0) {
+                                    e->path->n_volume_writes++;
                                     r = snd_mixer_selem_set_capture_dB(me, c, value, 0);
+                                }
                             } else {
+                                e->path->n_volume_writes++;
                                 if ((r = snd_mixer_selem_set_capture_dB(me, c, value, rounding)) >= 0)
                                     r = snd_mixer_selem_get_capture_dB(me, c, &value);
                             }
@@ -1279,12 +1367,14 @@ static int element_set_volume(pa_alsa_element *e, snd_mixer_t *m, const pa_chann
 
             if (e->direction == PA_ALSA_DIRECTION_OUTPUT) {
                 if (snd_mixer_selem_has_playback_channel(me, c)) {
+                    e->path->n_volume_writes++;
                     if ((r = snd_mixer_selem_set_playback_volume(me, c, value)) >= 0)
                         r = snd_mixer_selem_get_playback_volume(me, c, &value);
                 } else
                     r = -1;
             } else {
                 if (snd_mixer_selem_has_capture_channel(me, c)) {
+                    e->path->n_volume_writes++;
                     if ((r = snd_mixer_selem_set_capture_volume(me, c, value)) >= 0)
                         r = snd_mixer_selem_get_capture_volume(me, c, &value);
                 } else
@@ -3949,6 +4039,7 @@ void pa_alsa_profile_set_free(pa_alsa_profile_set *ps) {
     if (ps->decibel_fixes)
         pa_hashmap_free(ps->decibel_fixes);
 
+    pa_xfree(ps->path);
     pa_xfree(ps);
 }
 
@@ -4511,9 +4602,11 @@ static void profile_set_set_availability_groups(pa_alsa_profile_set *ps) {
     pa_dynarray_free(paths);
 }
 
+/* The mixer is looked up through the opened PCM, or through alsa_card_index
+ * if the PCM was not opened because the probe result was cached */
 static void mapping_paths_probe(pa_alsa_mapping *m, pa_alsa_profile *profile,
                                 pa_alsa_direction_t direction, pa_hashmap *used_paths,
-                                pa_hashmap *mixers) {
+                                pa_hashmap *mixers, int alsa_card_index) {
 
     pa_alsa_path *p;
     void *state;
@@ -4536,9 +4629,12 @@ static void mapping_paths_probe(pa_alsa_mapping *m, pa_alsa_profile *profile,
     if (!ps)
         return; /* No paths */
 
-    pa_assert(pcm_handle);
-
-    mixer_handle = pa_alsa_open_mixer_for_pcm(mixers, pcm_handle, true);
+    if (pcm_handle)
+        mixer_handle = pa_alsa_open_mixer_for_pcm(mixers, pcm_handle, true);
+    else {
+        pa_assert(alsa_card_index >= 0);
+        mixer_handle = pa_alsa_open_mixer(mixers, alsa_card_index, true);
+    }
     if (!mixer_handle) {
         /* Cannot open mixer, remove all entries */
         pa_hashmap_remove_all(ps->paths);
@@ -4930,7 +5026,6 @@ pa_alsa_profile_set* pa_alsa_profile_set_new(const char *fname, const pa_channel
     pa_alsa_profile *p;
     pa_alsa_mapping *m;
     pa_alsa_decibel_fix *db_fix;
-    char *fn;
     int r;
     void *state;
 
@@ -4977,12 +5072,11 @@ pa_alsa_profile_set* pa_alsa_profile_set_new(const char *fname, const pa_channel
     if (!fname)
         fname = "default.conf";
 
-    fn = get_data_path(NULL, "profile-sets", fname);
+    ps->path = get_data_path(NULL, "profile-sets", fname);
 
-    pa_log_info("Loading profile set: %s", fn);
+    pa_log_info("Loading profile set: %s", ps->path);
 
-    r = pa_config_parse(fn, NULL, items, NULL, false, ps);
-    pa_xfree(fn);
+    r = pa_config_parse(ps->path, NULL, items, NULL, false, ps);
 
     if (r < 0)
         goto fail;
@@ -5019,12 +5113,15 @@ static void profile_finalize_probing(pa_alsa_profile *to_be_finalized, pa_alsa_p
     if (to_be_finalized->output_mappings)
         PA_IDXSET_FOREACH(m, to_be_finalized->output_mappings, idx) {
 
-            if (!m->output_pcm)
+            if (!m->output_pcm && !m->output_opens_alone)
                 continue;
 
             if (to_be_finalized->supported)
                 m->supported++;
 
+            if (!m->output_pcm)
+                continue;
+
             /* If this mapping is also in the next profile, we won't close the
              * pcm handle here, because it would get immediately reopened
              * anyway. */
@@ -5038,12 +5135,15 @@ static void profile_finalize_probing(pa_alsa_profile *to_be_finalized, pa_alsa_p
     if (to_be_finalized->input_mappings)
         PA_IDXSET_FOREACH(m, to_be_finalized->input_mappings, idx) {
 
-            if (!m->input_pcm)
+            if (!m->input_pcm && !m->input_opens_alone)
                 continue;
 
             if (to_be_finalized->supported)
                 m->supported++;
 
+            if (!m->input_pcm)
+                continue;
+
             /* If this mapping is also in the next profile, we won't close the
              * pcm handle here, because it would get immediately reopened
              * anyway. */
@@ -5142,6 +5242,197 @@ static void mapping_query_hw_device(pa_alsa_mapping *mapping, snd_pcm_t *pcm) {
     mapping->hw_device_index = snd_pcm_info_get_device(pcm_info);
 }
 
+#define PROBE_THREADS_MAX 8U
+
+struct probe_job {
+    pa_alsa_mapping *mapping;
+    bool output, input; /* The directions to check */
+    bool output_ok, input_ok;
+    int card_index;
+};
+
+struct probe_pool {
+    struct probe_job *jobs;
+    unsigned n_jobs;
+    pa_atomic_t next_job;
+
+    const pa_sample_spec *ss;
+    const char *dev_id;
+    unsigned default_n_fragments;
+    unsigned default_fragment_size_msec;
+};
+
+static bool probe_job_open(struct probe_job *j, struct probe_pool *pool, int mode) {
+    pa_alsa_mapping *m = j->mapping;
+    snd_pcm_info_t *pcm_info;
+    snd_pcm_t *pcm;
+
+    if (!(pcm = mapping_open_pcm(m, pool->ss, pool->dev_id, m->exact_channels, mode,
+                                 pool->default_n_fragments, pool->default_fragment_size_msec)))
+        return false;
+
+    if (m->hw_device_index < 0)
+        mapping_query_hw_device(m, pcm);
+
+    snd_pcm_info_alloca(&pcm_info);
+    if (snd_pcm_info(pcm, pcm_info) >= 0)
+        j->card_index = snd_pcm_info_get_card(pcm_info);
+
+    snd_pcm_close(pcm);
+    return true;
+}
+
+static void probe_job_run(struct probe_job *j, struct probe_pool *pool) {
+    if (j->output && !j->output_ok)
+        j->output_ok = probe_job_open(j, pool, SND_PCM_STREAM_PLAYBACK);
+    if (j->input && !j->input_ok)
+        j->input_ok = probe_job_open(j, pool, SND_PCM_STREAM_CAPTURE);
+}
+
+static void probe_thread_func(void *userdata) {
+    struct probe_pool *pool = userdata;
+    unsigned i;
+
+    while ((i = (unsigned) pa_atomic_inc(&pool->next_job)) < pool->n_jobs)
+        probe_job_run(&pool->jobs[i], pool);
+}
+
+static unsigned profile_n_mappings(pa_alsa_profile *p) {
+    return (p->output_mappings ? pa_idxset_size(p->output_mappings) : 0) +
+           (p->input_mappings ? pa_idxset_size(p->input_mappings) : 0);
+}
+
+/* Opens the PCM of every mapping that the serial probe would open on its
+ * own, spread over a few threads, so that devices with many mappings (e.g.
+ * HDMI) don't take the sum of all open times. These are the mappings of the
+ * profiles that consist of a single mapping and are not fallbacks; fallbacks
+ * are only opened by the serial probe if nothing else was found. Such a
+ * profile whose mapping opens on its own does not need to be opened again
+ * by the serial probe, and mappings that can't be opened on their own are
+ * marked as broken. Returns the card index, or -1 if no PCM could be opened.
+ *
+ * This only parallelizes the opens within one card. The calling thread
+ * waits for the pool, so the main loop still stalls while a card is probed,
+ * just for a shorter time, and cards are still probed one after another. */
+static int mappings_probe_parallel(
+        pa_alsa_profile_set *ps,
+        pa_hashmap *broken_inputs,
+        pa_hashmap *broken_outputs,
+        const char *dev_id,
+        const pa_sample_spec *ss,
+        unsigned default_n_fragments,
+        unsigned default_fragment_size_msec) {
+
+    struct probe_pool pool;
+    pa_thread *threads[PROBE_THREADS_MAX];
+    pa_hashmap *jobs_by_mapping;
+    pa_alsa_profile *p;
+    pa_alsa_mapping *m;
+    struct probe_job *j;
+    unsigned i, n_threads;
+    uint32_t idx;
+    void *state;
+    int card_index = -1;
+    pa_usec_t start;
+
+    pool.jobs = pa_xnew0(struct probe_job, pa_hashmap_size(ps->mappings));
+    pool.n_jobs = 0;
+    pa_atomic_store(&pool.next_job, 0);
+    pool.ss = ss;
+    pool.dev_id = dev_id;
+    pool.default_n_fragments = default_n_fragments;
+    pool.default_fragment_size_msec = default_fragment_size_msec;
+
+    /* One job per mapping, since opening a PCM may update the mapping's
+     * channel map */
+    jobs_by_mapping = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    PA_HASHMAP_FOREACH(p, ps->profiles, state) {
+        if (p->supported || p->fallback_input || p->fallback_output || profile_n_mappings(p) != 1)
+            continue;
+
+        if (p->output_mappings)
+            PA_IDXSET_FOREACH(m, p->output_mappings, idx) {
+                if (!(j = pa_hashmap_get(jobs_by_mapping, m))) {
+                    j = &pool.jobs[pool.n_jobs++];
+                    j->mapping = m;
+                    j->card_index = -1;
+                    pa_hashmap_put(jobs_by_mapping, m, j);
+                }
+                j->output = true;
+            }
+
+        if (p->input_mappings)
+            PA_IDXSET_FOREACH(m, p->input_mappings, idx) {
+                if (!(j = pa_hashmap_get(jobs_by_mapping, m))) {
+                    j = &pool.jobs[pool.n_jobs++];
+                    j->mapping = m;
+                    j->card_index = -1;
+                    pa_hashmap_put(jobs_by_mapping, m, j);
+                }
+                j->input = true;
+            }
+    }
+
+    pa_hashmap_free(jobs_by_mapping);
+
+    if (pool.n_jobs < 2)
+        goto finish;
+
+    start = pa_rtclock_now();
+    n_threads = PA_MIN(pool.n_jobs, PA_MIN(pa_ncpus(), PROBE_THREADS_MAX));
+
+    for (i = 1; i < n_threads; i++)
+        threads[i] = pa_thread_new("alsa-probe", probe_thread_func, &pool);
+
+    probe_thread_func(&pool);
+
+    for (i = 1; i < n_threads; i++)
+        if (threads[i])
+            pa_thread_free(threads[i]);
+
+    /* Mappings that share a device may have failed because another thread
+     * was holding it, so retry the failures one at a time */
+    for (i = 0; i < pool.n_jobs; i++)
+        probe_job_run(&pool.jobs[i], &pool);
+
+    pa_log_debug("Opening %u mappings with %u threads took %llu us.", pool.n_jobs, n_threads,
+                 (unsigned long long) (pa_rtclock_now() - start));
+
+    for (i = 0; i < pool.n_jobs; i++) {
+        j = &pool.jobs[i];
+        m = j->mapping;
+
+        if (j->output) {
+            m->output_opens_alone = j->output_ok;
+            if (!j->output_ok) {
+                pa_log_debug("Caching failure to open output:%s", m->name);
+                pa_hashmap_put(broken_outputs, m, m);
+            }
+        }
+
+        if (j->input) {
+            m->input_opens_alone = j->input_ok;
+            if (!j->input_ok) {
+                pa_log_debug("Caching failure to open input:%s", m->name);
+                pa_hashmap_put(broken_inputs, m, m);
+            }
+        }
+
+        if (card_index < 0)
+            card_index = j->card_index;
+    }
+
+    /* Without a card index the mixer can only be found through an opened PCM */
+    if (card_index < 0)
+        for (i = 0; i < pool.n_jobs; i++)
+            pool.jobs[i].mapping->output_opens_alone = pool.jobs[i].mapping->input_opens_alone = false;
+
+finish:
+    pa_xfree(pool.jobs);
+    return card_index;
+}
+
 void pa_alsa_profile_set_probe(
         pa_alsa_profile_set *ps,
         pa_hashmap *mixers,
@@ -5157,6 +5448,8 @@ void pa_alsa_profile_set_probe(
     pa_alsa_mapping *m;
     pa_hashmap *broken_inputs, *broken_outputs, *used_paths;
     pa_alsa_mapping *selected_fallback_input = NULL, *selected_fallback_output = NULL;
+    void *state;
+    int card_index;
 
     pa_assert(ps);
     pa_assert(dev_id);
@@ -5168,6 +5461,9 @@ void pa_alsa_profile_set_probe(
     broken_inputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
     broken_outputs = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
     used_paths = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    card_index = mappings_probe_parallel(ps, broken_inputs, broken_outputs, dev_id, ss,
+                                         default_n_fragments, default_fragment_size_msec);
     pp = probe_order = pa_xnew0(pa_alsa_profile *, pa_hashmap_size(ps->profiles) + 1);
 
     pp += add_profiles_to_probe(pp, ps->profiles, false, false);
@@ -5177,6 +5473,7 @@ void pa_alsa_profile_set_probe(
 
     for (pp = probe_order; *pp; pp++) {
         uint32_t idx;
+        bool single;
         p = *pp;
 
         /* Skip if fallback and already found something, but still probe already selected fallbacks.
@@ -5219,11 +5516,16 @@ void pa_alsa_profile_set_probe(
             if (p->supported)
                 pa_log_debug("Looking at profile %s", p->name);
 
+            /* Mappings that were opened on their own already need not be
+             * opened again, unless they have to be opened together with
+             * other mappings */
+            single = profile_n_mappings(p) == 1;
+
             /* Check if we can open all new ones */
             if (p->output_mappings && p->supported)
                 PA_IDXSET_FOREACH(m, p->output_mappings, idx) {
 
-                    if (m->output_pcm)
+                    if (m->output_pcm || (single && m->output_opens_alone))
                         continue;
 
                     pa_log_debug("Checking for playback on %s (%s)", m->description, m->name);
@@ -5247,7 +5549,7 @@ void pa_alsa_profile_set_probe(
             if (p->input_mappings && p->supported)
                 PA_IDXSET_FOREACH(m, p->input_mappings, idx) {
 
-                    if (m->input_pcm)
+                    if (m->input_pcm || (single && m->input_opens_alone))
                         continue;
 
                     pa_log_debug("Checking for recording on %s (%s)", m->description, m->name);
@@ -5278,28 +5580,31 @@ void pa_alsa_profile_set_probe(
 
         if (p->output_mappings)
             PA_IDXSET_FOREACH(m, p->output_mappings, idx)
-                if (m->output_pcm) {
+                if (m->output_pcm || m->output_opens_alone) {
                     found_output = true;
                     if (p->fallback_output && selected_fallback_output == NULL) {
                         selected_fallback_output = m;
                     }
-                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_OUTPUT, used_paths, mixers);
+                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_OUTPUT, used_paths, mixers, card_index);
                 }
 
         if (p->input_mappings)
             PA_IDXSET_FOREACH(m, p->input_mappings, idx)
-                if (m->input_pcm) {
+                if (m->input_pcm || m->input_opens_alone) {
                     found_input = true;
                     if (p->fallback_input && selected_fallback_input == NULL) {
                         selected_fallback_input = m;
                     }
-                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_INPUT, used_paths, mixers);
+                    mapping_paths_probe(m, p, PA_ALSA_DIRECTION_INPUT, used_paths, mixers, card_index);
                 }
     }
 
     /* Clean up */
     profile_finalize_probing(last, NULL);
 
+    PA_HASHMAP_FOREACH(m, ps->mappings, state)
+        m->output_opens_alone = m->input_opens_alone = false;
+
     pa_alsa_profile_set_drop_unsupported(ps);
 
     paths_drop_unused(ps->input_paths, used_paths);
@@ -5314,6 +5619,262 @@ void pa_alsa_profile_set_probe(
     ps->probed = true;
 }
 
+struct probe_cache_mapping {
+    unsigned supported;
+    int hw_device_index;
+    bool output_paths;
+    bool input_paths;
+};
+
+/* Builds the key that the cached probe result must match: any change of the
+ * card, its mixer controls, the profile set or the default sample spec
+ * invalidates the cache. On success *card_id is set to the card ID. */
+static char *probe_cache_key(pa_alsa_profile_set *ps, int alsa_card_index, const pa_sample_spec *ss, char **card_id) {
+    snd_ctl_t *ctl;
+    snd_ctl_card_info_t *info;
+    snd_ctl_elem_list_t *list;
+    pa_strbuf *buf;
+    struct stat st;
+    char *dev, *controls, *key = NULL;
+    char ss_buf[PA_SAMPLE_SPEC_SNPRINT_MAX];
+    unsigned i, count;
+    int err;
+
+    if (!ps->path || stat(ps->path, &st) < 0)
+        return NULL;
+
+    dev = pa_sprintf_malloc("hw:%i", alsa_card_index);
+    err = snd_ctl_open(&ctl, dev, 0);
+    pa_xfree(dev);
+
+    if (err < 0) {
+        pa_log_warn("Failed to open control device of card %i: %s", alsa_card_index, pa_alsa_strerror(err));
+        return NULL;
+    }
+
+    snd_ctl_card_info_alloca(&info);
+    snd_ctl_elem_list_alloca(&list);
+
+    if ((err = snd_ctl_card_info(ctl, info)) < 0 ||
+        (err = snd_ctl_elem_list(ctl, list)) < 0 ||
+        (err = snd_ctl_elem_list_alloc_space(list, snd_ctl_elem_list_get_count(list))) < 0)
+        goto finish;
+
+    if ((err = snd_ctl_elem_list(ctl, list)) < 0)
+        goto free_space;
+
+    buf = pa_strbuf_new();
+    count = snd_ctl_elem_list_get_used(list);
+    for (i = 0; i < count; i++)
+        pa_strbuf_printf(buf, "%s,%u\n", snd_ctl_elem_list_get_name(list, i), snd_ctl_elem_list_get_index(list, i));
+    controls = pa_strbuf_to_string_free(buf);
+
+    *card_id = pa_xstrdup(snd_ctl_card_info_get_id(info));
+    key = pa_sprintf_malloc("%s %s %s controls=%u/%08x %s mtime=%llu %s",
+                            PACKAGE_VERSION,
+                            *card_id,
+                            snd_ctl_card_info_get_driver(info),
+                            count,
+                            pa_idxset_string_hash_func(controls),
+                            ps->path,
+                            (unsigned long long) st.st_mtime,
+                            pa_sample_spec_snprint(ss_buf, sizeof(ss_buf), ss));
+    pa_xfree(controls);
+
+free_space:
+    snd_ctl_elem_list_free_space(list);
+
+finish:
+    if (err < 0)
+        pa_log_warn("Failed to query control device of card %i: %s", alsa_card_index, pa_alsa_strerror(err));
+
+    snd_ctl_close(ctl);
+    return key;
+}
+
+static char *probe_cache_path(const char *card_id) {
+    char *fn, *path;
+
+    fn = pa_sprintf_malloc("alsa-probe-%s", card_id);
+    path = pa_state_path(fn, true);
+    pa_xfree(fn);
+
+    return path;
+}
+
+/* Reads the cached result into the given hashmaps. Returns false if the cache
+ * is missing, stale or refers to profiles or mappings that do not exist. */
+static bool probe_cache_read(pa_alsa_profile_set *ps, const char *fn, const char *key, pa_hashmap *profiles, pa_hashmap *mappings) {
+    FILE *f;
+    char line[1024];
+    bool ok = false;
+
+    if (!(f = pa_fopen_cloexec(fn, "r"))) {
+        if (errno != ENOENT)
+            pa_log_warn("Failed to open probe cache %s: %s", fn, pa_cstrerror(errno));
+        return false;
+    }
+
+    if (!fgets(line, sizeof(line), f) || !pa_streq(pa_strip_nl(line), key)) {
+        pa_log_info("Probe cache %s is outdated.", fn);
+        goto finish;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        struct probe_cache_mapping *e;
+        char o, i;
+        int n = 0;
+
+        pa_strip_nl(line);
+
+        if (pa_startswith(line, "profile ")) {
+            const char *name = line + 8;
+
+            if (!pa_hashmap_get(ps->profiles, name))
+                goto invalid;
+
+            pa_hashmap_put(profiles, pa_xstrdup(name), PA_INT_TO_PTR(1));
+            continue;
+        }
+
+        e = pa_xnew0(struct probe_cache_mapping, 1);
+
+        if (sscanf(line, "mapping %u %i %c%c %n", &e->supported, &e->hw_device_index, &o, &i, &n) < 4 || n == 0 ||
+            !pa_hashmap_get(ps->mappings, line + n)) {
+            pa_xfree(e);
+            goto invalid;
+        }
+
+        e->output_paths = o == 'o';
+        e->input_paths = i == 'i';
+        pa_hashmap_put(mappings, pa_xstrdup(line + n), e);
+    }
+
+    ok = true;
+    goto finish;
+
+invalid:
+    pa_log_info("Probe cache %s does not match the profile set: %s", fn, line);
+
+finish:
+    fclose(f);
+    return ok;
+}
+
+/* Applies the outcome of an earlier pa_alsa_profile_set_probe() run on the
+ * same card without opening any PCM devices. The mixer paths are still
+ * probed, because the path objects need the current mixer state. */
+bool pa_alsa_profile_set_load_probe_cache(pa_alsa_profile_set *ps, pa_hashmap *mixers, int alsa_card_index, const pa_sample_spec *ss) {
+    pa_hashmap *profiles, *mappings, *used_paths;
+    struct probe_cache_mapping *e;
+    pa_alsa_profile *p;
+    pa_alsa_mapping *m;
+    char *key, *card_id = NULL, *fn = NULL;
+    void *state;
+    bool ok = false;
+
+    pa_assert(ps);
+    pa_assert(ss);
+
+    if (ps->probed)
+        return true;
+
+    if (!(key = probe_cache_key(ps, alsa_card_index, ss, &card_id)))
+        return false;
+
+    profiles = pa_hashmap_new_full(pa_idxset_string_hash_func, pa_idxset_string_compare_func, pa_xfree, NULL);
+    mappings = pa_hashmap_new_full(pa_idxset_string_hash_func, pa_idxset_string_compare_func, pa_xfree, pa_xfree);
+
+    if (!(fn = probe_cache_path(card_id)) || !probe_cache_read(ps, fn, key, profiles, mappings))
+        goto finish;
+
+    PA_HASHMAP_FOREACH(p, ps->profiles, state)
+        p->supported = !!pa_hashmap_get(profiles, p->name);
+
+    used_paths = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    PA_HASHMAP_FOREACH(m, ps->mappings, state) {
+        if (!(e = pa_hashmap_get(mappings, m->name))) {
+            m->supported = 0;
+            continue;
+        }
+
+        m->supported = e->supported;
+        m->hw_device_index = e->hw_device_index;
+
+        if (e->output_paths)
+            mapping_paths_probe(m, NULL, PA_ALSA_DIRECTION_OUTPUT, used_paths, mixers, alsa_card_index);
+        if (e->input_paths)
+            mapping_paths_probe(m, NULL, PA_ALSA_DIRECTION_INPUT, used_paths, mixers, alsa_card_index);
+    }
+
+    pa_alsa_profile_set_drop_unsupported(ps);
+
+    paths_drop_unused(ps->input_paths, used_paths);
+    paths_drop_unused(ps->output_paths, used_paths);
+    pa_hashmap_free(used_paths);
+
+    profile_set_set_availability_groups(ps);
+
+    ps->probed = true;
+    ok = true;
+
+finish:
+    pa_hashmap_free(profiles);
+    pa_hashmap_free(mappings);
+    pa_xfree(fn);
+    pa_xfree(card_id);
+    pa_xfree(key);
+    return ok;
+}
+
+void pa_alsa_profile_set_save_probe_cache(pa_alsa_profile_set *ps, int alsa_card_index, const pa_sample_spec *ss) {
+    pa_alsa_profile *p;
+    pa_alsa_mapping *m;
+    char *key, *card_id = NULL, *fn = NULL, *tmp = NULL;
+    void *state;
+    FILE *f;
+
+    pa_assert(ps);
+    pa_assert(ps->probed);
+    pa_assert(ss);
+
+    if (!(key = probe_cache_key(ps, alsa_card_index, ss, &card_id)))
+        return;
+
+    if (!(fn = probe_cache_path(card_id)))
+        goto finish;
+
+    /* Write to a temporary file first so that a crash never leaves a
+     * truncated cache behind */
+    tmp = pa_sprintf_malloc("%s.tmp", fn);
+
+    if (!(f = pa_fopen_cloexec(tmp, "w"))) {
+        pa_log_warn("Failed to write probe cache %s: %s", tmp, pa_cstrerror(errno));
+        goto finish;
+    }
+
+    fprintf(f, "%s\n", key);
+
+    PA_HASHMAP_FOREACH(p, ps->profiles, state)
+        fprintf(f, "profile %s\n", p->name);
+
+    PA_HASHMAP_FOREACH(m, ps->mappings, state)
+        fprintf(f, "mapping %u %i %c%c %s\n", m->supported, m->hw_device_index,
+                m->output_path_set ? 'o' : '-', m->input_path_set ? 'i' : '-', m->name);
+
+    if (fclose(f) != 0 || rename(tmp, fn) < 0) {
+        pa_log_warn("Failed to write probe cache %s: %s", fn, pa_cstrerror(errno));
+        unlink(tmp);
+    }
+
+finish:
+    pa_xfree(tmp);
+    pa_xfree(fn);
+    pa_xfree(card_id);
+    pa_xfree(key);
+}
+
 void pa_alsa_profile_set_dump(pa_alsa_profile_set *ps) {
     pa_alsa_profile *p;
     pa_alsa_mapping *m;
@@ -236,6 +236,10 @@ struct pa_alsa_path {
     long min_volume, max_volume;
     double min_dB, max_dB;
 
+    /* Number of snd_mixer_selem_set_*() calls issued when setting the
+     * volume, whether or not they succeeded */
+    uint64_t n_volume_writes;
+
     /* This is used during parsing only, as a shortcut so that we
      * don't have to iterate the list all the time */
     pa_alsa_element *last_element;
@@ -314,6 +318,8 @@ struct pa_alsa_mapping {
     /* Temporarily used during probing */
     snd_pcm_t *input_pcm;
     snd_pcm_t *output_pcm;
+    bool input_opens_alone;
+    bool output_opens_alone;
 
     pa_sink *sink;
     pa_source *source;
@@ -373,6 +379,8 @@ struct pa_alsa_profile_set {
     pa_hashmap *input_paths;
     pa_hashmap *output_paths;
 
+    char *path; /* The profile set configuration file, NULL for UCM */
+
     bool auto_profiles;
     bool ignore_dB:1;
     bool probed:1;
@@ -385,6 +393,8 @@ pa_alsa_mapping *pa_alsa_mapping_get(pa_alsa_profile_set *ps, const char *name);
 
 pa_alsa_profile_set* pa_alsa_profile_set_new(const char *fname, const pa_channel_map *bonus);
 void pa_alsa_profile_set_probe(pa_alsa_profile_set *ps, pa_hashmap *mixers, const char *dev_id, const pa_sample_spec *ss, unsigned default_n_fragments, unsigned default_fragment_size_msec);
+bool pa_alsa_profile_set_load_probe_cache(pa_alsa_profile_set *ps, pa_hashmap *mixers, int alsa_card_index, const pa_sample_spec *ss);
+void pa_alsa_profile_set_save_probe_cache(pa_alsa_profile_set *ps, int alsa_card_index, const pa_sample_spec *ss);
 void pa_alsa_profile_set_free(pa_alsa_profile_set *s);
 void pa_alsa_profile_set_dump(pa_alsa_profile_set *s);
 void pa_alsa_profile_set_drop_unsupported(pa_alsa_profile_set *s);
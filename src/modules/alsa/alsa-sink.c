@@ -47,11 +47,15 @@
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/sample-util.h>
+#include <pulsecore/io-trace.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/message-handler.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/shared.h>
 
 #ifdef USE_SMOOTHER_2
 #include <pulsecore/time-smoother_2.h>
@@ -83,6 +87,7 @@
 #define TSCHED_MIN_SLEEP_USEC (10*PA_USEC_PER_MSEC)                /* 10ms  -- Sleep at least 10ms on each iteration */
 #define TSCHED_MIN_WAKEUP_USEC (4*PA_USEC_PER_MSEC)                /* 4ms   -- Wakeup at least this long before the buffer runs empty*/
 
+
 #ifdef USE_SMOOTHER_2
 #define SMOOTHER_WINDOW_USEC  (15*PA_USEC_PER_SEC)                 /* 15s   -- smoother windows size */
 #else
@@ -100,6 +105,8 @@
 
 #define DEFAULT_WRITE_ITERATION_THRESHOLD 0.03 /* don't iterate write if < 3% of the buffer is available */
 
+typedef struct alsa_io_group alsa_io_group;
+
 struct userdata {
     pa_core *core;
     pa_module *module;
@@ -159,10 +166,25 @@ struct userdata {
     char *device_name;  /* name of the PCM device */
     char *control_device; /* name of the control device */
 
-    bool use_mmap:1, use_tsched:1, deferred_volume:1, fixed_latency_range:1;
+    bool use_mmap:1, use_tsched:1, deferred_volume:1, fixed_latency_range:1, adaptive_watermark:1;
 
     bool first, after_rewind;
 
+    /* Query the device on every predict_wakeups-th timer wakeup only and
+     * rely on the smoother in between, 0 to query on every wakeup */
+    unsigned predict_wakeups;
+    unsigned predicted_left;
+    bool predicting, verifying;
+    uint64_t n_predicted_wakeups;
+    uint64_t n_verified_wakeups;
+    int64_t prediction_drift_usec;
+
+    /* Audio left in the device when the current IO cycle began */
+    pa_usec_t cycle_headroom_usec;
+
+    pa_alsa_wakeup_stats wakeup_stats;
+    char *message_handler_path;
+
     pa_rtpoll_item *alsa_rtpoll_item;
 
 #ifdef USE_SMOOTHER_2
@@ -173,6 +195,11 @@ struct userdata {
     uint64_t write_count;
     uint64_t since_start;
 
+    /* Extra copies done while rendering, averaged over one second */
+    pa_usec_t copy_rate_since;
+    uint64_t copy_rate_bytes;
+    uint64_t copied_bytes_per_sec;
+
 #ifndef USE_SMOOTHER_2
     pa_usec_t smoother_interval;
     pa_usec_t last_smoother_update;
@@ -187,14 +214,71 @@ struct userdata {
 
     /* ucm context */
     pa_alsa_ucm_mapping_context *ucm_context;
+
+    /* Set when the sink is served by an IO thread shared with the other
+     * sinks on the same card, the fields below are only used then */
+    alsa_io_group *io_group;
+    bool io_joined, io_failed;
+    unsigned short io_revents;
+    pa_usec_t io_sleep, io_sleep_start;
+    PA_LLIST_FIELDS(struct userdata);
+};
+
+/* One IO thread with one rtpoll serving several sinks on the same card,
+ * registered as shared object under its name */
+struct alsa_io_group {
+    pa_msgobject parent;
+
+    pa_core *core;
+    char *name;
+    unsigned n_sinks;
+
+    pa_thread *thread;
+    pa_thread_mq thread_mq;
+    pa_rtpoll *rtpoll;
+
+    /* Only accessed from the IO thread */
+    PA_LLIST_HEAD(struct userdata, members);
 };
 
+PA_DEFINE_PRIVATE_CLASS(alsa_io_group, pa_msgobject);
+#define ALSA_IO_GROUP(o) (alsa_io_group_cast(o))
+
 enum {
-    SINK_MESSAGE_SYNC_MIXER = PA_SINK_MESSAGE_MAX
+    IO_GROUP_MESSAGE_ADD,
+    IO_GROUP_MESSAGE_REMOVE
+};
+
+enum {
+    SINK_MESSAGE_SYNC_MIXER = PA_SINK_MESSAGE_MAX,
+    SINK_MESSAGE_GET_WAKEUP_STATS,
+    SINK_MESSAGE_GET_RENDER_STATS,
+    SINK_MESSAGE_GET_VOLUME_STATS
+};
+
+struct wakeup_report {
+    pa_alsa_wakeup_report base;
+    uint64_t n_predicted_wakeups;
+    uint64_t n_verified_wakeups;
+    int64_t prediction_drift_usec;
+};
+
+struct volume_report {
+    uint64_t changes_requested;
+    uint64_t changes_coalesced;
+    uint64_t volume_writes;
+    uint64_t mixer_writes;
+};
+
+struct render_report {
+    uint64_t written_bytes;
+    uint64_t copied_bytes;
+    uint64_t copied_bytes_per_sec;
 };
 
 static void userdata_free(struct userdata *u);
 static int unsuspend(struct userdata *u, bool recovering);
+static int64_t sink_get_latency(struct userdata *u);
 
 /* FIXME: Is there a better way to do this than device names? */
 static bool is_iec958(struct userdata *u) {
@@ -430,6 +514,52 @@ restart:
     u->watermark_dec_not_before = now + TSCHED_WATERMARK_VERIFY_AFTER_USEC;
 }
 
+/* Updates the rate of extra copies made while rendering, averaged over
+ * periods of at least a second, for the render statistics of the sink */
+static void update_copy_rate(struct userdata *u) {
+    pa_usec_t now;
+
+    pa_assert(u);
+
+    now = pa_rtclock_now();
+
+    if (u->copy_rate_since == 0) {
+        u->copy_rate_since = now;
+        u->copy_rate_bytes = u->sink->thread_info.render_copied_bytes;
+        return;
+    }
+
+    if (now - u->copy_rate_since < PA_USEC_PER_SEC)
+        return;
+
+    u->copied_bytes_per_sec = (u->sink->thread_info.render_copied_bytes - u->copy_rate_bytes) * PA_USEC_PER_SEC / (now - u->copy_rate_since);
+    u->copy_rate_since = now;
+    u->copy_rate_bytes = u->sink->thread_info.render_copied_bytes;
+}
+
+/* Called from IO context. See pa_alsa_adapt_watermark() */
+static void adapt_watermark(struct userdata *u, bool underrun) {
+    size_t old_watermark;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    if (underrun)
+        increase_watermark(u);
+
+    old_watermark = u->tsched_watermark;
+
+    if (!pa_alsa_adapt_watermark(&u->wakeup_stats, underrun, TSCHED_MIN_WAKEUP_USEC, &u->sink->sample_spec,
+                                 &u->watermark_dec_not_before, &u->tsched_watermark))
+        return;
+
+    fix_tsched_watermark(u);
+
+    if (old_watermark != u->tsched_watermark)
+        pa_log_info("Adapting wakeup watermark to %0.2f ms",
+                    (double) u->tsched_watermark_usec / PA_USEC_PER_MSEC);
+}
+
 /* Called from IO Context on unsuspend or from main thread when creating sink */
 static void reset_watermark(struct userdata *u, size_t tsched_watermark, pa_sample_spec *ss,
                             bool in_thread) {
@@ -573,9 +703,13 @@ static size_t check_left_to_play(struct userdata *u, size_t n_bytes, bool on_tim
         PA_DEBUG_TRAP;
 #endif
 
-        if (!u->first && !u->after_rewind)
+        if (!u->first && !u->after_rewind) {
+            pa_atomic_inc(&u->sink->n_underruns);
+            pa_io_trace(PA_IO_TRACE_ALSA_SINK_UNDERRUN, u->sink->index, 0, 0, 0);
+
             if (pa_log_ratelimit(PA_LOG_INFO))
                 pa_log_info("Underrun!");
+        }
     }
 
 #ifdef DEBUG_TIMING
@@ -585,7 +719,10 @@ static size_t check_left_to_play(struct userdata *u, size_t n_bytes, bool on_tim
                  (double) pa_bytes_to_usec(u->watermark_dec_threshold, &u->sink->sample_spec) / PA_USEC_PER_MSEC);
 #endif
 
-    if (u->use_tsched) {
+    if (u->use_tsched && u->adaptive_watermark) {
+        if (!u->first && !u->after_rewind)
+            adapt_watermark(u, underrun || left_to_play < u->watermark_inc_threshold);
+    } else if (u->use_tsched) {
         bool reset_not_before = true;
 
         if (!u->first && !u->after_rewind) {
@@ -610,6 +747,27 @@ static size_t check_left_to_play(struct userdata *u, size_t n_bytes, bool on_tim
     return left_to_play;
 }
 
+/* Compares the fill level the smoother predicts with the one the device
+ * reports. If they drifted apart by more than half the watermark, keep
+ * verifying on every wakeup until they agree again. */
+static void verify_prediction(struct userdata *u, size_t avail) {
+    int64_t actual_usec;
+
+    pa_assert(u);
+
+    actual_usec = (int64_t) pa_bytes_to_usec(u->hwbuf_size - PA_MIN(avail, u->hwbuf_size), &u->sink->sample_spec);
+    u->prediction_drift_usec = sink_get_latency(u) - actual_usec;
+    u->n_verified_wakeups++;
+
+    if (u->prediction_drift_usec > (int64_t) u->tsched_watermark_usec / 2 ||
+        u->prediction_drift_usec < -(int64_t) u->tsched_watermark_usec / 2) {
+        if (pa_log_ratelimit(PA_LOG_INFO))
+            pa_log_info("Predicted fill level is off by %0.2f ms, verifying on every wakeup.",
+                        (double) u->prediction_drift_usec / PA_USEC_PER_MSEC);
+        u->predicted_left = 0;
+    }
+}
+
 static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bool on_timeout) {
     bool work_done = false;
     pa_usec_t max_sleep_usec = 0, process_usec = 0;
@@ -628,6 +786,11 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
         int r;
         bool after_avail = true;
 
+        /* When predicting, don't ask the device again for what was
+         * consumed while we were filling up */
+        if (u->predicting && j > 0)
+            break;
+
         /* First we determine how many samples are missing to fill the
          * buffer up to 100% */
 
@@ -641,6 +804,9 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
 
         n_bytes = (size_t) n * u->frame_size;
 
+        if (u->verifying && j == 0)
+            verify_prediction(u, n_bytes);
+
 #ifdef DEBUG_TIMING
         pa_log_debug("avail: %lu", (unsigned long) n_bytes);
 #endif
@@ -648,6 +814,9 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
         left_to_play = check_left_to_play(u, n_bytes, on_timeout);
         on_timeout = false;
 
+        if (j == 0)
+            u->cycle_headroom_usec = pa_bytes_to_usec(left_to_play, &u->sink->sample_spec);
+
         if (u->use_tsched)
 
             /* We won't fill up the playback buffer before at least
@@ -712,6 +881,7 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
             snd_pcm_uframes_t offset, frames;
             snd_pcm_sframes_t sframes;
             size_t written;
+            pa_usec_t write_start;
 
             frames = (snd_pcm_uframes_t) (n_bytes / u->frame_size);
 /*             pa_log_debug("%lu frames to write", (unsigned long) frames); */
@@ -757,7 +927,11 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
             pa_sink_render_into_full(u->sink, &chunk);
             pa_memblock_unref_fixed(chunk.memblock);
 
-            if (PA_UNLIKELY((sframes = snd_pcm_mmap_commit(u->pcm_handle, offset, frames)) < 0)) {
+            write_start = pa_rtclock_now();
+            sframes = snd_pcm_mmap_commit(u->pcm_handle, offset, frames);
+            pa_cycle_timing_add(&u->sink->thread_info.cycle_stats.write, pa_rtclock_now() - write_start);
+
+            if (PA_UNLIKELY(sframes < 0)) {
 
                 if ((int) sframes == -EAGAIN)
                     break;
@@ -776,6 +950,11 @@ static int mmap_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
             u->write_count += written;
             u->since_start += written;
 
+            /* No avail query follows when predicting, so account for
+             * what we wrote ourselves */
+            if (u->predicting)
+                left_to_play += written;
+
 #ifdef DEBUG_TIMING
             pa_log_debug("Wrote %lu bytes (of possible %lu bytes)", (unsigned long) written, (unsigned long) n_bytes);
 #endif
@@ -825,6 +1004,9 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
         int r;
         bool after_avail = true;
 
+        if (u->predicting && j > 0)
+            break;
+
         if (PA_UNLIKELY((n = pa_alsa_safe_avail(u->pcm_handle, u->hwbuf_size, &u->sink->sample_spec)) < 0)) {
 
             if ((r = try_recover(u, "snd_pcm_avail", (int) n)) >= 0)
@@ -835,6 +1017,9 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
 
         n_bytes = (size_t) n * u->frame_size;
 
+        if (u->verifying && j == 0)
+            verify_prediction(u, n_bytes);
+
 #ifdef DEBUG_TIMING
         pa_log_debug("avail: %lu", (unsigned long) n_bytes);
 #endif
@@ -842,6 +1027,9 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
         left_to_play = check_left_to_play(u, n_bytes, on_timeout);
         on_timeout = false;
 
+        if (j == 0)
+            u->cycle_headroom_usec = pa_bytes_to_usec(left_to_play, &u->sink->sample_spec);
+
         if (u->use_tsched)
 
             /* We won't fill up the playback buffer before at least
@@ -891,6 +1079,7 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
             snd_pcm_sframes_t frames;
             void *p;
             size_t written;
+            pa_usec_t write_start;
 
 /*         pa_log_debug("%lu frames to write", (unsigned long) frames); */
 
@@ -905,7 +1094,9 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
                 frames = (snd_pcm_sframes_t) (n_bytes/u->frame_size);
 
             p = pa_memblock_acquire(u->memchunk.memblock);
+            write_start = pa_rtclock_now();
             frames = snd_pcm_writei(u->pcm_handle, (const uint8_t*) p + u->memchunk.index, (snd_pcm_uframes_t) frames);
+            pa_cycle_timing_add(&u->sink->thread_info.cycle_stats.write, pa_rtclock_now() - write_start);
             pa_memblock_release(u->memchunk.memblock);
 
             if (PA_UNLIKELY(frames < 0)) {
@@ -942,6 +1133,11 @@ static int unix_write(struct userdata *u, pa_usec_t *sleep_usec, bool polled, bo
             u->write_count += written;
             u->since_start += written;
 
+            /* No avail query follows when predicting, so account for
+             * what we wrote ourselves */
+            if (u->predicting)
+                left_to_play += written;
+
 /*         pa_log_debug("wrote %lu frames", (unsigned long) frames); */
 
             if (written >= n_bytes)
@@ -1361,6 +1557,36 @@ static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offse
             sync_mixer(u, port);
             return 0;
         }
+
+        case SINK_MESSAGE_GET_WAKEUP_STATS: {
+            struct wakeup_report *r = data;
+
+            r->base.stats = u->wakeup_stats;
+            r->base.watermark_usec = u->use_tsched ? u->tsched_watermark_usec : 0;
+            r->n_predicted_wakeups = u->n_predicted_wakeups;
+            r->n_verified_wakeups = u->n_verified_wakeups;
+            r->prediction_drift_usec = u->prediction_drift_usec;
+            return 0;
+        }
+
+        case SINK_MESSAGE_GET_VOLUME_STATS: {
+            struct volume_report *r = data;
+
+            r->changes_requested = u->sink->thread_info.volume_changes_requested;
+            r->changes_coalesced = u->sink->thread_info.volume_changes_coalesced;
+            r->volume_writes = u->sink->thread_info.volume_writes;
+            r->mixer_writes = u->mixer_path ? u->mixer_path->n_volume_writes : 0;
+            return 0;
+        }
+
+        case SINK_MESSAGE_GET_RENDER_STATS: {
+            struct render_report *r = data;
+
+            r->written_bytes = u->write_count;
+            r->copied_bytes = u->sink->thread_info.render_copied_bytes;
+            r->copied_bytes_per_sec = u->copied_bytes_per_sec;
+            return 0;
+        }
     }
 
     return pa_sink_process_msg(o, code, data, offset, chunk);
@@ -1960,121 +2186,222 @@ rewind_done:
     return 0;
 }
 
-static void thread_func(void *userdata) {
-    struct userdata *u = userdata;
-    unsigned short revents = 0;
-
+/* Called from IO context. Handles pending rewinds, writes what is due and
+ * returns in *rtpoll_sleep when we have to be woken up next, 0 for only
+ * when the device or a message wakes us up. */
+static int thread_process(struct userdata *u, unsigned short revents, bool on_timeout, pa_usec_t *rtpoll_sleep) {
     pa_assert(u);
+    pa_assert(rtpoll_sleep);
 
-    pa_log_debug("Thread starting up");
+    *rtpoll_sleep = 0;
 
-    if (u->core->realtime_scheduling)
-        pa_thread_make_realtime(u->core->realtime_priority);
+    if (PA_UNLIKELY(u->sink->thread_info.rewind_requested)) {
+        if (process_rewind(u) < 0)
+            return -1;
+    }
 
-    pa_thread_mq_install(&u->thread_mq);
+    /* Render some data and write it to the dsp */
+    if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
+        int work_done;
+        pa_usec_t sleep_usec = 0, cycle_start;
+
+        /* Plain timer wakeups skip the device queries that only refine
+         * what the smoother already predicts, except every
+         * predict_wakeups-th one, which verifies the prediction */
+        u->predicting = u->verifying = false;
+        if (u->use_tsched && u->predict_wakeups > 1 && !u->first) {
+            if (on_timeout && !(revents & POLLOUT) && !u->after_rewind && u->predicted_left > 0) {
+                u->predicted_left--;
+                u->predicting = true;
+                u->n_predicted_wakeups++;
+            } else {
+                u->predicted_left = u->predict_wakeups - 1;
+                u->verifying = true;
+            }
+        }
 
-    for (;;) {
-        int ret;
-        pa_usec_t rtpoll_sleep = 0, real_sleep;
+        cycle_start = pa_rtclock_now();
+        u->cycle_headroom_usec = 0;
 
-#ifdef DEBUG_TIMING
-        pa_log_debug("Loop");
-#endif
-
-        if (PA_UNLIKELY(u->sink->thread_info.rewind_requested)) {
-            if (process_rewind(u) < 0)
-                goto fail;
-        }
+        if (u->use_mmap)
+            work_done = mmap_write(u, &sleep_usec, revents & POLLOUT, on_timeout);
+        else
+            work_done = unix_write(u, &sleep_usec, revents & POLLOUT, on_timeout);
 
-        /* Render some data and write it to the dsp */
-        if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
-            int work_done;
-            pa_usec_t sleep_usec = 0;
-            bool on_timeout = pa_rtpoll_timer_elapsed(u->rtpoll);
+        if (work_done < 0)
+            return -1;
 
-            if (u->use_mmap)
-                work_done = mmap_write(u, &sleep_usec, revents & POLLOUT, on_timeout);
-            else
-                work_done = unix_write(u, &sleep_usec, revents & POLLOUT, on_timeout);
+        if (work_done) {
+            pa_usec_t cycle_usec = pa_rtclock_now() - cycle_start;
 
-            if (work_done < 0)
-                goto fail;
+            pa_cycle_stats_add_cycle(&u->sink->thread_info.cycle_stats, cycle_usec, u->cycle_headroom_usec);
+            pa_io_trace(PA_IO_TRACE_ALSA_SINK_CYCLE, u->sink->index, (int64_t) u->cycle_headroom_usec, (int64_t) cycle_usec, (int64_t) sleep_usec);
+        }
 
-/*             pa_log_debug("work_done = %i", work_done); */
+/*         pa_log_debug("work_done = %i", work_done); */
 
-            if (work_done) {
+        if (work_done) {
 
-                if (u->first) {
-                    pa_log_info("Starting playback.");
-                    snd_pcm_start(u->pcm_handle);
+            if (u->first) {
+                pa_log_info("Starting playback.");
+                snd_pcm_start(u->pcm_handle);
 
 #ifdef USE_SMOOTHER_2
-                    pa_smoother_2_resume(u->smoother, pa_rtclock_now());
+                pa_smoother_2_resume(u->smoother, pa_rtclock_now());
 #else
-                    pa_smoother_resume(u->smoother, pa_rtclock_now(), true);
+                pa_smoother_resume(u->smoother, pa_rtclock_now(), true);
 #endif
 
-                    u->first = false;
-                }
+                u->first = false;
+            }
 
+            if (!u->predicting)
                 update_smoother(u);
-            }
+            update_copy_rate(u);
+        }
 
-            if (u->use_tsched) {
-                pa_usec_t cusec;
+        if (u->use_tsched) {
+            pa_usec_t cusec;
 
-                if (u->since_start <= u->hwbuf_size) {
+            if (u->since_start <= u->hwbuf_size) {
 
-                    /* USB devices on ALSA seem to hit a buffer
-                     * underrun during the first iterations much
-                     * quicker then we calculate here, probably due to
-                     * the transport latency. To accommodate for that
-                     * we artificially decrease the sleep time until
-                     * we have filled the buffer at least once
-                     * completely.*/
+                /* USB devices on ALSA seem to hit a buffer
+                 * underrun during the first iterations much
+                 * quicker then we calculate here, probably due to
+                 * the transport latency. To accommodate for that
+                 * we artificially decrease the sleep time until
+                 * we have filled the buffer at least once
+                 * completely.*/
 
-                    if (pa_log_ratelimit(PA_LOG_DEBUG))
-                        pa_log_debug("Cutting sleep time for the initial iterations by half.");
-                    sleep_usec /= 2;
-                }
+                if (pa_log_ratelimit(PA_LOG_DEBUG))
+                    pa_log_debug("Cutting sleep time for the initial iterations by half.");
+                sleep_usec /= 2;
+            }
 
-                /* OK, the playback buffer is now full, let's
-                 * calculate when to wake up next */
+            /* OK, the playback buffer is now full, let's
+             * calculate when to wake up next */
 #ifdef DEBUG_TIMING
-                pa_log_debug("Waking up in %0.2fms (sound card clock).", (double) sleep_usec / PA_USEC_PER_MSEC);
+            pa_log_debug("Waking up in %0.2fms (sound card clock).", (double) sleep_usec / PA_USEC_PER_MSEC);
 #endif
 
-                /* Convert from the sound card time domain to the
-                 * system time domain */
+            /* Convert from the sound card time domain to the
+             * system time domain */
 #ifdef USE_SMOOTHER_2
-                cusec = pa_smoother_2_translate(u->smoother, sleep_usec);
+            cusec = pa_smoother_2_translate(u->smoother, sleep_usec);
 #else
-                cusec = pa_smoother_translate(u->smoother, pa_rtclock_now(), sleep_usec);
+            cusec = pa_smoother_translate(u->smoother, pa_rtclock_now(), sleep_usec);
 #endif
 
 #ifdef DEBUG_TIMING
-                pa_log_debug("Waking up in %0.2fms (system clock).", (double) cusec / PA_USEC_PER_MSEC);
+            pa_log_debug("Waking up in %0.2fms (system clock).", (double) cusec / PA_USEC_PER_MSEC);
 #endif
 
-                /* We don't trust the conversion, so we wake up whatever comes first */
-                rtpoll_sleep = PA_MIN(sleep_usec, cusec);
-            }
+            /* We don't trust the conversion, so we wake up whatever comes first */
+            *rtpoll_sleep = PA_MIN(sleep_usec, cusec);
+        }
+
+        u->after_rewind = false;
 
-            u->after_rewind = false;
+    }
 
+    if (u->sink->flags & PA_SINK_DEFERRED_VOLUME) {
+        pa_usec_t volume_sleep;
+        pa_sink_volume_change_apply(u->sink, &volume_sleep);
+        if (volume_sleep > 0) {
+            if (*rtpoll_sleep > 0)
+                *rtpoll_sleep = PA_MIN(volume_sleep, *rtpoll_sleep);
+            else
+                *rtpoll_sleep = volume_sleep;
         }
+    }
 
-        if (u->sink->flags & PA_SINK_DEFERRED_VOLUME) {
-            pa_usec_t volume_sleep;
-            pa_sink_volume_change_apply(u->sink, &volume_sleep);
-            if (volume_sleep > 0) {
-                if (rtpoll_sleep > 0)
-                    rtpoll_sleep = PA_MIN(volume_sleep, rtpoll_sleep);
-                else
-                    rtpoll_sleep = volume_sleep;
-            }
+    return 0;
+}
+
+/* Called from IO context, after we slept real_sleep while we asked for
+ * rtpoll_sleep */
+static void thread_account_sleep(struct userdata *u, pa_usec_t rtpoll_sleep, pa_usec_t real_sleep) {
+    pa_assert(u);
+
+#ifdef DEBUG_TIMING
+    pa_log_debug("Expected sleep: %0.2fms, real sleep: %0.2fms (diff %0.2f ms)",
+        (double) rtpoll_sleep / PA_USEC_PER_MSEC, (double) real_sleep / PA_USEC_PER_MSEC,
+        (double) ((int64_t) real_sleep - (int64_t) rtpoll_sleep) / PA_USEC_PER_MSEC);
+#endif
+    if (u->use_tsched && real_sleep > rtpoll_sleep + u->tsched_watermark_usec)
+        pa_log_info("Scheduling delay of %0.2f ms > %0.2f ms, you might want to investigate this to improve latency...",
+            (double) (real_sleep - rtpoll_sleep) / PA_USEC_PER_MSEC,
+            (double) (u->tsched_watermark_usec) / PA_USEC_PER_MSEC);
+
+    /* Only timer wakeups tell us something about the scheduling delay */
+    if (u->use_tsched && real_sleep >= rtpoll_sleep)
+        pa_alsa_wakeup_stats_add(&u->wakeup_stats, real_sleep - rtpoll_sleep);
+}
+
+/* Called from IO context. Tells ALSA about the poll results and processes
+ * its response, *revents is what the next thread_process() gets. */
+static int thread_process_revents(struct userdata *u, unsigned short *revents) {
+    pa_assert(u);
+    pa_assert(revents);
+
+    if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
+        struct pollfd *pollfd;
+        int err;
+        unsigned n;
+
+        pollfd = pa_rtpoll_item_get_pollfd(u->alsa_rtpoll_item, &n);
+
+        if ((err = snd_pcm_poll_descriptors_revents(u->pcm_handle, pollfd, n, revents)) < 0) {
+            pa_log("snd_pcm_poll_descriptors_revents() failed: %s", pa_alsa_strerror(err));
+            return -1;
         }
 
+        if (*revents & ~POLLOUT) {
+            if ((err = pa_alsa_recover_from_poll(u->pcm_handle, *revents)) < 0)
+                return -1;
+
+            /* Stream needs to be restarted */
+            if (err == 1) {
+                close_pcm(u);
+                if (unsuspend(u, true) < 0)
+                    return -1;
+            } else
+                reset_vars(u);
+
+            *revents = 0;
+        } else if (*revents && u->use_tsched && pa_log_ratelimit(PA_LOG_DEBUG))
+            pa_log_debug("Wakeup from ALSA!");
+
+    } else
+        *revents = 0;
+
+    return 0;
+}
+
+static void thread_func(void *userdata) {
+    struct userdata *u = userdata;
+    unsigned short revents = 0;
+
+    pa_assert(u);
+
+    pa_log_debug("Thread starting up");
+
+    if (u->core->realtime_scheduling)
+        pa_thread_make_realtime(u->core->realtime_priority);
+
+    pa_thread_mq_install(&u->thread_mq);
+
+    for (;;) {
+        int ret;
+        pa_usec_t rtpoll_sleep = 0, real_sleep;
+
+#ifdef DEBUG_TIMING
+        pa_log_debug("Loop");
+#endif
+
+        if (thread_process(u, revents, pa_rtpoll_timer_elapsed(u->rtpoll), &rtpoll_sleep) < 0)
+            goto fail;
+
         if (rtpoll_sleep > 0) {
             pa_rtpoll_set_timer_relative(u->rtpoll, rtpoll_sleep);
             real_sleep = pa_rtclock_now();
@@ -2086,18 +2413,8 @@ static void thread_func(void *userdata) {
         if ((ret = pa_rtpoll_run(u->rtpoll)) < 0)
             goto fail;
 
-        if (rtpoll_sleep > 0) {
-            real_sleep = pa_rtclock_now() - real_sleep;
-#ifdef DEBUG_TIMING
-            pa_log_debug("Expected sleep: %0.2fms, real sleep: %0.2fms (diff %0.2f ms)",
-                (double) rtpoll_sleep / PA_USEC_PER_MSEC, (double) real_sleep / PA_USEC_PER_MSEC,
-                (double) ((int64_t) real_sleep - (int64_t) rtpoll_sleep) / PA_USEC_PER_MSEC);
-#endif
-            if (u->use_tsched && real_sleep > rtpoll_sleep + u->tsched_watermark_usec)
-                pa_log_info("Scheduling delay of %0.2f ms > %0.2f ms, you might want to investigate this to improve latency...",
-                    (double) (real_sleep - rtpoll_sleep) / PA_USEC_PER_MSEC,
-                    (double) (u->tsched_watermark_usec) / PA_USEC_PER_MSEC);
-        }
+        if (rtpoll_sleep > 0)
+            thread_account_sleep(u, rtpoll_sleep, pa_rtclock_now() - real_sleep);
 
         if (u->sink->flags & PA_SINK_DEFERRED_VOLUME)
             pa_sink_volume_change_apply(u->sink, NULL);
@@ -2105,47 +2422,279 @@ static void thread_func(void *userdata) {
         if (ret == 0)
             goto finish;
 
-        /* Tell ALSA about this and process its response */
-        if (PA_SINK_IS_OPENED(u->sink->thread_info.state)) {
-            struct pollfd *pollfd;
-            int err;
-            unsigned n;
+        if (thread_process_revents(u, &revents) < 0)
+            goto fail;
+    }
+
+fail:
+    /* If this was no regular exit from the loop we have to continue
+     * processing messages until we received PA_MESSAGE_SHUTDOWN */
+    pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->core), PA_CORE_MESSAGE_UNLOAD_MODULE, u->module, 0, NULL, NULL);
+    pa_asyncmsgq_wait_for(u->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
+
+finish:
+    pa_log_debug("Thread shutting down");
+}
+
+/* Called from the shared IO thread. Makes the core unload the module of a
+ * failed sink, once per module, while the other sinks keep running. */
+static void io_group_fail_member(alsa_io_group *g, struct userdata *u) {
+    struct userdata *i;
+
+    pa_assert(g);
+    pa_assert(u);
+
+    PA_LLIST_FOREACH(i, g->members)
+        if (i != u && i->io_failed && i->module == u->module)
+            break;
+
+    u->io_failed = true;
+
+    if (!i)
+        pa_asyncmsgq_post(g->thread_mq.outq, PA_MSGOBJECT(g->core), PA_CORE_MESSAGE_UNLOAD_MODULE, u->module, 0, NULL, NULL);
+}
+
+/* Same as thread_func(), but serves all sinks of one card. Every sink keeps
+ * its own wakeup deadline and the rtpoll sleeps until the earliest one. */
+static void io_group_thread_func(void *userdata) {
+    alsa_io_group *g = userdata;
+    struct userdata *u;
+
+    pa_assert(g);
+
+    pa_log_debug("Shared IO thread %s starting up", g->name);
+
+    if (g->core->realtime_scheduling)
+        pa_thread_make_realtime(g->core->realtime_priority);
+
+    pa_thread_mq_install(&g->thread_mq);
+
+    for (;;) {
+        int ret;
+        pa_usec_t now, deadline = 0;
+
+        now = pa_rtclock_now();
+
+        PA_LLIST_FOREACH(u, g->members) {
+            pa_usec_t rtpoll_sleep;
+            bool on_timeout;
+
+            if (u->io_failed)
+                continue;
 
-            pollfd = pa_rtpoll_item_get_pollfd(u->alsa_rtpoll_item, &n);
+            on_timeout = u->io_sleep > 0 && now >= u->io_sleep_start + u->io_sleep;
 
-            if ((err = snd_pcm_poll_descriptors_revents(u->pcm_handle, pollfd, n, &revents)) < 0) {
-                pa_log("snd_pcm_poll_descriptors_revents() failed: %s", pa_alsa_strerror(err));
-                goto fail;
+            /* Sinks that are not due yet and have neither device events nor
+             * a rewind pending keep their deadline, so that each of them
+             * does no more work than it would in a thread of its own. Their
+             * deferred volume changes still need to be written in time. */
+            if (u->io_sleep > 0 && !on_timeout && !u->io_revents && !u->sink->thread_info.rewind_requested) {
+                pa_usec_t member_deadline = u->io_sleep_start + u->io_sleep;
+
+                if (u->sink->flags & PA_SINK_DEFERRED_VOLUME) {
+                    pa_usec_t volume_sleep;
+
+                    pa_sink_volume_change_apply(u->sink, &volume_sleep);
+                    if (volume_sleep > 0)
+                        member_deadline = PA_MIN(member_deadline, now + volume_sleep);
+                }
+
+                if (deadline == 0 || member_deadline < deadline)
+                    deadline = member_deadline;
+
+                continue;
             }
 
-            if (revents & ~POLLOUT) {
-                if ((err = pa_alsa_recover_from_poll(u->pcm_handle, revents)) < 0)
-                    goto fail;
+            if (thread_process(u, u->io_revents, on_timeout, &rtpoll_sleep) < 0) {
+                io_group_fail_member(g, u);
+                continue;
+            }
 
-                /* Stream needs to be restarted */
-                if (err == 1) {
-                    close_pcm(u);
-                    if (unsuspend(u, true) < 0)
-                        goto fail;
-                } else
-                    reset_vars(u);
+            u->io_sleep = rtpoll_sleep;
+            if (rtpoll_sleep > 0) {
+                u->io_sleep_start = pa_rtclock_now();
 
-                revents = 0;
-            } else if (revents && u->use_tsched && pa_log_ratelimit(PA_LOG_DEBUG))
-                pa_log_debug("Wakeup from ALSA!");
+                if (deadline == 0 || u->io_sleep_start + rtpoll_sleep < deadline)
+                    deadline = u->io_sleep_start + rtpoll_sleep;
+            }
+        }
 
-        } else
-            revents = 0;
+        if (deadline > 0)
+            pa_rtpoll_set_timer_absolute(g->rtpoll, deadline);
+        else
+            pa_rtpoll_set_timer_disabled(g->rtpoll);
+
+        if ((ret = pa_rtpoll_run(g->rtpoll)) < 0)
+            goto fail;
+
+        now = pa_rtclock_now();
+
+        PA_LLIST_FOREACH(u, g->members) {
+            if (u->io_failed)
+                continue;
+
+            if (u->io_sleep > 0)
+                thread_account_sleep(u, u->io_sleep, now - u->io_sleep_start);
+
+            if (u->sink->flags & PA_SINK_DEFERRED_VOLUME)
+                pa_sink_volume_change_apply(u->sink, NULL);
+        }
+
+        if (ret == 0)
+            goto finish;
+
+        PA_LLIST_FOREACH(u, g->members) {
+            if (u->io_failed)
+                continue;
+
+            if (thread_process_revents(u, &u->io_revents) < 0)
+                io_group_fail_member(g, u);
+        }
     }
 
 fail:
-    /* If this was no regular exit from the loop we have to continue
-     * processing messages until we received PA_MESSAGE_SHUTDOWN */
-    pa_asyncmsgq_post(u->thread_mq.outq, PA_MSGOBJECT(u->core), PA_CORE_MESSAGE_UNLOAD_MODULE, u->module, 0, NULL, NULL);
-    pa_asyncmsgq_wait_for(u->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
+    PA_LLIST_FOREACH(u, g->members)
+        if (!u->io_failed)
+            io_group_fail_member(g, u);
+
+    pa_asyncmsgq_wait_for(g->thread_mq.inq, PA_MESSAGE_SHUTDOWN);
 
 finish:
-    pa_log_debug("Thread shutting down");
+    pa_log_debug("Shared IO thread %s shutting down", g->name);
+}
+
+/* Called from the shared IO thread */
+static int io_group_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    alsa_io_group *g = ALSA_IO_GROUP(o);
+    struct userdata *u = data;
+
+    pa_assert(u);
+
+    switch (code) {
+
+        case IO_GROUP_MESSAGE_ADD:
+            /* The mixer poll item has to be created in here, since the
+             * rtpoll is already in use by the other sinks */
+            if (u->mixer_pd && pa_alsa_set_mixer_rtpoll(u->mixer_pd, u->mixer_handle, g->rtpoll) < 0) {
+                pa_log("Failed to initialize file descriptor monitoring");
+                return -1;
+            }
+
+            PA_LLIST_PREPEND(struct userdata, g->members, u);
+            return 0;
+
+        case IO_GROUP_MESSAGE_REMOVE:
+            PA_LLIST_REMOVE(struct userdata, g->members, u);
+
+            if (u->alsa_rtpoll_item) {
+                pa_rtpoll_item_free(u->alsa_rtpoll_item);
+                u->alsa_rtpoll_item = NULL;
+            }
+
+            if (u->mixer_pd) {
+                pa_alsa_mixer_pdata_free(u->mixer_pd);
+                u->mixer_pd = NULL;
+            }
+
+            return 0;
+    }
+
+    return -1;
+}
+
+/* Called from main context. Moves the sink from its own rtpoll and message
+ * queue to the ones of the IO thread shared by all sinks on the card,
+ * starting that thread if this is the first sink. Returns 0 without joining
+ * if the device is not backed by a card. */
+static int io_group_join(struct userdata *u) {
+    snd_pcm_info_t *pcm_info;
+    alsa_io_group *g;
+    char *name;
+    int card;
+
+    pa_assert(u);
+    pa_assert(!u->io_group);
+
+    snd_pcm_info_alloca(&pcm_info);
+    if (snd_pcm_info(u->pcm_handle, pcm_info) < 0 || (card = snd_pcm_info_get_card(pcm_info)) < 0) {
+        pa_log_info("Device %s is not backed by a sound card, not sharing an IO thread.", u->device_name);
+        return 0;
+    }
+
+    name = pa_sprintf_malloc("alsa-sink-io-%i", card);
+
+    if (!(g = pa_shared_get(u->core, name))) {
+        g = pa_msgobject_new(alsa_io_group);
+        g->parent.process_msg = io_group_process_msg;
+        g->core = u->core;
+        g->name = name;
+        g->rtpoll = pa_rtpoll_new();
+        PA_LLIST_HEAD_INIT(struct userdata, g->members);
+
+        if (pa_thread_mq_init(&g->thread_mq, u->core->mainloop, g->rtpoll) < 0) {
+            pa_log("pa_thread_mq_init() failed.");
+            goto fail;
+        }
+
+        if (!(g->thread = pa_thread_new(name, io_group_thread_func, g))) {
+            pa_log("Failed to create thread.");
+            goto fail;
+        }
+
+        pa_shared_set(u->core, g->name, g);
+    } else
+        pa_xfree(name);
+
+    g->n_sinks++;
+
+    pa_thread_mq_done(&u->thread_mq);
+    pa_rtpoll_free(u->rtpoll);
+
+    /* Borrowed from the group, see io_group_leave() */
+    u->thread_mq = g->thread_mq;
+    u->rtpoll = g->rtpoll;
+    u->io_group = g;
+
+    pa_log_info("Sharing IO thread %s with %u other sink(s).", g->name, g->n_sinks - 1);
+
+    return 0;
+
+fail:
+    pa_thread_mq_done(&g->thread_mq);
+    pa_rtpoll_free(g->rtpoll);
+    pa_xfree(g->name);
+    alsa_io_group_unref(g);
+
+    return -1;
+}
+
+/* Called from main context */
+static void io_group_leave(struct userdata *u) {
+    alsa_io_group *g;
+
+    pa_assert(u);
+    pa_assert_se(g = u->io_group);
+
+    if (u->io_joined)
+        pa_asyncmsgq_send(g->thread_mq.inq, PA_MSGOBJECT(g), IO_GROUP_MESSAGE_REMOVE, u, 0, NULL);
+
+    pa_zero(u->thread_mq);
+    u->rtpoll = NULL;
+    u->io_group = NULL;
+    u->io_joined = false;
+
+    if (--g->n_sinks > 0)
+        return;
+
+    pa_shared_remove(g->core, g->name);
+
+    pa_asyncmsgq_send(g->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(g->thread);
+
+    pa_thread_mq_done(&g->thread_mq);
+    pa_rtpoll_free(g->rtpoll);
+    pa_xfree(g->name);
+    alsa_io_group_unref(g);
 }
 
 static void set_sink_name(pa_sink_new_data *data, pa_modargs *ma, const char *device_id, const char *device_name, pa_alsa_mapping *mapping) {
@@ -2302,7 +2851,8 @@ static int setup_mixer(struct userdata *u, bool ignore_dB) {
             u->mixer_pd = pa_alsa_mixer_pdata_new();
             mixer_callback = io_mixer_callback;
 
-            if (pa_alsa_set_mixer_rtpoll(u->mixer_pd, u->mixer_handle, u->rtpoll) < 0) {
+            /* A shared IO thread sets this up when the sink joins it */
+            if (!u->io_group && pa_alsa_set_mixer_rtpoll(u->mixer_pd, u->mixer_handle, u->rtpoll) < 0) {
                 pa_log("Failed to initialize file descriptor monitoring");
                 return -1;
             }
@@ -2325,6 +2875,64 @@ static int setup_mixer(struct userdata *u, bool ignore_dB) {
     return 0;
 }
 
+/* Called from main context */
+static int sink_message_handler(const char *object_path, const char *message, const pa_json_object *parameters, char **response, void *userdata) {
+    struct userdata *u = userdata;
+    pa_json_encoder *encoder;
+
+    pa_assert(u);
+    pa_assert(message);
+    pa_assert(response);
+
+    if (pa_streq(message, "get-wakeup-stats")) {
+        struct wakeup_report r;
+
+        pa_assert_se(pa_asyncmsgq_send(u->sink->asyncmsgq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_GET_WAKEUP_STATS, &r, 0, NULL) == 0);
+
+        encoder = pa_json_encoder_new();
+        pa_json_encoder_begin_element_object(encoder);
+        pa_alsa_wakeup_report_to_json(&r.base, u->adaptive_watermark, encoder);
+        pa_json_encoder_add_member_int(encoder, "predict_wakeups", u->predict_wakeups);
+        pa_json_encoder_add_member_int(encoder, "predicted_wakeups", (int64_t) r.n_predicted_wakeups);
+        pa_json_encoder_add_member_int(encoder, "verified_wakeups", (int64_t) r.n_verified_wakeups);
+        pa_json_encoder_add_member_int(encoder, "prediction_drift_usec", r.prediction_drift_usec);
+        pa_json_encoder_end_object(encoder);
+
+    } else if (pa_streq(message, "get-render-stats")) {
+        struct render_report r;
+
+        pa_assert_se(pa_asyncmsgq_send(u->sink->asyncmsgq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_GET_RENDER_STATS, &r, 0, NULL) == 0);
+
+        encoder = pa_json_encoder_new();
+        pa_json_encoder_begin_element_object(encoder);
+        pa_json_encoder_add_member_bool(encoder, "mmap", u->use_mmap);
+        pa_json_encoder_add_member_int(encoder, "written_bytes", (int64_t) r.written_bytes);
+        pa_json_encoder_add_member_int(encoder, "copied_bytes", (int64_t) r.copied_bytes);
+        pa_json_encoder_add_member_int(encoder, "copied_bytes_per_sec", (int64_t) r.copied_bytes_per_sec);
+        pa_json_encoder_end_object(encoder);
+
+    } else if (pa_streq(message, "get-volume-stats")) {
+        struct volume_report r;
+
+        pa_assert_se(pa_asyncmsgq_send(u->sink->asyncmsgq, PA_MSGOBJECT(u->sink), SINK_MESSAGE_GET_VOLUME_STATS, &r, 0, NULL) == 0);
+
+        encoder = pa_json_encoder_new();
+        pa_json_encoder_begin_element_object(encoder);
+        pa_json_encoder_add_member_bool(encoder, "deferred_volume", !!(u->sink->flags & PA_SINK_DEFERRED_VOLUME));
+        pa_json_encoder_add_member_int(encoder, "coalesce_usec", (int64_t) u->sink->thread_info.volume_change_coalesce);
+        pa_json_encoder_add_member_int(encoder, "changes_requested", (int64_t) r.changes_requested);
+        pa_json_encoder_add_member_int(encoder, "changes_coalesced", (int64_t) r.changes_coalesced);
+        pa_json_encoder_add_member_int(encoder, "volume_writes", (int64_t) r.volume_writes);
+        pa_json_encoder_add_member_int(encoder, "mixer_writes", (int64_t) r.mixer_writes);
+        pa_json_encoder_end_object(encoder);
+
+    } else
+        return -PA_ERR_NOTIMPLEMENTED;
+
+    *response = pa_json_encoder_to_string_free(encoder);
+    return 0;
+}
+
 pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_card *card, pa_alsa_mapping *mapping) {
 
     struct userdata *u = NULL;
@@ -2343,6 +2951,9 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
     bool deferred_volume = false;
     bool set_formats = false;
     bool fixed_latency_range = false;
+    bool adaptive_watermark = false;
+    uint32_t predict_wakeups = 0;
+    bool shared_io_thread = false;
     bool b;
     bool d;
     bool avoid_resampling;
@@ -2443,6 +3054,21 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "adaptive_watermark", &adaptive_watermark) < 0) {
+        pa_log("Failed to parse adaptive_watermark argument.");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_u32(ma, "predict_wakeups", &predict_wakeups) < 0) {
+        pa_log("Failed to parse predict_wakeups argument.");
+        goto fail;
+    }
+
+    if (pa_modargs_get_value_boolean(ma, "shared_io_thread", &shared_io_thread) < 0) {
+        pa_log("Failed to parse shared_io_thread argument.");
+        goto fail;
+    }
+
     use_tsched = pa_alsa_may_tsched(use_tsched);
 
     u = pa_xnew0(struct userdata, 1);
@@ -2458,6 +3084,8 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
     u->initial_info.rewind_safeguard = (size_t) rewind_safeguard;
     u->deferred_volume = deferred_volume;
     u->fixed_latency_range = fixed_latency_range;
+    u->adaptive_watermark = adaptive_watermark;
+    u->predict_wakeups = predict_wakeups;
     u->first = true;
     u->rewind_safeguard = rewind_safeguard;
     u->rtpoll = pa_rtpoll_new();
@@ -2735,6 +3363,12 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
         goto fail;
     }
 
+    if (pa_modargs_get_value_u32(ma, "deferred_volume_coalesce",
+                                 &u->sink->thread_info.volume_change_coalesce) < 0) {
+        pa_log("Failed to parse deferred_volume_coalesce parameter");
+        goto fail;
+    }
+
     u->sink->parent.process_msg = sink_process_msg;
     if (u->use_tsched)
         u->sink->update_requested_latency = sink_update_requested_latency_cb;
@@ -2747,6 +3381,9 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
     u->sink->reconfigure = sink_reconfigure_cb;
     u->sink->userdata = u;
 
+    if (shared_io_thread && io_group_join(u) < 0)
+        goto fail;
+
     pa_sink_set_asyncmsgq(u->sink, u->thread_mq.inq);
     pa_sink_set_rtpoll(u->sink, u->rtpoll);
 
@@ -2787,13 +3424,19 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
 
     pa_alsa_dump(PA_LOG_DEBUG, u->pcm_handle);
 
-    thread_name = pa_sprintf_malloc("alsa-sink-%s", pa_strnull(pa_proplist_gets(u->sink->proplist, "alsa.id")));
-    if (!(u->thread = pa_thread_new(thread_name, thread_func, u))) {
-        pa_log("Failed to create thread.");
-        goto fail;
+    if (u->io_group) {
+        if (pa_asyncmsgq_send(u->io_group->thread_mq.inq, PA_MSGOBJECT(u->io_group), IO_GROUP_MESSAGE_ADD, u, 0, NULL) < 0)
+            goto fail;
+        u->io_joined = true;
+    } else {
+        thread_name = pa_sprintf_malloc("alsa-sink-%s", pa_strnull(pa_proplist_gets(u->sink->proplist, "alsa.id")));
+        if (!(u->thread = pa_thread_new(thread_name, thread_func, u))) {
+            pa_log("Failed to create thread.");
+            goto fail;
+        }
+        pa_xfree(thread_name);
+        thread_name = NULL;
     }
-    pa_xfree(thread_name);
-    thread_name = NULL;
 
     /* Get initial mixer settings */
     if (volume_is_set) {
@@ -2836,6 +3479,10 @@ pa_sink *pa_alsa_sink_new(pa_module *m, pa_modargs *ma, const char*driver, pa_ca
 
     pa_sink_put(u->sink);
 
+    u->message_handler_path = pa_sprintf_malloc("/sink/%s/alsa", u->sink->name);
+    pa_message_handler_register(m->core, u->message_handler_path, "ALSA sink message handler",
+                                sink_message_handler, (void *) u);
+
     if (profile_set)
         pa_alsa_profile_set_free(profile_set);
 
@@ -2873,9 +3520,17 @@ fail:
 static void userdata_free(struct userdata *u) {
     pa_assert(u);
 
+    if (u->message_handler_path) {
+        pa_message_handler_unregister(u->core, u->message_handler_path);
+        pa_xfree(u->message_handler_path);
+    }
+
     if (u->sink)
         pa_sink_unlink(u->sink);
 
+    if (u->io_group)
+        io_group_leave(u);
+
     if (u->thread) {
         pa_asyncmsgq_send(u->thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
         pa_thread_free(u->thread);
@@ -42,8 +42,10 @@
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/sample-util.h>
+#include <pulsecore/io-trace.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/message-handler.h>
 #include <pulsecore/thread.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/rtpoll.h>
@@ -76,6 +78,7 @@
 #define TSCHED_MIN_SLEEP_USEC (10*PA_USEC_PER_MSEC)                /* 10ms */
 #define TSCHED_MIN_WAKEUP_USEC (4*PA_USEC_PER_MSEC)                /* 4ms */
 
+
 #ifdef USE_SMOOTHER_2
 #define SMOOTHER_WINDOW_USEC  (15*PA_USEC_PER_SEC)                 /* 15s */
 #else
@@ -143,10 +146,16 @@ struct userdata {
     char *device_name;  /* name of the PCM device */
     char *control_device; /* name of the control device */
 
-    bool use_mmap:1, use_tsched:1, deferred_volume:1, fixed_latency_range:1;
+    bool use_mmap:1, use_tsched:1, deferred_volume:1, fixed_latency_range:1, adaptive_watermark:1;
 
     bool first;
 
+    /* Space left in the device when the current IO cycle began */
+    pa_usec_t cycle_headroom_usec;
+
+    pa_alsa_wakeup_stats wakeup_stats;
+    char *message_handler_path;
+
     pa_rtpoll_item *alsa_rtpoll_item;
 
 #ifdef USE_SMOOTHER_2
@@ -156,6 +165,10 @@ struct userdata {
 #endif
     uint64_t read_count;
 
+    /* Bytes copied out of the mmap area because source outputs still
+     * referenced them after posting */
+    uint64_t mmap_copied_bytes;
+
 #ifndef USE_SMOOTHER_2
     pa_usec_t smoother_interval;
     pa_usec_t last_smoother_update;
@@ -171,7 +184,24 @@ struct userdata {
 };
 
 enum {
-    SOURCE_MESSAGE_SYNC_MIXER = PA_SOURCE_MESSAGE_MAX
+    SOURCE_MESSAGE_SYNC_MIXER = PA_SOURCE_MESSAGE_MAX,
+    SOURCE_MESSAGE_GET_WAKEUP_STATS,
+    SOURCE_MESSAGE_GET_VOLUME_STATS,
+    SOURCE_MESSAGE_GET_CAPTURE_STATS
+};
+
+struct capture_report {
+    uint64_t read_bytes;
+    uint64_t mmap_copied_bytes;
+    uint64_t post_copied_bytes;
+    unsigned n_outputs;
+};
+
+struct volume_report {
+    uint64_t changes_requested;
+    uint64_t changes_coalesced;
+    uint64_t volume_writes;
+    uint64_t mixer_writes;
 };
 
 static void userdata_free(struct userdata *u);
@@ -402,6 +432,29 @@ restart:
     u->watermark_dec_not_before = now + TSCHED_WATERMARK_VERIFY_AFTER_USEC;
 }
 
+/* Called from IO context. See pa_alsa_adapt_watermark() */
+static void adapt_watermark(struct userdata *u, bool overrun) {
+    size_t old_watermark;
+
+    pa_assert(u);
+    pa_assert(u->use_tsched);
+
+    if (overrun)
+        increase_watermark(u);
+
+    old_watermark = u->tsched_watermark;
+
+    if (!pa_alsa_adapt_watermark(&u->wakeup_stats, overrun, TSCHED_MIN_WAKEUP_USEC, &u->source->sample_spec,
+                                 &u->watermark_dec_not_before, &u->tsched_watermark))
+        return;
+
+    fix_tsched_watermark(u);
+
+    if (old_watermark != u->tsched_watermark)
+        pa_log_info("Adapting wakeup watermark to %0.2f ms",
+                    (double) u->tsched_watermark_usec / PA_USEC_PER_MSEC);
+}
+
 /* Called from IO Context on unsuspend or from main thread when creating source */
 static void reset_watermark(struct userdata *u, size_t tsched_watermark, pa_sample_spec *ss,
                             bool in_thread) {
@@ -551,6 +604,8 @@ static size_t check_left_to_record(struct userdata *u, size_t n_bytes, bool on_t
         PA_DEBUG_TRAP;
 #endif
 
+        pa_atomic_inc(&u->source->n_overruns);
+
         if (pa_log_ratelimit(PA_LOG_INFO))
             pa_log_info("Overrun!");
     }
@@ -559,7 +614,9 @@ static size_t check_left_to_record(struct userdata *u, size_t n_bytes, bool on_t
     pa_log_debug("%0.2f ms left to record", (double) pa_bytes_to_usec(left_to_record, &u->source->sample_spec) / PA_USEC_PER_MSEC);
 #endif
 
-    if (u->use_tsched) {
+    if (u->use_tsched && u->adaptive_watermark)
+        adapt_watermark(u, overrun || left_to_record < u->watermark_inc_threshold);
+    else if (u->use_tsched) {
         bool reset_not_before = true;
 
         if (overrun || left_to_record < u->watermark_inc_threshold)
@@ -619,6 +676,9 @@ static int mmap_read(struct userdata *u, pa_usec_t *sleep_usec, bool polled, boo
         left_to_record = check_left_to_record(u, n_bytes, on_timeout);
         on_timeout = false;
 
+        if (j == 0)
+            u->cycle_headroom_usec = pa_bytes_to_usec(left_to_record, &u->source->sample_spec);
+
         if (u->use_tsched)
             if (!polled &&
                 pa_bytes_to_usec(left_to_record, &u->source->sample_spec) > process_usec+max_sleep_usec/2) {
@@ -667,6 +727,7 @@ static int mmap_read(struct userdata *u, pa_usec_t *sleep_usec, bool polled, boo
             const snd_pcm_channel_area_t *areas;
             snd_pcm_uframes_t offset, frames;
             snd_pcm_sframes_t sframes;
+            pa_usec_t read_start;
 
             frames = (snd_pcm_uframes_t) (n_bytes / u->frame_size);
 /*             pa_log_debug("%lu frames to read", (unsigned long) frames); */
@@ -710,9 +771,19 @@ static int mmap_read(struct userdata *u, pa_usec_t *sleep_usec, bool polled, boo
             chunk.index = 0;
 
             pa_source_post(u->source, &chunk);
+
+            /* All outputs that kept a reference share a single copy made
+             * by pa_memblock_unref_fixed() */
+            if (!pa_memblock_ref_is_one(chunk.memblock))
+                u->mmap_copied_bytes += chunk.length;
+
             pa_memblock_unref_fixed(chunk.memblock);
 
-            if (PA_UNLIKELY((sframes = snd_pcm_mmap_commit(u->pcm_handle, offset, frames)) < 0)) {
+            read_start = pa_rtclock_now();
+            sframes = snd_pcm_mmap_commit(u->pcm_handle, offset, frames);
+            pa_cycle_timing_add(&u->source->thread_info.cycle_stats.write, pa_rtclock_now() - read_start);
+
+            if (PA_UNLIKELY(sframes < 0)) {
 
                 recovery_done = true;
                 if ((r = try_recover(u, "snd_pcm_mmap_commit", (int) sframes)) == 0)
@@ -789,6 +860,9 @@ static int unix_read(struct userdata *u, pa_usec_t *sleep_usec, bool polled, boo
         left_to_record = check_left_to_record(u, n_bytes, on_timeout);
         on_timeout = false;
 
+        if (j == 0)
+            u->cycle_headroom_usec = pa_bytes_to_usec(left_to_record, &u->source->sample_spec);
+
         if (u->use_tsched)
             if (!polled &&
                 pa_bytes_to_usec(left_to_record, &u->source->sample_spec) > process_usec+max_sleep_usec/2)
@@ -823,6 +897,7 @@ static int unix_read(struct userdata *u, pa_usec_t *sleep_usec, bool polled, boo
             void *p;
             snd_pcm_sframes_t frames;
             pa_memchunk chunk;
+            pa_usec_t read_start;
 
             chunk.memblock = pa_memblock_new(u->core->mempool, (size_t) -1);
 
@@ -834,7 +909,9 @@ static int unix_read(struct userdata *u, pa_usec_t *sleep_usec, bool polled, boo
 /*             pa_log_debug("%lu frames to read", (unsigned long) n); */
 
             p = pa_memblock_acquire(chunk.memblock);
+            read_start = pa_rtclock_now();
             frames = snd_pcm_readi(u->pcm_handle, (uint8_t*) p, (snd_pcm_uframes_t) frames);
+            pa_cycle_timing_add(&u->source->thread_info.cycle_stats.write, pa_rtclock_now() - read_start);
             pa_memblock_release(chunk.memblock);
 
             if (PA_UNLIKELY(frames < 0)) {
@@ -1235,6 +1312,34 @@ static int source_process_msg(pa_msgobject *o, int code, void *data, int64_t off
             sync_mixer(u, port);
             return 0;
         }
+
+        case SOURCE_MESSAGE_GET_WAKEUP_STATS: {
+            pa_alsa_wakeup_report *r = data;
+
+            r->stats = u->wakeup_stats;
+            r->watermark_usec = u->use_tsched ? u->tsched_watermark_usec : 0;
+            return 0;
+        }
+
+        case SOURCE_MESSAGE_GET_CAPTURE_STATS: {
+            struct capture_report *r = data;
+
+            r->read_bytes = u->read_count;
+            r->mmap_copied_bytes = u->mmap_copied_bytes;
+            r->post_copied_bytes = u->source->thread_info.post_copied_bytes;
+            r->n_outputs = pa_hashmap_size(u->source->thread_info.outputs);
+            return 0;
+        }
+
+        case SOURCE_MESSAGE_GET_VOLUME_STATS: {
+            struct volume_report *r = data;
+
+            r->changes_requested = u->source->thread_info.volume_changes_requested;
+            r->changes_coalesced = u->source->thread_info.volume_changes_coalesced;
+            r->volume_writes = u->source->thread_info.volume_writes;
+            r->mixer_writes = u->mixer_path ? u->mixer_path->n_volume_writes : 0;
+            return 0;
+        }
     }
 
     return pa_source_process_msg(o, code, data, offset, chunk);
@@ -1716,7 +1821,7 @@ static void thread_func(void *userdata) {
         /* Read some data and pass it to the sources */
         if (PA_SOURCE_IS_OPENED(u->source->thread_info.state)) {
             int work_done;
-            pa_usec_t sleep_usec = 0;
+            pa_usec_t sleep_usec = 0, cycle_start;
             bool on_timeout = pa_rtpoll_timer_elapsed(u->rtpoll);
 
             if (u->first) {
@@ -1732,6 +1837,9 @@ static void thread_func(void *userdata) {
                 u->first = false;
             }
 
+            cycle_start = pa_rtclock_now();
+            u->cycle_headroom_usec = 0;
+
             if (u->use_mmap)
                 work_done = mmap_read(u, &sleep_usec, revents & POLLIN, on_timeout);
             else
@@ -1740,6 +1848,13 @@ static void thread_func(void *userdata) {
             if (work_done < 0)
                 goto fail;
 
+            if (work_done) {
+                pa_usec_t cycle_usec = pa_rtclock_now() - cycle_start;
+
+                pa_cycle_stats_add_cycle(&u->source->thread_info.cycle_stats, cycle_usec, u->cycle_headroom_usec);
+                pa_io_trace(PA_IO_TRACE_ALSA_SOURCE_CYCLE, u->source->index, (int64_t) u->cycle_headroom_usec, (int64_t) cycle_usec, (int64_t) sleep_usec);
+            }
+
 /*             pa_log_debug("work_done = %i", work_done); */
 
             if (work_done)
@@ -1801,6 +1916,10 @@ static void thread_func(void *userdata) {
                 pa_log_info("Scheduling delay of %0.2f ms > %0.2f ms, you might want to investigate this to improve latency...",
                     (double) (real_sleep - rtpoll_sleep) / PA_USEC_PER_MSEC,
                     (double) (u->tsched_watermark_usec) / PA_USEC_PER_MSEC);
+
+            /* Only timer wakeups tell us something about the scheduling delay */
+            if (u->use_tsched && real_sleep >= rtpoll_sleep)
+                pa_alsa_wakeup_stats_add(&u->wakeup_stats, real_sleep - rtpoll_sleep);
         }
 
         if (u->source->flags & PA_SOURCE_DEFERRED_VOLUME)
@@ -2029,6 +2148,61 @@ static int setup_mixer(struct userdata *u, bool ignore_dB) {
     return 0;
 }
 
+/* Called from main context */
+static int source_message_handler(const char *object_path, const char *message, const pa_json_object *parameters, char **response, void *userdata) {
+    struct userdata *u = userdata;
+    pa_json_encoder *encoder;
+
+    pa_assert(u);
+    pa_assert(message);
+    pa_assert(response);
+
+    if (pa_streq(message, "get-wakeup-stats")) {
+        pa_alsa_wakeup_report r;
+
+        pa_assert_se(pa_asyncmsgq_send(u->source->asyncmsgq, PA_MSGOBJECT(u->source), SOURCE_MESSAGE_GET_WAKEUP_STATS, &r, 0, NULL) == 0);
+
+        encoder = pa_json_encoder_new();
+        pa_json_encoder_begin_element_object(encoder);
+        pa_alsa_wakeup_report_to_json(&r, u->adaptive_watermark, encoder);
+        pa_json_encoder_end_object(encoder);
+
+    } else if (pa_streq(message, "get-volume-stats")) {
+        struct volume_report r;
+
+        pa_assert_se(pa_asyncmsgq_send(u->source->asyncmsgq, PA_MSGOBJECT(u->source), SOURCE_MESSAGE_GET_VOLUME_STATS, &r, 0, NULL) == 0);
+
+        encoder = pa_json_encoder_new();
+        pa_json_encoder_begin_element_object(encoder);
+        pa_json_encoder_add_member_bool(encoder, "deferred_volume", !!(u->source->flags & PA_SOURCE_DEFERRED_VOLUME));
+        pa_json_encoder_add_member_int(encoder, "coalesce_usec", (int64_t) u->source->thread_info.volume_change_coalesce);
+        pa_json_encoder_add_member_int(encoder, "changes_requested", (int64_t) r.changes_requested);
+        pa_json_encoder_add_member_int(encoder, "changes_coalesced", (int64_t) r.changes_coalesced);
+        pa_json_encoder_add_member_int(encoder, "volume_writes", (int64_t) r.volume_writes);
+        pa_json_encoder_add_member_int(encoder, "mixer_writes", (int64_t) r.mixer_writes);
+        pa_json_encoder_end_object(encoder);
+
+    } else if (pa_streq(message, "get-capture-stats")) {
+        struct capture_report r;
+
+        pa_assert_se(pa_asyncmsgq_send(u->source->asyncmsgq, PA_MSGOBJECT(u->source), SOURCE_MESSAGE_GET_CAPTURE_STATS, &r, 0, NULL) == 0);
+
+        encoder = pa_json_encoder_new();
+        pa_json_encoder_begin_element_object(encoder);
+        pa_json_encoder_add_member_bool(encoder, "mmap", u->use_mmap);
+        pa_json_encoder_add_member_int(encoder, "outputs", r.n_outputs);
+        pa_json_encoder_add_member_int(encoder, "read_bytes", (int64_t) r.read_bytes);
+        pa_json_encoder_add_member_int(encoder, "mmap_copied_bytes", (int64_t) r.mmap_copied_bytes);
+        pa_json_encoder_add_member_int(encoder, "post_copied_bytes", (int64_t) r.post_copied_bytes);
+        pa_json_encoder_end_object(encoder);
+
+    } else
+        return -PA_ERR_NOTIMPLEMENTED;
+
+    *response = pa_json_encoder_to_string_free(encoder);
+    return 0;
+}
+
 pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, pa_card *card, pa_alsa_mapping *mapping) {
 
     struct userdata *u = NULL;
@@ -2046,6 +2220,7 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
     bool namereg_fail = false;
     bool deferred_volume = false;
     bool fixed_latency_range = false;
+    bool adaptive_watermark = false;
     bool b;
     bool d;
     bool avoid_resampling;
@@ -2136,6 +2311,11 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(ma, "adaptive_watermark", &adaptive_watermark) < 0) {
+        pa_log("Failed to parse adaptive_watermark argument.");
+        goto fail;
+    }
+
     use_tsched = pa_alsa_may_tsched(use_tsched);
 
     u = pa_xnew0(struct userdata, 1);
@@ -2150,6 +2330,7 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
     u->initial_info.tsched_watermark = (size_t) tsched_watermark;
     u->deferred_volume = deferred_volume;
     u->fixed_latency_range = fixed_latency_range;
+    u->adaptive_watermark = adaptive_watermark;
     u->first = true;
     u->rtpoll = pa_rtpoll_new();
 
@@ -2394,6 +2575,12 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
         goto fail;
     }
 
+    if (pa_modargs_get_value_u32(ma, "deferred_volume_coalesce",
+                                 &u->source->thread_info.volume_change_coalesce) < 0) {
+        pa_log("Failed to parse deferred_volume_coalesce parameter");
+        goto fail;
+    }
+
     u->source->parent.process_msg = source_process_msg;
     if (u->use_tsched)
         u->source->update_requested_latency = source_update_requested_latency_cb;
@@ -2473,6 +2660,10 @@ pa_source *pa_alsa_source_new(pa_module *m, pa_modargs *ma, const char*driver, p
 
     pa_source_put(u->source);
 
+    u->message_handler_path = pa_sprintf_malloc("/source/%s/alsa", u->source->name);
+    pa_message_handler_register(m->core, u->message_handler_path, "ALSA source message handler",
+                                source_message_handler, (void *) u);
+
     if (profile_set)
         pa_alsa_profile_set_free(profile_set);
 
@@ -2493,6 +2684,11 @@ fail:
 static void userdata_free(struct userdata *u) {
     pa_assert(u);
 
+    if (u->message_handler_path) {
+        pa_message_handler_unregister(u->core, u->message_handler_path);
+        pa_xfree(u->message_handler_path);
+    }
+
     if (u->source)
         pa_source_unlink(u->source);
 
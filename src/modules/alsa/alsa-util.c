@@ -25,6 +25,7 @@
 #include <sys/types.h>
 #include <alsa/asoundlib.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/sample.h>
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
@@ -1654,6 +1655,60 @@ bool pa_alsa_may_tsched(bool want) {
 
 #define SND_MIXER_ELEM_PULSEAUDIO (SND_MIXER_ELEM_LAST + 10)
 
+/* Maps the ids of the controls seen by our mixer class to their mixer
+ * elements, so that they can be found without walking all elements of the
+ * mixer, which gets slow on cards with hundreds of controls. The index is
+ * owned by the mixer class and is freed together with it. Mixers are only
+ * opened and closed from the main thread. */
+struct mixer_index {
+    snd_mixer_t *mixer;
+    pa_hashmap *elems;
+};
+
+/* snd_mixer_t -> struct mixer_index */
+static pa_hashmap *mixer_indexes = NULL;
+
+static char *mixer_index_key(snd_ctl_elem_iface_t iface,
+                             const char *name,
+                             unsigned int index,
+                             unsigned int device,
+                             unsigned int subdevice) {
+    return pa_sprintf_malloc("%i:%u:%u:%u:%s", (int) iface, index, device, subdevice, name);
+}
+
+static void mixer_index_free(snd_mixer_class_t *class) {
+    struct mixer_index *mi = snd_mixer_class_get_private(class);
+
+    if (!mi)
+        return;
+
+    if (mixer_indexes) {
+        pa_hashmap_remove(mixer_indexes, mi->mixer);
+
+        if (pa_hashmap_isempty(mixer_indexes)) {
+            pa_hashmap_free(mixer_indexes);
+            mixer_indexes = NULL;
+        }
+    }
+
+    pa_hashmap_free(mi->elems);
+    pa_xfree(mi);
+}
+
+static struct mixer_index *mixer_index_new(snd_mixer_t *mixer) {
+    struct mixer_index *mi;
+
+    mi = pa_xnew0(struct mixer_index, 1);
+    mi->mixer = mixer;
+    mi->elems = pa_hashmap_new_full(pa_idxset_string_hash_func, pa_idxset_string_compare_func, pa_xfree, NULL);
+
+    if (!mixer_indexes)
+        mixer_indexes = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
+    pa_hashmap_put(mixer_indexes, mixer, mi);
+    return mi;
+}
+
 static snd_mixer_elem_t *pa_alsa_mixer_find(snd_mixer_t *mixer,
                                             snd_ctl_elem_iface_t iface,
                                             const char *name,
@@ -1661,6 +1716,15 @@ static snd_mixer_elem_t *pa_alsa_mixer_find(snd_mixer_t *mixer,
                                             unsigned int device,
                                             unsigned int subdevice) {
     snd_mixer_elem_t *elem;
+    struct mixer_index *mi;
+
+    if (mixer_indexes && (mi = pa_hashmap_get(mixer_indexes, mixer))) {
+        char *key = mixer_index_key(iface, name, index, device, subdevice);
+
+        elem = pa_hashmap_get(mi->elems, key);
+        pa_xfree(key);
+        return elem;
+    }
 
     for (elem = snd_mixer_first_elem(mixer); elem; elem = snd_mixer_elem_next(elem)) {
         snd_hctl_elem_t **_helem, *helem;
@@ -1766,10 +1830,15 @@ static int mixer_class_event(snd_mixer_class_t *class, unsigned int mask,
             }
 
             if (!found) {
+                struct mixer_index *mi;
+
                 if ((err = snd_mixer_elem_add(new_melem, class)) < 0) {
                     pa_log_warn("snd_mixer_elem_add failed: %s", pa_alsa_strerror(err));
                     return 0;
                 }
+
+                if ((mi = snd_mixer_class_get_private(class)))
+                    pa_hashmap_put(mi->elems, mixer_index_key(iface, name, index, device, subdevice), new_melem);
             }
         }
     }
@@ -1801,6 +1870,8 @@ static int prepare_mixer(snd_mixer_t *mixer, const char *dev, snd_hctl_t *hctl)
     }
     snd_mixer_class_set_event(class, mixer_class_event);
     snd_mixer_class_set_compare(class, mixer_class_compare);
+    snd_mixer_class_set_private(class, mixer_index_new(mixer));
+    snd_mixer_class_set_private_free(class, mixer_index_free);
     if ((err = snd_mixer_class_register(class, mixer)) < 0) {
         pa_log_info("Unable register mixer class for %s: %s", dev, pa_alsa_strerror(err));
         snd_mixer_class_free(class);
@@ -2007,3 +2078,159 @@ int pa_alsa_get_hdmi_eld(snd_hctl_elem_t *elem, pa_hdmi_eld *eld) {
 
     return 0;
 }
+
+#define WAKEUP_STATS_MIN_USEC 125
+#define WAKEUP_STATS_DECAY_INTERVAL 512
+#define WAKEUP_STATS_WATERMARK_MIN_WAKEUPS 32
+#define WAKEUP_STATS_WATERMARK_PERCENTILE 0.99
+#define WATERMARK_ADAPT_INTERVAL_USEC (1*PA_USEC_PER_SEC)   /* 1s    -- How often to recompute the adaptive watermark */
+#define WATERMARK_ADAPT_HOLD_USEC (5*PA_USEC_PER_SEC)       /* 5s    -- Don't lower the adaptive watermark for this long after an xrun */
+
+static pa_usec_t wakeup_stats_bucket_limit(unsigned i) {
+    return (pa_usec_t) WAKEUP_STATS_MIN_USEC << i;
+}
+
+/* Called from IO context */
+void pa_alsa_wakeup_stats_add(pa_alsa_wakeup_stats *s, pa_usec_t delay) {
+    unsigned i;
+
+    pa_assert(s);
+
+    for (i = 0; i < PA_ALSA_WAKEUP_STATS_BUCKETS - 1; i++)
+        if (delay < wakeup_stats_bucket_limit(i))
+            break;
+
+    s->total[i]++;
+    s->n_total++;
+    s->max = PA_MAX(s->max, delay);
+
+    s->recent[i]++;
+    s->n_recent++;
+
+    /* Halve the weight of older samples regularly */
+    if (++s->n_since_decay >= WAKEUP_STATS_DECAY_INTERVAL) {
+        s->n_recent = 0;
+        for (i = 0; i < PA_ALSA_WAKEUP_STATS_BUCKETS; i++) {
+            s->recent[i] /= 2;
+            s->n_recent += s->recent[i];
+        }
+        s->n_since_decay = 0;
+    }
+}
+
+/* Returns the wakeup delay that p of the recent wakeups did not exceed,
+ * interpolated linearly within the bucket */
+pa_usec_t pa_alsa_wakeup_stats_percentile(const pa_alsa_wakeup_stats *s, double p) {
+    double wanted, seen = 0;
+    unsigned i;
+
+    pa_assert(s);
+    pa_assert(p >= 0 && p <= 1);
+
+    if (s->n_recent == 0)
+        return 0;
+
+    wanted = p * s->n_recent;
+
+    for (i = 0; i < PA_ALSA_WAKEUP_STATS_BUCKETS; i++) {
+        pa_usec_t lower, upper;
+
+        if (seen + s->recent[i] < wanted) {
+            seen += s->recent[i];
+            continue;
+        }
+
+        lower = i > 0 ? wakeup_stats_bucket_limit(i - 1) : 0;
+        upper = i < PA_ALSA_WAKEUP_STATS_BUCKETS - 1 ? wakeup_stats_bucket_limit(i) : PA_MAX(s->max, lower);
+
+        return lower + (pa_usec_t) ((upper - lower) * (wanted - seen) / PA_MAX(s->recent[i], 1u));
+    }
+
+    return s->max;
+}
+
+/* Nearly all wakeups have to happen early enough to leave min_wakeup for
+ * processing. The delay percentile is doubled, because the buckets are
+ * coarse and the tail of the distribution is not well known. */
+pa_usec_t pa_alsa_wakeup_stats_get_watermark(const pa_alsa_wakeup_stats *s, pa_usec_t min_wakeup) {
+    pa_assert(s);
+
+    if (s->n_recent < WAKEUP_STATS_WATERMARK_MIN_WAKEUPS)
+        return 0;
+
+    return 2 * pa_alsa_wakeup_stats_percentile(s, WAKEUP_STATS_WATERMARK_PERCENTILE) + min_wakeup;
+}
+
+/* Called from IO context. Sizes the watermark from the measured wakeup
+ * delays instead of using fixed steps: it goes up to the target at once,
+ * but only halfway down per interval. */
+bool pa_alsa_adapt_watermark(const pa_alsa_wakeup_stats *s, bool xrun, pa_usec_t min_wakeup, const pa_sample_spec *ss,
+                             pa_usec_t *not_before, size_t *watermark) {
+    pa_usec_t now, target_usec;
+    size_t target;
+
+    pa_assert(s);
+    pa_assert(ss);
+    pa_assert(not_before);
+    pa_assert(watermark);
+
+    now = pa_rtclock_now();
+
+    if (xrun) {
+        *not_before = now + WATERMARK_ADAPT_HOLD_USEC;
+        return false;
+    }
+
+    if (*not_before > now)
+        return false;
+
+    *not_before = now + WATERMARK_ADAPT_INTERVAL_USEC;
+
+    if (!(target_usec = pa_alsa_wakeup_stats_get_watermark(s, min_wakeup)))
+        return false;
+
+    target = pa_usec_to_bytes(target_usec, ss);
+
+    if (target == *watermark)
+        return false;
+
+    if (target > *watermark)
+        *watermark = target;
+    else
+        *watermark -= pa_frame_align((*watermark - target) / 2, ss);
+
+    return true;
+}
+
+void pa_alsa_wakeup_stats_to_json(const pa_alsa_wakeup_stats *s, pa_json_encoder *encoder) {
+    unsigned i;
+
+    pa_assert(s);
+    pa_assert(encoder);
+
+    pa_json_encoder_add_member_int(encoder, "wakeups", (int64_t) s->n_total);
+    pa_json_encoder_add_member_int(encoder, "max_delay_usec", (int64_t) s->max);
+    pa_json_encoder_add_member_int(encoder, "p50_delay_usec", (int64_t) pa_alsa_wakeup_stats_percentile(s, 0.5));
+    pa_json_encoder_add_member_int(encoder, "p99_delay_usec", (int64_t) pa_alsa_wakeup_stats_percentile(s, 0.99));
+
+    pa_json_encoder_begin_member_array(encoder, "histogram");
+    for (i = 0; i < PA_ALSA_WAKEUP_STATS_BUCKETS; i++) {
+        pa_json_encoder_begin_element_object(encoder);
+        if (i < PA_ALSA_WAKEUP_STATS_BUCKETS - 1)
+            pa_json_encoder_add_member_int(encoder, "below_usec", (int64_t) wakeup_stats_bucket_limit(i));
+        else
+            pa_json_encoder_add_member_null(encoder, "below_usec");
+        pa_json_encoder_add_member_int(encoder, "count", (int64_t) s->total[i]);
+        pa_json_encoder_end_object(encoder);
+    }
+    pa_json_encoder_end_array(encoder);
+}
+
+void pa_alsa_wakeup_report_to_json(const pa_alsa_wakeup_report *r, bool adaptive_watermark, pa_json_encoder *encoder) {
+    pa_assert(r);
+    pa_assert(encoder);
+
+    pa_json_encoder_add_member_bool(encoder, "adaptive_watermark", adaptive_watermark);
+    pa_json_encoder_add_member_int(encoder, "watermark_usec", (int64_t) r->watermark_usec);
+    pa_alsa_wakeup_stats_to_json(&r->stats, encoder);
+}
@@ -29,6 +29,7 @@
 
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/core.h>
+#include <pulsecore/json.h>
 #include <pulsecore/log.h>
 
 #include "alsa-mixer.h"
@@ -172,4 +173,44 @@ struct pa_hdmi_eld {
 
 int pa_alsa_get_hdmi_eld(snd_hctl_elem_t *elem, pa_hdmi_eld *eld);
 
+#define PA_ALSA_WAKEUP_STATS_BUCKETS 16
+
+/* Histogram of how late the IO thread woke up from its timer. The upper
+ * bounds of the buckets double starting at 125us, the last bucket is
+ * unbounded. The recent histogram decays, so that it follows the current
+ * system load, the total histogram is only kept for reporting. */
+typedef struct pa_alsa_wakeup_stats {
+    uint64_t total[PA_ALSA_WAKEUP_STATS_BUCKETS];
+    unsigned recent[PA_ALSA_WAKEUP_STATS_BUCKETS];
+    uint64_t n_total;
+    unsigned n_recent;
+    unsigned n_since_decay;
+    pa_usec_t max;
+} pa_alsa_wakeup_stats;
+
+void pa_alsa_wakeup_stats_add(pa_alsa_wakeup_stats *s, pa_usec_t delay);
+pa_usec_t pa_alsa_wakeup_stats_percentile(const pa_alsa_wakeup_stats *s, double p);
+void pa_alsa_wakeup_stats_to_json(const pa_alsa_wakeup_stats *s, pa_json_encoder *encoder);
+
+/* The watermark needed to cover the recent wakeup delays, or 0 if not enough
+ * wakeups have been measured yet */
+pa_usec_t pa_alsa_wakeup_stats_get_watermark(const pa_alsa_wakeup_stats *s, pa_usec_t min_wakeup);
+
+/* The adaptive watermark controller of the ALSA sink and source. On an xrun
+ * the caller raises the watermark by its usual step, and the watermark is
+ * then held for a while. Afterwards *watermark is moved towards the target
+ * derived from s once per interval, in bytes of ss. Returns true if
+ * *watermark was changed, the caller then has to clamp it. */
+bool pa_alsa_adapt_watermark(const pa_alsa_wakeup_stats *s, bool xrun, pa_usec_t min_wakeup, const pa_sample_spec *ss,
+                             pa_usec_t *not_before, size_t *watermark);
+
+/* What the IO threads of the ALSA sink and source report for the
+ * get-wakeup-stats message */
+typedef struct pa_alsa_wakeup_report {
+    pa_alsa_wakeup_stats stats;
+    pa_usec_t watermark_usec;
+} pa_alsa_wakeup_report;
+
+void pa_alsa_wakeup_report_to_json(const pa_alsa_wakeup_report *r, bool adaptive_watermark, pa_json_encoder *encoder);
+
 #endif
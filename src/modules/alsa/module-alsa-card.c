@@ -21,9 +21,11 @@
 #include <config.h>
 #endif
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/core-util.h>
+#include <pulsecore/dynarray.h>
 #include <pulsecore/i18n.h>
 #include <pulsecore/modargs.h>
 #include <pulsecore/queue.h>
@@ -63,6 +65,9 @@ PA_MODULE_USAGE(
         "tsched_buffer_watermark=<lower fill watermark> "
         "profile=<profile name> "
         "fixed_latency_range=<disable latency range changes on underrun?> "
+        "adaptive_watermark=<size the watermark from the measured wakeup delays?> "
+        "predict_wakeups=<query the device only on every Nth timer wakeup of sinks> "
+        "shared_io_thread=<serve all sinks of the card from one IO thread?> "
         "ignore_dB=<ignore dB information from the device?> "
         "deferred_volume=<Synchronize software and hardware volume changes to avoid momentary jumps?> "
         "profile_set=<profile set configuration file> "
@@ -70,6 +75,7 @@ PA_MODULE_USAGE(
         "use_ucm=<load use case manager> "
         "avoid_resampling=<use stream original sample rate if possible?> "
         "control=<name of mixer control> "
+        "skip_cached_probe=<reuse the cached profile probe result if the card did not change?> "
 );
 
 static const char* const valid_modargs[] = {
@@ -91,6 +97,9 @@ static const char* const valid_modargs[] = {
     "tsched_buffer_size",
     "tsched_buffer_watermark",
     "fixed_latency_range",
+    "adaptive_watermark",
+    "predict_wakeups",
+    "shared_io_thread",
     "profile",
     "ignore_dB",
     "deferred_volume",
@@ -99,6 +108,7 @@ static const char* const valid_modargs[] = {
     "use_ucm",
     "avoid_resampling",
     "control",
+    "skip_cached_probe",
     NULL
 };
 
@@ -123,6 +133,11 @@ struct userdata {
     pa_hashmap *mixers;
     pa_hashmap *jacks;
 
+    /* snd_mixer_elem_t -> pa_dynarray of the jacks using it */
+    pa_hashmap *jacks_by_melem;
+    /* ELD snd_mixer_elem_t -> pa_device_port */
+    pa_hashmap *eld_ports;
+
     pa_card *card;
 
     pa_modargs *modargs;
@@ -375,6 +390,8 @@ static int report_jack_state(snd_mixer_elem_t *melem, unsigned int mask) {
     bool plugged_in;
     void *state;
     pa_alsa_jack *jack;
+    pa_dynarray *jacks;
+    unsigned i;
     struct temp_port_avail *tp, *tports;
     pa_card_profile *profile;
     pa_available_t active_available = PA_AVAILABLE_UNKNOWN;
@@ -411,25 +428,27 @@ static int report_jack_state(snd_mixer_elem_t *melem, unsigned int mask) {
 
     pa_log_debug("Jack '%s' is now %s", pa_strnull(snd_hctl_elem_get_name(elem)), plugged_in ? "plugged in" : "unplugged");
 
-    tports = tp = pa_xnew0(struct temp_port_avail, pa_hashmap_size(u->jacks)+1);
+    if (!(jacks = pa_hashmap_get(u->jacks_by_melem, melem)))
+        return 0;
 
-    PA_HASHMAP_FOREACH(jack, u->jacks, state)
-        if (jack->melem == melem) {
-            pa_alsa_jack_set_plugged_in(jack, plugged_in);
+    tports = tp = pa_xnew0(struct temp_port_avail, pa_dynarray_size(jacks)+1);
 
-            if (u->use_ucm) {
-                /* When using UCM, pa_alsa_jack_set_plugged_in() maps the jack
-                 * state to port availability. */
-                continue;
-            }
+    PA_DYNARRAY_FOREACH(jack, jacks, i) {
+        pa_alsa_jack_set_plugged_in(jack, plugged_in);
 
-            /* When not using UCM, we have to do the jack state -> port
-             * availability mapping ourselves. */
-            pa_assert_se(tp->port = jack->path->port);
-            tp->avail = calc_port_state(tp->port, u);
-            tp++;
+        if (u->use_ucm) {
+            /* When using UCM, pa_alsa_jack_set_plugged_in() maps the jack
+             * state to port availability. */
+            continue;
         }
 
+        /* When not using UCM, we have to do the jack state -> port
+         * availability mapping ourselves. */
+        pa_assert_se(tp->port = jack->path->port);
+        tp->avail = calc_port_state(tp->port, u);
+        tp++;
+    }
+
     /* Report available ports before unavailable ones: in case port 1 becomes available when port 2 becomes unavailable,
        this prevents an unnecessary switch port 1 -> port 3 -> port 2 */
 
@@ -540,28 +559,6 @@ static int report_jack_state(snd_mixer_elem_t *melem, unsigned int mask) {
     return 0;
 }
 
-static pa_device_port* find_port_with_eld_device(struct userdata *u, int device) {
-    void *state;
-    pa_device_port *p;
-
-    if (u->use_ucm) {
-        PA_HASHMAP_FOREACH(p, u->card->ports, state) {
-            pa_alsa_ucm_port_data *data = PA_DEVICE_PORT_DATA(p);
-            pa_assert(data->eld_mixer_device_name);
-            if (device == data->eld_device)
-                return p;
-        }
-    } else {
-        PA_HASHMAP_FOREACH(p, u->card->ports, state) {
-            pa_alsa_port_data *data = PA_DEVICE_PORT_DATA(p);
-            pa_assert(data->path);
-            if (device == data->path->eld_device)
-                return p;
-        }
-    }
-    return NULL;
-}
-
 static int hdmi_eld_changed(snd_mixer_elem_t *melem, unsigned int mask) {
     struct userdata *u = snd_mixer_elem_get_callback_private(melem);
     snd_hctl_elem_t **_elem = snd_mixer_elem_get_private(melem), *elem;
@@ -579,7 +576,7 @@ static int hdmi_eld_changed(snd_mixer_elem_t *melem, unsigned int mask) {
     if (mask == SND_CTL_EVENT_MASK_REMOVE)
         return 0;
 
-    p = find_port_with_eld_device(u, device);
+    p = pa_hashmap_get(u->eld_ports, melem);
     if (p == NULL) {
         pa_log_error("Invalid device changed in ALSA: %d", device);
         return 0;
@@ -607,6 +604,8 @@ static void init_eld_ctls(struct userdata *u) {
     void *state;
     pa_device_port *port;
 
+    u->eld_ports = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+
     /* The code in this function expects ports to have a pa_alsa_port_data
      * struct as their data, but in UCM mode ports don't have any data. Hence,
      * the ELD controls can't currently be used in UCM mode. */
@@ -639,6 +638,11 @@ static void init_eld_ctls(struct userdata *u) {
 
         melem = pa_alsa_mixer_find_pcm(mixer_handle, "ELD", device);
         if (melem) {
+            /* Several ports may use the same ELD device, the first one
+             * gets the updates */
+            if (!pa_hashmap_get(u->eld_ports, melem))
+                pa_hashmap_put(u->eld_ports, melem, port);
+
             pa_alsa_mixer_set_fdlist(u->mixers, mixer_handle, u->core->mainloop);
             snd_mixer_elem_set_callback(melem, hdmi_eld_changed);
             snd_mixer_elem_set_callback_private(melem, u);
@@ -654,9 +658,13 @@ static void init_jacks(struct userdata *u) {
     void *state;
     pa_alsa_path* path;
     pa_alsa_jack* jack;
+    snd_mixer_elem_t *melem;
+    pa_dynarray *jacks;
     char buf[64];
 
     u->jacks = pa_hashmap_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
+    u->jacks_by_melem = pa_hashmap_new_full(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func,
+                                            NULL, (pa_free_cb_t) pa_dynarray_free);
 
     if (u->use_ucm) {
         PA_LLIST_FOREACH(jack, u->ucm.jacks)
@@ -704,9 +712,18 @@ static void init_jacks(struct userdata *u) {
             pa_alsa_jack_set_has_control(jack, false);
             continue;
         }
-        snd_mixer_elem_set_callback(jack->melem, report_jack_state);
-        snd_mixer_elem_set_callback_private(jack->melem, u);
-        report_jack_state(jack->melem, 0);
+
+        if (!(jacks = pa_hashmap_get(u->jacks_by_melem, jack->melem))) {
+            jacks = pa_dynarray_new(NULL);
+            pa_hashmap_put(u->jacks_by_melem, jack->melem, jacks);
+        }
+        pa_dynarray_append(jacks, jack);
+    }
+
+    PA_HASHMAP_FOREACH_KV(melem, jacks, u->jacks_by_melem, state) {
+        snd_mixer_elem_set_callback(melem, report_jack_state);
+        snd_mixer_elem_set_callback_private(melem, u);
+        report_jack_state(melem, 0);
     }
 }
 
@@ -774,14 +791,13 @@ static void set_card_name(pa_card_new_data *data, pa_modargs *ma, const char *de
 
 static pa_hook_result_t card_suspend_changed(pa_core *c, pa_card *card, struct userdata *u) {
     void *state;
-    pa_alsa_jack *jack;
+    snd_mixer_elem_t *melem;
+    pa_dynarray *jacks;
 
     if (card->suspend_cause == 0) {
         /* We were unsuspended, update jack state in case it changed while we were suspended */
-        PA_HASHMAP_FOREACH(jack, u->jacks, state) {
-            if (jack->melem)
-                report_jack_state(jack->melem, 0);
-        }
+        PA_HASHMAP_FOREACH_KV(melem, jacks, u->jacks_by_melem, state)
+            report_jack_state(melem, 0);
     }
 
     return PA_HOOK_OK;
@@ -850,6 +866,9 @@ static pa_hook_result_t source_output_unlink_hook_callback(pa_core *c, pa_source
 int pa__init(pa_module *m) {
     pa_card_new_data data;
     bool ignore_dB = false;
+    bool skip_cached_probe = false;
+    pa_usec_t probe_start;
+    unsigned probe_span;
     struct userdata *u;
     pa_reserve_wrapper *reserve = NULL;
     const char *description;
@@ -931,6 +950,11 @@ int pa__init(pa_module *m) {
         goto fail;
     }
 
+    if (pa_modargs_get_value_boolean(u->modargs, "skip_cached_probe", &skip_cached_probe) < 0) {
+        pa_log("Failed to parse skip_cached_probe argument.");
+        goto fail;
+    }
+
     if (!pa_in_system_mode()) {
         char *rname;
 
@@ -999,7 +1023,23 @@ int pa__init(pa_module *m) {
 
     u->profile_set->ignore_dB = ignore_dB;
 
-    pa_alsa_profile_set_probe(u->profile_set, u->mixers, u->device_id, &m->core->default_sample_spec, m->core->default_n_fragments, m->core->default_fragment_size_msec);
+    probe_start = pa_rtclock_now();
+    probe_span = pa_startup_trace_begin("card-probe", u->device_id, NULL);
+
+    /* UCM profile sets are probed when they are created */
+    if (!u->use_ucm && skip_cached_probe &&
+        pa_alsa_profile_set_load_probe_cache(u->profile_set, u->mixers, u->alsa_card_index, &m->core->default_sample_spec))
+        pa_log_info("Using cached profile probe result, took %llu us.", (unsigned long long) (pa_rtclock_now() - probe_start));
+    else {
+        pa_alsa_profile_set_probe(u->profile_set, u->mixers, u->device_id, &m->core->default_sample_spec, m->core->default_n_fragments, m->core->default_fragment_size_msec);
+        pa_log_info("Probing profiles took %llu us.", (unsigned long long) (pa_rtclock_now() - probe_start));
+
+        if (!u->use_ucm && skip_cached_probe)
+            pa_alsa_profile_set_save_probe_cache(u->profile_set, u->alsa_card_index, &m->core->default_sample_spec);
+    }
+
+    pa_startup_trace_end(probe_span);
+
     pa_alsa_profile_set_dump(u->profile_set);
 
     pa_card_new_data_init(&data);
@@ -1162,6 +1202,10 @@ void pa__done(pa_module*m) {
 
     if (u->mixers)
         pa_hashmap_free(u->mixers);
+    if (u->jacks_by_melem)
+        pa_hashmap_free(u->jacks_by_melem);
+    if (u->eld_ports)
+        pa_hashmap_free(u->eld_ports);
     if (u->jacks)
         pa_hashmap_free(u->jacks);
 
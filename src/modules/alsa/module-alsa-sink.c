@@ -57,7 +57,11 @@ PA_MODULE_USAGE(
         "deferred_volume=<Synchronize software and hardware volume changes to avoid momentary jumps?> "
         "deferred_volume_safety_margin=<usec adjustment depending on volume direction> "
         "deferred_volume_extra_delay=<usec adjustment to HW volume changes> "
-        "fixed_latency_range=<disable latency range changes on underrun?>");
+        "deferred_volume_coalesce=<usec window for merging HW volume changes> "
+        "fixed_latency_range=<disable latency range changes on underrun?> "
+        "adaptive_watermark=<size the watermark from the measured wakeup delays?> "
+        "predict_wakeups=<query the device only on every Nth timer wakeup> "
+        "shared_io_thread=<serve all sinks of the card from one IO thread?>");
 
 static const char* const valid_modargs[] = {
     "name",
@@ -83,7 +87,11 @@ static const char* const valid_modargs[] = {
     "deferred_volume",
     "deferred_volume_safety_margin",
     "deferred_volume_extra_delay",
+    "deferred_volume_coalesce",
     "fixed_latency_range",
+    "adaptive_watermark",
+    "predict_wakeups",
+    "shared_io_thread",
     NULL
 };
 
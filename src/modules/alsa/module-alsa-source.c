@@ -65,7 +65,9 @@ PA_MODULE_USAGE(
         "deferred_volume=<Synchronize software and hardware volume changes to avoid momentary jumps?> "
         "deferred_volume_safety_margin=<usec adjustment depending on volume direction> "
         "deferred_volume_extra_delay=<usec adjustment to HW volume changes> "
-        "fixed_latency_range=<disable latency range changes on overrun?>");
+        "deferred_volume_coalesce=<usec window for merging HW volume changes> "
+        "fixed_latency_range=<disable latency range changes on overrun?> "
+        "adaptive_watermark=<size the watermark from the measured wakeup delays?>");
 
 static const char* const valid_modargs[] = {
     "name",
@@ -90,7 +92,9 @@ static const char* const valid_modargs[] = {
     "deferred_volume",
     "deferred_volume_safety_margin",
     "deferred_volume_extra_delay",
+    "deferred_volume_coalesce",
     "fixed_latency_range",
+    "adaptive_watermark",
     NULL
 };
 
@@ -335,12 +335,15 @@ static bool bt_prepare_encoder_buffer(struct userdata *u)
 /* Run from IO thread */
 static int bt_write_buffer(struct userdata *u) {
     ssize_t written = 0;
+    pa_usec_t start;
 
     pa_assert(u);
     pa_assert(u->transport);
     pa_assert(u->bt_codec);
 
+    start = pa_rtclock_now();
     written = u->transport->write(u->transport, u->stream_fd, u->encoder_buffer, u->encoder_buffer_used, u->write_link_mtu);
+    pa_cycle_timing_add(&u->sink->thread_info.cycle_stats.write, pa_rtclock_now() - start);
 
     if (written > 0) {
         /* calculate remainder */
@@ -369,6 +372,7 @@ static int bt_process_render(struct userdata *u) {
     const uint8_t *ptr;
     size_t processed;
     size_t length;
+    pa_usec_t start;
 
     pa_assert(u);
     pa_assert(u->sink);
@@ -377,6 +381,8 @@ static int bt_process_render(struct userdata *u) {
     if (!bt_prepare_encoder_buffer(u))
         return false;
 
+    start = pa_rtclock_now();
+
     /* First, render some data */
     if (!u->write_memchunk.memblock)
         pa_sink_render_full(u->sink, u->write_block_size, &u->write_memchunk);
@@ -414,6 +420,10 @@ static int bt_process_render(struct userdata *u) {
     pa_memblock_unref(u->write_memchunk.memblock);
     pa_memchunk_reset(&u->write_memchunk);
 
+    /* Rendering and encoding one block has to keep up with playing it */
+    pa_cycle_stats_add_cycle(&u->sink->thread_info.cycle_stats, pa_rtclock_now() - start,
+                             pa_bytes_to_usec(u->write_block_size, &u->encoder_sample_spec));
+
     return ret;
 }
 
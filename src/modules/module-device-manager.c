@@ -162,7 +162,7 @@ static void save_time_callback(pa_mainloop_api*a, pa_time_event* e, const struct
     u->core->mainloop->time_free(u->save_time_event);
     u->save_time_event = NULL;
 
-    pa_database_sync(u->database);
+    pa_database_sync_async(u->database);
     pa_log_info("Synced.");
 
 #ifdef DUMP_DATABASE
@@ -66,10 +66,12 @@ PA_MODULE_USAGE(
         "restore_muted=<Save/restore muted states?> "
         "on_hotplug=<This argument is obsolete, please remove it from configuration> "
         "on_rescue=<This argument is obsolete, please remove it from configuration> "
-        "fallback_table=<filename>");
+        "fallback_table=<filename> "
+        "cache_size=<number of decoded entries kept in memory, 0 to disable>");
 
 #define SAVE_INTERVAL (10 * PA_USEC_PER_SEC)
 #define IDENTIFICATION_PROPERTY "module-stream-restore.id"
+#define DEFAULT_CACHE_SIZE 256
 
 #define DEFAULT_FALLBACK_FILE PA_DEFAULT_CONFIG_DIR"/stream-restore.table"
 #define DEFAULT_FALLBACK_FILE_USER "stream-restore.table"
@@ -83,6 +85,7 @@ static const char* const valid_modargs[] = {
     "on_hotplug",
     "on_rescue",
     "fallback_table",
+    "cache_size",
     NULL
 };
 
@@ -99,6 +102,12 @@ struct userdata {
     pa_time_event *save_time_event;
     pa_database* database;
 
+    /* Recently read entries by name, least recently used first. Entries
+     * that weren't found are cached too, as NULL. */
+    pa_hashmap *cache;
+    uint32_t cache_size;
+    uint64_t cache_hits, cache_misses;
+
     bool restore_device:1;
     bool restore_volume:1;
     bool restore_muted:1;
@@ -124,6 +133,11 @@ struct entry {
     char* card;
 };
 
+struct cache_entry {
+    char *name;
+    struct entry *entry;
+};
+
 enum {
     SUBCOMMAND_TEST,
     SUBCOMMAND_READ,
@@ -136,6 +150,7 @@ enum {
 static struct entry* entry_new(void);
 static void entry_free(struct entry *e);
 static struct entry *entry_read(struct userdata *u, const char *name);
+static void cache_invalidate(struct userdata *u, const char *name);
 static bool entry_write(struct userdata *u, const char *name, const struct entry *e, bool replace);
 static struct entry* entry_copy(const struct entry *e);
 static void entry_apply(struct userdata *u, const char *name, struct entry *e);
@@ -939,6 +954,7 @@ static void handle_entry_remove(DBusConnection *conn, DBusMessage *msg, void *us
     key.size = strlen(de->entry_name);
 
     pa_assert_se(pa_database_unset(de->userdata->database, &key) == 0);
+    cache_invalidate(de->userdata, de->entry_name);
 
     send_entry_removed_signal(de);
     trigger_save(de->userdata);
@@ -961,7 +977,7 @@ static void save_time_callback(pa_mainloop_api*a, pa_time_event* e, const struct
     u->core->mainloop->time_free(u->save_time_event);
     u->save_time_event = NULL;
 
-    pa_database_sync(u->database);
+    pa_database_sync_async(u->database);
     pa_log_info("Synced.");
 }
 
@@ -987,6 +1003,8 @@ static bool entry_write(struct userdata *u, const char *name, const struct entry
     pa_assert(name);
     pa_assert(e);
 
+    cache_invalidate(u, name);
+
     t = pa_tagstruct_new();
     pa_tagstruct_putu8(t, ENTRY_VERSION);
     pa_tagstruct_put_boolean(t, e->volume_valid);
@@ -1109,7 +1127,7 @@ fail:
 }
 #endif
 
-static struct entry *entry_read(struct userdata *u, const char *name) {
+static struct entry *entry_read_database(struct userdata *u, const char *name) {
     pa_datum key, data;
     struct entry *e = NULL;
     pa_tagstruct *t = NULL;
@@ -1237,6 +1255,56 @@ static struct entry* entry_copy(const struct entry *e) {
     return r;
 }
 
+static void cache_entry_free(struct cache_entry *c) {
+    pa_assert(c);
+
+    if (c->entry)
+        entry_free(c->entry);
+    pa_xfree(c->name);
+    pa_xfree(c);
+}
+
+static void cache_invalidate(struct userdata *u, const char *name) {
+    pa_assert(u);
+    pa_assert(name);
+
+    pa_hashmap_remove_and_free(u->cache, name);
+}
+
+/* Like entry_read_database(), but keeps the decoded entries of the most
+ * recently created streams around */
+static struct entry *entry_read(struct userdata *u, const char *name) {
+    struct cache_entry *c;
+    struct entry *e;
+
+    pa_assert(u);
+    pa_assert(name);
+
+    if (u->cache_size == 0)
+        return entry_read_database(u, name);
+
+    if ((c = pa_hashmap_remove(u->cache, name))) {
+        /* Move it to the end */
+        pa_hashmap_put(u->cache, c->name, c);
+        u->cache_hits++;
+
+        return c->entry ? entry_copy(c->entry) : NULL;
+    }
+
+    u->cache_misses++;
+    e = entry_read_database(u, name);
+
+    if (pa_hashmap_size(u->cache) >= u->cache_size)
+        cache_entry_free(pa_hashmap_steal_first(u->cache));
+
+    c = pa_xnew0(struct cache_entry, 1);
+    c->name = pa_xstrdup(name);
+    c->entry = e ? entry_copy(e) : NULL;
+    pa_hashmap_put(u->cache, c->name, c);
+
+    return e;
+}
+
 static void trigger_save(struct userdata *u) {
     pa_native_connection *c;
     uint32_t idx;
@@ -2042,6 +2110,7 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
                 }
 #endif
                 pa_database_clear(u->database);
+                pa_hashmap_remove_all(u->cache);
             }
 
             while (!pa_tagstruct_eof(t)) {
@@ -2173,6 +2242,7 @@ static int extension_cb(pa_native_protocol *p, pa_module *m, pa_native_connectio
                 key.size = strlen(name);
 
                 pa_database_unset(u->database, &key);
+                cache_invalidate(u, name);
             }
 
             trigger_save(u);
@@ -2255,14 +2325,15 @@ static void clean_up_db(struct userdata *u) {
 
         entry_name = pa_xstrndup(key.data, key.size);
 
-        /* Use entry_read() to check whether this entry is valid. */
-        if (!(e = entry_read(u, entry_name))) {
+        /* Use entry_read_database() to check whether this entry is valid.
+         * This goes through all entries, so don't let it fill the cache. */
+        if (!(e = entry_read_database(u, entry_name))) {
             item = pa_xnew0(struct clean_up_item, 1);
             PA_LLIST_INIT(struct clean_up_item, item);
             item->entry_name = entry_name;
 
 #ifdef ENABLE_LEGACY_DATABASE_ENTRY_FORMAT
-            /* entry_read() failed, but what about legacy_entry_read()? */
+            /* entry_read_database() failed, but what about legacy_entry_read()? */
             if (!(e = legacy_entry_read(u, entry_name)))
                 /* Not a legacy entry either, let's remove this. */
                 PA_LLIST_PREPEND(struct clean_up_item, to_be_removed, item);
@@ -2322,6 +2393,7 @@ int pa__init(pa_module*m) {
     pa_source_output *so;
     uint32_t idx;
     bool restore_device = true, restore_volume = true, restore_muted = true;
+    uint32_t cache_size = DEFAULT_CACHE_SIZE;
 
 #ifdef HAVE_DBUS
     pa_datum key;
@@ -2349,12 +2421,19 @@ int pa__init(pa_module*m) {
     if (!restore_muted && !restore_volume && !restore_device)
         pa_log_warn("Neither restoring volume, nor restoring muted, nor restoring device enabled!");
 
+    if (pa_modargs_get_value_u32(ma, "cache_size", &cache_size) < 0) {
+        pa_log("cache_size= expects a non-negative integer argument");
+        goto fail;
+    }
+
     m->userdata = u = pa_xnew0(struct userdata, 1);
     u->core = m->core;
     u->module = m;
     u->restore_device = restore_device;
     u->restore_volume = restore_volume;
     u->restore_muted = restore_muted;
+    u->cache_size = cache_size;
+    u->cache = pa_hashmap_new_full(pa_idxset_string_hash_func, pa_idxset_string_compare_func, NULL, (pa_free_cb_t) cache_entry_free);
     u->subscribed = pa_idxset_new(pa_idxset_trivial_hash_func, pa_idxset_trivial_compare_func);
 
     u->protocol = pa_native_protocol_get(m->core);
@@ -2468,6 +2547,12 @@ void pa__done(pa_module*m) {
     if (u->database)
         pa_database_close(u->database);
 
+    if (u->cache) {
+        pa_log_debug("Entry cache: %llu hits, %llu misses.",
+                     (unsigned long long) u->cache_hits, (unsigned long long) u->cache_misses);
+        pa_hashmap_free(u->cache);
+    }
+
     if (u->protocol) {
         pa_native_protocol_remove_ext(u->protocol, m);
         pa_native_protocol_unref(u->protocol);
@@ -21,6 +21,8 @@
 #include <config.h>
 #endif
 
+#include <stdlib.h>
+
 #include <pulse/volume.h>
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
@@ -660,6 +662,63 @@ char *pa_scache_list_to_string(pa_core *c) {
     return pa_strbuf_to_string_free(s);
 }
 
+static int hook_slot_compare(const void *a, const void *b) {
+    const pa_hook_slot *x = *(pa_hook_slot * const *) a, *y = *(pa_hook_slot * const *) b;
+
+    if (x->total_usec != y->total_usec)
+        return x->total_usec > y->total_usec ? -1 : 1;
+
+    return 0;
+}
+
+char *pa_hook_stats_to_string(pa_core *c) {
+    pa_strbuf *s;
+    pa_hook_slot *slot, **slots;
+    unsigned i, n = 0, n_slots = 0;
+
+    pa_assert(c);
+
+    s = pa_strbuf_new();
+
+    for (i = 0; i < PA_CORE_HOOK_MAX; i++)
+        PA_LLIST_FOREACH(slot, c->hooks[i].slots)
+            n_slots++;
+
+    slots = pa_xnew(pa_hook_slot*, n_slots + 1);
+
+    for (i = 0; i < PA_CORE_HOOK_MAX; i++)
+        PA_LLIST_FOREACH(slot, c->hooks[i].slots)
+            if (!slot->dead && slot->n_calls > 0)
+                slots[n++] = slot;
+
+    /* The most expensive callbacks first */
+    qsort(slots, n, sizeof(pa_hook_slot*), hook_slot_compare);
+
+    pa_strbuf_printf(s, "Hook profiling is %s, %u hook callback(s) called.\n",
+                     pa_hook_get_profiling() ? "enabled" : "disabled", n);
+
+    for (i = 0; i < n; i++) {
+        slot = slots[i];
+
+        pa_strbuf_printf(s, "    hook: <%s>\n"
+                         "\tmodule: <%s>\n"
+                         "\tpriority: %i\n"
+                         "\tcalls: %llu\n"
+                         "\ttotal: %0.3f ms\n"
+                         "\taverage: %0.1f usec\n",
+                         pa_core_hook_to_string((pa_core_hook_t) (slot->hook - c->hooks)),
+                         slot->module ? slot->module->name : "n/a",
+                         (int) slot->priority,
+                         (unsigned long long) slot->n_calls,
+                         (double) slot->total_usec / PA_USEC_PER_MSEC,
+                         (double) slot->total_usec / (double) slot->n_calls);
+    }
+
+    pa_xfree(slots);
+
+    return pa_strbuf_to_string_free(s);
+}
+
 char *pa_full_status_string(pa_core *c) {
     pa_strbuf *s;
     int i;
@@ -42,6 +42,11 @@ struct pa_client {
     pa_idxset *sink_inputs;
     pa_idxset *source_outputs;
 
+    /* Stream data received from and sent to the client, counted by the
+     * protocol */
+    uint64_t bytes_received;
+    uint64_t bytes_sent;
+
     void *userdata;
 
     void (*kill)(pa_client *c);
@@ -25,6 +25,7 @@
 
 #include <pulse/xmalloc.h>
 
+#include <pulsecore/hashmap.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 
@@ -53,10 +54,46 @@ struct pa_subscription_event {
 
     pa_subscription_event_type_t type;
     uint32_t index;
+    uint64_t seq;
 
     PA_LLIST_FIELDS(pa_subscription_event);
+
+    /* The queued events of the same object */
+    struct pending_object *object;
+    pa_subscription_event *object_next, *object_prev;
+};
+
+/* All queued events of one object, indexed by facility and index in
+ * core->subscription_event_objects, so that redundant events can be found
+ * without walking the queue */
+struct pending_object {
+    struct object_key {
+        pa_subscription_event_type_t facility;
+        uint32_t index;
+    } key;
+
+    PA_LLIST_HEAD(pa_subscription_event, events);
+    pa_subscription_event *last;
 };
 
+static unsigned object_key_hash(const void *p) {
+    const struct object_key *k = p;
+
+    return (unsigned) k->index * 31U + (unsigned) k->facility;
+}
+
+static int object_key_compare(const void *a, const void *b) {
+    const struct object_key *x = a, *y = b;
+
+    if (x->facility != y->facility)
+        return x->facility < y->facility ? -1 : 1;
+
+    if (x->index != y->index)
+        return x->index < y->index ? -1 : 1;
+
+    return 0;
+}
+
 static void sched_event(pa_core *c);
 
 /* Allocate a new subscription object for the given subscription mask. Use the specified callback function and user data */
@@ -96,13 +133,32 @@ static void free_subscription(pa_subscription *s) {
 }
 
 static void free_event(pa_subscription_event *s) {
+    struct pending_object *o;
+
     pa_assert(s);
     pa_assert(s->core);
+    pa_assert_se(o = s->object);
 
     if (!s->next)
         s->core->subscription_event_last = s->prev;
 
     PA_LLIST_REMOVE(pa_subscription_event, s->core->subscription_event_queue, s);
+
+    if (!s->object_next)
+        o->last = s->object_prev;
+
+    if (s->object_next)
+        s->object_next->object_prev = s->object_prev;
+    if (s->object_prev)
+        s->object_prev->object_next = s->object_next;
+    else
+        o->events = s->object_next;
+
+    if (!o->events) {
+        pa_hashmap_remove(s->core->subscription_event_objects, &o->key);
+        pa_xfree(o);
+    }
+
     pa_xfree(s);
 }
 
@@ -116,6 +172,11 @@ void pa_subscription_free_all(pa_core *c) {
     while (c->subscription_event_queue)
         free_event(c->subscription_event_queue);
 
+    if (c->subscription_event_objects) {
+        pa_hashmap_free(c->subscription_event_objects);
+        c->subscription_event_objects = NULL;
+    }
+
     if (c->subscription_defer_event) {
         c->mainloop->defer_free(c->subscription_defer_event);
         c->subscription_defer_event = NULL;
@@ -155,6 +216,8 @@ static void dump_event(const char * prefix, pa_subscription_event*e) {
 static void defer_cb(pa_mainloop_api *m, pa_defer_event *de, void *userdata) {
     pa_core *c = userdata;
     pa_subscription *s;
+    pa_subscription_event *e;
+    uint64_t limit;
 
     pa_assert(c->mainloop == m);
     pa_assert(c);
@@ -162,15 +225,22 @@ static void defer_cb(pa_mainloop_api *m, pa_defer_event *de, void *userdata) {
 
     c->mainloop->defer_enable(c->subscription_defer_event, 0);
 
-    /* Dispatch queued events */
+    /* Dispatch the events queued so far as one burst. Events posted by the
+     * callbacks are left for the next main loop iteration, where they can
+     * still be merged with what follows them. */
 
-    while (c->subscription_event_queue) {
-        pa_subscription_event *e = c->subscription_event_queue;
+    limit = c->subscription_events_posted;
 
+    if (c->subscription_event_queue)
+        c->subscription_bursts++;
+
+    while ((e = c->subscription_event_queue) && e->seq <= limit) {
         for (s = c->subscriptions; s; s = s->next) {
 
-            if (!s->dead && pa_subscription_match_flags(s->mask, e->type))
+            if (!s->dead && pa_subscription_match_flags(s->mask, e->type)) {
                 s->callback(c, e->type, e->index, s->userdata);
+                c->subscription_events_delivered++;
+            }
         }
 
 #ifdef DEBUG
@@ -179,6 +249,9 @@ static void defer_cb(pa_mainloop_api *m, pa_defer_event *de, void *userdata) {
         free_event(e);
     }
 
+    if (c->subscription_event_queue)
+        c->mainloop->defer_enable(c->subscription_defer_event, 1);
+
     /* Remove dead subscriptions */
 
     s = c->subscriptions;
@@ -205,55 +278,73 @@ static void sched_event(pa_core *c) {
 /* Append a new subscription event to the subscription event queue and schedule a main loop event */
 void pa_subscription_post(pa_core *c, pa_subscription_event_type_t t, uint32_t idx) {
     pa_subscription_event *e;
+    struct pending_object *o;
+    struct object_key key;
     pa_assert(c);
 
     /* No need for queuing subscriptions of no one is listening */
     if (!c->subscriptions)
         return;
 
-    if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_NEW) {
-        pa_subscription_event *i, *n;
+    c->subscription_events_posted++;
 
-        /* Check for duplicates */
-        for (i = c->subscription_event_last; i; i = n) {
-            n = i->prev;
+    if (!c->subscription_event_objects)
+        c->subscription_event_objects = pa_hashmap_new(object_key_hash, object_key_compare);
 
-            /* not the same object type */
-            if (((t ^ i->type) & PA_SUBSCRIPTION_EVENT_FACILITY_MASK))
-                continue;
+    key.facility = t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+    key.index = idx;
 
-            /* not the same object */
-            if (i->index != idx)
-                continue;
+    o = pa_hashmap_get(c->subscription_event_objects, &key);
 
-            if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
-                /* This object is being removed, hence there is no
-                 * point in keeping the old events regarding this
-                 * entry in the queue. */
+    if (o && (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_REMOVE) {
+        /* This object is being removed, hence there is no
+         * point in keeping the old events regarding this
+         * entry in the queue. */
 
-                free_event(i);
-                pa_log_debug("Dropped redundant event due to remove event.");
-                continue;
-            }
+        while (o) {
+            bool last = !o->events->object_next;
 
-            if ((t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE) {
-                /* This object has changed. If a "new" or "change" event for
-                 * this object is still in the queue we can exit. */
+            free_event(o->events);
+            c->subscription_events_coalesced++;
+            pa_log_debug("Dropped redundant event due to remove event.");
 
-                pa_log_debug("Dropped redundant event due to change event.");
-                return;
-            }
+            if (last)
+                o = NULL;
         }
+
+    } else if (o && (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) == PA_SUBSCRIPTION_EVENT_CHANGE) {
+        /* This object has changed. If a "new" or "change" event for
+         * this object is still in the queue we can exit. */
+
+        c->subscription_events_coalesced++;
+        pa_log_debug("Dropped redundant event due to change event.");
+        return;
+    }
+
+    if (!o) {
+        o = pa_xnew0(struct pending_object, 1);
+        o->key = key;
+        pa_hashmap_put(c->subscription_event_objects, &o->key, o);
     }
 
     e = pa_xnew(pa_subscription_event, 1);
     e->core = c;
     e->type = t;
     e->index = idx;
+    e->seq = c->subscription_events_posted;
 
     PA_LLIST_INSERT_AFTER(pa_subscription_event, c->subscription_event_queue, c->subscription_event_last, e);
     c->subscription_event_last = e;
 
+    e->object = o;
+    e->object_next = NULL;
+    e->object_prev = o->last;
+    if (o->last)
+        o->last->object_next = e;
+    else
+        o->events = e;
+    o->last = e;
+
 #ifdef DEBUG
     dump_event("Queued", e);
 #endif
@@ -33,6 +33,7 @@
 #include <pulsecore/module.h>
 #include <pulsecore/core-rtclock.h>
 #include <pulsecore/core-util.h>
+#include <pulsecore/database.h>
 #include <pulsecore/message-handler.h>
 #include <pulsecore/core-scache.h>
 #include <pulsecore/core-subscribe.h>
@@ -62,6 +63,85 @@ static int core_process_msg(pa_msgobject *o, int code, void *userdata, int64_t o
     }
 }
 
+static const char* const hook_names[PA_CORE_HOOK_MAX] = {
+    [PA_CORE_HOOK_SINK_NEW] = "sink-new",
+    [PA_CORE_HOOK_SINK_FIXATE] = "sink-fixate",
+    [PA_CORE_HOOK_SINK_PUT] = "sink-put",
+    [PA_CORE_HOOK_SINK_UNLINK] = "sink-unlink",
+    [PA_CORE_HOOK_SINK_UNLINK_POST] = "sink-unlink-post",
+    [PA_CORE_HOOK_SINK_STATE_CHANGED] = "sink-state-changed",
+    [PA_CORE_HOOK_SINK_PROPLIST_CHANGED] = "sink-proplist-changed",
+    [PA_CORE_HOOK_SINK_PORT_CHANGED] = "sink-port-changed",
+    [PA_CORE_HOOK_SINK_FLAGS_CHANGED] = "sink-flags-changed",
+    [PA_CORE_HOOK_SINK_VOLUME_CHANGED] = "sink-volume-changed",
+    [PA_CORE_HOOK_SINK_MUTE_CHANGED] = "sink-mute-changed",
+    [PA_CORE_HOOK_SINK_PORT_LATENCY_OFFSET_CHANGED] = "sink-port-latency-offset-changed",
+    [PA_CORE_HOOK_SOURCE_NEW] = "source-new",
+    [PA_CORE_HOOK_SOURCE_FIXATE] = "source-fixate",
+    [PA_CORE_HOOK_SOURCE_PUT] = "source-put",
+    [PA_CORE_HOOK_SOURCE_UNLINK] = "source-unlink",
+    [PA_CORE_HOOK_SOURCE_UNLINK_POST] = "source-unlink-post",
+    [PA_CORE_HOOK_SOURCE_STATE_CHANGED] = "source-state-changed",
+    [PA_CORE_HOOK_SOURCE_PROPLIST_CHANGED] = "source-proplist-changed",
+    [PA_CORE_HOOK_SOURCE_PORT_CHANGED] = "source-port-changed",
+    [PA_CORE_HOOK_SOURCE_FLAGS_CHANGED] = "source-flags-changed",
+    [PA_CORE_HOOK_SOURCE_VOLUME_CHANGED] = "source-volume-changed",
+    [PA_CORE_HOOK_SOURCE_MUTE_CHANGED] = "source-mute-changed",
+    [PA_CORE_HOOK_SOURCE_PORT_LATENCY_OFFSET_CHANGED] = "source-port-latency-offset-changed",
+    [PA_CORE_HOOK_SINK_INPUT_NEW] = "sink-input-new",
+    [PA_CORE_HOOK_SINK_INPUT_FIXATE] = "sink-input-fixate",
+    [PA_CORE_HOOK_SINK_INPUT_PUT] = "sink-input-put",
+    [PA_CORE_HOOK_SINK_INPUT_UNLINK] = "sink-input-unlink",
+    [PA_CORE_HOOK_SINK_INPUT_UNLINK_POST] = "sink-input-unlink-post",
+    [PA_CORE_HOOK_SINK_INPUT_MOVE_START] = "sink-input-move-start",
+    [PA_CORE_HOOK_SINK_INPUT_MOVE_FINISH] = "sink-input-move-finish",
+    [PA_CORE_HOOK_SINK_INPUT_MOVE_FAIL] = "sink-input-move-fail",
+    [PA_CORE_HOOK_SINK_INPUT_STATE_CHANGED] = "sink-input-state-changed",
+    [PA_CORE_HOOK_SINK_INPUT_PROPLIST_CHANGED] = "sink-input-proplist-changed",
+    [PA_CORE_HOOK_SINK_INPUT_VOLUME_CHANGED] = "sink-input-volume-changed",
+    [PA_CORE_HOOK_SINK_INPUT_MUTE_CHANGED] = "sink-input-mute-changed",
+    [PA_CORE_HOOK_SINK_INPUT_PREFERRED_SINK_CHANGED] = "sink-input-preferred-sink-changed",
+    [PA_CORE_HOOK_SINK_INPUT_SEND_EVENT] = "sink-input-send-event",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_NEW] = "source-output-new",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_FIXATE] = "source-output-fixate",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_PUT] = "source-output-put",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_UNLINK] = "source-output-unlink",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_UNLINK_POST] = "source-output-unlink-post",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_MOVE_START] = "source-output-move-start",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_MOVE_FINISH] = "source-output-move-finish",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_MOVE_FAIL] = "source-output-move-fail",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_STATE_CHANGED] = "source-output-state-changed",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_PROPLIST_CHANGED] = "source-output-proplist-changed",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_VOLUME_CHANGED] = "source-output-volume-changed",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_MUTE_CHANGED] = "source-output-mute-changed",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_PREFERRED_SOURCE_CHANGED] = "source-output-preferred-source-changed",
+    [PA_CORE_HOOK_SOURCE_OUTPUT_SEND_EVENT] = "source-output-send-event",
+    [PA_CORE_HOOK_CLIENT_NEW] = "client-new",
+    [PA_CORE_HOOK_CLIENT_PUT] = "client-put",
+    [PA_CORE_HOOK_CLIENT_UNLINK] = "client-unlink",
+    [PA_CORE_HOOK_CLIENT_PROPLIST_CHANGED] = "client-proplist-changed",
+    [PA_CORE_HOOK_CLIENT_SEND_EVENT] = "client-send-event",
+    [PA_CORE_HOOK_CARD_NEW] = "card-new",
+    [PA_CORE_HOOK_CARD_CHOOSE_INITIAL_PROFILE] = "card-choose-initial-profile",
+    [PA_CORE_HOOK_CARD_PUT] = "card-put",
+    [PA_CORE_HOOK_CARD_UNLINK] = "card-unlink",
+    [PA_CORE_HOOK_CARD_PREFERRED_PORT_CHANGED] = "card-preferred-port-changed",
+    [PA_CORE_HOOK_CARD_PROFILE_CHANGED] = "card-profile-changed",
+    [PA_CORE_HOOK_CARD_PROFILE_ADDED] = "card-profile-added",
+    [PA_CORE_HOOK_CARD_PROFILE_AVAILABLE_CHANGED] = "card-profile-available-changed",
+    [PA_CORE_HOOK_CARD_SUSPEND_CHANGED] = "card-suspend-changed",
+    [PA_CORE_HOOK_PORT_AVAILABLE_CHANGED] = "port-available-changed",
+    [PA_CORE_HOOK_PORT_LATENCY_OFFSET_CHANGED] = "port-latency-offset-changed",
+    [PA_CORE_HOOK_DEFAULT_SINK_CHANGED] = "default-sink-changed",
+    [PA_CORE_HOOK_DEFAULT_SOURCE_CHANGED] = "default-source-changed",
+    [PA_CORE_HOOK_MODULE_NEW] = "module-new",
+    [PA_CORE_HOOK_MODULE_PROPLIST_CHANGED] = "module-proplist-changed",
+    [PA_CORE_HOOK_MODULE_UNLINK] = "module-unlink",
+    [PA_CORE_HOOK_SAMPLE_CACHE_NEW] = "sample-cache-new",
+    [PA_CORE_HOOK_SAMPLE_CACHE_CHANGED] = "sample-cache-changed",
+    [PA_CORE_HOOK_SAMPLE_CACHE_UNLINK] = "sample-cache-unlink",
+};
+
 static void core_free(pa_object *o);
 
 /* Returns a list of handlers. */
@@ -86,6 +166,72 @@ static char *message_handler_list(pa_core *c) {
     return pa_json_encoder_to_string_free(encoder);
 }
 
+/* Returns the profiled core hook slots that were called at least once. */
+static char *hook_stats_to_json(pa_core *c) {
+    pa_json_encoder *encoder;
+    unsigned i;
+
+    encoder = pa_json_encoder_new();
+    pa_json_encoder_begin_element_object(encoder);
+    pa_json_encoder_add_member_bool(encoder, "enabled", pa_hook_get_profiling());
+
+    pa_json_encoder_begin_member_array(encoder, "slots");
+    for (i = 0; i < PA_CORE_HOOK_MAX; i++) {
+        pa_hook_slot *slot;
+
+        PA_LLIST_FOREACH(slot, c->hooks[i].slots) {
+            if (slot->dead || slot->n_calls == 0)
+                continue;
+
+            pa_json_encoder_begin_element_object(encoder);
+            pa_json_encoder_add_member_string(encoder, "hook", hook_names[i]);
+            pa_json_encoder_add_member_string(encoder, "module", slot->module ? slot->module->name : NULL);
+            pa_json_encoder_add_member_int(encoder, "priority", slot->priority);
+            pa_json_encoder_add_member_int(encoder, "calls", (int64_t) slot->n_calls);
+            pa_json_encoder_add_member_int(encoder, "usec", (int64_t) slot->total_usec);
+            pa_json_encoder_end_object(encoder);
+        }
+    }
+    pa_json_encoder_end_array(encoder);
+
+    pa_json_encoder_end_object(encoder);
+
+    return pa_json_encoder_to_string_free(encoder);
+}
+
+static char *io_stats_to_json(pa_core *c) {
+    pa_json_encoder *encoder;
+    pa_cycle_stats stats;
+    pa_sink *sink;
+    pa_source *source;
+    uint32_t idx;
+
+    encoder = pa_json_encoder_new();
+    pa_json_encoder_begin_element_array(encoder);
+
+    PA_IDXSET_FOREACH(sink, c->sinks, idx) {
+        pa_sink_get_cycle_stats(sink, &stats);
+
+        pa_json_encoder_begin_element_object(encoder);
+        pa_json_encoder_add_member_string(encoder, "sink", sink->name);
+        pa_cycle_stats_to_json(&stats, "render", encoder);
+        pa_json_encoder_end_object(encoder);
+    }
+
+    PA_IDXSET_FOREACH(source, c->sources, idx) {
+        pa_source_get_cycle_stats(source, &stats);
+
+        pa_json_encoder_begin_element_object(encoder);
+        pa_json_encoder_add_member_string(encoder, "source", source->name);
+        pa_cycle_stats_to_json(&stats, "post", encoder);
+        pa_json_encoder_end_object(encoder);
+    }
+
+    pa_json_encoder_end_array(encoder);
+
+    return pa_json_encoder_to_string_free(encoder);
+}
+
 static int core_message_handler(const char *object_path, const char *message, const pa_json_object *parameters, char **response, void *userdata) {
     pa_core *c = userdata;
 
@@ -99,6 +245,78 @@ static int core_message_handler(const char *object_path, const char *message, co
         return PA_OK;
     }
 
+    if (pa_streq(message, "get-subscription-stats")) {
+        pa_json_encoder *encoder;
+
+        encoder = pa_json_encoder_new();
+        pa_json_encoder_begin_element_object(encoder);
+        pa_json_encoder_add_member_int(encoder, "posted", (int64_t) c->subscription_events_posted);
+        pa_json_encoder_add_member_int(encoder, "coalesced", (int64_t) c->subscription_events_coalesced);
+        pa_json_encoder_add_member_int(encoder, "delivered", (int64_t) c->subscription_events_delivered);
+        pa_json_encoder_add_member_int(encoder, "bursts", (int64_t) c->subscription_bursts);
+        pa_json_encoder_end_object(encoder);
+
+        *response = pa_json_encoder_to_string_free(encoder);
+        return PA_OK;
+    }
+
+    if (pa_streq(message, "get-database-stats")) {
+        pa_database_stats stats;
+        pa_json_encoder *encoder;
+
+        pa_database_get_stats(&stats);
+
+        encoder = pa_json_encoder_new();
+        pa_json_encoder_begin_element_object(encoder);
+        pa_json_encoder_add_member_int(encoder, "caller_usec", (int64_t) stats.caller_usec);
+        pa_json_encoder_add_member_int(encoder, "writer_usec", (int64_t) stats.writer_usec);
+        pa_json_encoder_add_member_int(encoder, "syncs", (int64_t) stats.n_syncs);
+        pa_json_encoder_add_member_int(encoder, "async_syncs", (int64_t) stats.n_async_syncs);
+        pa_json_encoder_add_member_int(encoder, "snapshots_written", (int64_t) stats.n_snapshots_written);
+        pa_json_encoder_add_member_int(encoder, "snapshots_failed", (int64_t) stats.n_snapshots_failed);
+        pa_json_encoder_add_member_int(encoder, "queued", stats.n_queued);
+        pa_json_encoder_end_object(encoder);
+
+        *response = pa_json_encoder_to_string_free(encoder);
+        return PA_OK;
+    }
+
+    if (pa_streq(message, "get-hook-stats")) {
+        *response = hook_stats_to_json(c);
+        return PA_OK;
+    }
+
+    if (pa_streq(message, "set-hook-profiling")) {
+        if (!parameters || pa_json_object_get_type(parameters) != PA_JSON_TYPE_BOOL) {
+            pa_log_info("Core operation set-hook-profiling requires argument: \"true\" or \"false\"");
+            return -PA_ERR_INVALID;
+        }
+
+        pa_core_set_hook_profiling(c, pa_json_object_get_bool(parameters));
+        return PA_OK;
+    }
+
+    if (pa_streq(message, "get-io-stats")) {
+        *response = io_stats_to_json(c);
+        return PA_OK;
+    }
+
+    if (pa_streq(message, "get-mainloop-stats")) {
+        if (!c->mainloop_watchdog)
+            return -PA_ERR_NOENTITY;
+
+        *response = pa_mainloop_watchdog_stats_to_json(c->mainloop_watchdog);
+        return PA_OK;
+    }
+
+    if (pa_streq(message, "get-startup-trace")) {
+        if (!c->startup_trace)
+            return -PA_ERR_NOENTITY;
+
+        *response = pa_startup_trace_to_string(c->startup_trace, PA_STARTUP_TRACE_JSON);
+        return PA_OK;
+    }
+
     return -PA_ERR_NOTIMPLEMENTED;
 }
 
@@ -164,6 +382,8 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
 
     c->deferred_volume_safety_margin_usec = 8000;
     c->deferred_volume_extra_delay_usec = 0;
+    c->deferred_volume_coalesce_usec = 0;
+    c->rewind_limit_usec = 0;
 
     c->module_defer_unload_event = NULL;
     c->modules_pending_unload = pa_hashmap_new(NULL, NULL);
@@ -172,6 +392,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     PA_LLIST_HEAD_INIT(pa_subscription, c->subscriptions);
     PA_LLIST_HEAD_INIT(pa_subscription_event, c->subscription_event_queue);
     c->subscription_event_last = NULL;
+    c->subscription_event_objects = NULL;
 
     c->mempool = pool;
     c->shm_size = shm_size;
@@ -195,6 +416,7 @@ pa_core* pa_core_new(pa_mainloop_api *m, bool shared, bool enable_memfd, size_t
     c->remixing_consume_lfe = false;
     c->lfe_crossover_freq = 0;
     c->deferred_volume = true;
+    c->rewind_on_volume_change = true;
     c->resample_method = PA_RESAMPLER_SPEEX_FLOAT_BASE + 1;
 
     for (j = 0; j < PA_CORE_HOOK_MAX; j++)
@@ -269,6 +491,9 @@ static void core_free(pa_object *o) {
     pa_xfree(c->policy_default_source);
     pa_xfree(c->policy_default_sink);
 
+    if (c->startup_trace)
+        pa_startup_trace_free(c->startup_trace);
+
     pa_silence_cache_done(&c->silence_cache);
     pa_mempool_unref(c->mempool);
 
@@ -661,6 +886,32 @@ void pa_core_maybe_vacuum(pa_core *c) {
     pa_mempool_vacuum(c->mempool);
 }
 
+const char *pa_core_hook_to_string(pa_core_hook_t hook) {
+    pa_assert(hook < PA_CORE_HOOK_MAX);
+
+    return hook_names[hook];
+}
+
+void pa_core_set_hook_profiling(pa_core *c, bool enabled) {
+    unsigned i;
+
+    pa_assert(c);
+
+    if (enabled && !pa_hook_get_profiling()) {
+        for (i = 0; i < PA_CORE_HOOK_MAX; i++) {
+            pa_hook_slot *slot;
+
+            PA_LLIST_FOREACH(slot, c->hooks[i].slots) {
+                slot->n_calls = 0;
+                slot->total_usec = 0;
+            }
+        }
+    }
+
+    pa_hook_set_profiling(enabled);
+    pa_log_info("Hook profiling %s.", enabled ? "enabled" : "disabled");
+}
+
 pa_time_event* pa_core_rttime_new(pa_core *c, pa_usec_t usec, pa_time_event_cb_t cb, void *userdata) {
     struct timeval tv;
 
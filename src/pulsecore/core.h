@@ -53,6 +53,8 @@ typedef enum pa_suspend_cause {
 #include <pulsecore/source.h>
 #include <pulsecore/core-subscribe.h>
 #include <pulsecore/msgobject.h>
+#include <pulsecore/startup-trace.h>
+#include <pulsecore/mainloop-watchdog.h>
 
 typedef enum pa_server_type {
     PA_SERVER_TYPE_UNSET,
@@ -168,6 +170,12 @@ struct pa_core {
     /* Some hashmaps for all sorts of entities */
     pa_hashmap *namereg, *shared, *message_handlers;
 
+    /* Set while and after the startup is traced */
+    pa_startup_trace *startup_trace;
+
+    /* Set by the daemon if it runs the main loop through a watchdog */
+    pa_mainloop_watchdog *mainloop_watchdog;
+
     /* The default sink/source as configured by the user. If the user hasn't
      * explicitly configured anything, these are set to NULL. These are strings
      * instead of sink/source pointers, because that allows us to reference
@@ -197,6 +205,8 @@ struct pa_core {
     unsigned default_n_fragments, default_fragment_size_msec;
     unsigned deferred_volume_safety_margin_usec;
     int deferred_volume_extra_delay_usec;
+    unsigned deferred_volume_coalesce_usec;
+    pa_usec_t rewind_limit_usec;
     unsigned lfe_crossover_freq;
 
     pa_defer_event *module_defer_unload_event;
@@ -206,6 +216,14 @@ struct pa_core {
     PA_LLIST_HEAD(pa_subscription, subscriptions);
     PA_LLIST_HEAD(pa_subscription_event, subscription_event_queue);
     pa_subscription_event *subscription_event_last;
+    pa_hashmap *subscription_event_objects;
+
+    /* Subscription events posted, dropped as redundant, handed to
+     * subscribers, and the number of dispatch rounds */
+    uint64_t subscription_events_posted;
+    uint64_t subscription_events_coalesced;
+    uint64_t subscription_events_delivered;
+    uint64_t subscription_bursts;
 
     /* The mempool is used for data we write to, it's readonly for the client. */
     pa_mempool *mempool;
@@ -233,6 +251,7 @@ struct pa_core {
     bool remixing_produce_lfe:1;
     bool remixing_consume_lfe:1;
     bool deferred_volume:1;
+    bool rewind_on_volume_change:1;
 
     pa_resample_method_t resample_method;
     int realtime_priority;
@@ -280,6 +299,13 @@ int pa_core_exit(pa_core *c, bool force, int retval);
 
 void pa_core_maybe_vacuum(pa_core *c);
 
+const char *pa_core_hook_to_string(pa_core_hook_t hook);
+
+/* Enables or disables profiling of hook callbacks, see
+ * pa_hook_set_profiling(). Enabling it resets the counters of all core hook
+ * slots. */
+void pa_core_set_hook_profiling(pa_core *c, bool enabled);
+
 /* wrapper for c->mainloop->time_*() RT time events */
 pa_time_event* pa_core_rttime_new(pa_core *c, pa_usec_t usec, pa_time_event_cb_t cb, void *userdata);
 void pa_core_rttime_restart(pa_core *c, pa_time_event *e, pa_usec_t usec);
@@ -18,21 +18,425 @@
 #include <config.h>
 #endif
 
+#include <errno.h>
+#include <stdio.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/mix.h>
+#include <pulsecore/random.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/sconv.h>
+
 #include "cpu.h"
 #include "cpu-orc.h"
 
+#define TUNE_CACHE_FILE "dsp-tuning"
+#define TUNE_CHANNELS 2
+#define TUNE_SAMPLES_MAX 8192
+#define TUNE_SAMPLES_PER_RUN 65536
+#define TUNE_REPEATS 3
+
+/* The implementations of the DSP functions in the order they are
+ * installed by pa_cpu_init(), later ones override earlier ones */
+typedef enum {
+    CANDIDATE_C,
+    CANDIDATE_SIMD,
+    CANDIDATE_ORC,
+    CANDIDATE_MAX
+} candidate_t;
+
+static const char * const candidate_names[CANDIDATE_MAX] = {
+    [CANDIDATE_C] = "c",
+    [CANDIDATE_SIMD] = "simd",
+    [CANDIDATE_ORC] = "orc",
+};
+
+typedef enum {
+    KERNEL_VOLUME,
+    KERNEL_MIX,
+    KERNEL_TO_FLOAT32NE,
+    KERNEL_FROM_FLOAT32NE,
+    KERNEL_TO_S16NE,
+    KERNEL_FROM_S16NE,
+} kernel_type_t;
+
+typedef void (*kernel_func_t)(void);
+
+struct kernel {
+    const char *name;
+    kernel_type_t type;
+    pa_sample_format_t format;
+    kernel_func_t candidates[CANDIDATE_MAX];
+};
+
+/* The functions for which optimized implementations exist */
+static struct kernel kernels[] = {
+    { "volume-s16ne",             KERNEL_VOLUME,         PA_SAMPLE_S16NE },
+    { "volume-s16re",             KERNEL_VOLUME,         PA_SAMPLE_S16RE },
+    { "mix-s16ne",                KERNEL_MIX,            PA_SAMPLE_S16NE },
+    { "s16le-to-float32ne",       KERNEL_TO_FLOAT32NE,   PA_SAMPLE_S16LE },
+    { "float32ne-to-s16le",       KERNEL_FROM_FLOAT32NE, PA_SAMPLE_S16LE },
+    { "float32le-to-s16ne",       KERNEL_TO_S16NE,       PA_SAMPLE_FLOAT32LE },
+    { "s16ne-to-float32le",       KERNEL_FROM_S16NE,     PA_SAMPLE_FLOAT32LE },
+};
+
+struct tune_buffers {
+    void *in[2];
+    void *out;
+    int32_t volume[PA_CHANNELS_MAX + 32];
+    pa_mix_info streams[2];
+};
+
+static kernel_func_t get_kernel_func(const struct kernel *k) {
+    switch (k->type) {
+        case KERNEL_VOLUME:
+            return (kernel_func_t) pa_get_volume_func(k->format);
+        case KERNEL_MIX:
+            return (kernel_func_t) pa_get_mix_func(k->format);
+        case KERNEL_TO_FLOAT32NE:
+            return (kernel_func_t) pa_get_convert_to_float32ne_function(k->format);
+        case KERNEL_FROM_FLOAT32NE:
+            return (kernel_func_t) pa_get_convert_from_float32ne_function(k->format);
+        case KERNEL_TO_S16NE:
+            return (kernel_func_t) pa_get_convert_to_s16ne_function(k->format);
+        case KERNEL_FROM_S16NE:
+            return (kernel_func_t) pa_get_convert_from_s16ne_function(k->format);
+    }
+
+    pa_assert_not_reached();
+}
+
+static void set_kernel_func(const struct kernel *k, kernel_func_t func) {
+    switch (k->type) {
+        case KERNEL_VOLUME:
+            pa_set_volume_func(k->format, (pa_do_volume_func_t) func);
+            return;
+        case KERNEL_MIX:
+            pa_set_mix_func(k->format, (pa_do_mix_func_t) func);
+            return;
+        case KERNEL_TO_FLOAT32NE:
+            pa_set_convert_to_float32ne_function(k->format, (pa_convert_func_t) func);
+            return;
+        case KERNEL_FROM_FLOAT32NE:
+            pa_set_convert_from_float32ne_function(k->format, (pa_convert_func_t) func);
+            return;
+        case KERNEL_TO_S16NE:
+            pa_set_convert_to_s16ne_function(k->format, (pa_convert_func_t) func);
+            return;
+        case KERNEL_FROM_S16NE:
+            pa_set_convert_from_s16ne_function(k->format, (pa_convert_func_t) func);
+            return;
+    }
+
+    pa_assert_not_reached();
+}
+
+/* Remember the currently installed implementations */
+static void save_candidates(candidate_t candidate) {
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(kernels); i++)
+        kernels[i].candidates[candidate] = get_kernel_func(&kernels[i]);
+}
+
 void pa_cpu_init(pa_cpu_info *cpu_info) {
+    unsigned i;
+
     cpu_info->cpu_type = PA_CPU_UNDEFINED;
     /* don't force generic code, used for testing only */
     cpu_info->force_generic_code = false;
+    save_candidates(CANDIDATE_C);
     if (!getenv("PULSE_NO_SIMD")) {
         if (pa_cpu_init_x86(&cpu_info->flags.x86))
             cpu_info->cpu_type = PA_CPU_X86;
         else if (pa_cpu_init_arm(&cpu_info->flags.arm))
             cpu_info->cpu_type = PA_CPU_ARM;
+        save_candidates(CANDIDATE_SIMD);
         pa_cpu_init_orc(*cpu_info);
+        save_candidates(CANDIDATE_ORC);
     }
 
     pa_remap_func_init(cpu_info);
     pa_mix_func_init(cpu_info);
+
+    /* pa_mix_func_init() overrides the mix functions installed above */
+    for (i = 0; i < PA_ELEMENTSOF(kernels); i++)
+        if (kernels[i].type == KERNEL_MIX)
+            kernels[i].candidates[CANDIDATE_C] = get_kernel_func(&kernels[i]);
+}
+
+/* Runs one implementation on a block of n samples */
+static void run_kernel(const struct kernel *k, kernel_func_t func, struct tune_buffers *b, unsigned n) {
+    switch (k->type) {
+        case KERNEL_VOLUME:
+            ((pa_do_volume_func_t) func)(b->out, b->volume, TUNE_CHANNELS, n * pa_sample_size_of_format(k->format));
+            break;
+
+        case KERNEL_MIX:
+            b->streams[0].ptr = b->in[0];
+            b->streams[1].ptr = b->in[1];
+            ((pa_do_mix_func_t) func)(b->streams, 2, TUNE_CHANNELS, b->out, n * pa_sample_size_of_format(k->format));
+            break;
+
+        case KERNEL_TO_FLOAT32NE:
+        case KERNEL_TO_S16NE:
+        case KERNEL_FROM_S16NE:
+            ((pa_convert_func_t) func)(n, b->in[0], b->out);
+            break;
+
+        case KERNEL_FROM_FLOAT32NE:
+            /* The input needs to be valid float data */
+            ((pa_convert_func_t) func)(n, b->in[1], b->out);
+            break;
+    }
+}
+
+/* Returns the processing time per sample in nanoseconds, summed over a small,
+ * medium and large block size */
+static double time_kernel(const struct kernel *k, kernel_func_t func, struct tune_buffers *b) {
+    static const unsigned block_sizes[] = { 64, 1024, TUNE_SAMPLES_MAX };
+    double total = 0;
+    unsigned i, r, j;
+
+    for (i = 0; i < PA_ELEMENTSOF(block_sizes); i++) {
+        unsigned n = block_sizes[i], runs = TUNE_SAMPLES_PER_RUN / n;
+        pa_usec_t best = (pa_usec_t) -1;
+
+        /* Warm up the caches */
+        run_kernel(k, func, b, n);
+
+        for (r = 0; r < TUNE_REPEATS; r++) {
+            pa_usec_t start = pa_rtclock_now();
+
+            for (j = 0; j < runs; j++)
+                run_kernel(k, func, b, n);
+
+            best = PA_MIN(best, pa_rtclock_now() - start);
+        }
+
+        total += (double) best * 1000 / (runs * n);
+    }
+
+    return total;
+}
+
+static void tune_buffers_init(struct tune_buffers *b) {
+    float *f;
+    int16_t *s;
+    unsigned i;
+
+    /* Large enough for all formats */
+    b->in[0] = pa_xmalloc(TUNE_SAMPLES_MAX * sizeof(float));
+    b->in[1] = pa_xmalloc(TUNE_SAMPLES_MAX * sizeof(float));
+    b->out = pa_xmalloc0(TUNE_SAMPLES_MAX * sizeof(float));
+
+    /* in[0] holds random integer data, in[1] holds float data in the
+     * range [-1, 1) */
+    pa_random(b->in[0], TUNE_SAMPLES_MAX * sizeof(float));
+    s = b->in[0];
+    f = b->in[1];
+    for (i = 0; i < TUNE_SAMPLES_MAX; i++)
+        f[i] = s[i] / (float) 0x8000;
+
+    for (i = 0; i < PA_ELEMENTSOF(b->volume); i++)
+        b->volume[i] = 0x10000;
+
+    for (i = 0; i < TUNE_CHANNELS; i++)
+        b->streams[0].linear[i].i = b->streams[1].linear[i].i = 0x8000;
+}
+
+static void tune_buffers_done(struct tune_buffers *b) {
+    pa_xfree(b->in[0]);
+    pa_xfree(b->in[1]);
+    pa_xfree(b->out);
+}
+
+/* Returns true if the candidate exists and differs from all previous ones */
+static bool candidate_is_unique(const struct kernel *k, candidate_t c) {
+    candidate_t i;
+
+    if (!k->candidates[c])
+        return false;
+
+    for (i = 0; i < c; i++)
+        if (k->candidates[i] == k->candidates[c])
+            return false;
+
+    return true;
+}
+
+static struct kernel *find_kernel(const char *name) {
+    unsigned i;
+
+    for (i = 0; i < PA_ELEMENTSOF(kernels); i++)
+        if (pa_streq(kernels[i].name, name))
+            return &kernels[i];
+
+    return NULL;
+}
+
+static candidate_t find_candidate(const char *name) {
+    candidate_t c;
+
+    for (c = 0; c < CANDIDATE_MAX; c++)
+        if (pa_streq(candidate_names[c], name))
+            return c;
+
+    return CANDIDATE_MAX;
+}
+
+static char *cache_header(const pa_cpu_info *cpu_info) {
+    unsigned flags = 0;
+
+    if (cpu_info->cpu_type == PA_CPU_X86)
+        flags = cpu_info->flags.x86;
+    else if (cpu_info->cpu_type == PA_CPU_ARM)
+        flags = cpu_info->flags.arm;
+
+    return pa_sprintf_malloc("%s %u 0x%x", PACKAGE_VERSION, cpu_info->cpu_type, flags);
+}
+
+/* Installs the implementations listed in the cache file. Returns false if
+ * the file is missing or was written for a different CPU or version. */
+static bool load_cache(const char *fn, const char *header, candidate_t choice[]) {
+    FILE *f;
+    char line[256];
+    bool ok = false;
+
+    if (!(f = pa_fopen_cloexec(fn, "r"))) {
+        if (errno != ENOENT)
+            pa_log_warn("Failed to open DSP tuning cache %s: %s", fn, pa_cstrerror(errno));
+        return false;
+    }
+
+    if (!fgets(line, sizeof(line), f) || !pa_streq(pa_strip_nl(line), header)) {
+        pa_log_info("DSP tuning cache is outdated.");
+        goto finish;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        const char *state = NULL;
+        char *name, *impl;
+        struct kernel *k;
+        candidate_t c;
+
+        pa_strip_nl(line);
+        name = pa_split_spaces(line, &state);
+        impl = pa_split_spaces(line, &state);
+
+        if (name && impl && (k = find_kernel(name)) && (c = find_candidate(impl)) < CANDIDATE_MAX && k->candidates[c])
+            choice[k - kernels] = c;
+        else
+            pa_log_warn("Ignoring invalid line in DSP tuning cache: %s", line);
+
+        pa_xfree(name);
+        pa_xfree(impl);
+    }
+
+    ok = true;
+
+finish:
+    fclose(f);
+    return ok;
+}
+
+static void save_cache(const char *fn, const char *header, const candidate_t choice[]) {
+    FILE *f;
+    unsigned i;
+
+    if (!(f = pa_fopen_cloexec(fn, "w"))) {
+        pa_log_warn("Failed to write DSP tuning cache %s: %s", fn, pa_cstrerror(errno));
+        return;
+    }
+
+    fprintf(f, "%s\n", header);
+
+    for (i = 0; i < PA_ELEMENTSOF(kernels); i++)
+        if (choice[i] < CANDIDATE_MAX)
+            fprintf(f, "%s %s\n", kernels[i].name, candidate_names[choice[i]]);
+
+    if (fclose(f) != 0)
+        pa_log_warn("Failed to write DSP tuning cache %s: %s", fn, pa_cstrerror(errno));
+}
+
+/* Chooses the fastest implementation of every kernel that has more than one */
+static void benchmark_kernels(candidate_t choice[]) {
+    struct tune_buffers b;
+    unsigned i;
+
+    tune_buffers_init(&b);
+
+    for (i = 0; i < PA_ELEMENTSOF(kernels); i++) {
+        struct kernel *k = &kernels[i];
+        double best_time = 0;
+        candidate_t c, n = 0;
+
+        for (c = 0; c < CANDIDATE_MAX; c++)
+            if (candidate_is_unique(k, c))
+                n++;
+
+        if (n < 2)
+            continue;
+
+        for (c = 0; c < CANDIDATE_MAX; c++) {
+            double t;
+
+            if (!candidate_is_unique(k, c))
+                continue;
+
+            t = time_kernel(k, k->candidates[c], &b);
+            pa_log_debug("DSP function %s, %s implementation: %0.3f ns/sample", k->name, candidate_names[c], t);
+
+            if (choice[i] == CANDIDATE_MAX || t < best_time) {
+                choice[i] = c;
+                best_time = t;
+            }
+        }
+    }
+
+    tune_buffers_done(&b);
+}
+
+void pa_cpu_tune(const pa_cpu_info *cpu_info) {
+    candidate_t choice[PA_ELEMENTSOF(kernels)];
+    char *fn, *header;
+    unsigned i;
+
+    pa_assert(cpu_info);
+
+    if (cpu_info->cpu_type == PA_CPU_UNDEFINED || cpu_info->force_generic_code)
+        return;
+
+    for (i = 0; i < PA_ELEMENTSOF(kernels); i++)
+        choice[i] = CANDIDATE_MAX;
+
+    header = cache_header(cpu_info);
+    fn = pa_state_path(TUNE_CACHE_FILE, true);
+
+    if (!fn || !load_cache(fn, header, choice)) {
+        pa_usec_t start = pa_rtclock_now();
+
+        benchmark_kernels(choice);
+        pa_log_info("Tuning DSP functions took %llu ms.", (unsigned long long) ((pa_rtclock_now() - start) / PA_USEC_PER_MSEC));
+
+        if (fn)
+            save_cache(fn, header, choice);
+    }
+
+    for (i = 0; i < PA_ELEMENTSOF(kernels); i++) {
+        if (choice[i] == CANDIDATE_MAX)
+            continue;
+
+        pa_log_info("Using %s implementation of %s.", candidate_names[choice[i]], kernels[i].name);
+        set_kernel_func(&kernels[i], kernels[i].candidates[choice[i]]);
+    }
+
+    pa_xfree(fn);
+    pa_xfree(header);
 }
@@ -43,6 +43,10 @@ struct pa_cpu_info {
 
 void pa_cpu_init(pa_cpu_info *cpu_info);
 
+/* Benchmarks the available implementations of the DSP functions and
+ * installs the fastest ones. The choice is cached in the state directory. */
+void pa_cpu_tune(const pa_cpu_info *cpu_info);
+
 void pa_remap_func_init(const pa_cpu_info *cpu_info);
 void pa_mix_func_init(const pa_cpu_info *cpu_info);
 
@@ -0,0 +1,178 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulsecore/macro.h>
+
+#include "cycle-stats.h"
+
+#define TIMING_MIN_USEC 16
+
+static pa_usec_t timing_bucket_limit(unsigned i) {
+    return (pa_usec_t) TIMING_MIN_USEC << i;
+}
+
+/* Called from IO context */
+void pa_cycle_timing_add(pa_cycle_timing *t, pa_usec_t usec) {
+    unsigned i;
+
+    pa_assert(t);
+
+    for (i = 0; i < PA_CYCLE_TIMING_BUCKETS - 1; i++)
+        if (usec < timing_bucket_limit(i))
+            break;
+
+    t->buckets[i]++;
+    t->n++;
+    t->total += usec;
+    t->max = PA_MAX(t->max, usec);
+}
+
+/* Returns the time that p of the recorded ones did not exceed, interpolated
+ * linearly within the bucket */
+pa_usec_t pa_cycle_timing_percentile(const pa_cycle_timing *t, double p) {
+    double wanted, seen = 0;
+    unsigned i;
+
+    pa_assert(t);
+    pa_assert(p >= 0 && p <= 1);
+
+    if (t->n == 0)
+        return 0;
+
+    wanted = p * t->n;
+
+    for (i = 0; i < PA_CYCLE_TIMING_BUCKETS; i++) {
+        pa_usec_t lower, upper;
+
+        if (seen + t->buckets[i] < wanted) {
+            seen += t->buckets[i];
+            continue;
+        }
+
+        lower = i > 0 ? timing_bucket_limit(i - 1) : 0;
+        upper = i < PA_CYCLE_TIMING_BUCKETS - 1 ? timing_bucket_limit(i) : PA_MAX(t->max, lower);
+        upper = PA_MIN(upper, t->max);
+
+        if (upper <= lower)
+            return upper;
+
+        return lower + (pa_usec_t) ((upper - lower) * (wanted - seen) / PA_MAX(t->buckets[i], 1u));
+    }
+
+    return t->max;
+}
+
+/* Called from IO context */
+void pa_cycle_stats_add_cycle(pa_cycle_stats *s, pa_usec_t busy_usec, pa_usec_t headroom_usec) {
+    unsigned i;
+
+    pa_assert(s);
+
+    pa_cycle_timing_add(&s->cycle, busy_usec);
+
+    if (headroom_usec == 0)
+        return;
+
+    i = (unsigned) PA_MIN(busy_usec * 10 / headroom_usec, (pa_usec_t) PA_CYCLE_STATS_LOAD_BUCKETS - 1);
+    s->load[i]++;
+
+    if (s->n_loaded == 0 || headroom_usec < s->min_headroom)
+        s->min_headroom = headroom_usec;
+
+    s->n_loaded++;
+}
+
+/* Called from IO context */
+void pa_cycle_stats_add_rewind(pa_cycle_stats *s, size_t nbytes) {
+    pa_assert(s);
+
+    s->rewound_bytes += nbytes;
+    s->rerender_pending += nbytes;
+}
+
+/* Called from IO context */
+void pa_cycle_stats_add_render(pa_cycle_stats *s, size_t nbytes) {
+    uint64_t n;
+
+    pa_assert(s);
+
+    if (s->rerender_pending == 0)
+        return;
+
+    n = PA_MIN((uint64_t) nbytes, s->rerender_pending);
+    s->rerendered_bytes += n;
+    s->rerender_pending -= n;
+}
+
+unsigned pa_cycle_stats_load_percentile(const pa_cycle_stats *s, double p) {
+    double wanted, seen = 0;
+    unsigned i;
+
+    pa_assert(s);
+    pa_assert(p >= 0 && p <= 1);
+
+    if (s->n_loaded == 0)
+        return 0;
+
+    wanted = p * s->n_loaded;
+
+    for (i = 0; i < PA_CYCLE_STATS_LOAD_BUCKETS - 1; i++) {
+        if (seen + s->load[i] >= wanted)
+            return (i + 1) * 10;
+
+        seen += s->load[i];
+    }
+
+    return 100;
+}
+
+static void timing_to_json(const pa_cycle_timing *t, const char *name, pa_json_encoder *encoder) {
+    pa_json_encoder_begin_member_object(encoder, name);
+    pa_json_encoder_add_member_int(encoder, "count", (int64_t) t->n);
+    pa_json_encoder_add_member_int(encoder, "total_usec", (int64_t) t->total);
+    pa_json_encoder_add_member_int(encoder, "max_usec", (int64_t) t->max);
+    pa_json_encoder_add_member_int(encoder, "p50_usec", (int64_t) pa_cycle_timing_percentile(t, 0.5));
+    pa_json_encoder_add_member_int(encoder, "p99_usec", (int64_t) pa_cycle_timing_percentile(t, 0.99));
+    pa_json_encoder_end_object(encoder);
+}
+
+void pa_cycle_stats_to_json(const pa_cycle_stats *s, const char *render_name, pa_json_encoder *encoder) {
+    pa_assert(s);
+    pa_assert(render_name);
+    pa_assert(encoder);
+
+    timing_to_json(&s->render, render_name, encoder);
+    timing_to_json(&s->write, "device", encoder);
+    timing_to_json(&s->cycle, "cycle", encoder);
+
+    pa_json_encoder_add_member_int(encoder, "min_headroom_usec", (int64_t) s->min_headroom);
+    pa_json_encoder_add_member_int(encoder, "p50_load_percent", pa_cycle_stats_load_percentile(s, 0.5));
+    pa_json_encoder_add_member_int(encoder, "p99_load_percent", pa_cycle_stats_load_percentile(s, 0.99));
+    pa_json_encoder_add_member_int(encoder, "overloaded_cycles", (int64_t) s->load[PA_CYCLE_STATS_LOAD_BUCKETS - 1]);
+
+    pa_json_encoder_add_member_int(encoder, "resampler_runs", (int64_t) s->n_resampler_runs);
+    pa_json_encoder_add_member_int(encoder, "resampler_usec", (int64_t) s->resampler_usec);
+
+    pa_json_encoder_add_member_int(encoder, "rewound_bytes", (int64_t) s->rewound_bytes);
+    pa_json_encoder_add_member_int(encoder, "rerendered_bytes", (int64_t) s->rerendered_bytes);
+    pa_json_encoder_add_member_int(encoder, "limited_rewinds", (int64_t) s->n_rewinds_limited);
+    pa_json_encoder_add_member_int(encoder, "skipped_rewinds", (int64_t) s->n_rewinds_skipped);
+}
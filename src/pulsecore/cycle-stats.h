@@ -0,0 +1,96 @@
+#ifndef foocyclestatshfoo
+#define foocyclestatshfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulse/sample.h>
+
+#include <pulsecore/json.h>
+
+/* How long the IO thread of a sink or source spends in each cycle, always
+ * collected. The histograms are cumulative, the upper bounds of their
+ * buckets double starting at 16 usec, and the last bucket is unbounded. */
+
+#define PA_CYCLE_TIMING_BUCKETS 16
+
+/* Load is the time a cycle took relative to the headroom it had, in steps
+ * of 10%. The last bucket counts cycles that took longer than their
+ * headroom. */
+#define PA_CYCLE_STATS_LOAD_BUCKETS 11
+
+typedef struct pa_cycle_timing {
+    uint64_t buckets[PA_CYCLE_TIMING_BUCKETS];
+    uint64_t n;
+    pa_usec_t total;
+    pa_usec_t max;
+} pa_cycle_timing;
+
+typedef struct pa_cycle_stats {
+    /* pa_sink_render*() or pa_source_post() */
+    pa_cycle_timing render;
+
+    /* Device writes or reads and whole IO cycles, if the implementor
+     * reports them */
+    pa_cycle_timing write;
+    pa_cycle_timing cycle;
+
+    uint64_t load[PA_CYCLE_STATS_LOAD_BUCKETS];
+    uint64_t n_loaded;
+    pa_usec_t min_headroom;
+
+    /* Filled in when the statistics are retrieved, from the resamplers of
+     * the streams connected at that time */
+    uint64_t n_resampler_runs;
+    pa_usec_t resampler_usec;
+
+    /* Bytes given back by rewinds, and the part of them that was rendered
+     * again afterwards */
+    uint64_t rewound_bytes;
+    uint64_t rerendered_bytes;
+    uint64_t rerender_pending;
+
+    /* Rewind requests that the rewind policy of a sink shortened, or
+     * dropped because they were only for a volume change */
+    uint64_t n_rewinds_limited;
+    uint64_t n_rewinds_skipped;
+} pa_cycle_stats;
+
+void pa_cycle_timing_add(pa_cycle_timing *t, pa_usec_t usec);
+pa_usec_t pa_cycle_timing_percentile(const pa_cycle_timing *t, double p);
+
+/* Records an IO cycle that was busy for busy_usec, while the device had
+ * headroom_usec of data (or space) left when it started. A headroom of 0
+ * means that it is unknown. */
+void pa_cycle_stats_add_cycle(pa_cycle_stats *s, pa_usec_t busy_usec, pa_usec_t headroom_usec);
+
+/* Record a rewind of nbytes, and nbytes of audio rendered or posted. The
+ * rendered bytes count as rerendered until they have made up for the
+ * rewinds. */
+void pa_cycle_stats_add_rewind(pa_cycle_stats *s, size_t nbytes);
+void pa_cycle_stats_add_render(pa_cycle_stats *s, size_t nbytes);
+
+/* Returns the load in percent that p of the cycles did not exceed */
+unsigned pa_cycle_stats_load_percentile(const pa_cycle_stats *s, double p);
+
+/* Adds the statistics as members of the current object of the encoder,
+ * render_name names the render timing */
+void pa_cycle_stats_to_json(const pa_cycle_stats *s, const char *render_name, pa_json_encoder *encoder);
+
+#endif
@@ -92,7 +92,7 @@ pa_database* pa_database_open_internal(const char *path, bool for_write) {
     return (pa_database*) f;
 }
 
-void pa_database_close(pa_database *db) {
+void pa_database_close_internal(pa_database *db) {
     pa_assert(db);
 
     gdbm_close(MAKE_GDBM_FILE(db));
@@ -236,9 +236,24 @@ pa_datum* pa_database_next(pa_database *db, const pa_datum *key, pa_datum *next,
     return next;
 }
 
-int pa_database_sync(pa_database *db) {
+int pa_database_sync_internal(pa_database *db) {
     pa_assert(db);
 
     gdbm_sync(MAKE_GDBM_FILE(db));
     return 0;
 }
+
+/* The GDBM file can't be flushed while it's being used from another thread,
+ * so this syncs right away */
+pa_database_snapshot* pa_database_snapshot_internal(pa_database *db) {
+    pa_database_sync_internal(db);
+    return NULL;
+}
+
+int pa_database_snapshot_write_internal(pa_database_snapshot *s) {
+    pa_assert_not_reached();
+}
+
+void pa_database_snapshot_free_internal(pa_database_snapshot *s) {
+    pa_assert_not_reached();
+}
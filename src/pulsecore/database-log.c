@@ -0,0 +1,858 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdio.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include <pulse/xmalloc.h>
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/hashmap.h>
+#include <pulsecore/thread.h>
+
+#include "database.h"
+
+/* The database file is a header followed by a log of records. Each record
+ * sets or removes one key, or clears the whole database, and the state of
+ * the database is what replaying the log from the start yields. Syncing
+ * only appends the records of the changes since the last sync. Once the
+ * log has grown to more than twice the size the live entries would take,
+ * it is rewritten with just those entries by a background thread.
+ *
+ * Record layout, all integers little endian:
+ *
+ *   uint8_t  op
+ *   uint8_t  padding[3]
+ *   uint32_t key_len
+ *   uint32_t data_len
+ *   uint32_t checksum     FNV-1a over the first 12 bytes, key and data
+ *   uint8_t  key[key_len]
+ *   uint8_t  data[data_len]
+ *
+ * A record that is cut short or fails the checksum ends the log; this is
+ * what is left when we crashed while appending. */
+
+#define LOG_MAGIC "PALOGDB1"
+#define LOG_MAGIC_SIZE 8
+#define RECORD_HEADER_SIZE 16
+
+/* Don't bother compacting logs smaller than this */
+#define COMPACT_MIN_BYTES (64*1024)
+
+enum {
+    OP_SET = 1,
+    OP_UNSET = 2,
+    OP_CLEAR = 3
+};
+
+typedef struct buffer {
+    uint8_t *data;
+    size_t size;
+    size_t allocated;
+} buffer;
+
+typedef struct compaction {
+    pa_thread *thread;
+    const char *filename;
+    const char *tmp_filename;
+    buffer buf;
+    int ret;
+    pa_atomic_t done;
+} compaction;
+
+typedef struct log_data {
+    char *filename;
+    char *tmp_filename;
+    pa_hashmap *map;
+    bool read_only;
+
+    /* The file contents as read at open time, entries loaded from it
+     * point into this */
+    uint8_t *contents;
+    size_t contents_size;
+    bool mapped;
+
+    /* Opened for appending on the first sync */
+    int fd;
+
+    /* Valid bytes in the file, and bytes the live entries would take in a
+     * compacted file */
+    size_t file_bytes;
+    size_t live_bytes;
+
+    /* Records not yet written to the file */
+    buffer pending;
+
+    compaction *compaction;
+
+    /* Set by the writer thread when appending a snapshot failed */
+    pa_atomic_t write_failed;
+} log_data;
+
+struct pa_database_snapshot {
+    int fd;
+    buffer buf;
+    size_t offset;
+    pa_atomic_t *write_failed;
+};
+
+typedef struct entry {
+    pa_datum key;
+    pa_datum data;
+    /* Key and data point into the file contents */
+    bool borrowed;
+} entry;
+
+void pa_datum_free(pa_datum *d) {
+    pa_assert(d);
+
+    pa_xfree(d->data);
+    d->data = NULL;
+    d->size = 0;
+}
+
+static int compare_func(const void *a, const void *b) {
+    const pa_datum *aa, *bb;
+
+    aa = (const pa_datum*)a;
+    bb = (const pa_datum*)b;
+
+    if (aa->size != bb->size)
+        return aa->size > bb->size ? 1 : -1;
+
+    return memcmp(aa->data, bb->data, aa->size);
+}
+
+/* pa_idxset_string_hash_func modified for our use */
+static unsigned hash_func(const void *p) {
+    const pa_datum *d;
+    unsigned hash = 0;
+    const char *c;
+    unsigned i;
+
+    d = (const pa_datum*)p;
+    c = d->data;
+
+    for (i = 0; i < d->size; i++) {
+        hash = 31 * hash + (unsigned) *c;
+        c++;
+    }
+
+    return hash;
+}
+
+static void free_entry(entry *e) {
+    if (!e)
+        return;
+
+    if (!e->borrowed) {
+        pa_xfree(e->key.data);
+        pa_xfree(e->data.data);
+    }
+
+    pa_xfree(e);
+}
+
+static size_t record_size(size_t key_len, size_t data_len) {
+    return RECORD_HEADER_SIZE + key_len + data_len;
+}
+
+static uint32_t checksum(uint32_t hash, const uint8_t *p, size_t size) {
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static void write_u32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint8_t *buffer_reserve(buffer *b, size_t size) {
+    uint8_t *p;
+
+    if (b->size + size > b->allocated) {
+        b->allocated = PA_MAX(b->allocated * 2, b->size + size);
+        b->data = pa_xrealloc(b->data, b->allocated);
+    }
+
+    p = b->data + b->size;
+    b->size += size;
+    return p;
+}
+
+static void buffer_done(buffer *b) {
+    pa_xfree(b->data);
+    pa_zero(*b);
+}
+
+static void buffer_append_record(buffer *b, uint8_t op, const pa_datum *key, const pa_datum *data) {
+    size_t key_len = key ? key->size : 0;
+    size_t data_len = data ? data->size : 0;
+    uint8_t *p;
+    uint32_t hash;
+
+    p = buffer_reserve(b, record_size(key_len, data_len));
+
+    p[0] = op;
+    p[1] = p[2] = p[3] = 0;
+    write_u32(p + 4, (uint32_t) key_len);
+    write_u32(p + 8, (uint32_t) data_len);
+
+    if (key_len > 0)
+        memcpy(p + RECORD_HEADER_SIZE, key->data, key_len);
+    if (data_len > 0)
+        memcpy(p + RECORD_HEADER_SIZE + key_len, data->data, data_len);
+
+    hash = checksum(2166136261U, p, 12);
+    hash = checksum(hash, p + RECORD_HEADER_SIZE, key_len + data_len);
+    write_u32(p + 12, hash);
+}
+
+static void add_entry(log_data *db, entry *e) {
+    entry *old;
+
+    if ((old = pa_hashmap_remove(db->map, &e->key))) {
+        db->live_bytes -= record_size(old->key.size, old->data.size);
+        free_entry(old);
+    }
+
+    pa_hashmap_put(db->map, &e->key, e);
+    db->live_bytes += record_size(e->key.size, e->data.size);
+}
+
+static int remove_entry(log_data *db, const pa_datum *key) {
+    entry *e;
+
+    if (!(e = pa_hashmap_remove(db->map, key)))
+        return -1;
+
+    db->live_bytes -= record_size(e->key.size, e->data.size);
+    free_entry(e);
+    return 0;
+}
+
+static void remove_all_entries(log_data *db) {
+    pa_hashmap_remove_all(db->map);
+    db->live_bytes = LOG_MAGIC_SIZE;
+}
+
+/* Replays the records in the file contents and returns how many bytes of it
+ * are valid */
+static size_t replay(log_data *db) {
+    const uint8_t *p = db->contents;
+    size_t left = db->contents_size;
+
+    if (left < LOG_MAGIC_SIZE || memcmp(p, LOG_MAGIC, LOG_MAGIC_SIZE) != 0) {
+        pa_log_warn("Database file '%s' has no valid header, ignoring its contents.", db->filename);
+        return 0;
+    }
+
+    p += LOG_MAGIC_SIZE;
+    left -= LOG_MAGIC_SIZE;
+
+    while (left > 0) {
+        uint32_t key_len, data_len, hash;
+        entry *e;
+
+        if (left < RECORD_HEADER_SIZE)
+            break;
+
+        key_len = read_u32(p + 4);
+        data_len = read_u32(p + 8);
+
+        if (key_len > left - RECORD_HEADER_SIZE || data_len > left - RECORD_HEADER_SIZE - key_len)
+            break;
+
+        hash = checksum(2166136261U, p, 12);
+        hash = checksum(hash, p + RECORD_HEADER_SIZE, key_len + data_len);
+        if (hash != read_u32(p + 12))
+            break;
+
+        switch (p[0]) {
+            case OP_SET:
+                e = pa_xnew0(entry, 1);
+                e->key.data = key_len > 0 ? (void*) (p + RECORD_HEADER_SIZE) : NULL;
+                e->key.size = key_len;
+                e->data.data = data_len > 0 ? (void*) (p + RECORD_HEADER_SIZE + key_len) : NULL;
+                e->data.size = data_len;
+                e->borrowed = true;
+                add_entry(db, e);
+                break;
+
+            case OP_UNSET: {
+                pa_datum key;
+
+                key.data = (void*) (p + RECORD_HEADER_SIZE);
+                key.size = key_len;
+                remove_entry(db, &key);
+                break;
+            }
+
+            case OP_CLEAR:
+                remove_all_entries(db);
+                break;
+
+            default:
+                goto finish;
+        }
+
+        p += record_size(key_len, data_len);
+        left -= record_size(key_len, data_len);
+    }
+
+finish:
+    if (left > 0)
+        pa_log_warn("Database file '%s' has %zu bytes of broken records at its end, ignoring them.", db->filename, left);
+
+    return db->contents_size - left;
+}
+
+static int load(log_data *db, int fd) {
+    struct stat st;
+
+    if (fstat(fd, &st) < 0)
+        return -1;
+
+    if (st.st_size <= 0)
+        return 0;
+
+    db->contents_size = (size_t) st.st_size;
+
+#ifdef HAVE_SYS_MMAN_H
+    if ((db->contents = mmap(NULL, db->contents_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED)
+        db->mapped = true;
+    else
+        db->contents = NULL;
+#endif
+
+    if (!db->contents) {
+        ssize_t r;
+
+        db->contents = pa_xmalloc(db->contents_size);
+
+        if ((r = pa_loop_read(fd, db->contents, db->contents_size, NULL)) < 0)
+            return -1;
+
+        db->contents_size = (size_t) r;
+    }
+
+    db->file_bytes = replay(db);
+    return 0;
+}
+
+static void free_contents(log_data *db) {
+    if (!db->contents)
+        return;
+
+#ifdef HAVE_SYS_MMAN_H
+    if (db->mapped)
+        munmap(db->contents, db->contents_size);
+    else
+#endif
+        pa_xfree(db->contents);
+
+    db->contents = NULL;
+}
+
+const char* pa_database_get_filename_suffix(void) {
+    return ".logdb";
+}
+
+pa_database* pa_database_open_internal(const char *path, bool for_write) {
+    log_data *db;
+    int fd;
+
+    pa_assert(path);
+
+    errno = 0;
+
+    if ((fd = pa_open_cloexec(path, O_RDONLY, 0)) < 0 && errno != ENOENT) /* file not found is ok */
+        return NULL;
+
+    db = pa_xnew0(log_data, 1);
+    db->map = pa_hashmap_new_full(hash_func, compare_func, NULL, (pa_free_cb_t) free_entry);
+    db->filename = pa_xstrdup(path);
+    db->tmp_filename = pa_sprintf_malloc("%s.tmp", db->filename);
+    db->read_only = !for_write;
+    db->live_bytes = LOG_MAGIC_SIZE;
+    db->fd = -1;
+
+    if (fd >= 0) {
+        int r = load(db, fd);
+
+        pa_close(fd);
+
+        if (r < 0) {
+            int saved_errno = errno;
+
+            pa_hashmap_free(db->map);
+            free_contents(db);
+            pa_xfree(db->filename);
+            pa_xfree(db->tmp_filename);
+            pa_xfree(db);
+
+            errno = saved_errno ? saved_errno : EIO;
+            return NULL;
+        }
+    }
+
+    return (pa_database*) db;
+}
+
+static void compaction_thread_func(void *userdata) {
+    compaction *c = userdata;
+    int fd;
+
+    c->ret = -1;
+
+    if ((fd = pa_open_cloexec(c->tmp_filename, O_WRONLY|O_CREAT|O_TRUNC, 0600)) < 0) {
+        pa_log_warn("Failed to create compacted database file '%s': %s", c->tmp_filename, pa_cstrerror(errno));
+        goto finish;
+    }
+
+    if (pa_loop_write(fd, c->buf.data, c->buf.size, NULL) != (ssize_t) c->buf.size || fsync(fd) < 0) {
+        pa_log_warn("Failed to write compacted database file '%s': %s", c->tmp_filename, pa_cstrerror(errno));
+        pa_close(fd);
+        unlink(c->tmp_filename);
+        goto finish;
+    }
+
+    pa_close(fd);
+
+    if (rename(c->tmp_filename, c->filename) < 0) {
+        pa_log_warn("Failed to rename compacted database file: %s", pa_cstrerror(errno));
+        unlink(c->tmp_filename);
+        goto finish;
+    }
+
+    c->ret = 0;
+
+finish:
+    pa_atomic_store(&c->done, 1);
+}
+
+/* Snapshots the live entries and has them written to a new file in the
+ * background. Changes made meanwhile stay pending until it's done. */
+static bool start_compaction(log_data *db) {
+    compaction *c;
+    void *state;
+    entry *e;
+
+    pa_assert(!db->compaction);
+    pa_assert(db->pending.size == 0);
+
+    c = pa_xnew0(compaction, 1);
+    c->filename = db->filename;
+    c->tmp_filename = db->tmp_filename;
+    pa_atomic_store(&c->done, 0);
+
+    memcpy(buffer_reserve(&c->buf, LOG_MAGIC_SIZE), LOG_MAGIC, LOG_MAGIC_SIZE);
+    PA_HASHMAP_FOREACH(e, db->map, state)
+        buffer_append_record(&c->buf, OP_SET, &e->key, &e->data);
+
+    pa_log_debug("Compacting database file '%s' from %zu to %zu bytes.", db->filename, db->file_bytes, c->buf.size);
+
+    if (!(c->thread = pa_thread_new("db-compact", compaction_thread_func, c))) {
+        pa_log_warn("Failed to start database compaction thread.");
+        buffer_done(&c->buf);
+        pa_xfree(c);
+        return false;
+    }
+
+    db->compaction = c;
+    return true;
+}
+
+static void finish_compaction(log_data *db) {
+    compaction *c = db->compaction;
+
+    pa_assert(c);
+
+    pa_thread_free(c->thread);
+
+    if (c->ret >= 0) {
+        /* The append fd still refers to the old file */
+        if (db->fd >= 0) {
+            pa_close(db->fd);
+            db->fd = -1;
+        }
+
+        db->file_bytes = c->buf.size;
+    }
+
+    buffer_done(&c->buf);
+    pa_xfree(c);
+    db->compaction = NULL;
+}
+
+static int open_for_append(log_data *db) {
+    struct stat st;
+
+    if (db->fd >= 0)
+        return 0;
+
+    if ((db->fd = pa_open_cloexec(db->filename, O_WRONLY|O_CREAT|O_APPEND, 0600)) < 0) {
+        pa_log_warn("Failed to open database file '%s': %s", db->filename, pa_cstrerror(errno));
+        return -1;
+    }
+
+    /* Cut off whatever we didn't accept while loading, later records
+     * wouldn't be found after it */
+    if (fstat(db->fd, &st) < 0 || ((size_t) st.st_size != db->file_bytes && ftruncate(db->fd, (off_t) db->file_bytes) < 0)) {
+        pa_log_warn("Failed to truncate database file '%s': %s", db->filename, pa_cstrerror(errno));
+        goto fail;
+    }
+
+    if (db->file_bytes == 0) {
+        if (pa_loop_write(db->fd, LOG_MAGIC, LOG_MAGIC_SIZE, NULL) != LOG_MAGIC_SIZE) {
+            pa_log_warn("Failed to write database file '%s': %s", db->filename, pa_cstrerror(errno));
+            goto fail;
+        }
+
+        db->file_bytes = LOG_MAGIC_SIZE;
+    }
+
+    return 0;
+
+fail:
+    pa_close(db->fd);
+    db->fd = -1;
+    return -1;
+}
+
+void pa_database_close_internal(pa_database *database) {
+    log_data *db = (log_data*)database;
+    pa_assert(db);
+
+    if (db->compaction)
+        finish_compaction(db);
+
+    pa_database_sync_internal(database);
+
+    /* A compaction may have been started by the sync above */
+    if (db->compaction)
+        finish_compaction(db);
+
+    if (db->fd >= 0)
+        pa_close(db->fd);
+
+    pa_hashmap_free(db->map);
+    free_contents(db);
+    buffer_done(&db->pending);
+    pa_xfree(db->filename);
+    pa_xfree(db->tmp_filename);
+    pa_xfree(db);
+}
+
+pa_datum* pa_database_get(pa_database *database, const pa_datum *key, pa_datum* data) {
+    log_data *db = (log_data*)database;
+    entry *e;
+
+    pa_assert(db);
+    pa_assert(key);
+    pa_assert(data);
+
+    e = pa_hashmap_get(db->map, key);
+
+    if (!e)
+        return NULL;
+
+    data->data = e->data.size > 0 ? pa_xmemdup(e->data.data, e->data.size) : NULL;
+    data->size = e->data.size;
+
+    return data;
+}
+
+int pa_database_set(pa_database *database, const pa_datum *key, const pa_datum* data, bool overwrite) {
+    log_data *db = (log_data*)database;
+    entry *e;
+
+    pa_assert(db);
+    pa_assert(key);
+    pa_assert(data);
+
+    if (db->read_only)
+        return -1;
+
+    if (!overwrite && pa_hashmap_get(db->map, key))
+        return -1;
+
+    e = pa_xnew0(entry, 1);
+    e->key.data = key->size > 0 ? pa_xmemdup(key->data, key->size) : NULL;
+    e->key.size = key->size;
+    e->data.data = data->size > 0 ? pa_xmemdup(data->data, data->size) : NULL;
+    e->data.size = data->size;
+    add_entry(db, e);
+
+    buffer_append_record(&db->pending, OP_SET, key, data);
+
+    return 0;
+}
+
+int pa_database_unset(pa_database *database, const pa_datum *key) {
+    log_data *db = (log_data*)database;
+
+    pa_assert(db);
+    pa_assert(key);
+
+    if (remove_entry(db, key) < 0)
+        return -1;
+
+    if (!db->read_only)
+        buffer_append_record(&db->pending, OP_UNSET, key, NULL);
+
+    return 0;
+}
+
+int pa_database_clear(pa_database *database) {
+    log_data *db = (log_data*)database;
+
+    pa_assert(db);
+
+    remove_all_entries(db);
+
+    if (!db->read_only)
+        buffer_append_record(&db->pending, OP_CLEAR, NULL, NULL);
+
+    return 0;
+}
+
+signed pa_database_size(pa_database *database) {
+    log_data *db = (log_data*)database;
+    pa_assert(db);
+
+    return (signed) pa_hashmap_size(db->map);
+}
+
+pa_datum* pa_database_first(pa_database *database, pa_datum *key, pa_datum *data) {
+    log_data *db = (log_data*)database;
+    entry *e;
+
+    pa_assert(db);
+    pa_assert(key);
+
+    e = pa_hashmap_first(db->map);
+
+    if (!e)
+        return NULL;
+
+    key->data = e->key.size > 0 ? pa_xmemdup(e->key.data, e->key.size) : NULL;
+    key->size = e->key.size;
+
+    if (data) {
+        data->data = e->data.size > 0 ? pa_xmemdup(e->data.data, e->data.size) : NULL;
+        data->size = e->data.size;
+    }
+
+    return key;
+}
+
+pa_datum* pa_database_next(pa_database *database, const pa_datum *key, pa_datum *next, pa_datum *data) {
+    log_data *db = (log_data*)database;
+    entry *e;
+    entry *search;
+    void *state;
+    bool pick_now;
+
+    pa_assert(db);
+    pa_assert(next);
+
+    if (!key)
+        return pa_database_first(database, next, data);
+
+    search = pa_hashmap_get(db->map, key);
+
+    state = NULL;
+    pick_now = false;
+
+    while ((e = pa_hashmap_iterate(db->map, &state, NULL))) {
+        if (pick_now)
+            break;
+
+        if (search == e)
+            pick_now = true;
+    }
+
+    if (!pick_now || !e)
+        return NULL;
+
+    next->data = e->key.size > 0 ? pa_xmemdup(e->key.data, e->key.size) : NULL;
+    next->size = e->key.size;
+
+    if (data) {
+        data->data = e->data.size > 0 ? pa_xmemdup(e->data.data, e->data.size) : NULL;
+        data->size = e->data.size;
+    }
+
+    return next;
+}
+
+/* Returns whether there are pending records that can be appended now */
+static bool prepare_append(log_data *db) {
+    if (db->compaction) {
+        if (!pa_atomic_load(&db->compaction->done))
+            return false;
+
+        finish_compaction(db);
+    }
+
+    if (pa_atomic_load(&db->write_failed)) {
+        /* The file misses the records of the failed snapshot, rewrite it
+         * from what we have */
+        pa_atomic_store(&db->write_failed, 0);
+        db->pending.size = 0;
+
+        if (!start_compaction(db))
+            pa_atomic_store(&db->write_failed, 1);
+
+        return false;
+    }
+
+    return db->pending.size > 0;
+}
+
+static void maybe_start_compaction(log_data *db) {
+    if (db->file_bytes > COMPACT_MIN_BYTES && db->file_bytes > 2 * db->live_bytes)
+        start_compaction(db);
+}
+
+int pa_database_sync_internal(pa_database *database) {
+    log_data *db = (log_data*)database;
+    ssize_t r;
+
+    pa_assert(db);
+
+    if (db->read_only)
+        return 0;
+
+    if (!prepare_append(db))
+        return 0;
+
+    if (open_for_append(db) < 0)
+        return -1;
+
+    if ((r = pa_loop_write(db->fd, db->pending.data, db->pending.size, NULL)) != (ssize_t) db->pending.size) {
+        pa_log_warn("Failed to write database file '%s': %s", db->filename, r < 0 ? pa_cstrerror(errno) : "short write");
+
+        /* Don't leave half a record behind, it would hide everything
+         * appended after it */
+        if (ftruncate(db->fd, (off_t) db->file_bytes) < 0) {
+            pa_close(db->fd);
+            db->fd = -1;
+        }
+
+        return -1;
+    }
+
+    db->file_bytes += db->pending.size;
+    db->pending.size = 0;
+
+    maybe_start_compaction(db);
+
+    return 0;
+}
+
+/* Takes over the pending records, to be appended by the writer thread */
+pa_database_snapshot* pa_database_snapshot_internal(pa_database *database) {
+    log_data *db = (log_data*)database;
+    pa_database_snapshot *s;
+    int fd;
+
+    pa_assert(db);
+
+    if (db->read_only)
+        return NULL;
+
+    if (!prepare_append(db))
+        return NULL;
+
+    if (open_for_append(db) < 0)
+        return NULL;
+
+    /* The writer may still use the file after a compaction replaced it
+     * and we closed ours */
+    if ((fd = dup(db->fd)) < 0) {
+        pa_log_warn("Failed to duplicate database file descriptor: %s", pa_cstrerror(errno));
+        return NULL;
+    }
+
+    pa_make_fd_cloexec(fd);
+
+    s = pa_xnew0(pa_database_snapshot, 1);
+    s->fd = fd;
+    s->buf = db->pending;
+    s->offset = db->file_bytes;
+    s->write_failed = &db->write_failed;
+    pa_zero(db->pending);
+
+    db->file_bytes += s->buf.size;
+
+    maybe_start_compaction(db);
+
+    return s;
+}
+
+int pa_database_snapshot_write_internal(pa_database_snapshot *s) {
+    ssize_t r;
+
+    pa_assert(s);
+
+    if ((r = pa_loop_write(s->fd, s->buf.data, s->buf.size, NULL)) == (ssize_t) s->buf.size)
+        return 0;
+
+    pa_log_warn("Failed to write database file: %s", r < 0 ? pa_cstrerror(errno) : "short write");
+
+    if (ftruncate(s->fd, (off_t) s->offset) < 0)
+        pa_log_warn("Failed to truncate database file: %s", pa_cstrerror(errno));
+
+    pa_atomic_store(s->write_failed, 1);
+    return -1;
+}
+
+void pa_database_snapshot_free_internal(pa_database_snapshot *s) {
+    pa_assert(s);
+
+    pa_close(s->fd);
+    buffer_done(&s->buf);
+    pa_xfree(s);
+}
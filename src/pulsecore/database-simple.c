@@ -28,6 +28,7 @@
 #include <stdio.h>
 
 #include <pulse/xmalloc.h>
+#include <pulsecore/atomic.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/log.h>
 #include <pulsecore/core-error.h>
@@ -40,6 +41,11 @@ typedef struct simple_data {
     char *tmp_filename;
     pa_hashmap *map;
     bool read_only;
+    /* Changed since the last snapshot or sync */
+    bool dirty;
+    /* Whether the last snapshot written failed, it may be set from the
+     * writer thread */
+    pa_atomic_t write_failed;
 } simple_data;
 
 typedef struct entry {
@@ -47,6 +53,14 @@ typedef struct entry {
     pa_datum data;
 } entry;
 
+struct pa_database_snapshot {
+    char *filename;
+    char *tmp_filename;
+    uint8_t *data;
+    size_t size;
+    pa_atomic_t *write_failed;
+};
+
 void pa_datum_free(pa_datum *d) {
     pa_assert(d);
 
@@ -240,7 +254,7 @@ pa_database* pa_database_open_internal(const char *path, bool for_write) {
         db = pa_xnew0(simple_data, 1);
         db->map = pa_hashmap_new_full(hash_func, compare_func, NULL, (pa_free_cb_t) free_entry);
         db->filename = pa_xstrdup(path);
-        db->tmp_filename = pa_sprintf_malloc(".%s.tmp", db->filename);
+        db->tmp_filename = pa_sprintf_malloc("%s.tmp", db->filename);
         db->read_only = !for_write;
 
         if (f) {
@@ -256,11 +270,11 @@ pa_database* pa_database_open_internal(const char *path, bool for_write) {
     return (pa_database*) db;
 }
 
-void pa_database_close(pa_database *database) {
+void pa_database_close_internal(pa_database *database) {
     simple_data *db = (simple_data*)database;
     pa_assert(db);
 
-    pa_database_sync(database);
+    pa_database_sync_internal(database);
     pa_xfree(db->filename);
     pa_xfree(db->tmp_filename);
     pa_hashmap_free(db->map);
@@ -299,6 +313,7 @@ int pa_database_set(pa_database *database, const pa_datum *key, const pa_datum*
         return -1;
 
     e = new_entry(key, data);
+    db->dirty = true;
 
     if (pa_hashmap_put(db->map, &e->key, e) < 0) {
         /* entry with same key exists in hashmap */
@@ -324,7 +339,11 @@ int pa_database_unset(pa_database *database, const pa_datum *key) {
     pa_assert(db);
     pa_assert(key);
 
-    return pa_hashmap_remove_and_free(db->map, key);
+    if (pa_hashmap_remove_and_free(db->map, key) < 0)
+        return -1;
+
+    db->dirty = true;
+    return 0;
 }
 
 int pa_database_clear(pa_database *database) {
@@ -333,6 +352,7 @@ int pa_database_clear(pa_database *database) {
     pa_assert(db);
 
     pa_hashmap_remove_all(db->map);
+    db->dirty = true;
 
     return 0;
 }
@@ -407,89 +427,136 @@ pa_datum* pa_database_next(pa_database *database, const pa_datum *key, pa_datum
     return next;
 }
 
-static int write_uint(FILE *f, const uint32_t num) {
-    size_t items;
-    uint8_t values[4];
+static void write_uint(uint8_t **p, const uint32_t num) {
     int i;
-    errno = 0;
 
     for (i = 0; i < 4; i++)
-        values[i] = (num >> (i*8)) & 0xFF;
-
-    items = fwrite(&values, sizeof(values), sizeof(uint8_t), f);
+        (*p)[i] = (num >> (i*8)) & 0xFF;
 
-    if (ferror(f))
-        return -1;
-
-    return items;
+    *p += 4;
 }
 
-static int write_data(FILE *f, void *data, const size_t length) {
-    size_t items;
-    uint32_t len;
+static void write_data(uint8_t **p, const void *data, const size_t length) {
+    write_uint(p, length);
+    memcpy(*p, data, length);
+    *p += length;
+}
 
-    len = length;
-    if ((items = write_uint(f, len)) <= 0)
-        return -1;
+/* Serializes all entries, the file is rewritten as a whole every time */
+static pa_database_snapshot* take_snapshot(simple_data *db) {
+    pa_database_snapshot *s;
+    void *state;
+    entry *e;
+    size_t size = 0;
+    uint8_t *p;
+
+    PA_HASHMAP_FOREACH(e, db->map, state)
+        size += 8 + e->key.size + e->data.size;
+
+    s = pa_xnew0(pa_database_snapshot, 1);
+    s->filename = pa_xstrdup(db->filename);
+    s->tmp_filename = pa_xstrdup(db->tmp_filename);
+    s->write_failed = &db->write_failed;
+    s->data = p = pa_xmalloc(PA_MAX(size, 1U));
+
+    PA_HASHMAP_FOREACH(e, db->map, state) {
+        /* Reading stops at empty fields */
+        if (e->key.size == 0 || e->data.size == 0) {
+            pa_log_warn("Not writing database entry with empty key or data.");
+            continue;
+        }
 
-    items = fwrite(data, length, 1, f);
+        write_data(&p, e->key.data, e->key.size);
+        write_data(&p, e->data.data, e->data.size);
+    }
 
-    if (ferror(f) || items != 1)
-        return -1;
+    s->size = p - s->data;
+    db->dirty = false;
 
-    return 0;
+    return s;
 }
 
-static int write_entry(FILE *f, const entry *e) {
-    pa_assert(f);
-    pa_assert(e);
+int pa_database_sync_internal(pa_database *database) {
+    simple_data *db = (simple_data*)database;
+    pa_database_snapshot *s;
+    int r;
 
-    if (write_data(f, e->key.data, e->key.size) < 0)
-        return -1;
-    if (write_data(f, e->data.data, e->data.size) < 0)
-        return -1;
+    pa_assert(db);
 
-    return 0;
+    if (db->read_only)
+        return 0;
+
+    s = take_snapshot(db);
+    if ((r = pa_database_snapshot_write_internal(s)) < 0)
+        db->dirty = true;
+    pa_database_snapshot_free_internal(s);
+
+    return r;
 }
 
-int pa_database_sync(pa_database *database) {
+pa_database_snapshot* pa_database_snapshot_internal(pa_database *database) {
     simple_data *db = (simple_data*)database;
-    FILE *f;
-    void *state;
-    entry *e;
 
     pa_assert(db);
 
-    if (db->read_only)
-        return 0;
+    /* Write the changes of a failed snapshot again */
+    if (pa_atomic_cmpxchg(&db->write_failed, 1, 0))
+        db->dirty = true;
+
+    if (db->read_only || !db->dirty)
+        return NULL;
+
+    return take_snapshot(db);
+}
+
+int pa_database_snapshot_write_internal(pa_database_snapshot *s) {
+    FILE *f;
+
+    pa_assert(s);
 
     errno = 0;
 
-    f = pa_fopen_cloexec(db->tmp_filename, "w");
+    f = pa_fopen_cloexec(s->tmp_filename, "w");
 
     if (!f)
         goto fail;
 
-    state = NULL;
-    while((e = pa_hashmap_iterate(db->map, &state, NULL))) {
-        if (write_entry(f, e) < 0) {
-            pa_log_warn("error while writing to file. %s", pa_cstrerror(errno));
-            goto fail;
-        }
+    if (s->size > 0 && fwrite(s->data, s->size, 1, f) != 1) {
+        pa_log_warn("error while writing to file. %s", pa_cstrerror(errno));
+        goto fail;
+    }
+
+    if (fclose(f) != 0) {
+        f = NULL;
+        pa_log_warn("error while writing to file. %s", pa_cstrerror(errno));
+        goto fail;
     }
 
-    fclose(f);
     f = NULL;
 
-    if (rename(db->tmp_filename, db->filename) < 0) {
+    if (rename(s->tmp_filename, s->filename) < 0) {
         pa_log_warn("error while renaming file. %s", pa_cstrerror(errno));
         goto fail;
     }
 
+    /* The snapshots are written in order, this one has all changes of
+     * the failed ones before it */
+    pa_atomic_store(s->write_failed, 0);
+
     return 0;
 
 fail:
     if (f)
         fclose(f);
+    pa_atomic_store(s->write_failed, 1);
     return -1;
 }
+
+void pa_database_snapshot_free_internal(pa_database_snapshot *s) {
+    pa_assert(s);
+
+    pa_xfree(s->data);
+    pa_xfree(s->filename);
+    pa_xfree(s->tmp_filename);
+    pa_xfree(s);
+}
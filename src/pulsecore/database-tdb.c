@@ -118,7 +118,7 @@ pa_database* pa_database_open_internal(const char *path, bool for_write) {
     return (pa_database*) c;
 }
 
-void pa_database_close(pa_database *db) {
+void pa_database_close_internal(pa_database *db) {
     pa_assert(db);
 
     tdb_close(MAKE_TDB_CONTEXT(db));
@@ -243,8 +243,23 @@ pa_datum* pa_database_next(pa_database *db, const pa_datum *key, pa_datum *next,
     return next;
 }
 
-int pa_database_sync(pa_database *db) {
+int pa_database_sync_internal(pa_database *db) {
     pa_assert(db);
 
     return 0;
 }
+
+/* Changes are written to the file right away, there's nothing to sync */
+pa_database_snapshot* pa_database_snapshot_internal(pa_database *db) {
+    pa_assert(db);
+
+    return NULL;
+}
+
+int pa_database_snapshot_write_internal(pa_database_snapshot *s) {
+    pa_assert_not_reached();
+}
+
+void pa_database_snapshot_free_internal(pa_database_snapshot *s) {
+    pa_assert_not_reached();
+}
@@ -24,13 +24,129 @@
 #include <errno.h>
 #include <dirent.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 #include <pulsecore/core-util.h>
 #include <pulsecore/log.h>
+#include <pulsecore/mutex.h>
+#include <pulsecore/queue.h>
+#include <pulsecore/thread.h>
 
 #include "database.h"
 #include "core-error.h"
 
+/* The writer thread is started by the first pa_database_sync_async() and
+ * stopped when the last database is closed. Everything below is protected
+ * by the mutex. */
+static pa_static_mutex mutex = PA_STATIC_MUTEX_INIT;
+static pa_thread *writer = NULL;
+static pa_cond *writer_cond = NULL;
+static pa_queue *writer_queue = NULL;
+static bool writer_quit = false;
+static bool writer_busy = false;
+static unsigned n_databases = 0;
+static pa_database_stats stats;
+
+static pa_mutex *get_mutex(void) {
+    return pa_static_mutex_get(&mutex, false, false);
+}
+
+static int write_snapshot(pa_database_snapshot *s) {
+    int r;
+
+    r = pa_database_snapshot_write_internal(s);
+    pa_database_snapshot_free_internal(s);
+
+    return r;
+}
+
+static void writer_thread_func(void *userdata) {
+    pa_mutex *m = get_mutex();
+
+    pa_mutex_lock(m);
+
+    for (;;) {
+        pa_database_snapshot *s;
+        pa_usec_t start;
+        int r;
+
+        if (!(s = pa_queue_pop(writer_queue))) {
+            if (writer_quit)
+                break;
+
+            pa_cond_wait(writer_cond, m);
+            continue;
+        }
+
+        writer_busy = true;
+        pa_mutex_unlock(m);
+
+        start = pa_rtclock_now();
+        r = write_snapshot(s);
+
+        pa_mutex_lock(m);
+        writer_busy = false;
+        stats.n_queued--;
+        stats.writer_usec += pa_rtclock_now() - start;
+        if (r < 0)
+            stats.n_snapshots_failed++;
+        else
+            stats.n_snapshots_written++;
+
+        /* Wake up whoever waits for the queue to drain */
+        pa_cond_signal(writer_cond, 1);
+    }
+
+    pa_mutex_unlock(m);
+}
+
+/* Called with the mutex held */
+static bool start_writer(void) {
+    if (writer)
+        return true;
+
+    writer_cond = pa_cond_new();
+    writer_queue = pa_queue_new();
+    writer_quit = false;
+
+    if (!(writer = pa_thread_new("db-writer", writer_thread_func, NULL))) {
+        pa_log_warn("Failed to start database writer thread, writing synchronously.");
+        pa_queue_free(writer_queue, NULL);
+        writer_queue = NULL;
+        pa_cond_free(writer_cond);
+        writer_cond = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+/* Called with the mutex held, which is released while joining the thread */
+static void stop_writer(pa_mutex *m) {
+    pa_thread *t = writer;
+
+    pa_assert(writer);
+
+    writer_quit = true;
+    pa_cond_signal(writer_cond, 1);
+
+    pa_mutex_unlock(m);
+    pa_thread_free(t);
+    pa_mutex_lock(m);
+
+    writer = NULL;
+    pa_queue_free(writer_queue, NULL);
+    writer_queue = NULL;
+    pa_cond_free(writer_cond);
+    writer_cond = NULL;
+}
+
+/* Called with the mutex held */
+static void wait_for_writer(pa_mutex *m) {
+    while (writer && (writer_busy || !pa_queue_isempty(writer_queue)))
+        pa_cond_wait(writer_cond, m);
+}
+
 pa_database* pa_database_open(const char *path, const char *fn, bool prependmid, bool for_write) {
 
     const char *filename_suffix = pa_database_get_filename_suffix();
@@ -41,6 +157,8 @@ pa_database* pa_database_open(const char *path, const char *fn, bool prependmid,
     struct dirent *de;
 
     pa_database *f;
+    pa_usec_t start = pa_rtclock_now();
+    pa_mutex *m;
 
     pa_assert(filename_suffix && filename_suffix[0]);
 
@@ -97,6 +215,13 @@ pa_database* pa_database_open(const char *path, const char *fn, bool prependmid,
     else
         pa_log("Failed to open '%s' database file '%s': %s", fn, full_path, pa_cstrerror(errno));
 
+    m = get_mutex();
+    pa_mutex_lock(m);
+    if (f)
+        n_databases++;
+    stats.caller_usec += pa_rtclock_now() - start;
+    pa_mutex_unlock(m);
+
     pa_xfree(full_path);
     pa_xfree(filename_prefix);
 
@@ -105,3 +230,92 @@ pa_database* pa_database_open(const char *path, const char *fn, bool prependmid,
 
     return f;
 }
+
+void pa_database_close(pa_database *db) {
+    pa_usec_t start = pa_rtclock_now();
+    pa_mutex *m = get_mutex();
+
+    pa_assert(db);
+
+    pa_mutex_lock(m);
+    wait_for_writer(m);
+    pa_mutex_unlock(m);
+
+    pa_database_close_internal(db);
+
+    pa_mutex_lock(m);
+    if (n_databases > 0)
+        n_databases--;
+    if (n_databases == 0 && writer)
+        stop_writer(m);
+    stats.caller_usec += pa_rtclock_now() - start;
+    pa_mutex_unlock(m);
+}
+
+int pa_database_sync(pa_database *db) {
+    pa_usec_t start = pa_rtclock_now();
+    pa_mutex *m = get_mutex();
+    int r;
+
+    pa_assert(db);
+
+    pa_mutex_lock(m);
+    wait_for_writer(m);
+    pa_mutex_unlock(m);
+
+    r = pa_database_sync_internal(db);
+
+    pa_mutex_lock(m);
+    stats.n_syncs++;
+    stats.caller_usec += pa_rtclock_now() - start;
+    pa_mutex_unlock(m);
+
+    return r;
+}
+
+void pa_database_sync_async(pa_database *db) {
+    pa_usec_t start = pa_rtclock_now();
+    pa_mutex *m = get_mutex();
+    pa_database_snapshot *s;
+    int r = 0;
+
+    pa_assert(db);
+
+    s = pa_database_snapshot_internal(db);
+
+    pa_mutex_lock(m);
+
+    if (s && start_writer()) {
+        pa_queue_push(writer_queue, s);
+        stats.n_queued++;
+        pa_cond_signal(writer_cond, 1);
+        s = NULL;
+    }
+
+    pa_mutex_unlock(m);
+
+    /* No writer thread, do it ourselves */
+    if (s)
+        r = write_snapshot(s);
+
+    pa_mutex_lock(m);
+    if (s) {
+        if (r < 0)
+            stats.n_snapshots_failed++;
+        else
+            stats.n_snapshots_written++;
+    }
+    stats.n_async_syncs++;
+    stats.caller_usec += pa_rtclock_now() - start;
+    pa_mutex_unlock(m);
+}
+
+void pa_database_get_stats(pa_database_stats *s) {
+    pa_mutex *m = get_mutex();
+
+    pa_assert(s);
+
+    pa_mutex_lock(m);
+    *s = stats;
+    pa_mutex_unlock(m);
+}
@@ -22,6 +22,7 @@
 
 #include <sys/types.h>
 
+#include <pulse/sample.h>
 #include <pulsecore/macro.h>
 
 /* A little abstraction over simple databases, such as gdbm, tdb, and
@@ -30,6 +31,7 @@
  * be arch independent. */
 
 typedef struct pa_database pa_database;
+typedef struct pa_database_snapshot pa_database_snapshot;
 
 typedef struct pa_datum {
     void *data;
@@ -61,8 +63,14 @@ pa_database* pa_database_open(const char *path, const char *fn, bool prependmid,
 
 /* Database implementation; opens specified database file using provided path. */
 pa_database* pa_database_open_internal(const char *path, bool for_write);
+
+/* Waits for the pending writes of pa_database_sync_async() and closes the
+ * database, writing out any changes. */
 void pa_database_close(pa_database *db);
 
+/* Database implementation; closes the database, writing out any changes. */
+void pa_database_close_internal(pa_database *db);
+
 pa_datum* pa_database_get(pa_database *db, const pa_datum *key, pa_datum* data);
 
 int pa_database_set(pa_database *db, const pa_datum *key, const pa_datum* data, bool overwrite);
@@ -75,6 +83,41 @@ signed pa_database_size(pa_database *db);
 pa_datum* pa_database_first(pa_database *db, pa_datum *key, pa_datum *data /* may be NULL */);
 pa_datum* pa_database_next(pa_database *db, const pa_datum *key, pa_datum *next, pa_datum *data /* may be NULL */);
 
+/* Waits for the pending writes of pa_database_sync_async() and writes out
+ * the remaining changes. */
 int pa_database_sync(pa_database *db);
 
+/* Takes a snapshot of the changes and has it written out by a writer thread
+ * shared by all databases, so that the caller doesn't block on the I/O. The
+ * writes are done in order, and pa_database_sync() and pa_database_close()
+ * wait for them. */
+void pa_database_sync_async(pa_database *db);
+
+/* Database implementation; writes out the changes. */
+int pa_database_sync_internal(pa_database *db);
+
+/* Database implementation; collects the changes that
+ * pa_database_sync_internal() would write out, or returns NULL if there are
+ * none. Backends that can't write from another thread sync right away and
+ * return NULL. Writing a snapshot must not access the database, it may be
+ * done from any thread. */
+pa_database_snapshot* pa_database_snapshot_internal(pa_database *db);
+int pa_database_snapshot_write_internal(pa_database_snapshot *s);
+void pa_database_snapshot_free_internal(pa_database_snapshot *s);
+
+typedef struct pa_database_stats {
+    /* Time the callers spent opening, syncing and closing databases */
+    pa_usec_t caller_usec;
+    /* Time the writer thread spent writing snapshots */
+    pa_usec_t writer_usec;
+    uint64_t n_syncs;
+    uint64_t n_async_syncs;
+    uint64_t n_snapshots_written;
+    uint64_t n_snapshots_failed;
+    /* Snapshots queued but not written yet */
+    unsigned n_queued;
+} pa_database_stats;
+
+void pa_database_get_stats(pa_database_stats *stats);
+
 #endif
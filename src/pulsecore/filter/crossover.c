@@ -7,10 +7,18 @@
 #include <config.h>
 #endif
 
+#include <string.h>
+
 #include <pulsecore/macro.h>
 
 #include "crossover.h"
 
+#if defined(__GNUC__)
+/* Four float lanes, mapped by the compiler to SSE, NEON or AltiVec registers
+ * where available and to scalar code elsewhere. */
+typedef float v4sf __attribute__((vector_size(LR4_BANK_LANES * sizeof(float))));
+#endif
+
 void lr4_set(struct lr4 *lr4, enum biquad_type type, float freq)
 {
 	biquad_set(&lr4->bq, type, freq);
@@ -95,3 +103,252 @@ void lr4_process_s16(struct lr4 *lr4, int samples, int channels, short *src, sho
 	lr4->z1 = lz1;
 	lr4->z2 = lz2;
 }
+
+void lr4_bank_init(struct lr4_bank *bank, int channels)
+{
+	pa_assert(channels > 0 && channels <= (int) PA_CHANNELS_MAX);
+
+	memset(bank, 0, sizeof(*bank));
+	bank->channels = channels;
+}
+
+void lr4_bank_set(struct lr4_bank *bank, int channel, enum biquad_type type, float freq)
+{
+	struct biquad bq;
+
+	pa_assert(channel >= 0 && channel < bank->channels);
+
+	biquad_set(&bq, type, freq);
+	bank->b0[channel] = bq.b0;
+	bank->b1[channel] = bq.b1;
+	bank->b2[channel] = bq.b2;
+	bank->a1[channel] = bq.a1;
+	bank->a2[channel] = bq.a2;
+	bank->x1[channel] = 0;
+	bank->x2[channel] = 0;
+	bank->y1[channel] = 0;
+	bank->y2[channel] = 0;
+	bank->z1[channel] = 0;
+	bank->z2[channel] = 0;
+}
+
+#if defined(__GNUC__)
+
+static inline v4sf load_v4sf(const float *p)
+{
+	v4sf v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline void store_v4sf(float *p, v4sf v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+
+/* Gather the first n (at most LR4_BANK_LANES) samples at p into a vector,
+ * leaving the remaining lanes zero. */
+static inline v4sf gather_float32(const float *p, int n)
+{
+	switch (n) {
+	case 1:
+		return (v4sf) { p[0], 0, 0, 0 };
+	case 2:
+		return (v4sf) { p[0], p[1], 0, 0 };
+	case 3:
+		return (v4sf) { p[0], p[1], p[2], 0 };
+	default:
+		return load_v4sf(p);
+	}
+}
+
+static inline v4sf gather_s16(const short *p, int n)
+{
+	switch (n) {
+	case 1:
+		return (v4sf) { p[0], 0, 0, 0 };
+	case 2:
+		return (v4sf) { p[0], p[1], 0, 0 };
+	case 3:
+		return (v4sf) { p[0], p[1], p[2], 0 };
+	default:
+		return (v4sf) { p[0], p[1], p[2], p[3] };
+	}
+}
+
+static inline void scatter_float32(float *p, v4sf v, int n)
+{
+	switch (n) {
+	case 3:
+		p[2] = v[2];
+		/* fall through */
+	case 2:
+		p[1] = v[1];
+		/* fall through */
+	case 1:
+		p[0] = v[0];
+		break;
+	default:
+		store_v4sf(p, v);
+	}
+}
+
+/* Run the LR4 filters of channels [c, c + n) over all frames, n being at most
+ * LR4_BANK_LANES. Partial groups at the end of a frame are gathered lane by
+ * lane so that the next frame is never touched. */
+static inline void lr4_bank_group_float32(struct lr4_bank *bank, int c, int n, int samples, float *src, float *dest)
+{
+	const int channels = bank->channels;
+	const v4sf lb0 = load_v4sf(&bank->b0[c]);
+	const v4sf lb1 = load_v4sf(&bank->b1[c]);
+	const v4sf lb2 = load_v4sf(&bank->b2[c]);
+	const v4sf la1 = load_v4sf(&bank->a1[c]);
+	const v4sf la2 = load_v4sf(&bank->a2[c]);
+	v4sf lx1 = load_v4sf(&bank->x1[c]);
+	v4sf lx2 = load_v4sf(&bank->x2[c]);
+	v4sf ly1 = load_v4sf(&bank->y1[c]);
+	v4sf ly2 = load_v4sf(&bank->y2[c]);
+	v4sf lz1 = load_v4sf(&bank->z1[c]);
+	v4sf lz2 = load_v4sf(&bank->z2[c]);
+
+	int i;
+	for (i = 0; i < samples * channels; i += channels) {
+		v4sf x, y, z;
+		x = gather_float32(&src[i], n);
+		y = lb0*x + lb1*lx1 + lb2*lx2 - la1*ly1 - la2*ly2;
+		z = lb0*y + lb1*ly1 + lb2*ly2 - la1*lz1 - la2*lz2;
+		lx2 = lx1;
+		lx1 = x;
+		ly2 = ly1;
+		ly1 = y;
+		lz2 = lz1;
+		lz1 = z;
+		scatter_float32(&dest[i], z, n);
+	}
+
+	store_v4sf(&bank->x1[c], lx1);
+	store_v4sf(&bank->x2[c], lx2);
+	store_v4sf(&bank->y1[c], ly1);
+	store_v4sf(&bank->y2[c], ly2);
+	store_v4sf(&bank->z1[c], lz1);
+	store_v4sf(&bank->z2[c], lz2);
+}
+
+static inline void lr4_bank_group_s16(struct lr4_bank *bank, int c, int n, int samples, short *src, short *dest)
+{
+	const int channels = bank->channels;
+	const v4sf lb0 = load_v4sf(&bank->b0[c]);
+	const v4sf lb1 = load_v4sf(&bank->b1[c]);
+	const v4sf lb2 = load_v4sf(&bank->b2[c]);
+	const v4sf la1 = load_v4sf(&bank->a1[c]);
+	const v4sf la2 = load_v4sf(&bank->a2[c]);
+	v4sf lx1 = load_v4sf(&bank->x1[c]);
+	v4sf lx2 = load_v4sf(&bank->x2[c]);
+	v4sf ly1 = load_v4sf(&bank->y1[c]);
+	v4sf ly2 = load_v4sf(&bank->y2[c]);
+	v4sf lz1 = load_v4sf(&bank->z1[c]);
+	v4sf lz2 = load_v4sf(&bank->z2[c]);
+
+	int i, k;
+	for (i = 0; i < samples * channels; i += channels) {
+		v4sf x, y, z;
+		x = gather_s16(&src[i], n);
+		y = lb0*x + lb1*lx1 + lb2*lx2 - la1*ly1 - la2*ly2;
+		z = lb0*y + lb1*ly1 + lb2*ly2 - la1*lz1 - la2*lz2;
+		lx2 = lx1;
+		lx1 = x;
+		ly2 = ly1;
+		ly1 = y;
+		lz2 = lz1;
+		lz1 = z;
+		for (k = 0; k < n; k++)
+			dest[i + k] = PA_CLAMP_UNLIKELY((int) z[k], -0x8000, 0x7fff);
+	}
+
+	store_v4sf(&bank->x1[c], lx1);
+	store_v4sf(&bank->x2[c], lx2);
+	store_v4sf(&bank->y1[c], ly1);
+	store_v4sf(&bank->y2[c], ly2);
+	store_v4sf(&bank->z1[c], lz1);
+	store_v4sf(&bank->z2[c], lz2);
+}
+
+void lr4_bank_process_float32(struct lr4_bank *bank, int samples, float *src, float *dest)
+{
+	int c;
+
+	for (c = 0; c + LR4_BANK_LANES <= bank->channels; c += LR4_BANK_LANES)
+		lr4_bank_group_float32(bank, c, LR4_BANK_LANES, samples, &src[c], &dest[c]);
+
+	if (c < bank->channels)
+		lr4_bank_group_float32(bank, c, bank->channels - c, samples, &src[c], &dest[c]);
+}
+
+void lr4_bank_process_s16(struct lr4_bank *bank, int samples, short *src, short *dest)
+{
+	int c;
+
+	for (c = 0; c + LR4_BANK_LANES <= bank->channels; c += LR4_BANK_LANES)
+		lr4_bank_group_s16(bank, c, LR4_BANK_LANES, samples, &src[c], &dest[c]);
+
+	if (c < bank->channels)
+		lr4_bank_group_s16(bank, c, bank->channels - c, samples, &src[c], &dest[c]);
+}
+
+#else /* __GNUC__ */
+
+void lr4_bank_process_float32(struct lr4_bank *bank, int samples, float *src, float *dest)
+{
+	struct lr4 lr4;
+	int c;
+
+	for (c = 0; c < bank->channels; c++) {
+		lr4.bq.b0 = bank->b0[c];
+		lr4.bq.b1 = bank->b1[c];
+		lr4.bq.b2 = bank->b2[c];
+		lr4.bq.a1 = bank->a1[c];
+		lr4.bq.a2 = bank->a2[c];
+		lr4.x1 = bank->x1[c];
+		lr4.x2 = bank->x2[c];
+		lr4.y1 = bank->y1[c];
+		lr4.y2 = bank->y2[c];
+		lr4.z1 = bank->z1[c];
+		lr4.z2 = bank->z2[c];
+		lr4_process_float32(&lr4, samples, bank->channels, &src[c], &dest[c]);
+		bank->x1[c] = lr4.x1;
+		bank->x2[c] = lr4.x2;
+		bank->y1[c] = lr4.y1;
+		bank->y2[c] = lr4.y2;
+		bank->z1[c] = lr4.z1;
+		bank->z2[c] = lr4.z2;
+	}
+}
+
+void lr4_bank_process_s16(struct lr4_bank *bank, int samples, short *src, short *dest)
+{
+	struct lr4 lr4;
+	int c;
+
+	for (c = 0; c < bank->channels; c++) {
+		lr4.bq.b0 = bank->b0[c];
+		lr4.bq.b1 = bank->b1[c];
+		lr4.bq.b2 = bank->b2[c];
+		lr4.bq.a1 = bank->a1[c];
+		lr4.bq.a2 = bank->a2[c];
+		lr4.x1 = bank->x1[c];
+		lr4.x2 = bank->x2[c];
+		lr4.y1 = bank->y1[c];
+		lr4.y2 = bank->y2[c];
+		lr4.z1 = bank->z1[c];
+		lr4.z2 = bank->z2[c];
+		lr4_process_s16(&lr4, samples, bank->channels, &src[c], &dest[c]);
+		bank->x1[c] = lr4.x1;
+		bank->x2[c] = lr4.x2;
+		bank->y1[c] = lr4.y1;
+		bank->y2[c] = lr4.y2;
+		bank->z1[c] = lr4.z1;
+		bank->z2[c] = lr4.z2;
+	}
+}
+
+#endif /* __GNUC__ */
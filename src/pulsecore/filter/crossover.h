@@ -6,6 +6,8 @@
 #ifndef CROSSOVER_H_
 #define CROSSOVER_H_
 
+#include <pulse/sample.h>
+
 #include "biquad.h"
 /* An LR4 filter is two biquads with the same parameters connected in series:
  *
@@ -26,4 +28,28 @@ void lr4_set(struct lr4 *lr4, enum biquad_type type, float freq);
 void lr4_process_float32(struct lr4 *lr4, int samples, int channels, float *src, float *dest);
 void lr4_process_s16(struct lr4 *lr4, int samples, int channels, short *src, short *dest);
 
+/* A bank of LR4 filters, one per channel of an interleaved stream. The
+ * coefficients and history values of all channels are kept in separate
+ * arrays indexed by channel, so that adjacent channels of a frame can be
+ * filtered together in SIMD lanes. The arrays are padded to a multiple of the
+ * vector width; unused lanes have zero coefficients and stay silent.
+ */
+#define LR4_BANK_LANES 4
+#define LR4_BANK_SIZE ((PA_CHANNELS_MAX + LR4_BANK_LANES - 1) / LR4_BANK_LANES * LR4_BANK_LANES)
+
+struct lr4_bank {
+	int channels;
+	float b0[LR4_BANK_SIZE], b1[LR4_BANK_SIZE], b2[LR4_BANK_SIZE];
+	float a1[LR4_BANK_SIZE], a2[LR4_BANK_SIZE];
+	float x1[LR4_BANK_SIZE], x2[LR4_BANK_SIZE];
+	float y1[LR4_BANK_SIZE], y2[LR4_BANK_SIZE];
+	float z1[LR4_BANK_SIZE], z2[LR4_BANK_SIZE];
+};
+
+void lr4_bank_init(struct lr4_bank *bank, int channels);
+void lr4_bank_set(struct lr4_bank *bank, int channel, enum biquad_type type, float freq);
+
+void lr4_bank_process_float32(struct lr4_bank *bank, int samples, float *src, float *dest);
+void lr4_bank_process_s16(struct lr4_bank *bank, int samples, short *src, short *dest);
+
 #endif /* CROSSOVER_H_ */
@@ -32,7 +32,7 @@ struct saved_state {
     PA_LLIST_FIELDS(struct saved_state);
     pa_memchunk chunk;
     int64_t index;
-    struct lr4 lr4[PA_CHANNELS_MAX];
+    struct lr4_bank lr4;
 };
 
 PA_STATIC_FLIST_DECLARE(lfe_state, 0, pa_xfree);
@@ -53,7 +53,7 @@ struct pa_lfe_filter {
     pa_sample_spec ss;
     size_t maxrewind;
     bool active;
-    struct lr4 lr4[PA_CHANNELS_MAX];
+    struct lr4_bank lr4;
 };
 
 static void remove_state(pa_lfe_filter_t *f, struct saved_state *s) {
@@ -90,17 +90,13 @@ static void process_block(pa_lfe_filter_t *f, pa_memchunk *buf, bool store_resul
     void *garbage = store_result ? NULL : pa_xmalloc(buf->length);
 
     if (f->ss.format == PA_SAMPLE_FLOAT32NE) {
-        int i;
         float *data = pa_memblock_acquire_chunk(buf);
-        for (i = 0; i < f->cm.channels; i++)
-            lr4_process_float32(&f->lr4[i], samples, f->cm.channels, &data[i], garbage ? garbage : &data[i]);
+        lr4_bank_process_float32(&f->lr4, samples, data, garbage ? garbage : data);
         pa_memblock_release(buf->memblock);
     }
     else if (f->ss.format == PA_SAMPLE_S16NE) {
-        int i;
         short *data = pa_memblock_acquire_chunk(buf);
-        for (i = 0; i < f->cm.channels; i++)
-            lr4_process_s16(&f->lr4[i], samples, f->cm.channels, &data[i], garbage ? garbage : &data[i]);
+        lr4_bank_process_s16(&f->lr4, samples, data, garbage ? garbage : data);
         pa_memblock_release(buf->memblock);
     }
     else pa_assert_not_reached();
@@ -138,7 +134,7 @@ pa_memchunk * pa_lfe_filter_process(pa_lfe_filter_t *f, pa_memchunk *buf) {
     pa_mempool_unref(pool), pool = NULL;
 
     s->index = f->index;
-    memcpy(s->lr4, f->lr4, sizeof(struct lr4) * f->cm.channels);
+    s->lr4 = f->lr4;
     PA_LLIST_PREPEND(struct saved_state, f->saved, s);
 
     process_block(f, buf, true);
@@ -160,8 +156,9 @@ void pa_lfe_filter_update_rate(pa_lfe_filter_t *f, uint32_t new_rate) {
         return;
     }
 
+    lr4_bank_init(&f->lr4, f->cm.channels);
     for (i = 0; i < f->cm.channels; i++)
-        lr4_set(&f->lr4[i], f->cm.map[i] == PA_CHANNEL_POSITION_LFE ? BQ_LOWPASS : BQ_HIGHPASS, biquad_freq);
+        lr4_bank_set(&f->lr4, i, f->cm.map[i] == PA_CHANNEL_POSITION_LFE ? BQ_LOWPASS : BQ_HIGHPASS, biquad_freq);
 
     f->active = true;
 }
@@ -185,7 +182,7 @@ void pa_lfe_filter_rewind(pa_lfe_filter_t *f, size_t amount) {
     }
     pa_log_debug("Rewinding LFE filter %zu samples to position %lli. Found saved state at position %lli",
         samples, (long long) f->index, (long long) s->index);
-    memcpy(f->lr4, s->lr4, sizeof(struct lr4) * f->cm.channels);
+    f->lr4 = s->lr4;
 
     /* now fast forward to the actual position */
     if (f->index > s->index) {
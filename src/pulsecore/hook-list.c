@@ -21,12 +21,17 @@
 #include <config.h>
 #endif
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 
 #include <pulsecore/macro.h>
+#include <pulsecore/startup-trace.h>
 
 #include "hook-list.h"
 
+static bool profiling = false;
+static struct pa_module *connecting_module = NULL;
+
 void pa_hook_init(pa_hook *hook, void *data) {
     pa_assert(hook);
 
@@ -65,6 +70,9 @@ pa_hook_slot* pa_hook_connect(pa_hook *hook, pa_hook_priority_t prio, pa_hook_cb
     slot->callback = cb;
     slot->data = data;
     slot->priority = prio;
+    slot->module = connecting_module;
+    slot->n_calls = 0;
+    slot->total_usec = 0;
 
     prev = NULL;
     for (where = hook->slots; where; where = where->next) {
@@ -89,6 +97,29 @@ void pa_hook_slot_free(pa_hook_slot *slot) {
         slot_free(slot->hook, slot);
 }
 
+static pa_hook_result_t call_slot_traced(pa_hook *hook, pa_hook_slot *slot, void *data) {
+    pa_hook_result_t result;
+    unsigned span;
+    bool profile = profiling;
+    pa_usec_t start = 0;
+
+    span = pa_startup_trace_begin_hook(hook, slot);
+
+    if (profile)
+        start = pa_rtclock_now();
+
+    result = slot->callback(hook->data, data, slot->data);
+
+    if (profile) {
+        slot->n_calls++;
+        slot->total_usec += pa_rtclock_now() - start;
+    }
+
+    pa_startup_trace_end(span);
+
+    return result;
+}
+
 pa_hook_result_t pa_hook_fire(pa_hook *hook, void *data) {
     pa_hook_slot *slot, *next;
     pa_hook_result_t result = PA_HOOK_OK;
@@ -101,7 +132,12 @@ pa_hook_result_t pa_hook_fire(pa_hook *hook, void *data) {
         if (slot->dead)
             continue;
 
-        if ((result = slot->callback(hook->data, data, slot->data)) != PA_HOOK_OK)
+        if (PA_UNLIKELY(profiling || pa_startup_trace_running()))
+            result = call_slot_traced(hook, slot, data);
+        else
+            result = slot->callback(hook->data, data, slot->data);
+
+        if (result != PA_HOOK_OK)
             break;
     }
 
@@ -127,3 +163,19 @@ bool pa_hook_is_firing(pa_hook *hook) {
 
     return hook->n_firing > 0;
 }
+
+void pa_hook_set_profiling(bool enabled) {
+    profiling = enabled;
+}
+
+bool pa_hook_get_profiling(void) {
+    return profiling;
+}
+
+struct pa_module *pa_hook_set_connecting_module(struct pa_module *m) {
+    struct pa_module *old = connecting_module;
+
+    connecting_module = m;
+
+    return old;
+}
@@ -20,8 +20,12 @@
   License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
 ***/
 
+#include <inttypes.h>
+
 #include <pulsecore/llist.h>
 
+struct pa_module;
+
 typedef struct pa_hook_slot pa_hook_slot;
 typedef struct pa_hook pa_hook;
 
@@ -48,6 +52,14 @@ struct pa_hook_slot {
     pa_hook_priority_t priority;
     pa_hook_cb_t callback;
     void *data;
+
+    /* The module that connected the slot, if known */
+    struct pa_module *module;
+
+    /* Only counted while hook profiling is enabled */
+    uint64_t n_calls;
+    uint64_t total_usec;
+
     PA_LLIST_FIELDS(pa_hook_slot);
 };
 
@@ -68,4 +80,13 @@ pa_hook_result_t pa_hook_fire(pa_hook *hook, void *data);
 
 bool pa_hook_is_firing(pa_hook *hook);
 
+/* When enabled, every slot counts its calls and the time spent in its
+ * callback. Disabled by default. */
+void pa_hook_set_profiling(bool enabled);
+bool pa_hook_get_profiling(void);
+
+/* Slots connected while a module is set here are attributed to that module.
+ * Returns the previously set module. */
+struct pa_module *pa_hook_set_connecting_module(struct pa_module *m);
+
 #endif
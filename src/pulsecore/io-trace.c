@@ -0,0 +1,350 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/util.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/atomic.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/llist.h>
+#include <pulsecore/log.h>
+#include <pulsecore/thread.h>
+
+#include "io-trace.h"
+
+/* Records per thread, a power of two. At a few hundred records per second
+ * this lasts for several flushes. */
+#define RING_SIZE 2048
+#define FLUSH_INTERVAL_MSEC 50
+
+typedef struct ring ring;
+
+/* Written by its thread and read by the flushing thread only. The indices
+ * run freely and are masked when accessing the records. */
+struct ring {
+    uint32_t id;
+    char name[PA_IO_TRACE_NAME_MAX];
+
+    pa_atomic_t write_index;
+    pa_atomic_t read_index;
+    pa_atomic_t n_dropped;
+    /* Set when the thread exits, the flushing thread frees the ring */
+    pa_atomic_t dead;
+
+    /* Owned by the flushing thread */
+    bool announced;
+    unsigned n_dropped_reported;
+    PA_LLIST_FIELDS(ring);
+
+    /* Link in the stack of rings that the flushing thread didn't pick up
+     * yet */
+    ring *next_new;
+
+    pa_io_trace_record records[RING_SIZE];
+};
+
+static const char * const event_names[PA_IO_TRACE_EVENT_MAX] = {
+    [PA_IO_TRACE_THREAD] = "thread",
+    [PA_IO_TRACE_DROPPED] = "dropped",
+    [PA_IO_TRACE_SINK_RENDER] = "sink-render",
+    [PA_IO_TRACE_SINK_REWIND] = "sink-rewind",
+    [PA_IO_TRACE_SOURCE_POST] = "source-post",
+    [PA_IO_TRACE_ALSA_SINK_CYCLE] = "alsa-sink-cycle",
+    [PA_IO_TRACE_ALSA_SOURCE_CYCLE] = "alsa-source-cycle",
+    [PA_IO_TRACE_ALSA_SINK_UNDERRUN] = "alsa-sink-underrun",
+};
+
+static pa_atomic_t running = PA_ATOMIC_INIT(0);
+static pa_atomic_t next_id = PA_ATOMIC_INIT(0);
+static pa_atomic_ptr_t new_rings = PA_ATOMIC_PTR_INIT(NULL);
+
+/* Only touched by the flushing thread, or by the main thread while that
+ * isn't running */
+static PA_LLIST_HEAD(ring, rings) = NULL;
+static pa_thread *flush_thread = NULL;
+static int fd = -1;
+static bool write_failed = false;
+
+static void ring_release(void *userdata) {
+    ring *r = userdata;
+
+    pa_atomic_store(&r->dead, 1);
+}
+
+PA_STATIC_TLS_DECLARE(io_trace_ring, ring_release);
+
+static ring *ring_new(void) {
+    ring *r;
+    const char *name;
+    void *head;
+
+    r = pa_xnew0(ring, 1);
+    r->id = (uint32_t) pa_atomic_inc(&next_id);
+
+    if (!(name = pa_thread_get_name(pa_thread_self())))
+        name = "unknown";
+    pa_strlcpy(r->name, name, sizeof(r->name));
+
+    do {
+        head = pa_atomic_ptr_load(&new_rings);
+        r->next_new = head;
+    } while (!pa_atomic_ptr_cmpxchg(&new_rings, head, r));
+
+    PA_STATIC_TLS_SET(io_trace_ring, r);
+
+    return r;
+}
+
+const char *pa_io_trace_event_to_string(pa_io_trace_event_t event) {
+    if (event >= PA_IO_TRACE_EVENT_MAX)
+        return NULL;
+
+    return event_names[event];
+}
+
+void pa_io_trace_thread_init(void) {
+    if (!pa_atomic_load(&running))
+        return;
+
+    if (!PA_STATIC_TLS_GET(io_trace_ring))
+        ring_new();
+}
+
+/* Called from any thread */
+void pa_io_trace(pa_io_trace_event_t event, int64_t a0, int64_t a1, int64_t a2, int64_t a3) {
+    ring *r;
+    unsigned w;
+    pa_io_trace_record *rec;
+
+    if (PA_LIKELY(!pa_atomic_load(&running)))
+        return;
+
+    if (PA_UNLIKELY(!(r = PA_STATIC_TLS_GET(io_trace_ring))))
+        r = ring_new();
+
+    w = (unsigned) pa_atomic_load(&r->write_index);
+
+    if (w - (unsigned) pa_atomic_load(&r->read_index) >= RING_SIZE) {
+        pa_atomic_inc(&r->n_dropped);
+        return;
+    }
+
+    rec = &r->records[w & (RING_SIZE - 1)];
+    rec->usec = pa_rtclock_now();
+    rec->event = event;
+    rec->thread = r->id;
+    rec->args[0] = a0;
+    rec->args[1] = a1;
+    rec->args[2] = a2;
+    rec->args[3] = a3;
+
+    /* Publishes the record */
+    pa_atomic_store(&r->write_index, (int) (w + 1));
+}
+
+static void write_data(const void *data, size_t size) {
+    if (write_failed)
+        return;
+
+    if (pa_loop_write(fd, data, size, NULL) != (ssize_t) size) {
+        pa_log_warn("Failed to write IO trace: %s", pa_cstrerror(errno));
+        write_failed = true;
+    }
+}
+
+static void write_record(ring *r, pa_io_trace_event_t event, int64_t arg) {
+    pa_io_trace_record rec;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.usec = pa_rtclock_now();
+    rec.event = event;
+    rec.thread = r->id;
+    rec.args[0] = arg;
+
+    write_data(&rec, sizeof(rec));
+}
+
+static void pick_up_new_rings(void) {
+    ring *r;
+
+    do {
+        r = pa_atomic_ptr_load(&new_rings);
+    } while (!pa_atomic_ptr_cmpxchg(&new_rings, r, NULL));
+
+    while (r) {
+        ring *next = r->next_new;
+
+        PA_LLIST_PREPEND(ring, rings, r);
+        r = next;
+    }
+}
+
+static void flush_rings(void) {
+    ring *r, *n;
+
+    pick_up_new_rings();
+
+    PA_LLIST_FOREACH_SAFE(r, n, rings) {
+        unsigned rd, w, n_dropped;
+        bool dead;
+
+        /* Read this first, so that nothing written before the thread
+         * exited is lost */
+        dead = pa_atomic_load(&r->dead);
+
+        if (!r->announced) {
+            pa_io_trace_record rec;
+
+            pa_assert_cc(sizeof(rec.args) == PA_IO_TRACE_NAME_MAX);
+
+            memset(&rec, 0, sizeof(rec));
+            rec.usec = pa_rtclock_now();
+            rec.event = PA_IO_TRACE_THREAD;
+            rec.thread = r->id;
+            memcpy(rec.args, r->name, PA_IO_TRACE_NAME_MAX);
+
+            write_data(&rec, sizeof(rec));
+            r->announced = true;
+        }
+
+        rd = (unsigned) pa_atomic_load(&r->read_index);
+        w = (unsigned) pa_atomic_load(&r->write_index);
+
+        while (rd != w) {
+            unsigned k = PA_MIN(w - rd, RING_SIZE - (rd & (RING_SIZE - 1)));
+
+            write_data(&r->records[rd & (RING_SIZE - 1)], k * sizeof(pa_io_trace_record));
+            rd += k;
+        }
+
+        pa_atomic_store(&r->read_index, (int) rd);
+
+        n_dropped = (unsigned) pa_atomic_load(&r->n_dropped);
+        if (n_dropped != r->n_dropped_reported) {
+            write_record(r, PA_IO_TRACE_DROPPED, n_dropped - r->n_dropped_reported);
+            r->n_dropped_reported = n_dropped;
+        }
+
+        if (dead) {
+            PA_LLIST_REMOVE(ring, rings, r);
+            pa_xfree(r);
+        }
+    }
+}
+
+static void flush_thread_func(void *userdata) {
+    pa_log_debug("IO trace flushing thread starting up.");
+
+    /* Don't inherit the raised priority of the daemon, writing the trace
+     * must not get in the way of the IO threads */
+    pa_reset_priority();
+
+    while (pa_atomic_load(&running)) {
+        flush_rings();
+        pa_msleep(FLUSH_INTERVAL_MSEC);
+    }
+
+    pa_log_debug("IO trace flushing thread shutting down.");
+}
+
+/* Called from main context */
+int pa_io_trace_start(const char *fn) {
+    pa_io_trace_header header;
+    char names[PA_IO_TRACE_EVENT_MAX][PA_IO_TRACE_NAME_MAX];
+    unsigned i;
+    ring *r;
+
+    pa_assert(fn);
+    pa_assert(!flush_thread);
+
+    if ((fd = pa_open_cloexec(fn, O_WRONLY|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR)) < 0) {
+        pa_log("Failed to open IO trace file %s: %s", fn, pa_cstrerror(errno));
+        return -1;
+    }
+
+    write_failed = false;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PA_IO_TRACE_MAGIC, sizeof(PA_IO_TRACE_MAGIC));
+    header.version = PA_IO_TRACE_VERSION;
+    header.n_events = PA_IO_TRACE_EVENT_MAX;
+    write_data(&header, sizeof(header));
+
+    memset(names, 0, sizeof(names));
+    for (i = 0; i < PA_IO_TRACE_EVENT_MAX; i++)
+        pa_strlcpy(names[i], event_names[i], PA_IO_TRACE_NAME_MAX);
+    write_data(names, sizeof(names));
+
+    if (write_failed) {
+        pa_close(fd);
+        fd = -1;
+        return -1;
+    }
+
+    /* Skip whatever threads recorded after an earlier trace was stopped,
+     * and name the threads again in the new file */
+    pick_up_new_rings();
+    PA_LLIST_FOREACH(r, rings) {
+        pa_atomic_store(&r->read_index, pa_atomic_load(&r->write_index));
+        r->n_dropped_reported = (unsigned) pa_atomic_load(&r->n_dropped);
+        r->announced = false;
+    }
+
+    pa_atomic_store(&running, 1);
+
+    if (!(flush_thread = pa_thread_new("io-trace", flush_thread_func, NULL))) {
+        pa_log("Failed to create IO trace flushing thread.");
+        pa_atomic_store(&running, 0);
+        pa_close(fd);
+        fd = -1;
+        return -1;
+    }
+
+    pa_log_info("Writing IO trace to %s.", fn);
+
+    return 0;
+}
+
+/* Called from main context */
+void pa_io_trace_stop(void) {
+    if (!flush_thread)
+        return;
+
+    pa_atomic_store(&running, 0);
+    pa_thread_free(flush_thread);
+    flush_thread = NULL;
+
+    flush_rings();
+
+    pa_close(fd);
+    fd = -1;
+}
+
+bool pa_io_trace_running(void) {
+    return pa_atomic_load(&running);
+}
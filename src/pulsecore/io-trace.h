@@ -0,0 +1,93 @@
+#ifndef fooiotracehfoo
+#define fooiotracehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <inttypes.h>
+
+#include <pulsecore/macro.h>
+
+/* A binary trace of high frequency events in IO threads, cheap enough to
+ * record while audio is playing. pa_io_trace() neither formats nor takes
+ * locks: each thread appends fixed size records to its own ring, and a
+ * thread of normal priority writes the rings to the trace file. When a ring
+ * is full the record is dropped and the drop is counted. The file is
+ * decoded with pa-io-trace. */
+
+typedef enum pa_io_trace_event {
+    /* Written by the flushing thread: the name of a thread, packed into
+     * the arguments, and the number of records a thread dropped */
+    PA_IO_TRACE_THREAD,
+    PA_IO_TRACE_DROPPED,
+
+    /* sink index, bytes, usec */
+    PA_IO_TRACE_SINK_RENDER,
+    /* sink index, bytes */
+    PA_IO_TRACE_SINK_REWIND,
+    /* source index, bytes, usec */
+    PA_IO_TRACE_SOURCE_POST,
+    /* sink or source index, usec of audio left in the device (or of
+     * space left for capture), usec the cycle took, usec the write or
+     * read asked to sleep */
+    PA_IO_TRACE_ALSA_SINK_CYCLE,
+    PA_IO_TRACE_ALSA_SOURCE_CYCLE,
+    /* sink index */
+    PA_IO_TRACE_ALSA_SINK_UNDERRUN,
+    PA_IO_TRACE_EVENT_MAX
+} pa_io_trace_event_t;
+
+#define PA_IO_TRACE_ARGS 4
+#define PA_IO_TRACE_NAME_MAX 32
+
+/* The file starts with a header, followed by the names of the events, each
+ * PA_IO_TRACE_NAME_MAX bytes long and NUL padded, and the records. All
+ * fields are in host byte order. */
+
+#define PA_IO_TRACE_MAGIC "PAIOTRC"
+#define PA_IO_TRACE_VERSION 1
+
+typedef struct pa_io_trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_events;
+} pa_io_trace_header;
+
+typedef struct pa_io_trace_record {
+    uint64_t usec;
+    uint32_t event;
+    uint32_t thread;
+    int64_t args[PA_IO_TRACE_ARGS];
+} pa_io_trace_record;
+
+/* Opens the file and starts the flushing thread. Called from the main
+ * thread. */
+int pa_io_trace_start(const char *fn);
+/* Writes what is left in the rings and closes the file */
+void pa_io_trace_stop(void);
+bool pa_io_trace_running(void);
+
+/* Records an event in the ring of the calling thread. The ring is allocated
+ * by the first event a thread records, or ahead by pa_io_trace_thread_init(),
+ * which pa_thread_mq_install() calls for the IO threads. Does nothing unless
+ * a trace is running. */
+void pa_io_trace(pa_io_trace_event_t event, int64_t a0, int64_t a1, int64_t a2, int64_t a3);
+void pa_io_trace_thread_init(void);
+
+const char *pa_io_trace_event_to_string(pa_io_trace_event_t event);
+
+#endif
@@ -0,0 +1,468 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#ifdef HAVE_EXECINFO_H
+#include <execinfo.h>
+#endif
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/json.h>
+#include <pulsecore/log.h>
+
+#include "mainloop-watchdog.h"
+
+/* Iterations are sorted into buckets of up to 16 usec, 32 usec, ... 2^20
+ * usec (about 1 s), plus one for anything longer */
+#define FIRST_BUCKET_SHIFT 4
+#define N_BUCKETS 18
+
+enum {
+    KIND_IO,
+    KIND_TIME,
+    KIND_DEFER,
+    N_KINDS
+};
+
+static const char* const kind_names[N_KINDS] = {
+    [KIND_IO] = "io",
+    [KIND_TIME] = "time",
+    [KIND_DEFER] = "defer"
+};
+
+struct kind_stats {
+    uint64_t n_calls;
+    pa_usec_t total_usec;
+};
+
+struct pa_mainloop_watchdog {
+    pa_mainloop *mainloop;
+    pa_mainloop_api *parent;
+    pa_mainloop_api api;
+
+    pa_usec_t stall_threshold;
+
+    uint64_t n_iterations;
+    uint64_t buckets[N_BUCKETS];
+    pa_usec_t busy_usec;
+    pa_usec_t max_busy_usec;
+
+    struct kind_stats kinds[N_KINDS];
+    uint64_t n_stalls;
+    pa_usec_t worst_stall_usec;
+    char *worst_stall_callback;
+};
+
+/* The events handed out wrap the ones of the main loop. They are freed by
+ * the destroy callback of the wrapped event, which the main loop calls once
+ * it is done with it. */
+
+struct pa_io_event {
+    pa_mainloop_watchdog *watchdog;
+    pa_io_event *parent;
+    pa_io_event_cb_t callback;
+    void *userdata;
+    pa_io_event_destroy_cb_t destroy_callback;
+};
+
+struct pa_time_event {
+    pa_mainloop_watchdog *watchdog;
+    pa_time_event *parent;
+    pa_time_event_cb_t callback;
+    void *userdata;
+    pa_time_event_destroy_cb_t destroy_callback;
+};
+
+struct pa_defer_event {
+    pa_mainloop_watchdog *watchdog;
+    pa_defer_event *parent;
+    pa_defer_event_cb_t callback;
+    void *userdata;
+    pa_defer_event_destroy_cb_t destroy_callback;
+};
+
+/* Static callbacks don't have a symbol, but the object and offset still
+ * identify them */
+static char *callback_name(void *callback) {
+#ifdef HAVE_EXECINFO_H
+    char **symbols;
+
+    if ((symbols = backtrace_symbols(&callback, 1))) {
+        char *name = pa_xstrdup(symbols[0]);
+
+        free(symbols);
+        return name;
+    }
+#endif
+
+    return pa_sprintf_malloc("%p", callback);
+}
+
+static void account(pa_mainloop_watchdog *w, unsigned kind, void *callback, pa_usec_t usec) {
+    pa_assert(w);
+
+    w->kinds[kind].n_calls++;
+    w->kinds[kind].total_usec += usec;
+
+    if (usec < w->stall_threshold)
+        return;
+
+    w->n_stalls++;
+
+    if (usec > w->worst_stall_usec || pa_log_ratelimit(PA_LOG_WARN)) {
+        char *name = callback_name(callback);
+
+        pa_log_warn("Main loop %s event callback %s took %0.2f ms.",
+                    kind_names[kind], name, (double) usec / PA_USEC_PER_MSEC);
+
+        if (usec > w->worst_stall_usec) {
+            w->worst_stall_usec = usec;
+            pa_xfree(w->worst_stall_callback);
+            w->worst_stall_callback = name;
+        } else
+            pa_xfree(name);
+    }
+}
+
+static void io_callback(pa_mainloop_api *a, pa_io_event *parent, int fd, pa_io_event_flags_t events, void *userdata) {
+    pa_io_event *e = userdata;
+    pa_io_event_cb_t callback = e->callback;
+    pa_usec_t start;
+
+    start = pa_rtclock_now();
+    callback(&e->watchdog->api, e, fd, events, e->userdata);
+    account(e->watchdog, KIND_IO, (void *) callback, pa_rtclock_now() - start);
+}
+
+static void io_destroy(pa_mainloop_api *a, pa_io_event *parent, void *userdata) {
+    pa_io_event *e = userdata;
+
+    if (e->destroy_callback)
+        e->destroy_callback(&e->watchdog->api, e, e->userdata);
+
+    pa_xfree(e);
+}
+
+static pa_io_event* watchdog_io_new(pa_mainloop_api *a, int fd, pa_io_event_flags_t events, pa_io_event_cb_t callback, void *userdata) {
+    pa_mainloop_watchdog *w;
+    pa_io_event *e;
+
+    pa_assert(a);
+    pa_assert(callback);
+    pa_assert_se(w = a->userdata);
+
+    e = pa_xnew0(pa_io_event, 1);
+    e->watchdog = w;
+    e->callback = callback;
+    e->userdata = userdata;
+
+    e->parent = w->parent->io_new(w->parent, fd, events, io_callback, e);
+    w->parent->io_set_destroy(e->parent, io_destroy);
+
+    return e;
+}
+
+static void watchdog_io_enable(pa_io_event *e, pa_io_event_flags_t events) {
+    pa_assert(e);
+
+    e->watchdog->parent->io_enable(e->parent, events);
+}
+
+static void watchdog_io_free(pa_io_event *e) {
+    pa_assert(e);
+
+    e->watchdog->parent->io_free(e->parent);
+}
+
+static void watchdog_io_set_destroy(pa_io_event *e, pa_io_event_destroy_cb_t callback) {
+    pa_assert(e);
+
+    e->destroy_callback = callback;
+}
+
+static void time_callback(pa_mainloop_api *a, pa_time_event *parent, const struct timeval *tv, void *userdata) {
+    pa_time_event *e = userdata;
+    pa_time_event_cb_t callback = e->callback;
+    pa_usec_t start;
+
+    start = pa_rtclock_now();
+    callback(&e->watchdog->api, e, tv, e->userdata);
+    account(e->watchdog, KIND_TIME, (void *) callback, pa_rtclock_now() - start);
+}
+
+static void time_destroy(pa_mainloop_api *a, pa_time_event *parent, void *userdata) {
+    pa_time_event *e = userdata;
+
+    if (e->destroy_callback)
+        e->destroy_callback(&e->watchdog->api, e, e->userdata);
+
+    pa_xfree(e);
+}
+
+static pa_time_event* watchdog_time_new(pa_mainloop_api *a, const struct timeval *tv, pa_time_event_cb_t callback, void *userdata) {
+    pa_mainloop_watchdog *w;
+    pa_time_event *e;
+
+    pa_assert(a);
+    pa_assert(callback);
+    pa_assert_se(w = a->userdata);
+
+    e = pa_xnew0(pa_time_event, 1);
+    e->watchdog = w;
+    e->callback = callback;
+    e->userdata = userdata;
+
+    e->parent = w->parent->time_new(w->parent, tv, time_callback, e);
+    w->parent->time_set_destroy(e->parent, time_destroy);
+
+    return e;
+}
+
+static void watchdog_time_restart(pa_time_event *e, const struct timeval *tv) {
+    pa_assert(e);
+
+    e->watchdog->parent->time_restart(e->parent, tv);
+}
+
+static void watchdog_time_free(pa_time_event *e) {
+    pa_assert(e);
+
+    e->watchdog->parent->time_free(e->parent);
+}
+
+static void watchdog_time_set_destroy(pa_time_event *e, pa_time_event_destroy_cb_t callback) {
+    pa_assert(e);
+
+    e->destroy_callback = callback;
+}
+
+static void defer_callback(pa_mainloop_api *a, pa_defer_event *parent, void *userdata) {
+    pa_defer_event *e = userdata;
+    pa_defer_event_cb_t callback = e->callback;
+    pa_usec_t start;
+
+    start = pa_rtclock_now();
+    callback(&e->watchdog->api, e, e->userdata);
+    account(e->watchdog, KIND_DEFER, (void *) callback, pa_rtclock_now() - start);
+}
+
+static void defer_destroy(pa_mainloop_api *a, pa_defer_event *parent, void *userdata) {
+    pa_defer_event *e = userdata;
+
+    if (e->destroy_callback)
+        e->destroy_callback(&e->watchdog->api, e, e->userdata);
+
+    pa_xfree(e);
+}
+
+static pa_defer_event* watchdog_defer_new(pa_mainloop_api *a, pa_defer_event_cb_t callback, void *userdata) {
+    pa_mainloop_watchdog *w;
+    pa_defer_event *e;
+
+    pa_assert(a);
+    pa_assert(callback);
+    pa_assert_se(w = a->userdata);
+
+    e = pa_xnew0(pa_defer_event, 1);
+    e->watchdog = w;
+    e->callback = callback;
+    e->userdata = userdata;
+
+    e->parent = w->parent->defer_new(w->parent, defer_callback, e);
+    w->parent->defer_set_destroy(e->parent, defer_destroy);
+
+    return e;
+}
+
+static void watchdog_defer_enable(pa_defer_event *e, int b) {
+    pa_assert(e);
+
+    e->watchdog->parent->defer_enable(e->parent, b);
+}
+
+static void watchdog_defer_free(pa_defer_event *e) {
+    pa_assert(e);
+
+    e->watchdog->parent->defer_free(e->parent);
+}
+
+static void watchdog_defer_set_destroy(pa_defer_event *e, pa_defer_event_destroy_cb_t callback) {
+    pa_assert(e);
+
+    e->destroy_callback = callback;
+}
+
+static void watchdog_quit(pa_mainloop_api *a, int retval) {
+    pa_mainloop_watchdog *w;
+
+    pa_assert(a);
+    pa_assert_se(w = a->userdata);
+
+    w->parent->quit(w->parent, retval);
+}
+
+static const pa_mainloop_api vtable = {
+    .userdata = NULL,
+
+    .io_new = watchdog_io_new,
+    .io_enable = watchdog_io_enable,
+    .io_free = watchdog_io_free,
+    .io_set_destroy = watchdog_io_set_destroy,
+
+    .time_new = watchdog_time_new,
+    .time_restart = watchdog_time_restart,
+    .time_free = watchdog_time_free,
+    .time_set_destroy = watchdog_time_set_destroy,
+
+    .defer_new = watchdog_defer_new,
+    .defer_enable = watchdog_defer_enable,
+    .defer_free = watchdog_defer_free,
+    .defer_set_destroy = watchdog_defer_set_destroy,
+
+    .quit = watchdog_quit,
+};
+
+pa_mainloop_watchdog *pa_mainloop_watchdog_new(pa_mainloop *m, pa_usec_t stall_threshold) {
+    pa_mainloop_watchdog *w;
+
+    pa_assert(m);
+
+    w = pa_xnew0(pa_mainloop_watchdog, 1);
+    w->mainloop = m;
+    w->parent = pa_mainloop_get_api(m);
+    w->stall_threshold = stall_threshold;
+
+    w->api = vtable;
+    w->api.userdata = w;
+
+    return w;
+}
+
+void pa_mainloop_watchdog_free(pa_mainloop_watchdog *w) {
+    pa_assert(w);
+
+    pa_xfree(w->worst_stall_callback);
+    pa_xfree(w);
+}
+
+pa_mainloop_api *pa_mainloop_watchdog_get_api(pa_mainloop_watchdog *w) {
+    pa_assert(w);
+
+    return w->stall_threshold > 0 ? &w->api : w->parent;
+}
+
+static void account_iteration(pa_mainloop_watchdog *w, pa_usec_t usec) {
+    unsigned i;
+
+    w->n_iterations++;
+    w->busy_usec += usec;
+    w->max_busy_usec = PA_MAX(w->max_busy_usec, usec);
+
+    for (i = 0; i < N_BUCKETS - 1; i++)
+        if (usec <= (pa_usec_t) 1 << (FIRST_BUCKET_SHIFT + i))
+            break;
+
+    w->buckets[i]++;
+}
+
+int pa_mainloop_watchdog_run(pa_mainloop_watchdog *w, int *retval) {
+    pa_usec_t woken_up = 0;
+    int r;
+
+    pa_assert(w);
+
+    /* Like pa_mainloop_iterate(), but counts everything from the return of
+     * one poll to the start of the next one, including the destruction of
+     * dead events while preparing */
+    for (;;) {
+        r = pa_mainloop_prepare(w->mainloop, -1);
+
+        if (woken_up > 0)
+            account_iteration(w, pa_rtclock_now() - woken_up);
+
+        if (r < 0)
+            break;
+
+        if ((r = pa_mainloop_poll(w->mainloop)) < 0)
+            break;
+
+        woken_up = pa_rtclock_now();
+
+        if ((r = pa_mainloop_dispatch(w->mainloop)) < 0)
+            break;
+    }
+
+    if (r == -2) {
+        if (retval)
+            *retval = pa_mainloop_get_retval(w->mainloop);
+        return 1;
+    }
+
+    return -1;
+}
+
+char *pa_mainloop_watchdog_stats_to_json(pa_mainloop_watchdog *w) {
+    pa_json_encoder *encoder;
+    unsigned i;
+
+    pa_assert(w);
+
+    encoder = pa_json_encoder_new();
+    pa_json_encoder_begin_element_object(encoder);
+
+    pa_json_encoder_add_member_int(encoder, "iterations", (int64_t) w->n_iterations);
+    pa_json_encoder_add_member_int(encoder, "busy_usec", (int64_t) w->busy_usec);
+    pa_json_encoder_add_member_int(encoder, "max_busy_usec", (int64_t) w->max_busy_usec);
+
+    pa_json_encoder_begin_member_array(encoder, "bucket_limits_usec");
+    for (i = 0; i < N_BUCKETS - 1; i++)
+        pa_json_encoder_add_element_int(encoder, (int64_t) 1 << (FIRST_BUCKET_SHIFT + i));
+    pa_json_encoder_end_array(encoder);
+
+    pa_json_encoder_begin_member_array(encoder, "buckets");
+    for (i = 0; i < N_BUCKETS; i++)
+        pa_json_encoder_add_element_int(encoder, (int64_t) w->buckets[i]);
+    pa_json_encoder_end_array(encoder);
+
+    pa_json_encoder_add_member_int(encoder, "stall_threshold_usec", (int64_t) w->stall_threshold);
+
+    if (w->stall_threshold > 0) {
+        for (i = 0; i < N_KINDS; i++) {
+            pa_json_encoder_begin_member_object(encoder, kind_names[i]);
+            pa_json_encoder_add_member_int(encoder, "calls", (int64_t) w->kinds[i].n_calls);
+            pa_json_encoder_add_member_int(encoder, "usec", (int64_t) w->kinds[i].total_usec);
+            pa_json_encoder_end_object(encoder);
+        }
+
+        pa_json_encoder_add_member_int(encoder, "stalls", (int64_t) w->n_stalls);
+        pa_json_encoder_add_member_int(encoder, "worst_stall_usec", (int64_t) w->worst_stall_usec);
+        pa_json_encoder_add_member_string(encoder, "worst_stall_callback", w->worst_stall_callback);
+    }
+
+    pa_json_encoder_end_object(encoder);
+
+    return pa_json_encoder_to_string_free(encoder);
+}
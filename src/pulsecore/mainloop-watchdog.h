@@ -0,0 +1,48 @@
+#ifndef foomainloopwatchdoghfoo
+#define foomainloopwatchdoghfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulse/mainloop.h>
+#include <pulse/sample.h>
+
+#include <pulsecore/macro.h>
+
+/* Watches how long the daemon's main loop is kept busy. Running the loop
+ * with pa_mainloop_watchdog_run() keeps a histogram of the time spent
+ * between two polls. If a stall threshold is set, the API returned by
+ * pa_mainloop_watchdog_get_api() wraps the one of the main loop and times
+ * every io, time and defer event callback, logging the ones that take
+ * longer than the threshold. */
+
+typedef struct pa_mainloop_watchdog pa_mainloop_watchdog;
+
+/* A threshold of 0 disables timing of single callbacks. Has to be freed
+ * after the main loop, whose events may still refer to it. */
+pa_mainloop_watchdog *pa_mainloop_watchdog_new(pa_mainloop *m, pa_usec_t stall_threshold);
+void pa_mainloop_watchdog_free(pa_mainloop_watchdog *w);
+
+/* Returns the API to hand out instead of the one of the main loop */
+pa_mainloop_api *pa_mainloop_watchdog_get_api(pa_mainloop_watchdog *w);
+
+/* Same as pa_mainloop_run() */
+int pa_mainloop_watchdog_run(pa_mainloop_watchdog *w, int *retval);
+
+char *pa_mainloop_watchdog_stats_to_json(pa_mainloop_watchdog *w);
+
+#endif
@@ -121,49 +121,159 @@ static const pa_calc_stream_volumes_func_t calc_stream_volumes_table[] = {
   [PA_SAMPLE_S24_32BE]  = (pa_calc_stream_volumes_func_t) calc_linear_integer_stream_volumes
 };
 
-/* special case: mix 2 s16ne streams, 1 channel each */
-static void pa_mix2_ch1_s16ne(pa_mix_info streams[], int16_t *data, unsigned length) {
-    const int16_t *ptr0 = streams[0].ptr;
-    const int16_t *ptr1 = streams[1].ptr;
-
-    const int32_t cv0 = streams[0].linear[0].i;
-    const int32_t cv1 = streams[1].linear[0].i;
-
-    length /= sizeof(int16_t);
-
-    for (; length > 0; length--) {
-        int32_t sum;
-
-        sum = pa_mult_s16_volume(*ptr0++, cv0);
-        sum += pa_mult_s16_volume(*ptr1++, cv1);
+/* Mixers specialized for a fixed number of channels and, except for the
+ * *_n variants, a fixed number of streams. DEFINE_MIX_FIXED() generates the
+ * mixing loops for one sample format; DEFINE_MIX_FIXED_FUNCS() instantiates
+ * them with constant stream and channel counts, so that the compiler can
+ * unroll the inner loops. */
+#define MIX_FIXED_STREAMS_MAX 4
+#define MIX_FIXED_CHANNELS_MAX 8
+#define MIX_BLOCK_SAMPLES 512
+
+/* Complete unrolling of the constant loops isn't done at -O2 by default */
+#if defined(__GNUC__) && (__GNUC__ >= 8 || defined(__clang__))
+#define MIX_UNROLL _Pragma("GCC unroll 8")
+#else
+#define MIX_UNROLL
+#endif
 
-        sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
-        *data++ = sum;
-    }
+#define DEFINE_MIX_FIXED(fmt, type, sum_type, vol_type, field, mult, store)                          \
+static inline void mix_fixed_##fmt(pa_mix_info streams[], unsigned nstreams, unsigned channels,      \
+                                   type *data, unsigned length) {                                    \
+    const type *ptr[MIX_FIXED_STREAMS_MAX];                                                          \
+    vol_type cv[MIX_FIXED_STREAMS_MAX][MIX_FIXED_CHANNELS_MAX];                                      \
+    unsigned i, j, c;                                                                                \
+                                                                                                     \
+    for (i = 0; i < nstreams; i++) {                                                                 \
+        ptr[i] = streams[i].ptr;                                                                     \
+        for (c = 0; c < channels; c++)                                                               \
+            cv[i][c] = streams[i].linear[c].field;                                                   \
+    }                                                                                                \
+                                                                                                     \
+    length /= sizeof(type);                                                                          \
+                                                                                                     \
+    for (j = 0; j + channels <= length; j += channels) {                                             \
+        MIX_UNROLL                                                                                   \
+        for (c = 0; c < channels; c++) {                                                             \
+            sum_type sum = 0;                                                                        \
+                                                                                                     \
+            MIX_UNROLL                                                                               \
+            for (i = 0; i < nstreams; i++)                                                           \
+                sum += mult(ptr[i][j + c], cv[i][c]);                                                \
+                                                                                                     \
+            data[j + c] = store(sum);                                                                \
+        }                                                                                            \
+    }                                                                                                \
+}                                                                                                    \
+                                                                                                     \
+static inline void mix_fixed_n_##fmt(pa_mix_info streams[], unsigned nstreams, unsigned channels,    \
+                                     type *data, unsigned length) {                                  \
+    sum_type sum[MIX_BLOCK_SAMPLES];                                                                 \
+    unsigned i, j, c, n;                                                                             \
+                                                                                                     \
+    length /= sizeof(type);                                                                          \
+                                                                                                     \
+    while (length > 0) {                                                                             \
+        n = PA_MIN(length, MIX_BLOCK_SAMPLES / channels * channels);                                 \
+                                                                                                     \
+        for (j = 0; j < n; j++)                                                                      \
+            sum[j] = 0;                                                                              \
+                                                                                                     \
+        for (i = 0; i < nstreams; i++) {                                                             \
+            const type *ptr = streams[i].ptr;                                                        \
+            vol_type cv[MIX_FIXED_CHANNELS_MAX];                                                     \
+                                                                                                     \
+            for (c = 0; c < channels; c++)                                                           \
+                cv[c] = streams[i].linear[c].field;                                                  \
+                                                                                                     \
+            for (j = 0; j < n; j += channels) {                                                      \
+                MIX_UNROLL                                                                           \
+                for (c = 0; c < channels; c++)                                                       \
+                    sum[j + c] += mult(ptr[j + c], cv[c]);                                           \
+            }                                                                                        \
+                                                                                                     \
+            streams[i].ptr = (uint8_t*) streams[i].ptr + n * sizeof(type);                           \
+        }                                                                                            \
+                                                                                                     \
+        for (j = 0; j < n; j++)                                                                      \
+            data[j] = store(sum[j]);                                                                 \
+                                                                                                     \
+        data += n;                                                                                   \
+        length -= n;                                                                                 \
+    }                                                                                                \
 }
 
-/* special case: mix 2 s16ne streams, 2 channels each */
-static void pa_mix2_ch2_s16ne(pa_mix_info streams[], int16_t *data, unsigned length) {
-    const int16_t *ptr0 = streams[0].ptr;
-    const int16_t *ptr1 = streams[1].ptr;
-
-    length /= sizeof(int16_t) * 2;
-
-    for (; length > 0; length--) {
-        int32_t sum;
-
-        sum = pa_mult_s16_volume(*ptr0++, streams[0].linear[0].i);
-        sum += pa_mult_s16_volume(*ptr1++, streams[1].linear[0].i);
-
-        sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
-        *data++ = sum;
+#define DEFINE_MIX_FIXED_FUNCS(fmt, ch)                                                              \
+static void pa_mix2_ch##ch##_##fmt(pa_mix_info streams[], unsigned nstreams, unsigned channels,      \
+                                   void *data, unsigned length) {                                    \
+    mix_fixed_##fmt(streams, 2, ch, data, length);                                                   \
+}                                                                                                    \
+static void pa_mix3_ch##ch##_##fmt(pa_mix_info streams[], unsigned nstreams, unsigned channels,      \
+                                   void *data, unsigned length) {                                    \
+    mix_fixed_##fmt(streams, 3, ch, data, length);                                                   \
+}                                                                                                    \
+static void pa_mix4_ch##ch##_##fmt(pa_mix_info streams[], unsigned nstreams, unsigned channels,      \
+                                   void *data, unsigned length) {                                    \
+    mix_fixed_##fmt(streams, 4, ch, data, length);                                                   \
+}                                                                                                    \
+static void pa_mix_ch##ch##_##fmt(pa_mix_info streams[], unsigned nstreams, unsigned channels,       \
+                                  void *data, unsigned length) {                                     \
+    mix_fixed_n_##fmt(streams, nstreams, ch, data, length);                                          \
+}
 
-        sum = pa_mult_s16_volume(*ptr0++, streams[0].linear[1].i);
-        sum += pa_mult_s16_volume(*ptr1++, streams[1].linear[1].i);
+#define MIX_FIXED_TABLE_ROW(fmt, ch) \
+    { pa_mix2_ch##ch##_##fmt, pa_mix3_ch##ch##_##fmt, pa_mix4_ch##ch##_##fmt, pa_mix_ch##ch##_##fmt }
+
+#define DEFINE_MIX_FIXED_TABLE(fmt)                                                                  \
+DEFINE_MIX_FIXED_FUNCS(fmt, 1)                                                                       \
+DEFINE_MIX_FIXED_FUNCS(fmt, 2)                                                                       \
+DEFINE_MIX_FIXED_FUNCS(fmt, 4)                                                                       \
+DEFINE_MIX_FIXED_FUNCS(fmt, 6)                                                                       \
+DEFINE_MIX_FIXED_FUNCS(fmt, 8)                                                                       \
+static const pa_do_mix_func_t mix_fixed_##fmt##_table[][MIX_FIXED_STREAMS_MAX] = {                   \
+    MIX_FIXED_TABLE_ROW(fmt, 1),                                                                     \
+    MIX_FIXED_TABLE_ROW(fmt, 2),                                                                     \
+    MIX_FIXED_TABLE_ROW(fmt, 4),                                                                     \
+    MIX_FIXED_TABLE_ROW(fmt, 6),                                                                     \
+    MIX_FIXED_TABLE_ROW(fmt, 8),                                                                     \
+};
 
-        sum = PA_CLAMP_UNLIKELY(sum, -0x8000, 0x7FFF);
-        *data++ = sum;
+#define MIX_MULT_S16NE(v, cv) pa_mult_s16_volume((v), (cv))
+#define MIX_STORE_S16NE(sum) ((int16_t) PA_CLAMP_UNLIKELY((sum), -0x8000, 0x7FFF))
+#define MIX_MULT_S32NE(v, cv) (((int64_t) (v) * (cv)) >> 16)
+#define MIX_STORE_S32NE(sum) ((int32_t) PA_CLAMP_UNLIKELY((sum), -0x80000000LL, 0x7FFFFFFFLL))
+/* Muted streams are skipped like in the generic code, so that infinite or
+ * NaN samples don't show up in the result */
+#define MIX_MULT_FLOAT32NE(v, cv) ((cv) > 0 ? (v) * (cv) : 0.0f)
+#define MIX_STORE_FLOAT32NE(sum) (sum)
+
+DEFINE_MIX_FIXED(s16ne, int16_t, int32_t, int32_t, i, MIX_MULT_S16NE, MIX_STORE_S16NE)
+DEFINE_MIX_FIXED(s32ne, int32_t, int64_t, int32_t, i, MIX_MULT_S32NE, MIX_STORE_S32NE)
+DEFINE_MIX_FIXED(float32ne, float, float, float, f, MIX_MULT_FLOAT32NE, MIX_STORE_FLOAT32NE)
+
+DEFINE_MIX_FIXED_TABLE(s16ne)
+DEFINE_MIX_FIXED_TABLE(s32ne)
+DEFINE_MIX_FIXED_TABLE(float32ne)
+
+/* Returns the specialized mixer for the given stream and channel count,
+ * or NULL if there is none */
+static pa_do_mix_func_t get_fixed_mix_func(const pa_do_mix_func_t table[][MIX_FIXED_STREAMS_MAX], unsigned nstreams, unsigned channels) {
+    unsigned row;
+
+    if (nstreams < 2)
+        return NULL;
+
+    switch (channels) {
+        case 1: row = 0; break;
+        case 2: row = 1; break;
+        case 4: row = 2; break;
+        case 6: row = 3; break;
+        case 8: row = 4; break;
+        default:
+            return NULL;
     }
+
+    return table[row][PA_MIN(nstreams, MIX_FIXED_STREAMS_MAX + 1) - 2];
 }
 
 /* special case: mix 2 s16ne streams */
@@ -188,32 +298,6 @@ static void pa_mix2_s16ne(pa_mix_info streams[], unsigned channels, int16_t *dat
     }
 }
 
-/* special case: mix s16ne streams, 2 channels each */
-static void pa_mix_ch2_s16ne(pa_mix_info streams[], unsigned nstreams, int16_t *data, unsigned length) {
-
-    length /= sizeof(int16_t) * 2;
-
-    for (; length > 0; length--) {
-        int32_t sum0 = 0, sum1 = 0;
-        unsigned i;
-
-        for (i = 0; i < nstreams; i++) {
-            pa_mix_info *m = streams + i;
-            int32_t cv0 = m->linear[0].i;
-            int32_t cv1 = m->linear[1].i;
-
-            sum0 += pa_mult_s16_volume(*((int16_t*) m->ptr), cv0);
-            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
-
-            sum1 += pa_mult_s16_volume(*((int16_t*) m->ptr), cv1);
-            m->ptr = (uint8_t*) m->ptr + sizeof(int16_t);
-        }
-
-        *data++ = PA_CLAMP_UNLIKELY(sum0, -0x8000, 0x7FFF);
-        *data++ = PA_CLAMP_UNLIKELY(sum1, -0x8000, 0x7FFF);
-    }
-}
-
 static void pa_mix_generic_s16ne(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
     unsigned channel = 0;
 
@@ -241,14 +325,12 @@ static void pa_mix_generic_s16ne(pa_mix_info streams[], unsigned nstreams, unsig
 }
 
 static void pa_mix_s16ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, int16_t *data, unsigned length) {
-    if (nstreams == 2 && channels == 1)
-        pa_mix2_ch1_s16ne(streams, data, length);
-    else if (nstreams == 2 && channels == 2)
-        pa_mix2_ch2_s16ne(streams, data, length);
+    pa_do_mix_func_t func;
+
+    if ((func = get_fixed_mix_func(mix_fixed_s16ne_table, nstreams, channels)))
+        func(streams, nstreams, channels, data, length);
     else if (nstreams == 2)
         pa_mix2_s16ne(streams, channels, data, length);
-    else if (channels == 2)
-        pa_mix_ch2_s16ne(streams, nstreams, data, length);
     else
         pa_mix_generic_s16ne(streams, nstreams, channels, data, length);
 }
@@ -279,7 +361,7 @@ static void pa_mix_s16re_c(pa_mix_info streams[], unsigned nstreams, unsigned ch
     }
 }
 
-static void pa_mix_s32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+static void pa_mix_generic_s32ne(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
     unsigned channel = 0;
 
     length /= sizeof(int32_t);
@@ -309,6 +391,15 @@ static void pa_mix_s32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned ch
     }
 }
 
+static void pa_mix_s32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
+    pa_do_mix_func_t func;
+
+    if ((func = get_fixed_mix_func(mix_fixed_s32ne_table, nstreams, channels)))
+        func(streams, nstreams, channels, data, length);
+    else
+        pa_mix_generic_s32ne(streams, nstreams, channels, data, length);
+}
+
 static void pa_mix_s32re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, int32_t *data, unsigned length) {
     unsigned channel = 0;
 
@@ -536,7 +627,7 @@ static void pa_mix_alaw_c(pa_mix_info streams[], unsigned nstreams, unsigned cha
     }
 }
 
-static void pa_mix_float32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+static void pa_mix_generic_float32ne(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
     unsigned channel = 0;
 
     length /= sizeof(float);
@@ -564,6 +655,15 @@ static void pa_mix_float32ne_c(pa_mix_info streams[], unsigned nstreams, unsigne
     }
 }
 
+static void pa_mix_float32ne_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
+    pa_do_mix_func_t func;
+
+    if ((func = get_fixed_mix_func(mix_fixed_float32ne_table, nstreams, channels)))
+        func(streams, nstreams, channels, data, length);
+    else
+        pa_mix_generic_float32ne(streams, nstreams, channels, data, length);
+}
+
 static void pa_mix_float32re_c(pa_mix_info streams[], unsigned nstreams, unsigned channels, float *data, unsigned length) {
     unsigned channel = 0;
 
@@ -606,10 +706,15 @@ static pa_do_mix_func_t do_mix_table[] = {
 };
 
 void pa_mix_func_init(const pa_cpu_info *cpu_info) {
-    if (cpu_info->force_generic_code)
+    if (cpu_info->force_generic_code) {
         do_mix_table[PA_SAMPLE_S16NE] = (pa_do_mix_func_t) pa_mix_generic_s16ne;
-    else
+        do_mix_table[PA_SAMPLE_S32NE] = (pa_do_mix_func_t) pa_mix_generic_s32ne;
+        do_mix_table[PA_SAMPLE_FLOAT32NE] = (pa_do_mix_func_t) pa_mix_generic_float32ne;
+    } else {
         do_mix_table[PA_SAMPLE_S16NE] = (pa_do_mix_func_t) pa_mix_s16ne_c;
+        do_mix_table[PA_SAMPLE_S32NE] = (pa_do_mix_func_t) pa_mix_s32ne_c;
+        do_mix_table[PA_SAMPLE_FLOAT32NE] = (pa_do_mix_func_t) pa_mix_float32ne_c;
+    }
 }
 
 size_t pa_mix(
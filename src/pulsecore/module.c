@@ -106,10 +106,15 @@ bool pa_module_exists(const char *name) {
 }
 
 void pa_module_hook_connect(pa_module *m, pa_hook *hook, pa_hook_priority_t prio, pa_hook_cb_t cb, void *data) {
+    pa_hook_slot *slot;
+
     pa_assert(m);
     pa_assert(hook);
     pa_assert(m->hooks);
-    pa_dynarray_append(m->hooks, pa_hook_connect(hook, prio, cb, data));
+
+    slot = pa_hook_connect(hook, prio, cb, data);
+    slot->module = m;
+    pa_dynarray_append(m->hooks, slot);
 }
 
 int pa_module_load(pa_module** module, pa_core *c, const char *name, const char *argument) {
@@ -119,11 +124,15 @@ int pa_module_load(pa_module** module, pa_core *c, const char *name, const char
     const char* (*get_deprecated)(void);
     pa_modinfo *mi;
     int errcode, rval;
+    unsigned span, init_span;
+    pa_module *connecting;
 
     pa_assert(module);
     pa_assert(c);
     pa_assert(name);
 
+    span = pa_startup_trace_begin("module", name, argument);
+
     if (c->disallow_module_loading) {
         errcode = -PA_ERR_ACCESS;
         goto fail;
@@ -205,7 +214,14 @@ int pa_module_load(pa_module** module, pa_core *c, const char *name, const char
     pa_assert_se(pa_idxset_put(c->modules, m, &m->index) >= 0);
     pa_assert(m->index != PA_IDXSET_INVALID);
 
-    if ((rval = m->init(m)) < 0) {
+    /* Hooks the module connects while initializing are attributed to it */
+    init_span = pa_startup_trace_begin("init", name, NULL);
+    connecting = pa_hook_set_connecting_module(m);
+    rval = m->init(m);
+    pa_hook_set_connecting_module(connecting);
+    pa_startup_trace_end(init_span);
+
+    if (rval < 0) {
         if (rval == -PA_MODULE_ERR_SKIP) {
             errcode = -PA_ERR_NOENTITY;
             goto fail;
@@ -237,6 +253,8 @@ int pa_module_load(pa_module** module, pa_core *c, const char *name, const char
 
     *module = m;
 
+    pa_startup_trace_end(span);
+
     return 0;
 
 fail:
@@ -262,6 +280,8 @@ fail:
 
     *module = NULL;
 
+    pa_startup_trace_end(span);
+
     return errcode;
 }
 
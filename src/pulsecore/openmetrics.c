@@ -0,0 +1,285 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <pulse/proplist.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/client.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/cycle-stats.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/source.h>
+#include <pulsecore/strbuf.h>
+
+#include "openmetrics.h"
+
+#define PREFIX "pulseaudio_"
+
+/* What is sampled from a sink or source, so that each metric family can be
+ * written in one piece */
+typedef struct device_sample {
+    const char *name;
+    pa_usec_t latency;
+    pa_cycle_stats stats;
+    unsigned n_xruns;
+    unsigned n_rewinds;
+} device_sample;
+
+static void family(pa_strbuf *sb, const char *name, const char *type, const char *help) {
+    pa_strbuf_printf(sb, "# TYPE " PREFIX "%s %s\n", name, type);
+    pa_strbuf_printf(sb, "# HELP " PREFIX "%s %s\n", name, help);
+}
+
+/* Label values escape backslashes, double quotes and line feeds */
+static void label_value(pa_strbuf *sb, const char *v) {
+    const char *p;
+
+    for (p = v; *p; p++) {
+        if (*p == '\\')
+            pa_strbuf_puts(sb, "\\\\");
+        else if (*p == '"')
+            pa_strbuf_puts(sb, "\\\"");
+        else if (*p == '\n')
+            pa_strbuf_puts(sb, "\\n");
+        else
+            pa_strbuf_putc(sb, *p);
+    }
+}
+
+static void sample_begin(pa_strbuf *sb, const char *name, const char *label, const char *value) {
+    pa_strbuf_printf(sb, PREFIX "%s", name);
+
+    if (label) {
+        pa_strbuf_printf(sb, "{%s=\"", label);
+        label_value(sb, value);
+        pa_strbuf_puts(sb, "\"}");
+    }
+}
+
+static void sample_uint(pa_strbuf *sb, const char *name, const char *label, const char *value, uint64_t v) {
+    sample_begin(sb, name, label, value);
+    pa_strbuf_printf(sb, " %llu\n", (unsigned long long) v);
+}
+
+static void sample_seconds(pa_strbuf *sb, const char *name, const char *label, const char *value, pa_usec_t usec) {
+    sample_begin(sb, name, label, value);
+    pa_strbuf_printf(sb, " %llu.%06llu\n",
+                     (unsigned long long) (usec / PA_USEC_PER_SEC),
+                     (unsigned long long) (usec % PA_USEC_PER_SEC));
+}
+
+static void mempool_metrics(pa_strbuf *sb, pa_mempool *pool) {
+    const pa_mempool_stat *stat;
+
+    stat = pa_mempool_get_stat(pool);
+
+    family(sb, "mempool_blocks", "gauge", "Memory blocks currently in use.");
+    sample_uint(sb, "mempool_blocks", "state", "allocated", (unsigned) pa_atomic_load(&stat->n_allocated));
+    sample_uint(sb, "mempool_blocks", "state", "imported", (unsigned) pa_atomic_load(&stat->n_imported));
+    sample_uint(sb, "mempool_blocks", "state", "exported", (unsigned) pa_atomic_load(&stat->n_exported));
+
+    family(sb, "mempool_bytes", "gauge", "Size of the memory blocks currently in use.");
+    sample_uint(sb, "mempool_bytes", "state", "allocated", (unsigned) pa_atomic_load(&stat->allocated_size));
+    sample_uint(sb, "mempool_bytes", "state", "imported", (unsigned) pa_atomic_load(&stat->imported_size));
+    sample_uint(sb, "mempool_bytes", "state", "exported", (unsigned) pa_atomic_load(&stat->exported_size));
+
+    family(sb, "mempool_allocations", "counter", "Memory blocks allocated.");
+    sample_uint(sb, "mempool_allocations_total", NULL, NULL, (unsigned) pa_atomic_load(&stat->n_accumulated));
+
+    family(sb, "mempool_allocated_bytes", "counter", "Size of the memory blocks allocated.");
+    sample_uint(sb, "mempool_allocated_bytes_total", NULL, NULL, (unsigned) pa_atomic_load(&stat->accumulated_size));
+
+    family(sb, "mempool_pool_full", "counter", "Allocations that found the pool full.");
+    sample_uint(sb, "mempool_pool_full_total", NULL, NULL, (unsigned) pa_atomic_load(&stat->n_pool_full));
+
+    family(sb, "mempool_too_large", "counter", "Allocations too large for a pool slot.");
+    sample_uint(sb, "mempool_too_large_total", NULL, NULL, (unsigned) pa_atomic_load(&stat->n_too_large_for_pool));
+}
+
+/* kind is "sink" or "source", render names what the IO thread does with
+ * the audio */
+static void device_metrics(pa_strbuf *sb, const char *kind, const char *render, const char *xrun,
+                           const device_sample *samples, unsigned n) {
+    char name[64], help[128];
+    unsigned i;
+
+    pa_snprintf(name, sizeof(name), "%s_latency_seconds", kind);
+    family(sb, name, "gauge", "Latency reported by the device.");
+    for (i = 0; i < n; i++)
+        sample_seconds(sb, name, kind, samples[i].name, samples[i].latency);
+
+    pa_snprintf(name, sizeof(name), "%s_%s_seconds", kind, render);
+    pa_snprintf(help, sizeof(help), "Time the IO thread spent in pa_%s_%s().", kind, render);
+    family(sb, name, "counter", help);
+    pa_snprintf(name, sizeof(name), "%s_%s_seconds_total", kind, render);
+    for (i = 0; i < n; i++)
+        sample_seconds(sb, name, kind, samples[i].name, samples[i].stats.render.total);
+
+    pa_snprintf(name, sizeof(name), "%s_%s_calls", kind, render);
+    pa_snprintf(help, sizeof(help), "Calls of pa_%s_%s().", kind, render);
+    family(sb, name, "counter", help);
+    pa_snprintf(name, sizeof(name), "%s_%s_calls_total", kind, render);
+    for (i = 0; i < n; i++)
+        sample_uint(sb, name, kind, samples[i].name, samples[i].stats.render.n);
+
+    pa_snprintf(name, sizeof(name), "%s_%ss", kind, xrun);
+    pa_snprintf(help, sizeof(help), "Device %ss the driver noticed. Only ALSA devices count them, others stay at 0.", xrun);
+    family(sb, name, "counter", help);
+    pa_snprintf(name, sizeof(name), "%s_%ss_total", kind, xrun);
+    for (i = 0; i < n; i++)
+        sample_uint(sb, name, kind, samples[i].name, samples[i].n_xruns);
+
+    if (pa_streq(kind, "sink")) {
+        family(sb, "sink_rewinds", "counter", "Rewinds of the sink.");
+        for (i = 0; i < n; i++)
+            sample_uint(sb, "sink_rewinds_total", kind, samples[i].name, samples[i].n_rewinds);
+
+        family(sb, "sink_rewound_bytes", "counter", "Audio given back by rewinds of the sink.");
+        for (i = 0; i < n; i++)
+            sample_uint(sb, "sink_rewound_bytes_total", kind, samples[i].name, samples[i].stats.rewound_bytes);
+
+        family(sb, "sink_rerendered_bytes", "counter", "Audio rendered again after rewinds of the sink.");
+        for (i = 0; i < n; i++)
+            sample_uint(sb, "sink_rerendered_bytes_total", kind, samples[i].name, samples[i].stats.rerendered_bytes);
+
+        family(sb, "sink_rewinds_limited", "counter", "Rewind requests shortened to rewind-limit-msec.");
+        for (i = 0; i < n; i++)
+            sample_uint(sb, "sink_rewinds_limited_total", kind, samples[i].name, samples[i].stats.n_rewinds_limited);
+
+        family(sb, "sink_rewinds_skipped", "counter", "Volume changes applied without a rewind.");
+        for (i = 0; i < n; i++)
+            sample_uint(sb, "sink_rewinds_skipped_total", kind, samples[i].name, samples[i].stats.n_rewinds_skipped);
+    }
+
+    /* The resamplers go away with their streams, so these can decrease */
+    pa_snprintf(name, sizeof(name), "%s_resampler_seconds", kind);
+    family(sb, name, "gauge", "Time the resamplers of the connected streams spent resampling.");
+    for (i = 0; i < n; i++)
+        sample_seconds(sb, name, kind, samples[i].name, samples[i].stats.resampler_usec);
+
+    pa_snprintf(name, sizeof(name), "%s_resampler_runs", kind);
+    family(sb, name, "gauge", "Runs of the resamplers of the connected streams.");
+    for (i = 0; i < n; i++)
+        sample_uint(sb, name, kind, samples[i].name, samples[i].stats.n_resampler_runs);
+}
+
+static void sink_metrics(pa_strbuf *sb, pa_core *c) {
+    device_sample *samples;
+    pa_sink *sink;
+    uint32_t idx;
+    unsigned n = 0;
+
+    samples = pa_xnew0(device_sample, pa_idxset_size(c->sinks) + 1);
+
+    PA_IDXSET_FOREACH(sink, c->sinks, idx) {
+        device_sample *s;
+
+        if (!PA_SINK_IS_LINKED(sink->state))
+            continue;
+
+        s = &samples[n++];
+        s->name = sink->name;
+        s->latency = pa_sink_get_latency(sink);
+        pa_sink_get_cycle_stats(sink, &s->stats);
+        s->n_xruns = (unsigned) pa_atomic_load(&sink->n_underruns);
+        s->n_rewinds = (unsigned) pa_atomic_load(&sink->n_rewinds);
+    }
+
+    device_metrics(sb, "sink", "render", "underrun", samples, n);
+    pa_xfree(samples);
+}
+
+static void source_metrics(pa_strbuf *sb, pa_core *c) {
+    device_sample *samples;
+    pa_source *source;
+    uint32_t idx;
+    unsigned n = 0;
+
+    samples = pa_xnew0(device_sample, pa_idxset_size(c->sources) + 1);
+
+    PA_IDXSET_FOREACH(source, c->sources, idx) {
+        device_sample *s;
+
+        if (!PA_SOURCE_IS_LINKED(source->state))
+            continue;
+
+        s = &samples[n++];
+        s->name = source->name;
+        s->latency = pa_source_get_latency(source);
+        pa_source_get_cycle_stats(source, &s->stats);
+        s->n_xruns = (unsigned) pa_atomic_load(&source->n_overruns);
+    }
+
+    device_metrics(sb, "source", "post", "overrun", samples, n);
+    pa_xfree(samples);
+}
+
+static void client_label(pa_strbuf *sb, pa_client *client) {
+    const char *app;
+
+    pa_strbuf_printf(sb, "{client=\"%u\",application=\"", client->index);
+    if ((app = pa_proplist_gets(client->proplist, PA_PROP_APPLICATION_NAME)))
+        label_value(sb, app);
+    pa_strbuf_puts(sb, "\"}");
+}
+
+static void client_metrics(pa_strbuf *sb, pa_core *c) {
+    pa_client *client;
+    uint32_t idx;
+
+    family(sb, "clients", "gauge", "Connected clients.");
+    sample_uint(sb, "clients", NULL, NULL, pa_idxset_size(c->clients));
+
+    family(sb, "client_received_bytes", "counter", "Stream data received from the client.");
+    PA_IDXSET_FOREACH(client, c->clients, idx) {
+        pa_strbuf_puts(sb, PREFIX "client_received_bytes_total");
+        client_label(sb, client);
+        pa_strbuf_printf(sb, " %llu\n", (unsigned long long) client->bytes_received);
+    }
+
+    family(sb, "client_sent_bytes", "counter", "Stream data sent to the client.");
+    PA_IDXSET_FOREACH(client, c->clients, idx) {
+        pa_strbuf_puts(sb, PREFIX "client_sent_bytes_total");
+        client_label(sb, client);
+        pa_strbuf_printf(sb, " %llu\n", (unsigned long long) client->bytes_sent);
+    }
+}
+
+/* Called from main context */
+char *pa_openmetrics_to_string(pa_core *c) {
+    pa_strbuf *sb;
+
+    pa_core_assert_ref(c);
+
+    sb = pa_strbuf_new();
+
+    mempool_metrics(sb, c->mempool);
+    sink_metrics(sb, c);
+    source_metrics(sb, c);
+    client_metrics(sb, c);
+
+    pa_strbuf_puts(sb, "# EOF\n");
+
+    return pa_strbuf_to_string_free(sb);
+}
@@ -0,0 +1,29 @@
+#ifndef fooopenmetricshfoo
+#define fooopenmetricshfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulsecore/core.h>
+
+#define PA_OPENMETRICS_MIME_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/* Returns the memory pool, sink, source and client statistics of the core in
+ * the OpenMetrics text format */
+char *pa_openmetrics_to_string(pa_core *c);
+
+#endif
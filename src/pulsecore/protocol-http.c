@@ -40,6 +40,7 @@
 #include <pulsecore/shared.h>
 #include <pulsecore/core-error.h>
 #include <pulsecore/mime-type.h>
+#include <pulsecore/openmetrics.h>
 
 #include "protocol-http.h"
 
@@ -51,6 +52,7 @@
 #define URL_STATUS "/status"
 #define URL_LISTEN "/listen"
 #define URL_LISTEN_SOURCE "/listen/source/"
+#define URL_METRICS "/metrics"
 
 #define MIME_HTML "text/html; charset=utf-8"
 #define MIME_TEXT "text/plain; charset=utf-8"
@@ -407,6 +409,7 @@ static void handle_root(struct connection *c) {
                    "</table>\n"
                    "<p><a href=\"" URL_STATUS "\">Show an extensive server status report</a></p>\n"
                    "<p><a href=\"" URL_LISTEN "\">Monitor sinks and sources</a></p>\n"
+                   "<p><a href=\"" URL_METRICS "\">Show the server metrics in the OpenMetrics format</a></p>\n"
                    HTML_FOOTER);
 
     pa_ioline_defer_close(c->line);
@@ -453,6 +456,25 @@ static void handle_status(struct connection *c) {
     pa_ioline_defer_close(c->line);
 }
 
+static void handle_metrics(struct connection *c) {
+    char *r;
+
+    pa_assert(c);
+
+    http_response(c, 200, "OK", PA_OPENMETRICS_MIME_TYPE);
+
+    if (c->method == METHOD_HEAD) {
+        pa_ioline_defer_close(c->line);
+        return;
+    }
+
+    r = pa_openmetrics_to_string(c->protocol->core);
+    pa_ioline_puts(c->line, r);
+    pa_xfree(r);
+
+    pa_ioline_defer_close(c->line);
+}
+
 static void handle_listen(struct connection *c) {
     pa_source *source;
     pa_sink *sink;
@@ -621,6 +643,8 @@ static void handle_url(struct connection *c) {
         handle_css(c);
     else if (pa_streq(c->url, URL_STATUS))
         handle_status(c);
+    else if (pa_streq(c->url, URL_METRICS))
+        handle_metrics(c);
     else if (pa_streq(c->url, URL_LISTEN))
         handle_listen(c);
     else if (pa_startswith(c->url, URL_LISTEN_SOURCE))
@@ -1261,6 +1261,7 @@ static void native_connection_send_memblock(pa_native_connection *c) {
                 schunk.length = r->buffer_attr.fragsize;
 
             pa_pstream_send_memblock(c->pstream, r->index, 0, PA_SEEK_RELATIVE, &schunk, pa_memblockq_get_base(r->memblockq));
+            c->client->bytes_sent += schunk.length;
 
             pa_memblockq_drop(r->memblockq, schunk.length);
             pa_memblock_unref(schunk.memblock);
@@ -5074,6 +5075,8 @@ static void pstream_memblock_callback(pa_pstream *p, uint32_t channel, int64_t o
     pa_log("got %lu bytes from client", (unsigned long) chunk->length);
 #endif
 
+    c->client->bytes_received += chunk->length;
+
     if (playback_stream_isinstance(stream)) {
         playback_stream *ps = PLAYBACK_STREAM(stream);
 
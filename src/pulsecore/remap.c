@@ -348,6 +348,48 @@ static void remap_channels_matrix_float32ne_c(pa_remap_t *m, float *dst, const f
     }
 }
 
+/* Produce the column-wise sparse form of the remap matrix. Coefficients are
+ * clamped the same way the generic matrix code interprets them: negative
+ * values are ignored and values above unity are treated as unity. */
+bool pa_setup_remap_sparse(const pa_remap_t *m, pa_remap_sparse_t *sparse) {
+    unsigned ic, oc;
+    unsigned n_ic, n_oc;
+
+    pa_assert(m);
+    pa_assert(sparse);
+
+    n_ic = m->i_ss.channels;
+    n_oc = m->o_ss.channels;
+
+    if (n_oc > PA_REMAP_SPARSE_MAX_CHANNELS)
+        return false;
+
+    memset(sparse, 0, sizeof(*sparse));
+
+    for (ic = 0; ic < n_ic; ic++) {
+        bool used = false;
+
+        for (oc = 0; oc < n_oc; oc++) {
+            if (m->map_table_i[oc][ic] > 0 || m->map_table_f[oc][ic] > 0.0f) {
+                used = true;
+                break;
+            }
+        }
+
+        /* input channel does not contribute to any output channel */
+        if (!used)
+            continue;
+
+        for (oc = 0; oc < n_oc; oc++) {
+            sparse->col_f[sparse->n_used][oc] = PA_CLAMP_UNLIKELY(m->map_table_f[oc][ic], 0.0f, 1.0f);
+            sparse->col_i[sparse->n_used][oc] = PA_CLAMP_UNLIKELY(m->map_table_i[oc][ic], 0, 0x10000);
+        }
+        sparse->ic[sparse->n_used++] = ic;
+    }
+
+    return true;
+}
+
 /* Produce an array containing input channel indices to map to output channels.
  * If the output channel is empty, the array element is -1. */
 bool pa_setup_remap_arrange(const pa_remap_t *m, int8_t arrange[PA_CHANNELS_MAX]) {
@@ -54,6 +54,25 @@ void pa_set_init_remap_func(pa_init_remap_func_t func);
  */
 bool pa_setup_remap_arrange(const pa_remap_t *m, int8_t arrange[PA_CHANNELS_MAX]);
 
+/* Maximum number of output channels handled by the sparse matrix remappers */
+#define PA_REMAP_SPARSE_MAX_CHANNELS 8
+
+/* Column-wise representation of the remap matrix for the sparse matrix
+ * remappers. Only input channels that contribute to at least one output
+ * channel are listed, so silent inputs are skipped entirely. For each listed
+ * input channel ic[k], col_f[k] and col_i[k] hold the (clamped) coefficients
+ * towards all output channels, zero-padded to PA_REMAP_SPARSE_MAX_CHANNELS. */
+typedef struct pa_remap_sparse {
+    unsigned n_used;
+    uint8_t ic[PA_CHANNELS_MAX];
+    float col_f[PA_CHANNELS_MAX][PA_REMAP_SPARSE_MAX_CHANNELS];
+    int32_t col_i[PA_CHANNELS_MAX][PA_REMAP_SPARSE_MAX_CHANNELS];
+} pa_remap_sparse_t;
+
+/* Fill in the sparse representation of the remap matrix. Returns false if the
+ * number of output channels exceeds PA_REMAP_SPARSE_MAX_CHANNELS. */
+bool pa_setup_remap_sparse(const pa_remap_t *m, pa_remap_sparse_t *sparse);
+
 void pa_set_remap_func(pa_remap_t *m, pa_do_remap_func_t func_s16,
     pa_do_remap_func_t func_s32, pa_do_remap_func_t func_float);
 
@@ -380,6 +380,136 @@ static void remap_arrange_ch4_float32ne_neon(pa_remap_t *m, float *dst, const fl
     }
 }
 
+/* Sparse matrix remapping for 6 and 8 output channels: each contributing input
+ * sample is broadcast and multiplied with its coefficient column, computing
+ * all output channels of a frame in parallel. */
+static inline void remap_sparse_float32ne_neon(pa_remap_t *m, float *dst, const float *src, unsigned n,
+                                               const unsigned n_oc) {
+    const pa_remap_sparse_t *sparse = m->state;
+    const unsigned n_ic = m->i_ss.channels;
+    const unsigned n_used = sparse->n_used;
+    float32x4_t col[PA_CHANNELS_MAX][2];
+    unsigned k;
+
+    for (k = 0; k < n_used; k++) {
+        col[k][0] = vld1q_f32(sparse->col_f[k]);
+        col[k][1] = vld1q_f32(sparse->col_f[k] + 4);
+    }
+
+    for (; n > 0; n--) {
+        float32x4_t acc0 = vdupq_n_f32(0.0f), acc1 = vdupq_n_f32(0.0f);
+
+        for (k = 0; k < n_used; k++) {
+            const float32x4_t s = vdupq_n_f32(src[sparse->ic[k]]);
+
+            acc0 = vmlaq_f32(acc0, s, col[k][0]);
+            acc1 = vmlaq_f32(acc1, s, col[k][1]);
+        }
+
+        vst1q_f32(dst, acc0);
+        if (n_oc == 8)
+            vst1q_f32(dst + 4, acc1);
+        else
+            vst1_f32(dst + 4, vget_low_f32(acc1));
+
+        src += n_ic;
+        dst += n_oc;
+    }
+}
+
+static inline void remap_sparse_s16ne_neon(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n,
+                                           const unsigned n_oc) {
+    const pa_remap_sparse_t *sparse = m->state;
+    const unsigned n_ic = m->i_ss.channels;
+    const unsigned n_used = sparse->n_used;
+    int32x4_t col[PA_CHANNELS_MAX][2];
+    unsigned k;
+
+    for (k = 0; k < n_used; k++) {
+        col[k][0] = vld1q_s32(sparse->col_i[k]);
+        col[k][1] = vld1q_s32(sparse->col_i[k] + 4);
+    }
+
+    for (; n > 0; n--) {
+        int32x4_t acc0 = vdupq_n_s32(0), acc1 = vdupq_n_s32(0);
+        int16x4_t out1;
+
+        for (k = 0; k < n_used; k++) {
+            const int32x4_t s = vdupq_n_s32(src[sparse->ic[k]]);
+
+            /* 16 bit samples times coefficients of at most 0x10000 fit 32 bits */
+            acc0 = vaddq_s32(acc0, vshrq_n_s32(vmulq_s32(s, col[k][0]), 16));
+            acc1 = vaddq_s32(acc1, vshrq_n_s32(vmulq_s32(s, col[k][1]), 16));
+        }
+
+        vst1_s16(dst, vmovn_s32(acc0));
+        out1 = vmovn_s32(acc1);
+        if (n_oc == 8)
+            vst1_s16(dst + 4, out1);
+        else {
+            vst1_lane_s16(dst + 4, out1, 0);
+            vst1_lane_s16(dst + 5, out1, 1);
+        }
+
+        src += n_ic;
+        dst += n_oc;
+    }
+}
+
+static inline void remap_sparse_s32ne_neon(pa_remap_t *m, int32_t *dst, const int32_t *src, unsigned n,
+                                           const unsigned n_oc) {
+    const pa_remap_sparse_t *sparse = m->state;
+    const unsigned n_ic = m->i_ss.channels;
+    const unsigned n_used = sparse->n_used;
+    int32x2_t col[PA_CHANNELS_MAX][4];
+    unsigned k, v;
+
+    for (k = 0; k < n_used; k++)
+        for (v = 0; v < 4; v++)
+            col[k][v] = vld1_s32(sparse->col_i[k] + 2 * v);
+
+    for (; n > 0; n--) {
+        int32x2_t acc[4] = { vdup_n_s32(0), vdup_n_s32(0), vdup_n_s32(0), vdup_n_s32(0) };
+
+        for (k = 0; k < n_used; k++) {
+            const int32x2_t s = vdup_n_s32(src[sparse->ic[k]]);
+
+            for (v = 0; v < n_oc / 2; v++)
+                acc[v] = vadd_s32(acc[v], vshrn_n_s64(vmull_s32(s, col[k][v]), 16));
+        }
+
+        for (v = 0; v < n_oc / 2; v++)
+            vst1_s32(dst + 2 * v, acc[v]);
+
+        src += n_ic;
+        dst += n_oc;
+    }
+}
+
+static void remap_sparse_ch6_s16ne_neon(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    remap_sparse_s16ne_neon(m, dst, src, n, 6);
+}
+
+static void remap_sparse_ch8_s16ne_neon(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    remap_sparse_s16ne_neon(m, dst, src, n, 8);
+}
+
+static void remap_sparse_ch6_s32ne_neon(pa_remap_t *m, int32_t *dst, const int32_t *src, unsigned n) {
+    remap_sparse_s32ne_neon(m, dst, src, n, 6);
+}
+
+static void remap_sparse_ch8_s32ne_neon(pa_remap_t *m, int32_t *dst, const int32_t *src, unsigned n) {
+    remap_sparse_s32ne_neon(m, dst, src, n, 8);
+}
+
+static void remap_sparse_ch6_float32ne_neon(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    remap_sparse_float32ne_neon(m, dst, src, n, 6);
+}
+
+static void remap_sparse_ch8_float32ne_neon(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    remap_sparse_float32ne_neon(m, dst, src, n, 8);
+}
+
 static pa_cpu_arm_flag_t arm_flags;
 
 static void init_remap_neon(pa_remap_t *m) {
@@ -535,6 +665,21 @@ static void init_remap_neon(pa_remap_t *m) {
         default:
             pa_assert_not_reached();
         }
+    } else if ((n_oc == 6 || n_oc == 8) && !pa_setup_remap_arrange(m, arrange)) {
+
+        pa_log_info("Using ARM NEON sparse %u-channel matrix remapping", n_oc);
+        if (n_oc == 6)
+            pa_set_remap_func(m, (pa_do_remap_func_t) remap_sparse_ch6_s16ne_neon,
+                (pa_do_remap_func_t) remap_sparse_ch6_s32ne_neon,
+                (pa_do_remap_func_t) remap_sparse_ch6_float32ne_neon);
+        else
+            pa_set_remap_func(m, (pa_do_remap_func_t) remap_sparse_ch8_s16ne_neon,
+                (pa_do_remap_func_t) remap_sparse_ch8_s32ne_neon,
+                (pa_do_remap_func_t) remap_sparse_ch8_float32ne_neon);
+
+        /* setup state */
+        m->state = pa_xnew(pa_remap_sparse_t, 1);
+        pa_assert_se(pa_setup_remap_sparse(m, m->state));
     }
 }
 
@@ -24,12 +24,17 @@
 
 #include <pulse/sample.h>
 #include <pulse/volume.h>
+#include <pulse/xmalloc.h>
 #include <pulsecore/log.h>
 #include <pulsecore/macro.h>
 
 #include "cpu-x86.h"
 #include "remap.h"
 
+#if defined (__i386__) || defined (__amd64__)
+#include <emmintrin.h>
+#endif
+
 #define LOAD_SAMPLES                                   \
                 " movdqu (%1), %%xmm0           \n\t"  \
                 " movdqu 16(%1), %%xmm2         \n\t"  \
@@ -122,9 +127,127 @@ static void remap_mono_to_stereo_any32ne_sse2(pa_remap_t *m, float *dst, const f
     );
 }
 
+#ifdef __SSE2__
+/* Sparse matrix remapping for 6 and 8 output channels: all output channels of
+ * a frame are computed in parallel SIMD lanes. Each contributing input sample
+ * is broadcast and multiplied with its coefficient column; input channels that
+ * do not contribute to any output are never touched. The summation order
+ * matches the generic matrix code. */
+static inline void remap_sparse_float32ne_sse(pa_remap_t *m, float *dst, const float *src, unsigned n,
+                                              const unsigned n_oc) {
+    const pa_remap_sparse_t *sparse = m->state;
+    const unsigned n_ic = m->i_ss.channels;
+    const unsigned n_used = sparse->n_used;
+    __m128 col[PA_CHANNELS_MAX][2];
+    unsigned k;
+
+    for (k = 0; k < n_used; k++) {
+        col[k][0] = _mm_loadu_ps(sparse->col_f[k]);
+        col[k][1] = _mm_loadu_ps(sparse->col_f[k] + 4);
+    }
+
+    for (; n > 0; n--) {
+        __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+
+        for (k = 0; k < n_used; k++) {
+            const __m128 s = _mm_set1_ps(src[sparse->ic[k]]);
+
+            acc0 = _mm_add_ps(acc0, _mm_mul_ps(s, col[k][0]));
+            acc1 = _mm_add_ps(acc1, _mm_mul_ps(s, col[k][1]));
+        }
+
+        switch (n_oc) {
+            case 6:
+                _mm_storeu_ps(dst, acc0);
+                _mm_storel_pi((__m64 *) (dst + 4), acc1);
+                break;
+            case 8:
+                _mm_storeu_ps(dst, acc0);
+                _mm_storeu_ps(dst + 4, acc1);
+                break;
+            default:
+                pa_assert_not_reached();
+        }
+
+        src += n_ic;
+        dst += n_oc;
+    }
+}
+
+static void remap_sparse_ch6_float32ne_sse(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    remap_sparse_float32ne_sse(m, dst, src, n, 6);
+}
+
+static void remap_sparse_ch8_float32ne_sse(pa_remap_t *m, float *dst, const float *src, unsigned n) {
+    remap_sparse_float32ne_sse(m, dst, src, n, 8);
+}
+
+/* The 16.16 fixed point coefficients (at most 0x10000) are split into their
+ * low 16 bits, multiplied with pmulhw, and a mask that adds the sample once
+ * more where the low part wrapped negative. This yields exactly
+ * (s * vol) >> 16 per term, like the generic code. */
+static inline void remap_sparse_s16ne_sse2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n,
+                                           const unsigned n_oc) {
+    const pa_remap_sparse_t *sparse = m->state;
+    const unsigned n_ic = m->i_ss.channels;
+    const unsigned n_used = sparse->n_used;
+    __m128i lo[PA_CHANNELS_MAX], hi[PA_CHANNELS_MAX];
+    unsigned k, oc;
+
+    for (k = 0; k < n_used; k++) {
+        PA_DECLARE_ALIGNED(16, int16_t, l[8]);
+        PA_DECLARE_ALIGNED(16, int16_t, h[8]);
+
+        for (oc = 0; oc < 8; oc++) {
+            l[oc] = (int16_t) (sparse->col_i[k][oc] & 0xffff);
+            h[oc] = sparse->col_i[k][oc] >= 0x8000 ? -1 : 0;
+        }
+        lo[k] = _mm_load_si128((const __m128i *) l);
+        hi[k] = _mm_load_si128((const __m128i *) h);
+    }
+
+    for (; n > 0; n--) {
+        __m128i acc = _mm_setzero_si128();
+
+        for (k = 0; k < n_used; k++) {
+            const __m128i s = _mm_set1_epi16(src[sparse->ic[k]]);
+
+            acc = _mm_add_epi16(acc, _mm_add_epi16(_mm_mulhi_epi16(s, lo[k]), _mm_and_si128(s, hi[k])));
+        }
+
+        switch (n_oc) {
+            case 6:
+                _mm_storel_epi64((__m128i *) dst, acc);
+                dst[4] = (int16_t) _mm_extract_epi16(acc, 4);
+                dst[5] = (int16_t) _mm_extract_epi16(acc, 5);
+                break;
+            case 8:
+                _mm_storeu_si128((__m128i *) dst, acc);
+                break;
+            default:
+                pa_assert_not_reached();
+        }
+
+        src += n_ic;
+        dst += n_oc;
+    }
+}
+
+static void remap_sparse_ch6_s16ne_sse2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    remap_sparse_s16ne_sse2(m, dst, src, n, 6);
+}
+
+static void remap_sparse_ch8_s16ne_sse2(pa_remap_t *m, int16_t *dst, const int16_t *src, unsigned n) {
+    remap_sparse_s16ne_sse2(m, dst, src, n, 8);
+}
+#endif /* __SSE2__ */
+
 /* set the function that will execute the remapping based on the matrices */
 static void init_remap_sse2(pa_remap_t *m) {
     unsigned n_oc, n_ic;
+#ifdef __SSE2__
+    int8_t arrange[PA_CHANNELS_MAX];
+#endif
 
     n_oc = m->o_ss.channels;
     n_ic = m->i_ss.channels;
@@ -137,6 +260,34 @@ static void init_remap_sse2(pa_remap_t *m) {
         pa_set_remap_func(m, (pa_do_remap_func_t) remap_mono_to_stereo_s16ne_sse2,
             (pa_do_remap_func_t) remap_mono_to_stereo_any32ne_sse2,
             (pa_do_remap_func_t) remap_mono_to_stereo_any32ne_sse2);
+#ifdef __SSE2__
+    } else if ((n_oc == 6 || n_oc == 8) && !pa_setup_remap_arrange(m, arrange)) {
+        pa_do_remap_func_t func_s16 = NULL, func_float = NULL;
+
+        /* S32NE would need 32x32->64 bit multiplies which SSE2 lacks; the
+         * generic code is used for it. */
+        if (m->format == PA_SAMPLE_S32NE)
+            return;
+
+        switch (n_oc) {
+            case 6:
+                func_s16 = (pa_do_remap_func_t) remap_sparse_ch6_s16ne_sse2;
+                func_float = (pa_do_remap_func_t) remap_sparse_ch6_float32ne_sse;
+                break;
+            case 8:
+                func_s16 = (pa_do_remap_func_t) remap_sparse_ch8_s16ne_sse2;
+                func_float = (pa_do_remap_func_t) remap_sparse_ch8_float32ne_sse;
+                break;
+        }
+
+        /* setup state */
+        m->state = pa_xnew(pa_remap_sparse_t, 1);
+        pa_assert_se(pa_setup_remap_sparse(m, m->state));
+
+        pa_log_info("Using SSE2 sparse %u-channel matrix remapping (%u of %u input channels used)",
+                    n_oc, ((pa_remap_sparse_t *) m->state)->n_used, n_ic);
+        pa_set_remap_func(m, func_s16, NULL, func_float);
+#endif /* __SSE2__ */
     }
 }
 #endif /* defined (__i386__) || defined (__amd64__) */
@@ -24,6 +24,7 @@
 #include <string.h>
 #include <math.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/xmalloc.h>
 #include <pulse/timeval.h>
 #include <pulsecore/log.h>
@@ -36,6 +37,16 @@
 /* Number of samples of extra space we allow the resamplers to return */
 #define EXTRA_FRAMES 128
 
+/* Number of state checkpoints kept for rewinds */
+#define N_CHECKPOINTS 256
+
+struct checkpoint {
+    int64_t index;
+    double in_frames;
+    double out_frames;
+    /* Followed by impl.state_size bytes of implementation state */
+};
+
 struct ffmpeg_data { /* data specific to ffmpeg */
     struct AVResampleContext *state;
 };
@@ -456,6 +467,10 @@ pa_resampler* pa_resampler_new(
     if (init_table[method](r) < 0)
         goto fail;
 
+    /* The copy resampler has no state, so it can always be checkpointed */
+    if (r->impl.save_state || !r->impl.resample)
+        r->checkpoint_size = PA_ALIGN(sizeof(struct checkpoint)) + PA_ALIGN(r->impl.state_size);
+
     return r;
 
 fail:
@@ -488,6 +503,7 @@ void pa_resampler_free(pa_resampler *r) {
 
     free_remap(&r->remap);
 
+    pa_xfree(r->checkpoints);
     pa_xfree(r);
 }
 
@@ -505,6 +521,7 @@ void pa_resampler_set_input_rate(pa_resampler *r, uint32_t rate) {
 
     r->i_ss.rate = rate;
     calculate_gcd(r);
+    pa_resampler_drop_checkpoints(r);
 
     r->impl.update_rates(r);
 }
@@ -523,6 +540,7 @@ void pa_resampler_set_output_rate(pa_resampler *r, uint32_t rate) {
 
     r->o_ss.rate = rate;
     calculate_gcd(r);
+    pa_resampler_drop_checkpoints(r);
 
     r->impl.update_rates(r);
 
@@ -662,6 +680,87 @@ void pa_resampler_reset(pa_resampler *r) {
 
     r->in_frames = 0;
     r->out_frames = 0;
+    pa_resampler_drop_checkpoints(r);
+}
+
+void pa_resampler_drop_checkpoints(pa_resampler *r) {
+    pa_assert(r);
+
+    r->n_checkpoints = 0;
+}
+
+/* Returns the n-th newest checkpoint */
+static struct checkpoint *get_checkpoint(pa_resampler *r, unsigned n) {
+    unsigned idx;
+
+    pa_assert(n < r->n_checkpoints);
+
+    idx = (r->checkpoint_idx + N_CHECKPOINTS - n) % N_CHECKPOINTS;
+    return (struct checkpoint *) (r->checkpoints + idx * r->checkpoint_size);
+}
+
+static void *checkpoint_state(struct checkpoint *c) {
+    return (uint8_t *) c + PA_ALIGN(sizeof(struct checkpoint));
+}
+
+void pa_resampler_save_checkpoint(pa_resampler *r, int64_t index) {
+    struct checkpoint *c;
+    int64_t interval;
+
+    pa_assert(r);
+
+    /* Leftover data is not part of the checkpoint, so skip those */
+    if (r->checkpoint_size == 0 || *r->have_leftover)
+        return;
+
+    /* Take a checkpoint every 2 ms of input data, which is the minimum
+     * amount of history that is replayed on a rewind. */
+    interval = (int64_t) PA_MAX(r->i_ss.rate / 500, 1U) * r->i_fz;
+
+    if (r->n_checkpoints > 0) {
+        c = get_checkpoint(r, 0);
+
+        /* Flushes of the history queue drop the checkpoints, but stay on
+         * the safe side if the index went backwards anyway */
+        if (index < c->index)
+            pa_resampler_drop_checkpoints(r);
+        else if (index - c->index < interval)
+            return;
+    }
+
+    if (!r->checkpoints)
+        r->checkpoints = pa_xmalloc(N_CHECKPOINTS * r->checkpoint_size);
+
+    r->checkpoint_idx = (r->checkpoint_idx + 1) % N_CHECKPOINTS;
+    if (r->n_checkpoints < N_CHECKPOINTS)
+        r->n_checkpoints++;
+
+    c = get_checkpoint(r, 0);
+    c->index = index;
+    c->in_frames = r->in_frames;
+    c->out_frames = r->out_frames;
+
+    if (r->impl.save_state)
+        r->impl.save_state(r, checkpoint_state(c));
+}
+
+/* Drops all checkpoints taken after index, because the data following index
+ * will be rewritten. Returns the newest remaining checkpoint if it is not
+ * more than max_distance bytes before index. */
+static struct checkpoint *find_checkpoint(pa_resampler *r, int64_t index, size_t max_distance) {
+    struct checkpoint *c;
+
+    while (r->n_checkpoints > 0) {
+        c = get_checkpoint(r, 0);
+
+        if (c->index <= index)
+            return index - c->index <= (int64_t) max_distance ? c : NULL;
+
+        r->checkpoint_idx = (r->checkpoint_idx + N_CHECKPOINTS - 1) % N_CHECKPOINTS;
+        r->n_checkpoints--;
+    }
+
+    return NULL;
 }
 
 /* This function runs amount bytes of data from the history queue through the
@@ -723,8 +822,8 @@ size_t pa_resampler_prepare(pa_resampler *r, pa_memblockq *history_queue, size_t
 size_t pa_resampler_rewind(pa_resampler *r, size_t out_bytes, pa_memblockq *history_queue, size_t amount) {
     pa_assert(r);
 
-    /* For now, we don't have any rewindable resamplers, so we just reset
-     * the resampler if we cannot rewind using pa_resampler_prepare(). */
+    /* The resampler state is restored from a checkpoint or rebuilt by
+     * running history data through it. Without history, we just reset. */
     if (r->impl.reset && !history_queue)
         r->impl.reset(r);
 
@@ -736,10 +835,39 @@ size_t pa_resampler_rewind(pa_resampler *r, size_t out_bytes, pa_memblockq *hist
 
         r->in_frames = 0;
         r->out_frames = 0;
+        pa_resampler_drop_checkpoints(r);
+        return 0;
+    }
+
+    if (amount > 0) {
+        struct checkpoint *c;
+        int64_t index;
+        size_t replay, out_size;
+
+        index = pa_memblockq_get_read_index(history_queue);
+
+        if (!(c = find_checkpoint(r, index, amount)))
+            return pa_resampler_prepare(r, history_queue, amount);
+
+        /* Restore the state at the checkpoint and only replay the history
+         * that follows it. The result is corrected so that it matches the
+         * number of frames the replay of the full history would produce. */
+        replay = (size_t) (index - c->index);
+        pa_log_debug("Restoring resampler checkpoint, replaying %lu instead of %lu bytes.",
+                     (unsigned long) replay, (unsigned long) amount);
+
+        if (r->impl.restore_state)
+            r->impl.restore_state(r, checkpoint_state(c));
+
+        *r->have_leftover = false;
+        r->in_frames = c->in_frames;
+        r->out_frames = c->out_frames;
+
+        out_size = pa_resampler_prepare(r, history_queue, replay);
+        return pa_resampler_result(r, amount) - pa_resampler_result(r, replay) + out_size;
     }
 
-    if (history_queue && amount > 0)
-        return pa_resampler_prepare(r, history_queue, amount);
+    find_checkpoint(r, pa_memblockq_get_read_index(history_queue), 0);
 
     return 0;
 }
@@ -1602,6 +1730,7 @@ static pa_memchunk *convert_from_work_format(pa_resampler *r, pa_memchunk *input
 
 void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out) {
     pa_memchunk *buf;
+    pa_usec_t start;
 
     pa_assert(r);
     pa_assert(in);
@@ -1610,6 +1739,8 @@ void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out)
     pa_assert(in->memblock);
     pa_assert(in->length % r->i_fz == 0);
 
+    start = pa_rtclock_now();
+
     buf = (pa_memchunk*) in;
     r->in_frames += buf->length / r->i_fz;
     buf = convert_to_work_format(r, buf);
@@ -1638,6 +1769,9 @@ void pa_resampler_run(pa_resampler *r, const pa_memchunk *in, pa_memchunk *out)
             pa_memchunk_reset(buf);
     } else
         pa_memchunk_reset(out);
+
+    r->n_runs++;
+    r->run_usec += pa_rtclock_now() - start;
 }
 
 /* Get delay in input frames. Some resamplers may have negative delay. */
@@ -39,6 +39,13 @@ struct pa_resampler_impl {
     unsigned (*resample)(pa_resampler *r, const pa_memchunk *in, unsigned in_n_frames, pa_memchunk *out, unsigned *out_n_frames);
 
     void (*reset)(pa_resampler *r);
+
+    /* Optional, copy the implementation state to or from a buffer of
+     * state_size bytes. Used to take rewind checkpoints. */
+    void (*save_state)(pa_resampler *r, void *state);
+    void (*restore_state)(pa_resampler *r, const void *state);
+    size_t state_size;
+
     void *data;
 };
 
@@ -121,7 +128,17 @@ struct pa_resampler {
 
     pa_lfe_filter_t *lfe_filter;
 
+    /* Ring buffer of state checkpoints, keyed by history queue index */
+    uint8_t *checkpoints;
+    size_t checkpoint_size;
+    unsigned n_checkpoints;
+    unsigned checkpoint_idx;
+
     pa_resampler_impl impl;
+
+    /* Calls of pa_resampler_run() and the time spent in them */
+    uint64_t n_runs;
+    pa_usec_t run_usec;
 };
 
 pa_resampler* pa_resampler_new(
@@ -160,6 +177,16 @@ void pa_resampler_reset(pa_resampler *r);
 /* Prepare resampler for use by running some old data through it. */
 size_t pa_resampler_prepare(pa_resampler *r, pa_memblockq *history_queue, size_t amount);
 
+/* Save a checkpoint of the resampler state, if the resampler supports it.
+ * index is the history queue write index after the data passed to the
+ * resampler was pushed to the queue. */
+void pa_resampler_save_checkpoint(pa_resampler *r, int64_t index);
+
+/* Drop all checkpoints. Must be called whenever the history queue is flushed
+ * or silenced, because the checkpoints would then restore the state for audio
+ * that is no longer in the queue. */
+void pa_resampler_drop_checkpoints(pa_resampler *r);
+
 /* Rewind resampler */
 size_t pa_resampler_rewind(pa_resampler *r, size_t out_bytes, pa_memblockq *history_queue, size_t amount);
 
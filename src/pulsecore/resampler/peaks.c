@@ -134,6 +134,18 @@ static unsigned peaks_resample(pa_resampler *r, const pa_memchunk *input, unsign
     return 0;
 }
 
+static void peaks_save_state(pa_resampler *r, void *state) {
+    pa_assert(r);
+
+    memcpy(state, r->impl.data, sizeof(struct peaks_data));
+}
+
+static void peaks_restore_state(pa_resampler *r, const void *state) {
+    pa_assert(r);
+
+    memcpy(r->impl.data, state, sizeof(struct peaks_data));
+}
+
 static void peaks_update_rates_or_reset(pa_resampler *r) {
     struct peaks_data *peaks_data;
     pa_assert(r);
@@ -155,6 +167,9 @@ int pa_resampler_peaks_init(pa_resampler*r) {
     r->impl.resample = peaks_resample;
     r->impl.update_rates = peaks_update_rates_or_reset;
     r->impl.reset = peaks_update_rates_or_reset;
+    r->impl.save_state = peaks_save_state;
+    r->impl.restore_state = peaks_restore_state;
+    r->impl.state_size = sizeof(struct peaks_data);
     r->impl.data = peaks_data;
 
     return 0;
@@ -75,6 +75,18 @@ static unsigned trivial_resample(pa_resampler *r, const pa_memchunk *input, unsi
     return 0;
 }
 
+static void trivial_save_state(pa_resampler *r, void *state) {
+    pa_assert(r);
+
+    memcpy(state, r->impl.data, sizeof(struct trivial_data));
+}
+
+static void trivial_restore_state(pa_resampler *r, const void *state) {
+    pa_assert(r);
+
+    memcpy(r->impl.data, state, sizeof(struct trivial_data));
+}
+
 static void trivial_update_rates_or_reset(pa_resampler *r) {
     struct trivial_data *trivial_data;
     pa_assert(r);
@@ -94,6 +106,9 @@ int pa_resampler_trivial_init(pa_resampler *r) {
     r->impl.resample = trivial_resample;
     r->impl.update_rates = trivial_update_rates_or_reset;
     r->impl.reset = trivial_update_rates_or_reset;
+    r->impl.save_state = trivial_save_state;
+    r->impl.restore_state = trivial_restore_state;
+    r->impl.state_size = sizeof(struct trivial_data);
     r->impl.data = trivial_data;
 
     return 0;
@@ -1048,7 +1048,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
 
             /* It might be necessary to adjust the volume here */
             if (do_volume_adj_here && !volume_is_norm) {
-                pa_memchunk_make_writable(&wchunk, 0);
+                pa_sink_make_writable_counted(i->sink, &wchunk, 0);
 
                 if (i->thread_info.muted) {
                     pa_silence_memchunk(&wchunk, &i->thread_info.sample_spec);
@@ -1074,7 +1074,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
             if (!i->thread_info.resampler) {
 
                 if (nvfs) {
-                    pa_memchunk_make_writable(&wchunk, 0);
+                    pa_sink_make_writable_counted(i->sink, &wchunk, 0);
                     pa_volume_memchunk(&wchunk, &i->sink->sample_spec, &i->volume_factor_sink);
                 }
 
@@ -1082,6 +1082,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
             } else {
                 pa_memchunk rchunk;
                 pa_resampler_run(i->thread_info.resampler, &wchunk, &rchunk);
+                pa_resampler_save_checkpoint(i->thread_info.resampler, pa_memblockq_get_write_index(i->thread_info.history_memblockq));
 
 #ifdef SINK_INPUT_DEBUG
                 pa_log_debug("pushing %lu", (unsigned long) rchunk.length);
@@ -1090,7 +1091,7 @@ void pa_sink_input_peek(pa_sink_input *i, size_t slength /* in sink bytes */, pa
                 if (rchunk.memblock) {
 
                     if (nvfs) {
-                        pa_memchunk_make_writable(&rchunk, 0);
+                        pa_sink_make_writable_counted(i->sink, &rchunk, 0);
                         pa_volume_memchunk(&rchunk, &i->sink->sample_spec, &i->volume_factor_sink);
                     }
 
@@ -1178,6 +1179,8 @@ bool pa_sink_input_process_underrun(pa_sink_input *i) {
         /* All valid data has been played back, so we can empty this queue. */
         pa_memblockq_silence(i->thread_info.render_memblockq);
         pa_memblockq_silence(i->thread_info.history_memblockq);
+        if (i->thread_info.resampler)
+            pa_resampler_drop_checkpoints(i->thread_info.resampler);
         return true;
     }
     return false;
@@ -1217,6 +1220,8 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
 
         pa_memblockq_flush_write(i->thread_info.render_memblockq, true);
         pa_memblockq_flush_write(i->thread_info.history_memblockq, true);
+        if (i->thread_info.resampler)
+            pa_resampler_drop_checkpoints(i->thread_info.resampler);
 
     } else if (i->thread_info.rewrite_nbytes > 0) {
         size_t max_rewrite, sink_amount, sink_input_amount;
@@ -1279,6 +1284,8 @@ void pa_sink_input_process_rewind(pa_sink_input *i, size_t nbytes /* in sink sam
             if (i->thread_info.rewrite_flush) {
                 pa_memblockq_silence(i->thread_info.render_memblockq);
                 pa_memblockq_silence(i->thread_info.history_memblockq);
+                if (i->thread_info.resampler)
+                    pa_resampler_drop_checkpoints(i->thread_info.resampler);
             }
         }
     }
@@ -2342,7 +2349,11 @@ int pa_sink_input_process_msg(pa_msgobject *o, int code, void *userdata, int64_t
         case PA_SINK_INPUT_MESSAGE_SET_SOFT_VOLUME:
             if (!pa_cvolume_equal(&i->thread_info.soft_volume, &i->soft_volume)) {
                 i->thread_info.soft_volume = i->soft_volume;
-                pa_sink_input_request_rewind(i, 0, true, false, false);
+
+                if (pa_sink_rewind_on_volume_change(i->sink))
+                    pa_sink_input_request_rewind(i, 0, true, false, false);
+                else
+                    i->sink->thread_info.cycle_stats.n_rewinds_skipped++;
             }
             return 0;
 
@@ -2607,8 +2618,11 @@ int pa_sink_input_update_resampler(pa_sink_input *i, bool flush_history) {
     } else
         new_resampler = NULL;
 
-    if (flush_history)
+    if (flush_history) {
         pa_memblockq_flush_write(i->thread_info.history_memblockq, true);
+        if (i->thread_info.resampler)
+            pa_resampler_drop_checkpoints(i->thread_info.resampler);
+    }
 
     if (new_resampler == i->thread_info.resampler)
         return 0;
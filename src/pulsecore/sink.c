@@ -47,6 +47,7 @@
 #include <pulsecore/macro.h>
 #include <pulsecore/play-memblockq.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/io-trace.h>
 
 #include "sink.h"
 
@@ -60,6 +61,8 @@ PA_DEFINE_PUBLIC_CLASS(pa_sink, pa_msgobject);
 
 struct pa_sink_volume_change {
     pa_usec_t at;
+    /* When the first of the changes merged into this one was due */
+    pa_usec_t first_at;
     pa_cvolume hw_volume;
 
     PA_LLIST_FIELDS(pa_sink_volume_change);
@@ -354,6 +357,9 @@ pa_sink* pa_sink_new(
     pa_sw_cvolume_divide(&s->thread_info.current_hw_volume, &s->real_volume, &s->soft_volume);
     s->thread_info.volume_change_safety_margin = core->deferred_volume_safety_margin_usec;
     s->thread_info.volume_change_extra_delay = core->deferred_volume_extra_delay_usec;
+    s->thread_info.volume_change_coalesce = core->deferred_volume_coalesce_usec;
+    s->thread_info.rewind_limit = core->rewind_limit_usec;
+    s->thread_info.rewind_on_volume_change = core->rewind_on_volume_change;
     s->thread_info.port_latency_offset = s->port_latency_offset;
 
     /* FIXME: This should probably be moved to pa_sink_put() */
@@ -1078,8 +1084,12 @@ void pa_sink_process_rewind(pa_sink *s, size_t nbytes) {
     s->thread_info.rewind_nbytes = 0;
     s->thread_info.rewind_requested = false;
 
+    pa_io_trace(PA_IO_TRACE_SINK_REWIND, s->index, (int64_t) nbytes, 0, 0);
+
     if (nbytes > 0) {
         pa_log_debug("Processing rewind...");
+        pa_atomic_inc(&s->n_rewinds);
+        pa_cycle_stats_add_rewind(&s->thread_info.cycle_stats, nbytes);
         if (s->flags & PA_SINK_DEFERRED_VOLUME)
             pa_sink_volume_change_rewind(s, nbytes);
     }
@@ -1237,7 +1247,17 @@ static void inputs_drop(pa_sink *s, pa_mix_info *info, unsigned n, pa_memchunk *
 }
 
 /* Called from IO thread context */
-void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
+void pa_sink_make_writable_counted(pa_sink *s, pa_memchunk *c, size_t min) {
+    pa_memblock *b = c->memblock;
+
+    pa_memchunk_make_writable(c, min);
+
+    if (c->memblock != b)
+        s->thread_info.render_copied_bytes += c->length;
+}
+
+/* Called from IO thread context */
+static void sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t block_size_max;
@@ -1298,7 +1318,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
                                     &s->sample_spec,
                                     result->length);
         } else if (!pa_cvolume_is_norm(&volume)) {
-            pa_memchunk_make_writable(result, 0);
+            pa_sink_make_writable_counted(s, result, 0);
             pa_volume_memchunk(result, &s->sample_spec, &volume);
         }
     } else {
@@ -1322,7 +1342,7 @@ void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
 }
 
 /* Called from IO thread context */
-void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
+static void sink_render_into(pa_sink*s, pa_memchunk *target) {
     pa_mix_info info[MAX_MIX_CHANNELS];
     unsigned n;
     size_t length, block_size_max;
@@ -1373,18 +1393,16 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
             pa_memchunk vchunk;
 
             vchunk = info[0].chunk;
-            pa_memblock_ref(vchunk.memblock);
 
             if (vchunk.length > length)
                 vchunk.length = length;
 
-            if (!pa_cvolume_is_norm(&volume)) {
-                pa_memchunk_make_writable(&vchunk, 0);
-                pa_volume_memchunk(&vchunk, &s->sample_spec, &volume);
-            }
-
+            /* Apply the volume in the target rather than on a writable
+             * copy of the input, so that the data is only copied once */
             pa_memchunk_memcpy(target, &vchunk);
-            pa_memblock_unref(vchunk.memblock);
+
+            if (!pa_cvolume_is_norm(&volume))
+                pa_volume_memchunk(target, &s->sample_spec, &volume);
         }
 
     } else {
@@ -1407,7 +1425,7 @@ void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
 }
 
 /* Called from IO thread context */
-void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target) {
+static void sink_render_into_full(pa_sink *s, pa_memchunk *target) {
     pa_memchunk chunk;
     size_t l, d;
 
@@ -1436,7 +1454,7 @@ void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target) {
         chunk.index += d;
         chunk.length -= d;
 
-        pa_sink_render_into(s, &chunk);
+        sink_render_into(s, &chunk);
 
         d += chunk.length;
         l -= chunk.length;
@@ -1446,7 +1464,7 @@ void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target) {
 }
 
 /* Called from IO thread context */
-void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
+static void sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
     pa_assert(PA_SINK_IS_LINKED(s->thread_info.state));
@@ -1459,18 +1477,18 @@ void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
 
     pa_sink_ref(s);
 
-    pa_sink_render(s, length, result);
+    sink_render(s, length, result);
 
     if (result->length < length) {
         pa_memchunk chunk;
 
-        pa_memchunk_make_writable(result, length);
+        pa_sink_make_writable_counted(s, result, length);
 
         chunk.memblock = result->memblock;
         chunk.index = result->index + result->length;
         chunk.length = length - result->length;
 
-        pa_sink_render_into_full(s, &chunk);
+        sink_render_into_full(s, &chunk);
 
         result->length = length;
     }
@@ -1478,6 +1496,59 @@ void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
     pa_sink_unref(s);
 }
 
+/* Called from IO thread context */
+static void render_done(pa_sink *s, size_t length, pa_usec_t start) {
+    pa_usec_t usec = pa_rtclock_now() - start;
+
+    pa_cycle_timing_add(&s->thread_info.cycle_stats.render, usec);
+    pa_cycle_stats_add_render(&s->thread_info.cycle_stats, length);
+    pa_io_trace(PA_IO_TRACE_SINK_RENDER, s->index, (int64_t) length, (int64_t) usec, 0);
+}
+
+/* Called from IO thread context */
+void pa_sink_render(pa_sink*s, size_t length, pa_memchunk *result) {
+    pa_usec_t start;
+
+    pa_sink_assert_ref(s);
+
+    start = pa_rtclock_now();
+    sink_render(s, length, result);
+    render_done(s, result->length, start);
+}
+
+/* Called from IO thread context */
+void pa_sink_render_into(pa_sink*s, pa_memchunk *target) {
+    pa_usec_t start;
+
+    pa_sink_assert_ref(s);
+
+    start = pa_rtclock_now();
+    sink_render_into(s, target);
+    render_done(s, target->length, start);
+}
+
+/* Called from IO thread context */
+void pa_sink_render_into_full(pa_sink *s, pa_memchunk *target) {
+    pa_usec_t start;
+
+    pa_sink_assert_ref(s);
+
+    start = pa_rtclock_now();
+    sink_render_into_full(s, target);
+    render_done(s, target->length, start);
+}
+
+/* Called from IO thread context */
+void pa_sink_render_full(pa_sink *s, size_t length, pa_memchunk *result) {
+    pa_usec_t start;
+
+    pa_sink_assert_ref(s);
+
+    start = pa_rtclock_now();
+    sink_render_full(s, length, result);
+    render_done(s, result->length, start);
+}
+
 /* Called from main thread */
 void pa_sink_reconfigure(pa_sink *s, pa_sample_spec *spec, bool passthrough) {
     pa_sample_spec desired_spec;
@@ -1590,6 +1661,20 @@ size_t pa_sink_get_last_rewind(pa_sink *s) {
     return rewind_bytes;
 }
 
+/* Called from main thread */
+void pa_sink_get_cycle_stats(pa_sink *s, pa_cycle_stats *stats) {
+    pa_sink_assert_ref(s);
+    pa_assert_ctl_context();
+    pa_assert(stats);
+
+    if (!PA_SINK_IS_LINKED(s->state)) {
+        *stats = s->thread_info.cycle_stats;
+        return;
+    }
+
+    pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SINK_MESSAGE_GET_CYCLE_STATS, stats, 0, NULL) == 0);
+}
+
 /* Called from main thread */
 pa_usec_t pa_sink_get_latency(pa_sink *s) {
     int64_t usec = 0;
@@ -2583,7 +2668,11 @@ static void sync_input_volumes_within_thread(pa_sink *s) {
             continue;
 
         i->thread_info.soft_volume = i->soft_volume;
-        pa_sink_input_request_rewind(i, 0, true, false, false);
+
+        if (pa_sink_rewind_on_volume_change(s))
+            pa_sink_input_request_rewind(i, 0, true, false, false);
+        else
+            s->thread_info.cycle_stats.n_rewinds_skipped++;
     }
 }
 
@@ -2883,7 +2972,11 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
 
             if (!pa_cvolume_equal(&s->thread_info.soft_volume, &s->soft_volume)) {
                 s->thread_info.soft_volume = s->soft_volume;
-                pa_sink_request_rewind(s, (size_t) -1);
+
+                if (pa_sink_rewind_on_volume_change(s))
+                    pa_sink_request_rewind(s, (size_t) -1);
+                else
+                    s->thread_info.cycle_stats.n_rewinds_skipped++;
             }
 
             /* Fall through ... */
@@ -2903,7 +2996,11 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             /* In case sink implementor reset SW volume. */
             if (!pa_cvolume_equal(&s->thread_info.soft_volume, &s->soft_volume)) {
                 s->thread_info.soft_volume = s->soft_volume;
-                pa_sink_request_rewind(s, (size_t) -1);
+
+                if (pa_sink_rewind_on_volume_change(s))
+                    pa_sink_request_rewind(s, (size_t) -1);
+                else
+                    s->thread_info.cycle_stats.n_rewinds_skipped++;
             }
 
             return 0;
@@ -3010,6 +3107,24 @@ int pa_sink_process_msg(pa_msgobject *o, int code, void *userdata, int64_t offse
             *((size_t*) userdata) = s->thread_info.last_rewind_nbytes;
             return 0;
 
+        case PA_SINK_MESSAGE_GET_CYCLE_STATS: {
+            pa_cycle_stats *stats = userdata;
+            pa_sink_input *i;
+            void *state = NULL;
+
+            *stats = s->thread_info.cycle_stats;
+
+            PA_HASHMAP_FOREACH(i, s->thread_info.inputs, state) {
+                if (!i->thread_info.resampler)
+                    continue;
+
+                stats->n_resampler_runs += i->thread_info.resampler->n_runs;
+                stats->resampler_usec += i->thread_info.resampler->run_usec;
+            }
+
+            return 0;
+        }
+
         case PA_SINK_MESSAGE_GET_MAX_REQUEST:
 
             *((size_t*) userdata) = s->thread_info.max_request;
@@ -3103,6 +3218,8 @@ void pa_sink_attach_within_thread(pa_sink *s) {
 
 /* Called from IO thread */
 void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
+    bool limited = false;
+
     pa_sink_assert_ref(s);
     pa_sink_assert_io_context(s);
     pa_assert(PA_SINK_IS_LINKED(s->thread_info.state));
@@ -3112,10 +3229,22 @@ void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
 
     nbytes = PA_MIN(nbytes, s->thread_info.max_rewind);
 
+    if (s->thread_info.rewind_limit > 0) {
+        size_t limit = pa_usec_to_bytes(s->thread_info.rewind_limit, &s->sample_spec);
+
+        if (nbytes > limit) {
+            nbytes = limit;
+            limited = true;
+        }
+    }
+
     if (s->thread_info.rewind_requested &&
         nbytes <= s->thread_info.rewind_nbytes)
         return;
 
+    if (limited)
+        s->thread_info.cycle_stats.n_rewinds_limited++;
+
     s->thread_info.rewind_nbytes = nbytes;
     s->thread_info.rewind_requested = true;
 
@@ -3123,6 +3252,17 @@ void pa_sink_request_rewind(pa_sink*s, size_t nbytes) {
         s->request_rewind(s);
 }
 
+/* Called from IO thread. Tells whether a soft volume change of the sink or
+ * one of its inputs should rewind, so that it is heard right away, or wait
+ * for the next render. Mute changes always rewind. Callers that skip the
+ * rewind count it in the cycle statistics. */
+bool pa_sink_rewind_on_volume_change(pa_sink *s) {
+    pa_sink_assert_ref(s);
+    pa_sink_assert_io_context(s);
+
+    return s->thread_info.rewind_on_volume_change;
+}
+
 /* Called from IO thread */
 pa_usec_t pa_sink_get_requested_latency_within_thread(pa_sink *s) {
     pa_usec_t result = (pa_usec_t) -1;
@@ -3719,6 +3859,7 @@ static pa_sink_volume_change *pa_sink_volume_change_new(pa_sink *s) {
 
     PA_LLIST_INIT(pa_sink_volume_change, c);
     c->at = 0;
+    c->first_at = 0;
     pa_cvolume_reset(&c->hw_volume, s->sample_spec.channels);
     return c;
 }
@@ -3740,6 +3881,7 @@ void pa_sink_volume_change_push(pa_sink *s) {
     const char *direction = NULL;
 
     pa_assert(s);
+    s->thread_info.volume_changes_requested++;
     nc = pa_sink_volume_change_new(s);
 
     /* NOTE: There is already more different volumes in pa_sink that I can remember.
@@ -3798,6 +3940,22 @@ void pa_sink_volume_change_push(pa_sink *s) {
     }
     nc->next = NULL;
     s->thread_info.volume_changes_tail = nc;
+
+    /* While changes keep coming within the coalescing window, merge them
+     * into the previous queued change, so that a volume ramp results in
+     * at most one hardware write per window. */
+    pc = nc->prev;
+    if (s->thread_info.volume_change_coalesce > 0 && pc && nc->at < pc->first_at + s->thread_info.volume_change_coalesce) {
+        pa_log_debug("Volume change to %d at %llu merged into the one at %llu",
+                     pa_cvolume_avg(&nc->hw_volume), (long long unsigned) nc->at, (long long unsigned) pc->at);
+        pc->at = nc->at;
+        pc->hw_volume = nc->hw_volume;
+        PA_LLIST_REMOVE(pa_sink_volume_change, s->thread_info.volume_changes, nc);
+        pa_sink_volume_change_free(nc);
+        s->thread_info.volume_changes_tail = pc;
+        s->thread_info.volume_changes_coalesced++;
+    } else
+        nc->first_at = nc->at;
 }
 
 /* Called from the IO thread. */
@@ -3840,8 +3998,10 @@ bool pa_sink_volume_change_apply(pa_sink *s, pa_usec_t *usec_to_next) {
         pa_sink_volume_change_free(c);
     }
 
-    if (ret)
+    if (ret) {
         s->write_volume(s);
+        s->thread_info.volume_writes++;
+    }
 
     if (s->thread_info.volume_changes) {
         if (usec_to_next)
@@ -40,6 +40,7 @@
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/device-port.h>
 #include <pulsecore/card.h>
+#include <pulsecore/cycle-stats.h>
 #include <pulsecore/queue.h>
 #include <pulsecore/thread-mq.h>
 #include <pulsecore/sink-input.h>
@@ -302,6 +303,12 @@ struct pa_sink {
         /* Size of last rewind */
         size_t last_rewind_nbytes;
 
+        /* Rewind requests are shortened to this many usec, 0 for no
+         * limit. Soft volume changes are applied at the next render
+         * without a rewind unless rewind_on_volume_change is set. */
+        pa_usec_t rewind_limit;
+        bool rewind_on_volume_change;
+
         /* Both dynamic and fixed latencies will be clamped to this
          * range. */
         pa_usec_t min_latency; /* we won't go below this latency */
@@ -329,8 +336,29 @@ struct pa_sink {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+        /* Usec window within which queued volume changes are merged into one
+         * hardware write, 0 to disable. */
+        uint32_t volume_change_coalesce;
+        /* Volume changes pushed, merged into an earlier change, and
+         * write_volume() calls issued for them. */
+        uint64_t volume_changes_requested;
+        uint64_t volume_changes_coalesced;
+        uint64_t volume_writes;
+
+        /* Bytes that were copied while rendering, to apply sink or sink
+         * input volumes, in addition to being mixed or written into the
+         * target */
+        uint64_t render_copied_bytes;
+
+        /* Time spent rendering, and in the device writes and IO cycles
+         * the implementor reports */
+        pa_cycle_stats cycle_stats;
     } thread_info;
 
+    /* Counted by the IO thread, can be read from any thread */
+    pa_atomic_t n_underruns;
+    pa_atomic_t n_rewinds;
+
     void *userdata;
 };
 
@@ -363,6 +391,7 @@ typedef enum pa_sink_message {
     PA_SINK_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SINK_MESSAGE_SET_PORT_LATENCY_OFFSET,
     PA_SINK_MESSAGE_GET_LAST_REWIND,
+    PA_SINK_MESSAGE_GET_CYCLE_STATS,
     PA_SINK_MESSAGE_MAX
 } pa_sink_message_t;
 
@@ -461,6 +490,7 @@ pa_usec_t pa_sink_get_fixed_latency(pa_sink *s);
 
 size_t pa_sink_get_max_rewind(pa_sink *s);
 size_t pa_sink_get_last_rewind(pa_sink *s);
+void pa_sink_get_cycle_stats(pa_sink *s, pa_cycle_stats *stats);
 size_t pa_sink_get_max_request(pa_sink *s);
 
 int pa_sink_update_status(pa_sink*s);
@@ -558,9 +588,14 @@ size_t pa_sink_process_input_underruns(pa_sink *s, size_t left_to_play);
 /*** To be called exclusively by sink input drivers, from IO context */
 
 void pa_sink_request_rewind(pa_sink*s, size_t nbytes);
+bool pa_sink_rewind_on_volume_change(pa_sink *s);
 
 void pa_sink_invalidate_requested_latency(pa_sink *s, bool dynamic);
 
+/* Makes the chunk writable, counting the bytes in render_copied_bytes if that
+ * took a copy */
+void pa_sink_make_writable_counted(pa_sink *s, pa_memchunk *c, size_t min);
+
 int64_t pa_sink_get_latency_within_thread(pa_sink *s, bool allow_negative);
 
 /* Called from the main thread, from sink-input.c only. The normal way to set
@@ -810,7 +810,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
 
         /* It might be necessary to adjust the volume here */
         if (!volume_is_norm) {
-            pa_memchunk_make_writable(&qchunk, 0);
+            pa_source_make_writable_counted(o->source, &qchunk);
 
             if (o->thread_info.muted) {
                 pa_silence_memchunk(&qchunk, &o->source->sample_spec);
@@ -831,7 +831,7 @@ void pa_source_output_push(pa_source_output *o, const pa_memchunk *chunk) {
         }
 
         if (nvfs) {
-            pa_memchunk_make_writable(&qchunk, 0);
+            pa_source_make_writable_counted(o->source, &qchunk);
             pa_volume_memchunk(&qchunk, &o->source->sample_spec, &o->volume_factor_source);
         }
 
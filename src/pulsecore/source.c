@@ -40,6 +40,7 @@
 #include <pulsecore/log.h>
 #include <pulsecore/mix.h>
 #include <pulsecore/flist.h>
+#include <pulsecore/io-trace.h>
 
 #include "source.h"
 
@@ -51,6 +52,8 @@ PA_DEFINE_PUBLIC_CLASS(pa_source, pa_msgobject);
 
 struct pa_source_volume_change {
     pa_usec_t at;
+    /* When the first of the changes merged into this one was due */
+    pa_usec_t first_at;
     pa_cvolume hw_volume;
 
     PA_LLIST_FIELDS(pa_source_volume_change);
@@ -337,6 +340,7 @@ pa_source* pa_source_new(
     pa_sw_cvolume_divide(&s->thread_info.current_hw_volume, &s->real_volume, &s->soft_volume);
     s->thread_info.volume_change_safety_margin = core->deferred_volume_safety_margin_usec;
     s->thread_info.volume_change_extra_delay = core->deferred_volume_extra_delay_usec;
+    s->thread_info.volume_change_coalesce = core->deferred_volume_coalesce_usec;
     s->thread_info.port_latency_offset = s->port_latency_offset;
 
     /* FIXME: This should probably be moved to pa_source_put() */
@@ -964,6 +968,7 @@ void pa_source_process_rewind(pa_source *s, size_t nbytes) {
         return;
 
     pa_log_debug("Processing rewind...");
+    pa_cycle_stats_add_rewind(&s->thread_info.cycle_stats, nbytes);
 
     PA_HASHMAP_FOREACH(o, s->thread_info.outputs, state) {
         pa_source_output_assert_ref(o);
@@ -972,7 +977,17 @@ void pa_source_process_rewind(pa_source *s, size_t nbytes) {
 }
 
 /* Called from IO thread context */
-void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
+void pa_source_make_writable_counted(pa_source *s, pa_memchunk *c) {
+    pa_memblock *b = c->memblock;
+
+    pa_memchunk_make_writable(c, 0);
+
+    if (c->memblock != b)
+        s->thread_info.post_copied_bytes += c->length;
+}
+
+/* Called from IO thread context */
+static void source_post(pa_source*s, const pa_memchunk *chunk) {
     pa_source_output *o;
     void *state = NULL;
 
@@ -988,7 +1003,7 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
         pa_memchunk vchunk = *chunk;
 
         pa_memblock_ref(vchunk.memblock);
-        pa_memchunk_make_writable(&vchunk, 0);
+        pa_source_make_writable_counted(s, &vchunk);
 
         if (s->thread_info.soft_muted || pa_cvolume_is_muted(&s->thread_info.soft_volume))
             pa_silence_memchunk(&vchunk, &s->sample_spec);
@@ -1014,6 +1029,23 @@ void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
     }
 }
 
+/* Called from IO thread context */
+void pa_source_post(pa_source*s, const pa_memchunk *chunk) {
+    pa_usec_t start, usec;
+
+    pa_source_assert_ref(s);
+
+    start = pa_rtclock_now();
+    source_post(s, chunk);
+    usec = pa_rtclock_now() - start;
+
+    pa_cycle_timing_add(&s->thread_info.cycle_stats.render, usec);
+    /* Sources are rewound along with the sink they monitor, which then
+     * posts the rewound audio again */
+    pa_cycle_stats_add_render(&s->thread_info.cycle_stats, chunk->length);
+    pa_io_trace(PA_IO_TRACE_SOURCE_POST, s->index, (int64_t) chunk->length, (int64_t) usec, 0);
+}
+
 /* Called from IO thread context */
 void pa_source_post_direct(pa_source*s, pa_source_output *o, const pa_memchunk *chunk) {
     pa_source_assert_ref(s);
@@ -1030,7 +1062,7 @@ void pa_source_post_direct(pa_source*s, pa_source_output *o, const pa_memchunk *
         pa_memchunk vchunk = *chunk;
 
         pa_memblock_ref(vchunk.memblock);
-        pa_memchunk_make_writable(&vchunk, 0);
+        pa_source_make_writable_counted(s, &vchunk);
 
         if (s->thread_info.soft_muted || pa_cvolume_is_muted(&s->thread_info.soft_volume))
             pa_silence_memchunk(&vchunk, &s->sample_spec);
@@ -2324,6 +2356,24 @@ int pa_source_process_msg(pa_msgobject *object, int code, void *userdata, int64_
             s->thread_info.port_latency_offset = offset;
             return 0;
 
+        case PA_SOURCE_MESSAGE_GET_CYCLE_STATS: {
+            pa_cycle_stats *stats = userdata;
+            pa_source_output *o;
+            void *state = NULL;
+
+            *stats = s->thread_info.cycle_stats;
+
+            PA_HASHMAP_FOREACH(o, s->thread_info.outputs, state) {
+                if (!o->thread_info.resampler)
+                    continue;
+
+                stats->n_resampler_runs += o->thread_info.resampler->n_runs;
+                stats->resampler_usec += o->thread_info.resampler->run_usec;
+            }
+
+            return 0;
+        }
+
         case PA_SOURCE_MESSAGE_MAX:
             ;
     }
@@ -2673,6 +2723,20 @@ size_t pa_source_get_max_rewind(pa_source *s) {
     return r;
 }
 
+/* Called from main thread */
+void pa_source_get_cycle_stats(pa_source *s, pa_cycle_stats *stats) {
+    pa_assert_ctl_context();
+    pa_source_assert_ref(s);
+    pa_assert(stats);
+
+    if (!PA_SOURCE_IS_LINKED(s->state)) {
+        *stats = s->thread_info.cycle_stats;
+        return;
+    }
+
+    pa_assert_se(pa_asyncmsgq_send(s->asyncmsgq, PA_MSGOBJECT(s), PA_SOURCE_MESSAGE_GET_CYCLE_STATS, stats, 0, NULL) == 0);
+}
+
 /* Called from main context */
 int pa_source_set_port(pa_source *s, const char *name, bool save) {
     pa_device_port *port;
@@ -2730,6 +2794,7 @@ static pa_source_volume_change *pa_source_volume_change_new(pa_source *s) {
 
     PA_LLIST_INIT(pa_source_volume_change, c);
     c->at = 0;
+    c->first_at = 0;
     pa_cvolume_reset(&c->hw_volume, s->sample_spec.channels);
     return c;
 }
@@ -2751,6 +2816,7 @@ void pa_source_volume_change_push(pa_source *s) {
     const char *direction = NULL;
 
     pa_assert(s);
+    s->thread_info.volume_changes_requested++;
     nc = pa_source_volume_change_new(s);
 
     /* NOTE: There is already more different volumes in pa_source that I can remember.
@@ -2809,6 +2875,22 @@ void pa_source_volume_change_push(pa_source *s) {
     }
     nc->next = NULL;
     s->thread_info.volume_changes_tail = nc;
+
+    /* While changes keep coming within the coalescing window, merge them
+     * into the previous queued change, so that a volume ramp results in
+     * at most one hardware write per window. */
+    pc = nc->prev;
+    if (s->thread_info.volume_change_coalesce > 0 && pc && nc->at < pc->first_at + s->thread_info.volume_change_coalesce) {
+        pa_log_debug("Volume change to %d at %llu merged into the one at %llu",
+                     pa_cvolume_avg(&nc->hw_volume), (long long unsigned) nc->at, (long long unsigned) pc->at);
+        pc->at = nc->at;
+        pc->hw_volume = nc->hw_volume;
+        PA_LLIST_REMOVE(pa_source_volume_change, s->thread_info.volume_changes, nc);
+        pa_source_volume_change_free(nc);
+        s->thread_info.volume_changes_tail = pc;
+        s->thread_info.volume_changes_coalesced++;
+    } else
+        nc->first_at = nc->at;
 }
 
 /* Called from the IO thread. */
@@ -2851,8 +2933,10 @@ bool pa_source_volume_change_apply(pa_source *s, pa_usec_t *usec_to_next) {
         pa_source_volume_change_free(c);
     }
 
-    if (ret)
+    if (ret) {
         s->write_volume(s);
+        s->thread_info.volume_writes++;
+    }
 
     if (s->thread_info.volume_changes) {
         if (usec_to_next)
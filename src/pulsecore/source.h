@@ -40,6 +40,7 @@
 #include <pulsecore/msgobject.h>
 #include <pulsecore/rtpoll.h>
 #include <pulsecore/card.h>
+#include <pulsecore/cycle-stats.h>
 #include <pulsecore/device-port.h>
 #include <pulsecore/queue.h>
 #include <pulsecore/thread-mq.h>
@@ -268,8 +269,27 @@ struct pa_source {
         uint32_t volume_change_safety_margin;
         /* Usec delay added to all volume change events, may be negative. */
         int32_t volume_change_extra_delay;
+        /* Usec window within which queued volume changes are merged into one
+         * hardware write, 0 to disable. */
+        uint32_t volume_change_coalesce;
+        /* Volume changes pushed, merged into an earlier change, and
+         * write_volume() calls issued for them. */
+        uint64_t volume_changes_requested;
+        uint64_t volume_changes_coalesced;
+        uint64_t volume_writes;
+
+        /* Bytes that were copied while posting captured data, to apply
+         * source or source output volumes */
+        uint64_t post_copied_bytes;
+
+        /* Time spent posting captured data, and in the device reads and
+         * IO cycles the implementor reports */
+        pa_cycle_stats cycle_stats;
     } thread_info;
 
+    /* Counted by the IO thread, can be read from any thread */
+    pa_atomic_t n_overruns;
+
     void *userdata;
 };
 
@@ -297,6 +317,7 @@ typedef enum pa_source_message {
     PA_SOURCE_MESSAGE_SET_MAX_REWIND,
     PA_SOURCE_MESSAGE_UPDATE_VOLUME_AND_MUTE,
     PA_SOURCE_MESSAGE_SET_PORT_LATENCY_OFFSET,
+    PA_SOURCE_MESSAGE_GET_CYCLE_STATS,
     PA_SOURCE_MESSAGE_MAX
 } pa_source_message_t;
 
@@ -389,6 +410,7 @@ void pa_source_get_latency_range(pa_source *s, pa_usec_t *min_latency, pa_usec_t
 pa_usec_t pa_source_get_fixed_latency(pa_source *s);
 
 size_t pa_source_get_max_rewind(pa_source *s);
+void pa_source_get_cycle_stats(pa_source *s, pa_cycle_stats *stats);
 
 int pa_source_update_status(pa_source*s);
 int pa_source_suspend(pa_source *s, bool suspend, pa_suspend_cause_t cause);
@@ -475,6 +497,10 @@ bool pa_source_volume_change_apply(pa_source *s, pa_usec_t *usec_to_next);
 void pa_source_invalidate_requested_latency(pa_source *s, bool dynamic);
 int64_t pa_source_get_latency_within_thread(pa_source *s, bool allow_negative);
 
+/* Makes the chunk writable, counting the bytes in post_copied_bytes if that
+ * took a copy */
+void pa_source_make_writable_counted(pa_source *s, pa_memchunk *c);
+
 /* Called from the main thread, from source-output.c only. The normal way to
  * set the source reference volume is to call pa_source_set_volume(), but the
  * flat volume logic in source-output.c needs also a function that doesn't do
@@ -0,0 +1,340 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/core-error.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/dynarray.h>
+#include <pulsecore/json.h>
+#include <pulsecore/log.h>
+#include <pulsecore/module.h>
+
+#include "startup-trace.h"
+
+/* Hooks may fire a lot while modules load, don't let a misbehaving setup
+ * eat all memory */
+#define MAX_SPANS 65536
+
+struct span {
+    const char *category;
+    char *name;
+    char *detail;
+    unsigned depth;
+    bool open;
+
+    pa_usec_t start, wall;
+    pa_usec_t cpu_start, cpu;
+};
+
+struct pa_startup_trace {
+    pa_core *core;
+
+    pa_usec_t start, duration;
+    pa_dynarray *spans;
+    unsigned depth;
+    unsigned n_dropped;
+};
+
+/* The trace currently recording, if any */
+static pa_startup_trace *running = NULL;
+
+static pa_usec_t cpu_now(void) {
+#if defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_THREAD_CPUTIME_ID)
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0)
+        return (pa_usec_t) ts.tv_sec * PA_USEC_PER_SEC + (pa_usec_t) ts.tv_nsec / PA_NSEC_PER_USEC;
+#endif
+
+    return 0;
+}
+
+static void span_free(struct span *s) {
+    pa_xfree(s->name);
+    pa_xfree(s->detail);
+    pa_xfree(s);
+}
+
+void pa_startup_trace_start(pa_core *c) {
+    pa_startup_trace *t;
+
+    pa_assert(c);
+    pa_assert(!c->startup_trace);
+    pa_assert(!running);
+
+    t = pa_xnew0(pa_startup_trace, 1);
+    t->core = c;
+    t->spans = pa_dynarray_new((pa_free_cb_t) span_free);
+    t->start = pa_rtclock_now();
+
+    c->startup_trace = running = t;
+}
+
+void pa_startup_trace_stop(pa_core *c) {
+    struct span *s;
+    pa_usec_t now, cpu;
+    unsigned idx;
+
+    pa_assert(c);
+
+    if (!c->startup_trace || running != c->startup_trace)
+        return;
+
+    now = pa_rtclock_now();
+    cpu = cpu_now();
+
+    /* Close whatever is still open, so that the output stays consistent */
+    PA_DYNARRAY_FOREACH(s, running->spans, idx) {
+        if (!s->open)
+            continue;
+
+        s->wall = now - s->start;
+        s->cpu = cpu - s->cpu_start;
+        s->open = false;
+    }
+
+    running->duration = now - running->start;
+
+    pa_log_info("Startup took %0.2f ms, recorded %u trace spans.",
+                (double) running->duration / PA_USEC_PER_MSEC, pa_dynarray_size(running->spans));
+
+    if (running->n_dropped > 0)
+        pa_log_warn("Dropped %u startup trace spans.", running->n_dropped);
+
+    running = NULL;
+}
+
+void pa_startup_trace_free(pa_startup_trace *t) {
+    pa_assert(t);
+
+    if (running == t)
+        running = NULL;
+
+    pa_dynarray_free(t->spans);
+    pa_xfree(t);
+}
+
+bool pa_startup_trace_running(void) {
+    return !!running;
+}
+
+static unsigned begin(const char *category, char *name, char *detail) {
+    struct span *s;
+
+    if (pa_dynarray_size(running->spans) >= MAX_SPANS) {
+        running->n_dropped++;
+        pa_xfree(name);
+        pa_xfree(detail);
+        return PA_STARTUP_TRACE_INVALID;
+    }
+
+    s = pa_xnew0(struct span, 1);
+    s->category = category;
+    s->name = name;
+    s->detail = detail;
+    s->depth = running->depth++;
+    s->open = true;
+    s->start = pa_rtclock_now();
+    s->cpu_start = cpu_now();
+
+    pa_dynarray_append(running->spans, s);
+
+    return pa_dynarray_size(running->spans) - 1;
+}
+
+unsigned pa_startup_trace_begin(const char *category, const char *name, const char *detail) {
+    pa_assert(category);
+    pa_assert(name);
+
+    if (!running)
+        return PA_STARTUP_TRACE_INVALID;
+
+    return begin(category, pa_xstrdup(name), pa_xstrdup(detail));
+}
+
+/* Name hook callbacks after the hook and the module that connected them,
+ * the callback itself is usually a static function without a symbol */
+unsigned pa_startup_trace_begin_hook(pa_hook *hook, pa_hook_slot *slot) {
+    pa_core *c;
+    char *name;
+
+    pa_assert(hook);
+    pa_assert(slot);
+
+    if (!running)
+        return PA_STARTUP_TRACE_INVALID;
+
+    c = running->core;
+
+    if (hook >= c->hooks && hook < c->hooks + PA_CORE_HOOK_MAX)
+        name = pa_xstrdup(pa_core_hook_to_string((pa_core_hook_t) (hook - c->hooks)));
+    else
+        name = pa_sprintf_malloc("hook %p", (void *) hook);
+
+    return begin("hook", name, slot->module ? pa_xstrdup(slot->module->name) : NULL);
+}
+
+void pa_startup_trace_end(unsigned span) {
+    struct span *s;
+
+    if (!running || span == PA_STARTUP_TRACE_INVALID)
+        return;
+
+    pa_assert_se(s = pa_dynarray_get(running->spans, span));
+
+    if (!s->open)
+        return;
+
+    s->wall = pa_rtclock_now() - s->start;
+    s->cpu = cpu_now() - s->cpu_start;
+    s->open = false;
+
+    pa_assert(running->depth > 0);
+    running->depth--;
+}
+
+int pa_startup_trace_format_from_string(const char *s, pa_startup_trace_format_t *format) {
+    pa_assert(s);
+    pa_assert(format);
+
+    if (pa_streq(s, "json"))
+        *format = PA_STARTUP_TRACE_JSON;
+    else if (pa_streq(s, "chrome"))
+        *format = PA_STARTUP_TRACE_CHROME;
+    else
+        return -1;
+
+    return 0;
+}
+
+static void add_json_spans(pa_startup_trace *t, pa_json_encoder *encoder) {
+    struct span *s;
+    unsigned idx;
+
+    pa_json_encoder_add_member_int(encoder, "duration_usec", (int64_t) t->duration);
+    pa_json_encoder_add_member_int(encoder, "dropped", t->n_dropped);
+
+    pa_json_encoder_begin_member_array(encoder, "spans");
+    PA_DYNARRAY_FOREACH(s, t->spans, idx) {
+        pa_json_encoder_begin_element_object(encoder);
+        pa_json_encoder_add_member_string(encoder, "category", s->category);
+        pa_json_encoder_add_member_string(encoder, "name", s->name);
+        if (s->detail)
+            pa_json_encoder_add_member_string(encoder, "detail", s->detail);
+        pa_json_encoder_add_member_int(encoder, "depth", s->depth);
+        pa_json_encoder_add_member_int(encoder, "start_usec", (int64_t) (s->start - t->start));
+        pa_json_encoder_add_member_int(encoder, "wall_usec", (int64_t) s->wall);
+        pa_json_encoder_add_member_int(encoder, "cpu_usec", (int64_t) s->cpu);
+        pa_json_encoder_end_object(encoder);
+    }
+    pa_json_encoder_end_array(encoder);
+}
+
+/* The Trace Event Format understood by chrome://tracing and Perfetto, with
+ * one complete event per span */
+static void add_chrome_events(pa_startup_trace *t, pa_json_encoder *encoder) {
+    struct span *s;
+    unsigned idx;
+
+    pa_json_encoder_add_member_string(encoder, "displayTimeUnit", "ms");
+
+    pa_json_encoder_begin_member_array(encoder, "traceEvents");
+    PA_DYNARRAY_FOREACH(s, t->spans, idx) {
+        pa_json_encoder_begin_element_object(encoder);
+        pa_json_encoder_add_member_string(encoder, "name", s->name);
+        pa_json_encoder_add_member_string(encoder, "cat", s->category);
+        pa_json_encoder_add_member_string(encoder, "ph", "X");
+        pa_json_encoder_add_member_int(encoder, "ts", (int64_t) (s->start - t->start));
+        pa_json_encoder_add_member_int(encoder, "dur", (int64_t) s->wall);
+        pa_json_encoder_add_member_int(encoder, "pid", (int64_t) getpid());
+        pa_json_encoder_add_member_int(encoder, "tid", 1);
+
+        pa_json_encoder_begin_member_object(encoder, "args");
+        if (s->detail)
+            pa_json_encoder_add_member_string(encoder, "detail", s->detail);
+        pa_json_encoder_add_member_int(encoder, "cpu_usec", (int64_t) s->cpu);
+        pa_json_encoder_end_object(encoder);
+
+        pa_json_encoder_end_object(encoder);
+    }
+    pa_json_encoder_end_array(encoder);
+}
+
+char *pa_startup_trace_to_string(pa_startup_trace *t, pa_startup_trace_format_t format) {
+    pa_json_encoder *encoder;
+
+    pa_assert(t);
+
+    encoder = pa_json_encoder_new();
+    pa_json_encoder_begin_element_object(encoder);
+
+    if (format == PA_STARTUP_TRACE_CHROME)
+        add_chrome_events(t, encoder);
+    else
+        add_json_spans(t, encoder);
+
+    pa_json_encoder_end_object(encoder);
+
+    return pa_json_encoder_to_string_free(encoder);
+}
+
+int pa_startup_trace_save(pa_startup_trace *t, const char *fn, pa_startup_trace_format_t format) {
+    FILE *f;
+    char *s;
+    int r = 0;
+
+    pa_assert(t);
+    pa_assert(fn);
+
+    if (!(f = pa_fopen_cloexec(fn, "w"))) {
+        pa_log("Failed to open startup trace file '%s': %s", fn, pa_cstrerror(errno));
+        return -1;
+    }
+
+    s = pa_startup_trace_to_string(t, format);
+
+    if (fputs(s, f) < 0 || fputc('\n', f) < 0) {
+        pa_log("Failed to write startup trace file '%s': %s", fn, pa_cstrerror(errno));
+        r = -1;
+    }
+
+    pa_xfree(s);
+
+    if (fclose(f) != 0 && r == 0) {
+        pa_log("Failed to write startup trace file '%s': %s", fn, pa_cstrerror(errno));
+        r = -1;
+    }
+
+    if (r == 0)
+        pa_log_info("Wrote startup trace to '%s'.", fn);
+
+    return r;
+}
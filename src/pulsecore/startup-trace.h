@@ -0,0 +1,59 @@
+#ifndef foostartuptracehfoo
+#define foostartuptracehfoo
+
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#include <pulsecore/typedefs.h>
+#include <pulsecore/hook-list.h>
+#include <pulsecore/macro.h>
+
+/* Records how long the daemon spends in each step of its startup: module
+ * loads, module initialization, card probing and hook callbacks. Spans
+ * nest, and each one records wall clock and main thread CPU time. Only
+ * one core can be traced at a time, and only from the main thread. */
+
+typedef struct pa_startup_trace pa_startup_trace;
+
+typedef enum pa_startup_trace_format {
+    PA_STARTUP_TRACE_JSON,
+    PA_STARTUP_TRACE_CHROME
+} pa_startup_trace_format_t;
+
+#define PA_STARTUP_TRACE_INVALID ((unsigned) -1)
+
+/* Starts recording into c->startup_trace */
+void pa_startup_trace_start(pa_core *c);
+/* Stops recording. The trace stays in c->startup_trace until the core is
+ * freed. */
+void pa_startup_trace_stop(pa_core *c);
+void pa_startup_trace_free(pa_startup_trace *t);
+
+bool pa_startup_trace_running(void);
+
+/* Open a span and return its handle for pa_startup_trace_end(). Returns
+ * PA_STARTUP_TRACE_INVALID when no trace is running, which
+ * pa_startup_trace_end() ignores. */
+unsigned pa_startup_trace_begin(const char *category, const char *name, const char *detail);
+unsigned pa_startup_trace_begin_hook(pa_hook *hook, pa_hook_slot *slot);
+void pa_startup_trace_end(unsigned span);
+
+int pa_startup_trace_format_from_string(const char *s, pa_startup_trace_format_t *format);
+char *pa_startup_trace_to_string(pa_startup_trace *t, pa_startup_trace_format_t format);
+int pa_startup_trace_save(pa_startup_trace *t, const char *fn, pa_startup_trace_format_t format);
+
+#endif
@@ -27,6 +27,7 @@
 #include <pulsecore/thread.h>
 #include <pulsecore/semaphore.h>
 #include <pulsecore/macro.h>
+#include <pulsecore/io-trace.h>
 
 #include <pulse/mainloop-api.h>
 
@@ -216,6 +217,10 @@ void pa_thread_mq_install(pa_thread_mq *q) {
 
     pa_assert(!(PA_STATIC_TLS_GET(thread_mq)));
     PA_STATIC_TLS_SET(thread_mq, q);
+
+    /* IO threads record their first trace events while rendering, so
+     * allocate the ring now */
+    pa_io_trace_thread_init();
 }
 
 pa_thread_mq *pa_thread_mq_get(void) {
@@ -226,6 +226,39 @@ static void setup_remap_channels(
     }
 }
 
+/* Surround-style matrix where input channel 1 is unused and each output
+ * mixes its "own" input channel with some others at half level */
+static void setup_remap_sparse_channels(
+    pa_remap_t *m,
+    pa_sample_format_t f,
+    unsigned in_channels,
+    unsigned out_channels) {
+
+    unsigned i, o;
+
+    m->format = f;
+    m->i_ss.channels = in_channels;
+    m->o_ss.channels = out_channels;
+
+    for (o = 0; o < out_channels; o++) {
+        for (i = 0; i < in_channels; i++) {
+            if (i == 1) {
+                m->map_table_f[o][i] = 0.0f;
+                m->map_table_i[o][i] = 0;
+            } else if (o % in_channels == i) {
+                m->map_table_f[o][i] = 1.0f;
+                m->map_table_i[o][i] = 0x10000;
+            } else if ((o + i) % 3 == 0) {
+                m->map_table_f[o][i] = 0.5f;
+                m->map_table_i[o][i] = 0x8000;
+            } else {
+                m->map_table_f[o][i] = 0.0f;
+                m->map_table_i[o][i] = 0;
+            }
+        }
+    }
+}
+
 static void remap_test_channels(
     pa_remap_t *remap_func, pa_remap_t *remap_orig) {
 
@@ -282,6 +315,30 @@ static void remap_init_test_channels(
     init_func(&remap_func);
 
     remap_test_channels(&remap_func, &remap_orig);
+
+    pa_xfree(remap_func.state);
+    pa_xfree(remap_orig.state);
+}
+
+static void remap_init_test_sparse_channels(
+        pa_init_remap_func_t init_func,
+        pa_init_remap_func_t orig_init_func,
+        pa_sample_format_t f,
+        unsigned in_channels,
+        unsigned out_channels) {
+
+    pa_remap_t remap_orig = {0}, remap_func = {0};
+
+    setup_remap_sparse_channels(&remap_orig, f, in_channels, out_channels);
+    orig_init_func(&remap_orig);
+
+    setup_remap_sparse_channels(&remap_func, f, in_channels, out_channels);
+    init_func(&remap_func);
+
+    remap_test_channels(&remap_func, &remap_orig);
+
+    pa_xfree(remap_func.state);
+    pa_xfree(remap_orig.state);
 }
 
 static void remap_init2_test_channels(
@@ -408,6 +465,48 @@ START_TEST (remap_sse2_test) {
     remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 1, 2, false);
 }
 END_TEST
+
+START_TEST (remap_sse2_surround_test) {
+    pa_cpu_x86_flag_t flags = 0;
+    pa_init_remap_func_t init_func, orig_init_func;
+
+    pa_cpu_get_x86_flags(&flags);
+    if (!(flags & PA_CPU_X86_SSE2)) {
+        pa_log_info("SSE2 not supported. Skipping");
+        return;
+    }
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_sse(flags);
+    init_func = pa_get_init_remap_func();
+
+    pa_log_debug("Checking SSE2 remap (float, stereo->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 6, false);
+    pa_log_debug("Checking SSE2 remap (float, 5.1->7.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 6, 8, false);
+    pa_log_debug("Checking SSE2 remap (float, 7.1->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 8, 6, false);
+    pa_log_debug("Checking SSE2 remap (float, 7.1->7.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 8, 8, false);
+    pa_log_debug("Checking SSE2 remap (float, sparse 5.1->7.1)");
+    remap_init_test_sparse_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 6, 8);
+    pa_log_debug("Checking SSE2 remap (float, sparse 7.1->5.1)");
+    remap_init_test_sparse_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 8, 6);
+
+    pa_log_debug("Checking SSE2 remap (s16, stereo->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 2, 6, false);
+    pa_log_debug("Checking SSE2 remap (s16, 5.1->7.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 6, 8, false);
+    pa_log_debug("Checking SSE2 remap (s16, 7.1->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 8, 6, false);
+    pa_log_debug("Checking SSE2 remap (s16, 7.1->7.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 8, 8, false);
+    pa_log_debug("Checking SSE2 remap (s16, sparse 5.1->7.1)");
+    remap_init_test_sparse_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 6, 8);
+    pa_log_debug("Checking SSE2 remap (s16, sparse 7.1->5.1)");
+    remap_init_test_sparse_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 8, 6);
+}
+END_TEST
 #endif /* (defined (__i386__) || defined (__amd64__)) && defined (HAVE_SSE) */
 
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
@@ -464,6 +563,43 @@ START_TEST (remap_neon_test) {
 }
 END_TEST
 
+START_TEST (remap_neon_surround_test) {
+    pa_cpu_arm_flag_t flags = 0;
+    pa_init_remap_func_t init_func, orig_init_func;
+
+    pa_cpu_get_arm_flags(&flags);
+    if (!(flags & PA_CPU_ARM_NEON)) {
+        pa_log_info("NEON not supported. Skipping");
+        return;
+    }
+
+    orig_init_func = pa_get_init_remap_func();
+    pa_remap_func_init_neon(flags);
+    init_func = pa_get_init_remap_func();
+
+    pa_log_debug("Checking NEON remap (float, stereo->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 2, 6, false);
+    pa_log_debug("Checking NEON remap (float, 7.1->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 8, 6, false);
+    pa_log_debug("Checking NEON remap (float, sparse 5.1->7.1)");
+    remap_init_test_sparse_channels(init_func, orig_init_func, PA_SAMPLE_FLOAT32NE, 6, 8);
+
+    pa_log_debug("Checking NEON remap (s32, stereo->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S32NE, 2, 6, false);
+    pa_log_debug("Checking NEON remap (s32, 7.1->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S32NE, 8, 6, false);
+    pa_log_debug("Checking NEON remap (s32, sparse 5.1->7.1)");
+    remap_init_test_sparse_channels(init_func, orig_init_func, PA_SAMPLE_S32NE, 6, 8);
+
+    pa_log_debug("Checking NEON remap (s16, stereo->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 2, 6, false);
+    pa_log_debug("Checking NEON remap (s16, 7.1->5.1)");
+    remap_init_test_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 8, 6, false);
+    pa_log_debug("Checking NEON remap (s16, sparse 5.1->7.1)");
+    remap_init_test_sparse_channels(init_func, orig_init_func, PA_SAMPLE_S16NE, 6, 8);
+}
+END_TEST
+
 START_TEST (rearrange_neon_test) {
     pa_cpu_arm_flag_t flags = 0;
     pa_init_remap_func_t init_func, orig_init_func;
@@ -520,9 +656,11 @@ int main(int argc, char *argv[]) {
 #endif
 #if (defined (__i386__) || defined (__amd64__)) && defined (HAVE_SSE)
     tcase_add_test(tc, remap_sse2_test);
+    tcase_add_test(tc, remap_sse2_surround_test);
 #endif
 #if defined (__arm__) && defined (__linux__) && defined (HAVE_NEON)
     tcase_add_test(tc, remap_neon_test);
+    tcase_add_test(tc, remap_neon_surround_test);
 #endif
     tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
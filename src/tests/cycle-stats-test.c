@@ -0,0 +1,146 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+
+#include <pulse/timeval.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/cycle-stats.h>
+#include <pulsecore/log.h>
+
+START_TEST (cycle_timing_test) {
+    pa_cycle_timing t;
+    unsigned i;
+
+    memset(&t, 0, sizeof(t));
+    fail_unless(pa_cycle_timing_percentile(&t, 0.5) == 0);
+
+    /* 99 short ones and a long one */
+    for (i = 0; i < 99; i++)
+        pa_cycle_timing_add(&t, 100);
+    pa_cycle_timing_add(&t, 50000);
+
+    fail_unless(t.n == 100);
+    fail_unless(t.total == 99 * 100 + 50000);
+    fail_unless(t.max == 50000);
+
+    /* 100 usec falls into the bucket from 64 to 128 usec */
+    fail_unless(pa_cycle_timing_percentile(&t, 0.5) >= 64);
+    fail_unless(pa_cycle_timing_percentile(&t, 0.5) <= 128);
+    fail_unless(pa_cycle_timing_percentile(&t, 0.99) <= 128);
+    fail_unless(pa_cycle_timing_percentile(&t, 1) > 128);
+    fail_unless(pa_cycle_timing_percentile(&t, 1) <= 50000);
+
+    /* Whatever doesn't fit goes into the last bucket */
+    pa_cycle_timing_add(&t, 10 * PA_USEC_PER_SEC);
+    fail_unless(t.buckets[PA_CYCLE_TIMING_BUCKETS - 1] == 1);
+    fail_unless(pa_cycle_timing_percentile(&t, 1) == 10 * PA_USEC_PER_SEC);
+}
+END_TEST
+
+START_TEST (cycle_load_test) {
+    pa_cycle_stats s;
+    pa_json_encoder *encoder;
+    char *json;
+    unsigned i;
+
+    memset(&s, 0, sizeof(s));
+
+    /* Unknown headroom only counts the cycle */
+    pa_cycle_stats_add_cycle(&s, 1000, 0);
+    fail_unless(s.cycle.n == 1);
+    fail_unless(s.n_loaded == 0);
+    fail_unless(pa_cycle_stats_load_percentile(&s, 0.5) == 0);
+
+    for (i = 0; i < 9; i++)
+        pa_cycle_stats_add_cycle(&s, 1000, 20000);
+    pa_cycle_stats_add_cycle(&s, 30000, 10000);
+
+    fail_unless(s.n_loaded == 10);
+    fail_unless(s.min_headroom == 10000);
+    fail_unless(s.load[0] == 9);
+    fail_unless(s.load[PA_CYCLE_STATS_LOAD_BUCKETS - 1] == 1);
+    fail_unless(pa_cycle_stats_load_percentile(&s, 0.5) == 10);
+    fail_unless(pa_cycle_stats_load_percentile(&s, 0.99) == 100);
+
+    encoder = pa_json_encoder_new();
+    pa_json_encoder_begin_element_object(encoder);
+    pa_cycle_stats_to_json(&s, "render", encoder);
+    pa_json_encoder_end_object(encoder);
+    json = pa_json_encoder_to_string_free(encoder);
+
+    fail_unless(strstr(json, "\"render\":{\"count\":0") != NULL);
+    fail_unless(strstr(json, "\"overloaded_cycles\":1") != NULL);
+    pa_xfree(json);
+}
+END_TEST
+
+START_TEST (cycle_rewind_test) {
+    pa_cycle_stats s;
+
+    memset(&s, 0, sizeof(s));
+
+    /* Nothing to make up for yet */
+    pa_cycle_stats_add_render(&s, 1000);
+    fail_unless(s.rerendered_bytes == 0);
+
+    pa_cycle_stats_add_rewind(&s, 3000);
+    pa_cycle_stats_add_render(&s, 1000);
+    fail_unless(s.rerendered_bytes == 1000);
+
+    /* A second rewind before the first one was made up for */
+    pa_cycle_stats_add_rewind(&s, 500);
+    pa_cycle_stats_add_render(&s, 4000);
+    fail_unless(s.rewound_bytes == 3500);
+    fail_unless(s.rerendered_bytes == 3500);
+    fail_unless(s.rerender_pending == 0);
+
+    pa_cycle_stats_add_render(&s, 1000);
+    fail_unless(s.rerendered_bytes == 3500);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Cycle stats");
+    tc = tcase_create("cycle-stats");
+    tcase_add_test(tc, cycle_timing_test);
+    tcase_add_test(tc, cycle_load_test);
+    tcase_add_test(tc, cycle_rewind_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,415 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <check.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/database.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+
+#include "runtime-test-util.h"
+
+#define N_ENTRIES 20000
+#define DATA_SIZE 96
+#define TIMES 10
+#define TIMES2 10
+
+static char *dir = NULL;
+
+static void make_key(pa_datum *key, char *buf, size_t l, unsigned i) {
+    pa_snprintf(buf, l, "sink-input-by-application-name:app-%u", i);
+    key->data = buf;
+    key->size = strlen(buf);
+}
+
+static void make_data(pa_datum *data, uint8_t *buf, unsigned i, unsigned generation) {
+    unsigned j;
+
+    for (j = 0; j < DATA_SIZE; j++)
+        buf[j] = (uint8_t) (i + j + generation);
+
+    data->data = buf;
+    data->size = DATA_SIZE;
+}
+
+static pa_database *open_db(bool for_write) {
+    pa_database *db;
+
+    db = pa_database_open(dir, "test", false, for_write);
+    fail_unless(db != NULL);
+
+    return db;
+}
+
+static void fill(pa_database *db, unsigned n, unsigned generation) {
+    char kbuf[64];
+    uint8_t dbuf[DATA_SIZE];
+    pa_datum key, data;
+    unsigned i;
+
+    for (i = 0; i < n; i++) {
+        make_key(&key, kbuf, sizeof(kbuf), i);
+        make_data(&data, dbuf, i, generation);
+        fail_unless(pa_database_set(db, &key, &data, true) == 0);
+    }
+}
+
+static void check_entry(pa_database *db, unsigned i, unsigned generation) {
+    char kbuf[64];
+    uint8_t dbuf[DATA_SIZE];
+    pa_datum key, expected, data;
+
+    make_key(&key, kbuf, sizeof(kbuf), i);
+    make_data(&expected, dbuf, i, generation);
+
+    fail_unless(pa_database_get(db, &key, &data) != NULL);
+    fail_unless(data.size == expected.size);
+    fail_unless(memcmp(data.data, expected.data, data.size) == 0);
+    pa_datum_free(&data);
+}
+
+static char *get_filename(void) {
+    return pa_sprintf_malloc("%s" PA_PATH_SEP "test%s", dir, pa_database_get_filename_suffix());
+}
+
+static off_t get_file_size(void) {
+    char *fn;
+    struct stat st;
+
+    fn = get_filename();
+    fail_unless(stat(fn, &st) == 0);
+    pa_xfree(fn);
+
+    return st.st_size;
+}
+
+static void remove_files(void) {
+    char *fn, *tmp;
+
+    fn = get_filename();
+    tmp = pa_sprintf_malloc("%s.tmp", fn);
+    unlink(fn);
+    unlink(tmp);
+    pa_xfree(tmp);
+    pa_xfree(fn);
+}
+
+START_TEST (database_test) {
+    pa_database *db;
+    char kbuf[64];
+    uint8_t dbuf[DATA_SIZE];
+    pa_datum key, data, *k;
+    unsigned i;
+
+    remove_files();
+
+    db = open_db(true);
+    fail_unless(pa_database_size(db) == 0);
+
+    fill(db, 100, 0);
+    fail_unless(pa_database_size(db) == 100);
+
+    /* Don't overwrite unless asked to */
+    make_key(&key, kbuf, sizeof(kbuf), 0);
+    make_data(&data, dbuf, 0, 1);
+    fail_unless(pa_database_set(db, &key, &data, false) < 0);
+    check_entry(db, 0, 0);
+    fail_unless(pa_database_set(db, &key, &data, true) == 0);
+    check_entry(db, 0, 1);
+
+    make_key(&key, kbuf, sizeof(kbuf), 1);
+    fail_unless(pa_database_unset(db, &key) == 0);
+    fail_unless(pa_database_get(db, &key, &data) == NULL);
+    fail_unless(pa_database_size(db) == 99);
+
+    fail_unless(pa_database_sync(db) == 0);
+    pa_database_close(db);
+
+    /* Everything survives reopening */
+    db = open_db(false);
+    fail_unless(pa_database_size(db) == 99);
+    check_entry(db, 0, 1);
+    make_key(&key, kbuf, sizeof(kbuf), 1);
+    fail_unless(pa_database_get(db, &key, &data) == NULL);
+    for (i = 2; i < 100; i++)
+        check_entry(db, i, 0);
+
+    i = 0;
+    k = pa_database_first(db, &key, NULL);
+    while (k) {
+        pa_datum next = { NULL, 0 };
+
+        i++;
+        k = pa_database_next(db, &key, &next, NULL);
+        pa_datum_free(&key);
+        key = next;
+    }
+    fail_unless(i == 99);
+    pa_database_close(db);
+
+    db = open_db(true);
+    fail_unless(pa_database_clear(db) == 0);
+    fill(db, 10, 2);
+    pa_database_close(db);
+
+    db = open_db(false);
+    fail_unless(pa_database_size(db) == 10);
+    check_entry(db, 9, 2);
+    pa_database_close(db);
+
+    remove_files();
+}
+END_TEST
+
+/* Rewrites the same entries many times, syncing in between, which lets the
+ * log based backend compact its file */
+START_TEST (database_rewrite_test) {
+    pa_database *db;
+    unsigned generation;
+
+    remove_files();
+
+    db = open_db(true);
+
+    for (generation = 0; generation < 50; generation++) {
+        fill(db, 100, generation);
+        fail_unless(pa_database_sync(db) == 0);
+    }
+
+    pa_database_close(db);
+
+    db = open_db(false);
+    fail_unless(pa_database_size(db) == 100);
+    check_entry(db, 0, 49);
+    check_entry(db, 99, 49);
+    pa_database_close(db);
+
+    remove_files();
+}
+END_TEST
+
+/* Breaks the last record of the log, like a crash in the middle of writing
+ * it would. Earlier records must still be loaded, and the broken tail must be
+ * cut off before anything is appended after it. */
+static void torn_tail_test(bool truncate_tail) {
+    pa_database *db;
+    char kbuf[64];
+    uint8_t dbuf[DATA_SIZE];
+    pa_datum key, data;
+    off_t good_size, full_size;
+    char *fn;
+    unsigned i;
+
+    remove_files();
+
+    db = open_db(true);
+    fill(db, 10, 0);
+    fail_unless(pa_database_sync(db) == 0);
+    pa_database_close(db);
+    good_size = get_file_size();
+
+    db = open_db(true);
+    make_key(&key, kbuf, sizeof(kbuf), 10);
+    make_data(&data, dbuf, 10, 0);
+    fail_unless(pa_database_set(db, &key, &data, true) == 0);
+    fail_unless(pa_database_sync(db) == 0);
+    pa_database_close(db);
+    full_size = get_file_size();
+    fail_unless(full_size > good_size);
+
+    fn = get_filename();
+    if (truncate_tail)
+        fail_unless(truncate(fn, full_size - 5) == 0);
+    else {
+        FILE *f;
+        int c;
+
+        /* Flip a byte of the data, so that only the checksum notices */
+        fail_unless((f = fopen(fn, "r+")) != NULL);
+        fail_unless(fseeko(f, full_size - 1, SEEK_SET) == 0);
+        fail_unless((c = fgetc(f)) != EOF);
+        fail_unless(fseeko(f, full_size - 1, SEEK_SET) == 0);
+        fail_unless(fputc(c ^ 0xff, f) != EOF);
+        fail_unless(fclose(f) == 0);
+    }
+    pa_xfree(fn);
+
+    db = open_db(true);
+    fail_unless(pa_database_size(db) == 10);
+    for (i = 0; i < 10; i++)
+        check_entry(db, i, 0);
+    make_key(&key, kbuf, sizeof(kbuf), 10);
+    fail_unless(pa_database_get(db, &key, &data) == NULL);
+
+    /* The record has the same size as the broken one, so the file only
+     * keeps its size if the broken one was cut off first */
+    make_data(&data, dbuf, 10, 1);
+    fail_unless(pa_database_set(db, &key, &data, true) == 0);
+    fail_unless(pa_database_sync(db) == 0);
+    pa_database_close(db);
+    fail_unless(get_file_size() == full_size);
+
+    db = open_db(false);
+    fail_unless(pa_database_size(db) == 11);
+    for (i = 0; i < 10; i++)
+        check_entry(db, i, 0);
+    check_entry(db, 10, 1);
+    pa_database_close(db);
+
+    remove_files();
+}
+
+START_TEST (database_torn_tail_test) {
+    /* Only the log based backend appends to its file */
+    if (!pa_streq(pa_database_get_filename_suffix(), ".logdb"))
+        return;
+
+    torn_tail_test(true);
+    torn_tail_test(false);
+}
+END_TEST
+
+/* Keeps changing entries while earlier changes are written by the writer
+ * thread */
+START_TEST (database_async_test) {
+    pa_database *db;
+    pa_database_stats before, after;
+    unsigned generation;
+
+    remove_files();
+
+    pa_database_get_stats(&before);
+
+    db = open_db(true);
+
+    for (generation = 0; generation < 50; generation++) {
+        fill(db, 100, generation);
+        pa_database_sync_async(db);
+    }
+
+    /* Closing waits for the queued writes */
+    pa_database_close(db);
+
+    pa_database_get_stats(&after);
+    fail_unless(after.n_async_syncs == before.n_async_syncs + 50);
+    fail_unless(after.n_queued == 0);
+    fail_unless(after.n_snapshots_failed == before.n_snapshots_failed);
+
+    db = open_db(false);
+    fail_unless(pa_database_size(db) == 100);
+    check_entry(db, 0, 49);
+    check_entry(db, 99, 49);
+    pa_database_close(db);
+
+    remove_files();
+}
+END_TEST
+
+/* Times what stream-restore does: loading a big database, and saving it
+ * after small changes */
+START_TEST (database_timing_test) {
+    pa_database *db;
+    char kbuf[64];
+    uint8_t dbuf[DATA_SIZE];
+    pa_datum key, data;
+    unsigned generation = 0;
+    pa_usec_t start;
+
+    remove_files();
+
+    db = open_db(true);
+    fill(db, N_ENTRIES, 0);
+
+    start = pa_rtclock_now();
+    fail_unless(pa_database_sync(db) == 0);
+    pa_log_debug("Initial sync of %u entries: %llu usec.", N_ENTRIES, (long long unsigned) (pa_rtclock_now() - start));
+
+    PA_RUNTIME_TEST_RUN_START("sync after changing one entry", TIMES, TIMES2) {
+        generation++;
+        make_key(&key, kbuf, sizeof(kbuf), generation % N_ENTRIES);
+        make_data(&data, dbuf, generation % N_ENTRIES, generation);
+        pa_database_set(db, &key, &data, true);
+        pa_database_sync(db);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    PA_RUNTIME_TEST_RUN_START("async sync after changing one entry", TIMES, TIMES2) {
+        generation++;
+        make_key(&key, kbuf, sizeof(kbuf), generation % N_ENTRIES);
+        make_data(&data, dbuf, generation % N_ENTRIES, generation);
+        pa_database_set(db, &key, &data, true);
+        pa_database_sync_async(db);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    pa_database_close(db);
+
+    PA_RUNTIME_TEST_RUN_START("open and close", 1, TIMES2) {
+        db = open_db(false);
+        pa_database_close(db);
+    } PA_RUNTIME_TEST_RUN_STOP
+
+    db = open_db(false);
+    fail_unless(pa_database_size(db) == N_ENTRIES);
+    pa_database_close(db);
+
+    remove_files();
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    dir = pa_sprintf_malloc("%s" PA_PATH_SEP "pulse-database-test-XXXXXX", pa_get_temp_dir());
+    pa_assert_se(mkdtemp(dir));
+
+    s = suite_create("Database");
+    tc = tcase_create("database");
+    tcase_add_test(tc, database_test);
+    tcase_add_test(tc, database_rewrite_test);
+    tcase_add_test(tc, database_torn_tail_test);
+    tcase_add_test(tc, database_async_test);
+    tcase_add_test(tc, database_timing_test);
+    tcase_set_timeout(tc, 120);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    rmdir(dir);
+    pa_xfree(dir);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -41,6 +41,33 @@ START_TEST (hooklist_test) {
 }
 END_TEST
 
+START_TEST (hooklist_profiling_test) {
+    pa_hook hook;
+    pa_hook_slot *slot1, *slot2;
+
+    pa_hook_init(&hook, (void*) "hook");
+
+    slot1 = pa_hook_connect(&hook, PA_HOOK_NORMAL, (pa_hook_cb_t) func1, (void*) "slot1");
+    slot2 = pa_hook_connect(&hook, PA_HOOK_LATE, (pa_hook_cb_t) func2, (void*) "slot2");
+    fail_unless(slot1->module == NULL);
+
+    /* Not counted unless profiling is enabled */
+    pa_hook_fire(&hook, (void*) "call1");
+    fail_unless(slot1->n_calls == 0);
+
+    pa_hook_set_profiling(true);
+    pa_hook_fire(&hook, (void*) "call2");
+    pa_hook_fire(&hook, (void*) "call3");
+    pa_hook_set_profiling(false);
+    pa_hook_fire(&hook, (void*) "call4");
+
+    fail_unless(slot1->n_calls == 2);
+    fail_unless(slot2->n_calls == 2);
+
+    pa_hook_done(&hook);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -50,6 +77,7 @@ int main(int argc, char *argv[]) {
     s = suite_create("Hook List");
     tc = tcase_create("hooklist");
     tcase_add_test(tc, hooklist_test);
+    tcase_add_test(tc, hooklist_profiling_test);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
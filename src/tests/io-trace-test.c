@@ -0,0 +1,213 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as
+  published by the Free Software Foundation; either version 2.1 of the
+  License, or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <check.h>
+
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/io-trace.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/thread.h>
+
+#define N_THREADS 3
+#define N_EVENTS 1000
+#define N_FLOOD 100000
+
+static char *fn = NULL;
+
+typedef struct thread_counts {
+    char name[PA_IO_TRACE_NAME_MAX];
+    unsigned n_records;
+    unsigned n_dropped;
+    int64_t last;
+    bool in_order;
+} thread_counts;
+
+static void record_thread(void *userdata) {
+    unsigned n = PA_PTR_TO_UINT(userdata), i;
+
+    pa_io_trace_thread_init();
+
+    for (i = 0; i < n; i++)
+        pa_io_trace(PA_IO_TRACE_SINK_RENDER, 0, i, 0, 0);
+}
+
+static void run_threads(unsigned n_events) {
+    pa_thread *threads[N_THREADS];
+    unsigned i;
+
+    for (i = 0; i < N_THREADS; i++) {
+        char name[16];
+
+        pa_snprintf(name, sizeof(name), "trace-%u", i);
+        threads[i] = pa_thread_new(name, record_thread, PA_UINT_TO_PTR(n_events));
+        fail_unless(threads[i] != NULL);
+    }
+
+    for (i = 0; i < N_THREADS; i++)
+        pa_thread_free(threads[i]);
+}
+
+/* Reads the trace back, counting the records of each thread */
+static unsigned read_trace(thread_counts *counts, unsigned n_counts) {
+    FILE *f;
+    pa_io_trace_header header;
+    char names[PA_IO_TRACE_EVENT_MAX][PA_IO_TRACE_NAME_MAX];
+    pa_io_trace_record rec;
+    unsigned n_threads = 0;
+
+    memset(counts, 0, n_counts * sizeof(thread_counts));
+
+    fail_unless((f = fopen(fn, "r")) != NULL);
+    fail_unless(fread(&header, sizeof(header), 1, f) == 1);
+    fail_unless(memcmp(header.magic, PA_IO_TRACE_MAGIC, sizeof(PA_IO_TRACE_MAGIC)) == 0);
+    fail_unless(header.version == PA_IO_TRACE_VERSION);
+    fail_unless(header.n_events == PA_IO_TRACE_EVENT_MAX);
+    fail_unless(fread(names, sizeof(names), 1, f) == 1);
+    fail_unless(pa_streq(names[PA_IO_TRACE_SINK_RENDER], "sink-render"));
+
+    while (fread(&rec, sizeof(rec), 1, f) == 1) {
+        thread_counts *c;
+
+        fail_unless(rec.thread < n_counts);
+        c = &counts[rec.thread];
+
+        switch (rec.event) {
+            case PA_IO_TRACE_THREAD:
+                fail_unless(!c->name[0]);
+                memcpy(c->name, rec.args, sizeof(c->name));
+                c->last = -1;
+                c->in_order = true;
+                n_threads++;
+                break;
+
+            case PA_IO_TRACE_DROPPED:
+                c->n_dropped += (unsigned) rec.args[0];
+                break;
+
+            case PA_IO_TRACE_SINK_RENDER:
+                /* Records follow the name of their thread */
+                fail_unless(c->name[0]);
+                if (rec.args[1] <= c->last)
+                    c->in_order = false;
+                c->last = rec.args[1];
+                c->n_records++;
+                break;
+
+            default:
+                ck_abort();
+        }
+    }
+
+    fclose(f);
+
+    return n_threads;
+}
+
+START_TEST (io_trace_test) {
+    thread_counts counts[2 * N_THREADS + 1];
+    unsigned i, n;
+
+    fail_unless(!pa_io_trace_running());
+
+    /* Nothing is recorded while no trace is running */
+    run_threads(10);
+
+    fail_unless(pa_io_trace_start(fn) == 0);
+    fail_unless(pa_io_trace_running());
+
+    run_threads(N_EVENTS);
+
+    pa_io_trace_stop();
+    fail_unless(!pa_io_trace_running());
+
+    n = read_trace(counts, PA_ELEMENTSOF(counts));
+    fail_unless(n == N_THREADS);
+
+    for (i = 0; i < PA_ELEMENTSOF(counts); i++) {
+        if (!counts[i].name[0])
+            continue;
+
+        fail_unless(strncmp(counts[i].name, "trace-", 6) == 0);
+        fail_unless(counts[i].n_records == N_EVENTS);
+        fail_unless(counts[i].n_dropped == 0);
+        fail_unless(counts[i].in_order);
+    }
+}
+END_TEST
+
+/* Threads that record faster than the trace is flushed drop records, but
+ * account for them */
+START_TEST (io_trace_overflow_test) {
+    thread_counts counts[4 * N_THREADS + 1];
+    unsigned i, n;
+
+    fail_unless(pa_io_trace_start(fn) == 0);
+    run_threads(N_FLOOD);
+    pa_io_trace_stop();
+
+    n = read_trace(counts, PA_ELEMENTSOF(counts));
+    fail_unless(n == N_THREADS);
+
+    for (i = 0; i < PA_ELEMENTSOF(counts); i++) {
+        if (!counts[i].name[0])
+            continue;
+
+        pa_log_debug("%s: %u records, %u dropped", counts[i].name, counts[i].n_records, counts[i].n_dropped);
+        fail_unless(counts[i].n_records + counts[i].n_dropped == N_FLOOD);
+        fail_unless(counts[i].in_order);
+    }
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    fn = pa_sprintf_malloc("%s" PA_PATH_SEP "pulse-io-trace-test-%lu", pa_get_temp_dir(), (unsigned long) getpid());
+
+    s = suite_create("IO trace");
+    tc = tcase_create("io-trace");
+    tcase_add_test(tc, io_trace_test);
+    tcase_add_test(tc, io_trace_overflow_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    unlink(fn);
+    pa_xfree(fn);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -21,10 +21,14 @@
 
 #include <check.h>
 
+#include <math.h>
+
 #include <pulse/pulseaudio.h>
+#include <pulse/rtclock.h>
 #include <pulse/sample.h>
 #include <pulsecore/memblock.h>
 
+#include <pulsecore/filter/crossover.h>
 #include <pulsecore/filter/lfe-filter.h>
 
 struct lfe_filter_test {
@@ -38,6 +42,8 @@ static uint8_t *ori_sample_ptr;
 #define ONE_BLOCK_SAMPLES 4096
 #define TOTAL_SAMPLES 8192
 #define TOLERANT_VARIATION 1
+#define BENCHMARK_FRAMES 1024
+#define BENCHMARK_TIMES 1000
 
 static void save_data_block(struct lfe_filter_test *lft, void *d, pa_memblock *blk) {
     uint8_t *dst = d, *src;
@@ -172,6 +178,97 @@ START_TEST (lfe_filter_test) {
 }
 END_TEST
 
+/* Filter the same input with the multi-channel filter bank and with one
+ * scalar LR4 filter per channel, check that both agree and report the
+ * processing cost per frame. */
+static void lr4_bank_check(unsigned channels, pa_sample_format_t format) {
+    struct lr4 lr4[PA_CHANNELS_MAX];
+    struct lr4_bank bank;
+    void *in, *out_ref, *out;
+    size_t n = BENCHMARK_FRAMES * channels;
+    pa_usec_t start, stop;
+    unsigned c, i;
+
+    lr4_bank_init(&bank, channels);
+    for (c = 0; c < channels; c++) {
+        enum biquad_type type = c == channels - 1 ? BQ_LOWPASS : BQ_HIGHPASS;
+
+        lr4_set(&lr4[c], type, 120.0f / (48000 / 2));
+        lr4_bank_set(&bank, c, type, 120.0f / (48000 / 2));
+    }
+
+    if (format == PA_SAMPLE_FLOAT32NE) {
+        float *f;
+
+        in = f = pa_xnew(float, n);
+        for (i = 0; i < n; i++)
+            f[i] = 2.0f * (random() / (float) RAND_MAX - 0.5f);
+        out_ref = pa_xnew(float, n);
+        out = pa_xnew(float, n);
+
+        for (c = 0; c < channels; c++)
+            lr4_process_float32(&lr4[c], BENCHMARK_FRAMES, channels, (float *) in + c, (float *) out_ref + c);
+        lr4_bank_process_float32(&bank, BENCHMARK_FRAMES, in, out);
+
+        for (i = 0; i < n; i++)
+            fail_unless(fabsf(((float *) out)[i] - ((float *) out_ref)[i]) <= 0.0001f);
+    } else {
+        short *d;
+
+        in = d = pa_xnew(short, n);
+        for (i = 0; i < n; i++)
+            d[i] = random();
+        out_ref = pa_xnew(short, n);
+        out = pa_xnew(short, n);
+
+        for (c = 0; c < channels; c++)
+            lr4_process_s16(&lr4[c], BENCHMARK_FRAMES, channels, (short *) in + c, (short *) out_ref + c);
+        lr4_bank_process_s16(&bank, BENCHMARK_FRAMES, in, out);
+
+        for (i = 0; i < n; i++)
+            fail_unless(abs(((short *) out)[i] - ((short *) out_ref)[i]) <= TOLERANT_VARIATION);
+    }
+
+    start = pa_rtclock_now();
+    for (i = 0; i < BENCHMARK_TIMES; i++) {
+        if (format == PA_SAMPLE_FLOAT32NE)
+            for (c = 0; c < channels; c++)
+                lr4_process_float32(&lr4[c], BENCHMARK_FRAMES, channels, (float *) in + c, (float *) out_ref + c);
+        else
+            for (c = 0; c < channels; c++)
+                lr4_process_s16(&lr4[c], BENCHMARK_FRAMES, channels, (short *) in + c, (short *) out_ref + c);
+    }
+    stop = pa_rtclock_now();
+    pa_log_debug("%s, %u channels, per-channel filters: %.2f ns/frame", pa_sample_format_to_string(format), channels,
+                 (stop - start) * 1000.0 / (BENCHMARK_TIMES * BENCHMARK_FRAMES));
+
+    start = pa_rtclock_now();
+    for (i = 0; i < BENCHMARK_TIMES; i++) {
+        if (format == PA_SAMPLE_FLOAT32NE)
+            lr4_bank_process_float32(&bank, BENCHMARK_FRAMES, in, out);
+        else
+            lr4_bank_process_s16(&bank, BENCHMARK_FRAMES, in, out);
+    }
+    stop = pa_rtclock_now();
+    pa_log_debug("%s, %u channels, filter bank: %.2f ns/frame", pa_sample_format_to_string(format), channels,
+                 (stop - start) * 1000.0 / (BENCHMARK_TIMES * BENCHMARK_FRAMES));
+
+    pa_xfree(in);
+    pa_xfree(out_ref);
+    pa_xfree(out);
+}
+
+START_TEST (lr4_bank_test) {
+    lr4_bank_check(2, PA_SAMPLE_FLOAT32NE);
+    lr4_bank_check(6, PA_SAMPLE_FLOAT32NE);
+    lr4_bank_check(8, PA_SAMPLE_FLOAT32NE);
+
+    lr4_bank_check(2, PA_SAMPLE_S16NE);
+    lr4_bank_check(6, PA_SAMPLE_S16NE);
+    lr4_bank_check(8, PA_SAMPLE_S16NE);
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -184,7 +281,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("lfe-filter");
     tc = tcase_create("lfe-filter");
     tcase_add_test(tc, lfe_filter_test);
-    tcase_set_timeout(tc, 10);
+    tcase_add_test(tc, lr4_bank_test);
+    tcase_set_timeout(tc, 60);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
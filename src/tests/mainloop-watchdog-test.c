@@ -0,0 +1,155 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <check.h>
+
+#include <pulse/rtclock.h>
+#include <pulse/timeval.h>
+#include <pulse/util.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-rtclock.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/json.h>
+#include <pulsecore/log.h>
+#include <pulsecore/mainloop-watchdog.h>
+
+static int fds[2] = { -1, -1 };
+static unsigned n_io, n_time, n_defer, n_destroyed;
+
+static void destroy_cb(pa_mainloop_api *a, void *e, void *userdata) {
+    n_destroyed++;
+}
+
+static void io_cb(pa_mainloop_api *a, pa_io_event *e, int fd, pa_io_event_flags_t events, void *userdata) {
+    char c;
+
+    fail_unless(fd == fds[0]);
+    fail_unless(userdata == &n_io);
+    fail_unless(read(fd, &c, 1) == 1);
+
+    n_io++;
+    a->io_free(e);
+
+    /* Stall on purpose */
+    pa_msleep(20);
+
+    a->quit(a, 42);
+}
+
+static void time_cb(pa_mainloop_api *a, pa_time_event *e, const struct timeval *tv, void *userdata) {
+    fail_unless(userdata == &n_time);
+
+    n_time++;
+    fail_unless(write(fds[1], "x", 1) == 1);
+}
+
+static void defer_cb(pa_mainloop_api *a, pa_defer_event *e, void *userdata) {
+    struct timeval tv;
+    pa_time_event *t;
+
+    fail_unless(userdata == &n_defer);
+
+    n_defer++;
+    a->defer_enable(e, 0);
+
+    t = a->time_new(a, pa_timeval_rtstore(&tv, pa_rtclock_now() + 1000, true), time_cb, &n_time);
+    a->time_set_destroy(t, (pa_time_event_destroy_cb_t) destroy_cb);
+}
+
+static int64_t get_member(const pa_json_object *o, const char *name) {
+    const pa_json_object *m;
+
+    fail_unless((m = pa_json_object_get_object_member(o, name)) != NULL);
+    return pa_json_object_get_int(m);
+}
+
+START_TEST (mainloop_watchdog_test) {
+    pa_mainloop *m;
+    pa_mainloop_watchdog *w;
+    pa_mainloop_api *a;
+    pa_io_event *io;
+    pa_defer_event *d;
+    pa_json_object *o;
+    char *json;
+    int retval = 0;
+
+    fail_unless(pipe(fds) == 0);
+
+    m = pa_mainloop_new();
+    w = pa_mainloop_watchdog_new(m, 10 * PA_USEC_PER_MSEC);
+    a = pa_mainloop_watchdog_get_api(w);
+    fail_unless(a != pa_mainloop_get_api(m));
+
+    io = a->io_new(a, fds[0], PA_IO_EVENT_INPUT, io_cb, &n_io);
+    a->io_set_destroy(io, (pa_io_event_destroy_cb_t) destroy_cb);
+    d = a->defer_new(a, defer_cb, &n_defer);
+    a->defer_set_destroy(d, (pa_defer_event_destroy_cb_t) destroy_cb);
+
+    fail_unless(pa_mainloop_watchdog_run(w, &retval) == 1);
+    fail_unless(retval == 42);
+    fail_unless(n_io == 1 && n_time == 1 && n_defer == 1);
+
+    json = pa_mainloop_watchdog_stats_to_json(w);
+    pa_log_debug("%s", json);
+    fail_unless((o = pa_json_parse(json)) != NULL);
+    fail_unless(get_member(o, "iterations") >= 2);
+    fail_unless(get_member(o, "stalls") == 1);
+    fail_unless(get_member(o, "worst_stall_usec") >= 20 * PA_USEC_PER_MSEC);
+    fail_unless(get_member(pa_json_object_get_object_member(o, "io"), "calls") == 1);
+    fail_unless(get_member(pa_json_object_get_object_member(o, "time"), "calls") == 1);
+    fail_unless(get_member(pa_json_object_get_object_member(o, "defer"), "calls") == 1);
+    pa_json_object_free(o);
+    pa_xfree(json);
+
+    /* Destroying the events of the main loop frees the wrapping ones */
+    pa_mainloop_free(m);
+    fail_unless(n_destroyed == 3);
+
+    pa_mainloop_watchdog_free(w);
+
+    pa_close_pipe(fds);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Main loop watchdog");
+    tc = tcase_create("mainloopwatchdog");
+    tcase_add_test(tc, mainloop_watchdog_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -24,14 +24,21 @@
 
 #include <check.h>
 
+#include <pulse/rtclock.h>
 #include <pulse/sample.h>
 #include <pulse/volume.h>
+#include <pulse/xmalloc.h>
 
+#include <pulsecore/cpu.h>
 #include <pulsecore/macro.h>
 #include <pulsecore/endianmacros.h>
 #include <pulsecore/memblock.h>
 #include <pulsecore/sample-util.h>
 #include <pulsecore/mix.h>
+#include <pulsecore/random.h>
+
+#define SPECIAL_FRAMES 4800
+#define SPECIAL_TIMES 200
 
 /* PA_SAMPLE_U8 */
 static const uint8_t u8_result[3][10] = {
@@ -342,6 +349,116 @@ START_TEST (mix_test) {
 }
 END_TEST
 
+static void reset_special_streams(pa_mix_info streams[], unsigned nstreams, void *in[]) {
+    unsigned i;
+
+    for (i = 0; i < nstreams; i++)
+        streams[i].ptr = in[i];
+}
+
+static pa_usec_t run_special_mix(pa_do_mix_func_t func, pa_mix_info streams[], unsigned nstreams, void *in[],
+                                 unsigned channels, void *out, unsigned length) {
+    pa_usec_t start;
+    unsigned t;
+
+    start = pa_rtclock_now();
+
+    for (t = 0; t < SPECIAL_TIMES; t++) {
+        reset_special_streams(streams, nstreams, in);
+        func(streams, nstreams, channels, out, length);
+    }
+
+    return pa_rtclock_now() - start;
+}
+
+static void check_special_mix(pa_sample_format_t format, unsigned channels, unsigned nstreams,
+                              pa_do_mix_func_t generic_func, pa_do_mix_func_t special_func) {
+    pa_sample_spec ss;
+    pa_mix_info streams[6];
+    void *in[6], *out, *out_ref;
+    size_t length;
+    pa_usec_t generic_time, special_time;
+    unsigned i, c, j;
+
+    pa_assert(nstreams <= PA_ELEMENTSOF(streams));
+
+    ss.format = format;
+    ss.channels = channels;
+    ss.rate = 48000;
+    length = SPECIAL_FRAMES * pa_frame_size(&ss);
+
+    for (i = 0; i < nstreams; i++) {
+        in[i] = pa_xmalloc(length);
+
+        if (format == PA_SAMPLE_FLOAT32NE) {
+            float *f = in[i];
+            int16_t r;
+
+            for (j = 0; j < length / sizeof(float); j++) {
+                pa_random(&r, sizeof(r));
+                f[j] = r / (float) 0x8000;
+            }
+        } else
+            pa_random(in[i], length);
+
+        /* Use different volumes for all streams and channels, mute the last
+         * channel of the first stream */
+        for (c = 0; c < channels; c++) {
+            double v = (i == 0 && c == channels - 1) ? 0.0 : 0.2 + 0.1 * ((i + c) % 8);
+
+            if (format == PA_SAMPLE_FLOAT32NE)
+                streams[i].linear[c].f = (float) v;
+            else
+                streams[i].linear[c].i = (int32_t) lrint(v * 0x10000);
+        }
+    }
+
+    out = pa_xmalloc(length);
+    out_ref = pa_xmalloc(length);
+
+    generic_time = run_special_mix(generic_func, streams, nstreams, in, channels, out_ref, length);
+    special_time = run_special_mix(special_func, streams, nstreams, in, channels, out, length);
+
+    fail_unless(memcmp(out, out_ref, length) == 0);
+
+    pa_log_info("%s, %u channels, %u streams: generic %llu usec, special %llu usec, speedup %.2f",
+                pa_sample_format_to_string(format), channels, nstreams,
+                (long long unsigned) generic_time, (long long unsigned) special_time,
+                (double) generic_time / PA_MAX(special_time, 1U));
+
+    for (i = 0; i < nstreams; i++)
+        pa_xfree(in[i]);
+    pa_xfree(out);
+    pa_xfree(out_ref);
+}
+
+START_TEST (mix_special_test) {
+    static const pa_sample_format_t formats[] = { PA_SAMPLE_S16NE, PA_SAMPLE_S32NE, PA_SAMPLE_FLOAT32NE };
+    static const unsigned channels[] = { 1, 2, 3, 4, 6, 8 };
+    static const unsigned nstreams[] = { 2, 3, 4, 6 };
+    pa_cpu_info cpu_info = { PA_CPU_UNDEFINED, {}, false };
+    pa_do_mix_func_t generic_func, special_func;
+    unsigned f, c, n;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    for (f = 0; f < PA_ELEMENTSOF(formats); f++) {
+        cpu_info.force_generic_code = true;
+        pa_mix_func_init(&cpu_info);
+        generic_func = pa_get_mix_func(formats[f]);
+
+        cpu_info.force_generic_code = false;
+        pa_mix_func_init(&cpu_info);
+        special_func = pa_get_mix_func(formats[f]);
+
+        for (c = 0; c < PA_ELEMENTSOF(channels); c++)
+            for (n = 0; n < PA_ELEMENTSOF(nstreams); n++)
+                check_special_mix(formats[f], channels[c], nstreams[n], generic_func, special_func);
+    }
+}
+END_TEST
+
 int main(int argc, char *argv[]) {
     int failed = 0;
     Suite *s;
@@ -351,6 +468,8 @@ int main(int argc, char *argv[]) {
     s = suite_create("Mix");
     tc = tcase_create("mix");
     tcase_add_test(tc, mix_test);
+    tcase_add_test(tc, mix_special_test);
+    tcase_set_timeout(tc, 120);
     suite_add_tcase(s, tc);
 
     sr = srunner_create(s);
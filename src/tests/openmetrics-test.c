@@ -0,0 +1,213 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/client.h>
+#include <pulsecore/core.h>
+#include <pulsecore/core-util.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/openmetrics.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+#define PREFIX "pulseaudio_"
+
+static pa_rtpoll *rtpoll;
+static pa_thread_mq thread_mq;
+
+static void thread_func(void *userdata) {
+    pa_thread_mq_install(&thread_mq);
+
+    for (;;) {
+        int ret;
+
+        if ((ret = pa_rtpoll_run(rtpoll)) < 0)
+            pa_assert_not_reached();
+
+        if (ret == 0)
+            break;
+    }
+}
+
+/* Checks that each family is declared with a TYPE and a HELP line before its
+ * samples, that the samples of counters and only those carry the _total
+ * suffix, and that the exposition ends with a single # EOF line */
+static void check_exposition(const char *text) {
+    const char *line, *end;
+    char family[128] = "", type[16] = "";
+    unsigned n_families = 0, n_samples = 0;
+    bool eof = false;
+
+    for (line = text; *line; line = end + 1) {
+        char name[128];
+        size_t len;
+
+        fail_unless(!eof);
+        fail_unless((end = strchr(line, '\n')) != NULL);
+        len = (size_t) (end - line);
+
+        if (pa_startswith(line, "# TYPE ")) {
+            fail_unless(sscanf(line, "# TYPE %127s %15s", family, type) == 2);
+            fail_unless(pa_startswith(family, PREFIX));
+            fail_unless(pa_streq(type, "gauge") || pa_streq(type, "counter"));
+            fail_unless(!pa_endswith(family, "_total"));
+            n_families++;
+        } else if (pa_startswith(line, "# HELP ")) {
+            fail_unless(sscanf(line, "# HELP %127s", name) == 1);
+            fail_unless(pa_streq(name, family));
+            fail_unless(len > strlen("# HELP ") + strlen(name) + 1);
+        } else if (len == strlen("# EOF") && pa_startswith(line, "# EOF"))
+            eof = true;
+        else {
+            size_t name_len = strcspn(line, "{ ");
+            char *expected;
+
+            fail_unless(line[0] != '#');
+            fail_unless(name_len < sizeof(name));
+            memcpy(name, line, name_len);
+            name[name_len] = 0;
+
+            if (pa_streq(type, "counter"))
+                expected = pa_sprintf_malloc("%s_total", family);
+            else
+                expected = pa_xstrdup(family);
+            fail_unless(pa_streq(name, expected));
+            pa_xfree(expected);
+
+            n_samples++;
+        }
+    }
+
+    fail_unless(eof);
+    fail_unless(n_families > 0);
+    fail_unless(n_samples > 0);
+}
+
+START_TEST (openmetrics_test) {
+    pa_mainloop *m;
+    pa_core *core;
+    pa_thread *thread;
+    pa_sink_new_data sink_data;
+    pa_sink *sink;
+    pa_client_new_data client_data;
+    pa_client *client;
+    pa_sample_spec ss = { .format = PA_SAMPLE_S16LE, .rate = 44100, .channels = 2 };
+    char *text;
+
+    m = pa_mainloop_new();
+    fail_unless(m != NULL);
+
+    core = pa_core_new(pa_mainloop_get_api(m), false, false, 0);
+    fail_unless(core != NULL);
+
+    rtpoll = pa_rtpoll_new();
+    fail_unless(pa_thread_mq_init(&thread_mq, core->mainloop, rtpoll) == 0);
+
+    pa_sink_new_data_init(&sink_data);
+    sink_data.driver = __FILE__;
+    pa_sink_new_data_set_name(&sink_data, "metrics-test");
+    pa_sink_new_data_set_sample_spec(&sink_data, &ss);
+    pa_proplist_sets(sink_data.proplist, PA_PROP_DEVICE_DESCRIPTION, "Metrics Test Sink");
+    sink = pa_sink_new(core, &sink_data, 0);
+    pa_sink_new_data_done(&sink_data);
+    fail_unless(sink != NULL);
+
+    pa_sink_set_asyncmsgq(sink, thread_mq.inq);
+    pa_sink_set_rtpoll(sink, rtpoll);
+
+    thread = pa_thread_new("openmetrics-test", thread_func, NULL);
+    fail_unless(thread != NULL);
+
+    pa_sink_put(sink);
+    pa_atomic_store(&sink->n_underruns, 3);
+
+    pa_client_new_data_init(&client_data);
+    client_data.driver = __FILE__;
+    pa_proplist_sets(client_data.proplist, PA_PROP_APPLICATION_NAME, "say \"hi\"\\\nbye");
+    client = pa_client_new(core, &client_data);
+    pa_client_new_data_done(&client_data);
+    fail_unless(client != NULL);
+    client->bytes_received = 1234;
+
+    text = pa_openmetrics_to_string(core);
+    pa_log_debug("\n%s", text);
+
+    check_exposition(text);
+
+    /* One sample of each kind */
+    fail_unless(strstr(text, "\n" PREFIX "mempool_allocations_total ") != NULL);
+    fail_unless(strstr(text, "\n" PREFIX "sink_underruns_total{sink=\"metrics-test\"} 3\n") != NULL);
+    fail_unless(strstr(text, "\n" PREFIX "source_overruns_total{source=\"metrics-test.monitor\"} 0\n") != NULL);
+    fail_unless(strstr(text, "\n" PREFIX "clients 1\n") != NULL);
+
+    /* Quotes, backslashes and line feeds are escaped in label values */
+    fail_unless(strstr(text, "\n" PREFIX "client_received_bytes_total{client=\"0\",application=\"say \\\"hi\\\"\\\\\\nbye\"} 1234\n") != NULL);
+
+    fail_unless(pa_endswith(text, "\n# EOF\n"));
+
+    pa_xfree(text);
+
+    pa_client_free(client);
+
+    pa_sink_unlink(sink);
+    pa_sink_unref(sink);
+
+    pa_asyncmsgq_send(thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(thread);
+
+    pa_thread_mq_done(&thread_mq);
+    pa_rtpoll_free(rtpoll);
+    pa_core_unref(core);
+    pa_mainloop_free(m);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("OpenMetrics");
+    tc = tcase_create("openmetrics");
+    tcase_add_test(tc, openmetrics_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
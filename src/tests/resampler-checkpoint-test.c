@@ -0,0 +1,355 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include <check.h>
+
+#include <pulse/mainloop.h>
+#include <pulse/sample.h>
+
+#include <pulsecore/core.h>
+#include <pulsecore/log.h>
+#include <pulsecore/macro.h>
+#include <pulsecore/memblock.h>
+#include <pulsecore/memblockq.h>
+#include <pulsecore/resampler.h>
+#include <pulsecore/rtpoll.h>
+#include <pulsecore/sample-util.h>
+#include <pulsecore/sink.h>
+#include <pulsecore/sink-input.h>
+#include <pulsecore/thread.h>
+#include <pulsecore/thread-mq.h>
+
+#define BLOCK_FRAMES 256
+#define N_BLOCKS 20
+
+#define SINK_MESSAGE_RUN_SCENARIO PA_SINK_MESSAGE_MAX
+
+static pa_mempool *pool;
+static pa_sample_spec in_ss = { .format = PA_SAMPLE_FLOAT32NE, .rate = 48000, .channels = 1 };
+static pa_sample_spec out_ss = { .format = PA_SAMPLE_FLOAT32NE, .rate = 44100, .channels = 1 };
+
+/* Resamples one block like a sink input does: the input goes to the history
+ * queue, and is dropped from it once it has been rendered */
+static void render_block(pa_resampler *r, pa_memblockq *history) {
+    pa_memchunk in, out;
+    float *d;
+    unsigned i;
+
+    in.memblock = pa_memblock_new(pool, BLOCK_FRAMES * pa_frame_size(&in_ss));
+    in.index = 0;
+    in.length = pa_memblock_get_length(in.memblock);
+
+    d = pa_memblock_acquire(in.memblock);
+    for (i = 0; i < BLOCK_FRAMES; i++)
+        d[i] = (i & 16) ? 0.5f : -0.5f;
+    pa_memblock_release(in.memblock);
+
+    pa_memblockq_push(history, &in);
+    pa_resampler_run(r, &in, &out);
+    pa_resampler_save_checkpoint(r, pa_memblockq_get_write_index(history));
+    pa_memblockq_drop(history, in.length);
+
+    pa_memblock_unref(in.memblock);
+    if (out.memblock)
+        pa_memblock_unref(out.memblock);
+}
+
+START_TEST (checkpoint_flush_test) {
+    pa_resampler *r;
+    pa_memblockq *history;
+    pa_memchunk silence;
+    size_t block_size, rewind_size;
+    unsigned i;
+
+    pool = pa_mempool_new(PA_MEM_TYPE_PRIVATE, 0, true);
+    fail_unless(pool != NULL);
+
+    /* The trivial resampler can save its state */
+    r = pa_resampler_new(pool, &in_ss, NULL, &out_ss, NULL, 0, PA_RESAMPLER_TRIVIAL, 0);
+    fail_unless(r != NULL);
+
+    block_size = BLOCK_FRAMES * pa_frame_size(&in_ss);
+
+    silence.memblock = pa_silence_memblock(pa_memblock_new(pool, block_size), &in_ss);
+    silence.index = 0;
+    silence.length = block_size;
+    history = pa_memblockq_new("checkpoint-test", 0, 64 * block_size, 0, &in_ss, 0, 1, 64 * block_size, &silence);
+    pa_memblock_unref(silence.memblock);
+
+    for (i = 0; i < N_BLOCKS; i++)
+        render_block(r, history);
+    fail_unless(r->n_checkpoints == N_BLOCKS);
+
+    /* A flush that does not move the history index backwards must still
+     * invalidate the checkpoints */
+    pa_memblockq_flush_write(history, true);
+    pa_resampler_drop_checkpoints(r);
+    fail_unless(r->n_checkpoints == 0);
+
+    render_block(r, history);
+    render_block(r, history);
+    fail_unless(r->n_checkpoints == 2);
+
+    /* Rewind to the middle of the first block after the flush. Both new
+     * checkpoints are after that position, and the ones from before the
+     * flush must not be restored, so the history has to be replayed. */
+    rewind_size = block_size + block_size / 2;
+    pa_memblockq_rewind(history, rewind_size);
+    pa_resampler_rewind(r, pa_resampler_result(r, rewind_size), history, block_size / 2);
+    fail_unless(r->n_checkpoints == 0);
+
+    pa_memblockq_free(history);
+    pa_resampler_free(r);
+    pa_mempool_unref(pool);
+}
+END_TEST
+
+/* What the IO thread saw while running the sink input scenario */
+struct scenario {
+    unsigned n_played;
+    bool underrun_processed;
+    unsigned n_after_underrun;
+    unsigned n_resumed;
+    unsigned n_after_rewind;
+    unsigned n_after_flush;
+    unsigned n_after_flush_rewind;
+};
+
+static pa_core *core;
+static pa_rtpoll *rtpoll;
+static pa_thread_mq thread_mq;
+static pa_sink *sink;
+static pa_sink_input *input;
+static bool have_data;
+
+/* Called from IO context */
+static int sink_input_pop_cb(pa_sink_input *i, size_t length, pa_memchunk *chunk) {
+    float *d;
+    size_t n;
+
+    if (!have_data)
+        return -1;
+
+    chunk->memblock = pa_memblock_new(core->mempool, length);
+    chunk->index = 0;
+    chunk->length = pa_memblock_get_length(chunk->memblock);
+
+    d = pa_memblock_acquire(chunk->memblock);
+    for (n = 0; n < chunk->length / sizeof(float); n++)
+        d[n] = (n & 16) ? 0.5f : -0.5f;
+    pa_memblock_release(chunk->memblock);
+
+    return 0;
+}
+
+/* Called from IO context */
+static void sink_input_process_rewind_cb(pa_sink_input *i, size_t nbytes) {
+}
+
+/* Called from IO context */
+static bool sink_input_process_underrun_cb(pa_sink_input *i) {
+    /* Everything that was written has been played */
+    return true;
+}
+
+/* Called from main context */
+static void sink_input_kill_cb(pa_sink_input *i) {
+}
+
+/* Called from IO context */
+static void render_blocks(unsigned n) {
+    pa_memchunk chunk;
+
+    for (; n > 0; n--) {
+        pa_sink_render_full(sink, BLOCK_FRAMES * pa_frame_size(&sink->sample_spec), &chunk);
+        pa_memblock_unref(chunk.memblock);
+    }
+}
+
+/* Called from IO context */
+static void rewind_sink(bool rewrite, size_t nbytes) {
+    pa_sink_input_request_rewind(input, 0, rewrite, !rewrite, false);
+    pa_sink_process_rewind(sink, nbytes);
+}
+
+/* Called from IO context. Plays, underruns, resumes and rewinds the sink
+ * input, and records the checkpoints the resampler holds after each step. */
+static void run_scenario(struct scenario *sc) {
+    pa_resampler *r = input->thread_info.resampler;
+    size_t block_size = BLOCK_FRAMES * pa_frame_size(&sink->sample_spec);
+
+    pa_assert(r);
+
+    have_data = true;
+    render_blocks(N_BLOCKS);
+    sc->n_played = r->n_checkpoints;
+
+    /* The history is silenced when the underrun is processed, so the
+     * checkpoints into it are stale */
+    have_data = false;
+    render_blocks(2);
+    sc->underrun_processed = pa_sink_input_process_underrun(input);
+    sc->n_after_underrun = r->n_checkpoints;
+
+    have_data = true;
+    render_blocks(2);
+    sc->n_resumed = r->n_checkpoints;
+
+    /* Rewrite everything that was played after the underrun. The only
+     * checkpoints before the rewind position are the stale ones. */
+    rewind_sink(true, 4 * block_size);
+    sc->n_after_rewind = r->n_checkpoints;
+
+    /* A flush drops the history without moving its index backwards */
+    render_blocks(N_BLOCKS);
+    rewind_sink(false, 2 * block_size);
+    sc->n_after_flush = r->n_checkpoints;
+
+    render_blocks(2);
+    rewind_sink(true, 2 * block_size);
+    sc->n_after_flush_rewind = r->n_checkpoints;
+}
+
+/* Called from IO context */
+static int sink_process_msg(pa_msgobject *o, int code, void *data, int64_t offset, pa_memchunk *chunk) {
+    if (code == SINK_MESSAGE_RUN_SCENARIO) {
+        run_scenario(data);
+        return 0;
+    }
+
+    return pa_sink_process_msg(o, code, data, offset, chunk);
+}
+
+static void thread_func(void *userdata) {
+    pa_thread_mq_install(&thread_mq);
+
+    for (;;) {
+        int ret;
+
+        if ((ret = pa_rtpoll_run(rtpoll)) < 0)
+            pa_assert_not_reached();
+
+        if (ret == 0)
+            break;
+    }
+}
+
+START_TEST (sink_input_checkpoint_test) {
+    pa_mainloop *m;
+    pa_thread *thread;
+    pa_sink_new_data sink_data;
+    pa_sink_input_new_data input_data;
+    pa_sample_spec sink_ss = out_ss, input_ss = in_ss;
+    struct scenario sc;
+
+    m = pa_mainloop_new();
+    fail_unless(m != NULL);
+
+    core = pa_core_new(pa_mainloop_get_api(m), false, false, 0);
+    fail_unless(core != NULL);
+
+    rtpoll = pa_rtpoll_new();
+    fail_unless(pa_thread_mq_init(&thread_mq, core->mainloop, rtpoll) == 0);
+
+    pa_sink_new_data_init(&sink_data);
+    sink_data.driver = __FILE__;
+    pa_sink_new_data_set_name(&sink_data, "checkpoint-test");
+    pa_sink_new_data_set_sample_spec(&sink_data, &sink_ss);
+    pa_proplist_sets(sink_data.proplist, PA_PROP_DEVICE_DESCRIPTION, "Checkpoint Test Sink");
+    sink = pa_sink_new(core, &sink_data, 0);
+    pa_sink_new_data_done(&sink_data);
+    fail_unless(sink != NULL);
+
+    sink->parent.process_msg = sink_process_msg;
+    pa_sink_set_asyncmsgq(sink, thread_mq.inq);
+    pa_sink_set_rtpoll(sink, rtpoll);
+    pa_sink_set_max_rewind(sink, 8 * BLOCK_FRAMES * pa_frame_size(&sink_ss));
+    pa_sink_set_max_request(sink, BLOCK_FRAMES * pa_frame_size(&sink_ss));
+
+    thread = pa_thread_new("checkpoint-test", thread_func, NULL);
+    fail_unless(thread != NULL);
+
+    pa_sink_put(sink);
+
+    pa_sink_input_new_data_init(&input_data);
+    input_data.driver = __FILE__;
+    pa_sink_input_new_data_set_sink(&input_data, sink, false, true);
+    pa_sink_input_new_data_set_sample_spec(&input_data, &input_ss);
+    input_data.resample_method = PA_RESAMPLER_TRIVIAL;
+    fail_unless(pa_sink_input_new(&input, core, &input_data) == 0);
+    pa_sink_input_new_data_done(&input_data);
+
+    input->pop = sink_input_pop_cb;
+    input->process_rewind = sink_input_process_rewind_cb;
+    input->process_underrun = sink_input_process_underrun_cb;
+    input->kill = sink_input_kill_cb;
+    pa_sink_input_put(input);
+
+    pa_zero(sc);
+    pa_asyncmsgq_send(sink->asyncmsgq, PA_MSGOBJECT(sink), SINK_MESSAGE_RUN_SCENARIO, &sc, 0, NULL);
+
+    fail_unless(sc.n_played > 0);
+    fail_unless(sc.underrun_processed);
+    fail_unless(sc.n_after_underrun == 0);
+    fail_unless(sc.n_resumed > 0);
+    fail_unless(sc.n_after_rewind == 0);
+    fail_unless(sc.n_after_flush == 0);
+    fail_unless(sc.n_after_flush_rewind == 0);
+
+    pa_sink_input_unlink(input);
+    pa_sink_input_unref(input);
+    pa_sink_unlink(sink);
+    pa_sink_unref(sink);
+
+    pa_asyncmsgq_send(thread_mq.inq, NULL, PA_MESSAGE_SHUTDOWN, NULL, 0, NULL);
+    pa_thread_free(thread);
+
+    pa_thread_mq_done(&thread_mq);
+    pa_rtpoll_free(rtpoll);
+    pa_core_unref(core);
+    pa_mainloop_free(m);
+}
+END_TEST
+
+int main(int argc, char *argv[]) {
+    int failed = 0;
+    Suite *s;
+    TCase *tc;
+    SRunner *sr;
+
+    if (!getenv("MAKE_CHECK"))
+        pa_log_set_level(PA_LOG_DEBUG);
+
+    s = suite_create("Resampler checkpoints");
+    tc = tcase_create("resampler-checkpoint");
+    tcase_add_test(tc, checkpoint_flush_test);
+    tcase_add_test(tc, sink_input_checkpoint_test);
+    suite_add_tcase(s, tc);
+
+    sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -43,6 +43,7 @@
 #define MEMBLOCKQ_MAXLENGTH (16*1024*1024)
 #define PA_SILENCE_MAX (pa_page_size()*16)
 #define MAX_MATCHING_PERIOD 500
+#define BLOCK_SAMPLES 256
 
 static pa_memblock *silence_memblock_new(pa_mempool *pool, uint8_t c) {
     pa_memblock *b;
@@ -189,11 +190,12 @@ static void help(const char *argv0) {
            "      --frequency=unsigned            Frequency of square wave\n"
            "      --samples=unsigned              Number of samples for square wave\n"
            "      --rewind=unsigned               Number of output samples to rewind\n"
+           "      --no-checkpoints                Always replay the history on rewind\n"
            "\n"
            "This test generates samples for a square wave of given frequency, number of samples\n"
            "and input sample rate. Then this input data is resampled to the output rate, rewound\n"
            "by rewind samples and the rewound part is processed again. Then output is compared to\n"
-           "the result of the first pass.\n"
+           "the result of the first pass. The time needed for the rewind is reported.\n"
            "\n"
            "See --dump-resample-methods for possible values of resample methods.\n",
            argv0);
@@ -206,6 +208,7 @@ enum {
     ARG_FREQUENCY,
     ARG_SAMPLES,
     ARG_REWIND,
+    ARG_NO_CHECKPOINTS,
     ARG_RESAMPLE_METHOD,
     ARG_DUMP_RESAMPLE_METHODS
 };
@@ -226,10 +229,11 @@ int main(int argc, char *argv[]) {
     int ret = 1, c;
     unsigned samples, frequency, rewind;
     unsigned crossover_freq = 120;
+    bool checkpoints = true;
     pa_resampler *resampler;
     pa_memchunk in_chunk, out_chunk, rewound_chunk, silence_chunk;
     pa_usec_t ts;
-    pa_memblockq *history_queue = NULL;
+    pa_memblockq *history_queue = NULL, *out_queue = NULL;
     size_t in_rewind_size, in_frame_size, history_size, out_rewind_size, old_length, in_resampler_buffer, n_out_expected;
     float max_diff;
     double delay_before, delay_after, delay_expected;
@@ -243,6 +247,7 @@ int main(int argc, char *argv[]) {
         {"frequency",             1, NULL, ARG_FREQUENCY},
         {"samples",               1, NULL, ARG_SAMPLES},
         {"rewind",                1, NULL, ARG_REWIND},
+        {"no-checkpoints",        0, NULL, ARG_NO_CHECKPOINTS},
         {"resample-method",       1, NULL, ARG_RESAMPLE_METHOD},
         {"dump-resample-methods", 0, NULL, ARG_DUMP_RESAMPLE_METHODS},
         {NULL,                    0, NULL, 0}
@@ -309,6 +314,10 @@ int main(int argc, char *argv[]) {
                 rewind = (unsigned) atoi(optarg);
                 break;
 
+            case ARG_NO_CHECKPOINTS:
+                checkpoints = false;
+                break;
+
             case ARG_RESAMPLE_METHOD:
                 if (*optarg == '\0' || pa_streq(optarg, "help")) {
                     dump_resample_methods();
@@ -342,15 +351,49 @@ int main(int argc, char *argv[]) {
     in_chunk.index = 0;
     in_frame_size = pa_frame_size(&a);
 
-    /* First, resample the full block */
+    /* Create history queue */
+    silence_chunk.memblock = silence_memblock_new(pool, 0);
+    silence_chunk.length = pa_frame_align(pa_memblock_get_length(silence_chunk.memblock), &a);
+    silence_chunk.index = 0;
+    history_queue = pa_memblockq_new("Test-Queue", 0, MEMBLOCKQ_MAXLENGTH, 0, &a, 0, 1, samples * in_frame_size, &silence_chunk);
+    pa_memblock_unref(silence_chunk.memblock);
+
+    silence_chunk.memblock = silence_memblock_new(pool, 0);
+    silence_chunk.length = pa_frame_align(pa_memblock_get_length(silence_chunk.memblock), &b);
+    silence_chunk.index = 0;
+    out_queue = pa_memblockq_new("Output-Queue", 0, MEMBLOCKQ_MAXLENGTH, 0, &b, 0, 1, 0, &silence_chunk);
+    pa_memblock_unref(silence_chunk.memblock);
+
+    /* First, resample the full block in pieces like a sink input would,
+     * filling the history queue and taking checkpoints on the way */
     ts = pa_rtclock_now();
-    pa_resampler_run(resampler, &in_chunk, &out_chunk);
-    if (!out_chunk.memblock) {
-        pa_memblock_unref(in_chunk.memblock);
+    while (in_chunk.index < pa_memblock_get_length(in_chunk.memblock)) {
+        pa_memchunk chunk;
+
+        in_chunk.length = PA_MIN(BLOCK_SAMPLES * in_frame_size, pa_memblock_get_length(in_chunk.memblock) - in_chunk.index);
+        pa_memblockq_push(history_queue, &in_chunk);
+
+        pa_resampler_run(resampler, &in_chunk, &chunk);
+        if (checkpoints)
+            pa_resampler_save_checkpoint(resampler, pa_memblockq_get_write_index(history_queue));
+
+        if (chunk.memblock) {
+            pa_memblockq_push(out_queue, &chunk);
+            pa_memblock_unref(chunk.memblock);
+        }
+
+        in_chunk.index += in_chunk.length;
+    }
+    in_chunk.index = 0;
+    in_chunk.length = pa_memblock_get_length(in_chunk.memblock);
+
+    pa_memchunk_reset(&out_chunk);
+    if (pa_memblockq_get_length(out_queue) == 0) {
         pa_log_warn("Resampling did not return any output data");
         ret = 1;
-        goto quit;
+        goto quit1;
     }
+    pa_assert_se(pa_memblockq_peek_fixed_size(out_queue, pa_memblockq_get_length(out_queue), &out_chunk) >= 0);
 
     pa_log_info("resampling took %llu usec.", (long long unsigned)(pa_rtclock_now() - ts));
     if (rewind > out_chunk.length / pa_frame_size(&b)) {
@@ -362,14 +405,6 @@ int main(int argc, char *argv[]) {
     /* Get delay after first resampling pass */
     delay_before = pa_resampler_get_delay(resampler, true);
 
-    /* Create and prepare history queue */
-    silence_chunk.memblock = silence_memblock_new(pool, 0);
-    silence_chunk.length = pa_frame_align(pa_memblock_get_length(silence_chunk.memblock), &a);
-    silence_chunk.index = 0;
-    history_queue = pa_memblockq_new("Test-Queue", 0, MEMBLOCKQ_MAXLENGTH, 0, &a, 0, 1, samples * in_frame_size, &silence_chunk);
-    pa_memblock_unref(silence_chunk.memblock);
-
-    pa_memblockq_push(history_queue, &in_chunk);
     pa_memblockq_drop(history_queue, samples * in_frame_size);
 
     in_rewind_size = pa_resampler_request(resampler, rewind * pa_frame_size(&b));
@@ -383,7 +418,8 @@ int main(int argc, char *argv[]) {
     pa_log_debug("History is %lu frames.", history_size / in_frame_size);
     pa_resampler_rewind(resampler, out_rewind_size, history_queue, history_size);
 
-    pa_log_info("Rewind took %llu usec.", (long long unsigned)(pa_rtclock_now() - ts));
+    pa_log_info("Rewind took %llu usec (%s).", (long long unsigned)(pa_rtclock_now() - ts),
+                checkpoints ? "checkpoints enabled" : "full history replay");
     ts = pa_rtclock_now();
 
     /* Re-run the resampler */
@@ -423,11 +459,14 @@ int main(int argc, char *argv[]) {
 
 quit1:
     pa_memblock_unref(in_chunk.memblock);
-    pa_memblock_unref(out_chunk.memblock);
+    if (out_chunk.memblock)
+        pa_memblock_unref(out_chunk.memblock);
 
     pa_resampler_free(resampler);
     if (history_queue)
         pa_memblockq_free(history_queue);
+    if (out_queue)
+        pa_memblockq_free(out_queue);
 
 quit:
     if (pool)
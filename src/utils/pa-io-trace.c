@@ -0,0 +1,272 @@
+/***
+  This file is part of PulseAudio.
+
+  PulseAudio is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation; either version 2.1 of the License,
+  or (at your option) any later version.
+
+  PulseAudio is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with PulseAudio; if not, see <http://www.gnu.org/licenses/>.
+***/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <locale.h>
+
+#include <pulse/timeval.h>
+#include <pulse/util.h>
+#include <pulse/xmalloc.h>
+
+#include <pulsecore/core-util.h>
+#include <pulsecore/i18n.h>
+#include <pulsecore/io-trace.h>
+#include <pulsecore/macro.h>
+
+/* Decodes the files written for the io-trace-file= option of the daemon.
+ * Only relies on the format, so that it doesn't need the daemon's
+ * libraries. */
+
+/* Far more than any daemon records, so that corrupt files are rejected
+ * rather than allocating huge tables */
+#define MAX_EVENTS 1024
+#define MAX_THREADS 65536
+
+typedef char name_t[PA_IO_TRACE_NAME_MAX];
+
+static name_t *event_names = NULL;
+static uint32_t n_event_names = 0;
+static name_t *thread_names = NULL;
+static uint32_t n_thread_names = 0;
+
+static const char *event_name(uint32_t event) {
+    if (event >= n_event_names || !event_names[event][0])
+        return "unknown";
+
+    return event_names[event];
+}
+
+static const char *thread_name(uint32_t thread) {
+    if (thread >= n_thread_names || !thread_names[thread][0])
+        return "unknown";
+
+    return thread_names[thread];
+}
+
+static int set_thread_name(uint32_t thread, const pa_io_trace_record *rec) {
+    if (thread >= MAX_THREADS) {
+        fprintf(stderr, _("Invalid thread %u in IO trace file.\n"), thread);
+        return -1;
+    }
+
+    if (thread >= n_thread_names) {
+        uint32_t n = PA_MAX(thread + 1, n_thread_names * 2);
+
+        thread_names = pa_xrealloc(thread_names, n * sizeof(name_t));
+        memset(thread_names + n_thread_names, 0, (n - n_thread_names) * sizeof(name_t));
+        n_thread_names = n;
+    }
+
+    memcpy(thread_names[thread], rec->args, sizeof(name_t));
+    thread_names[thread][sizeof(name_t) - 1] = 0;
+
+    return 0;
+}
+
+static int read_header(FILE *f) {
+    pa_io_trace_header header;
+    uint32_t i;
+
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        memcmp(header.magic, PA_IO_TRACE_MAGIC, sizeof(PA_IO_TRACE_MAGIC)) != 0) {
+        fprintf(stderr, _("Not an IO trace file.\n"));
+        return -1;
+    }
+
+    if (header.version != PA_IO_TRACE_VERSION) {
+        fprintf(stderr, _("Unsupported IO trace version %u.\n"), header.version);
+        return -1;
+    }
+
+    if (header.n_events > MAX_EVENTS) {
+        fprintf(stderr, _("Invalid number of events %u in IO trace file.\n"), header.n_events);
+        return -1;
+    }
+
+    n_event_names = header.n_events;
+    event_names = pa_xnew0(name_t, PA_MAX(n_event_names, 1u));
+
+    if (fread(event_names, sizeof(name_t), n_event_names, f) != n_event_names) {
+        fprintf(stderr, _("Truncated IO trace file.\n"));
+        return -1;
+    }
+
+    for (i = 0; i < n_event_names; i++)
+        event_names[i][sizeof(name_t) - 1] = 0;
+
+    return 0;
+}
+
+static int compare_records(const void *a, const void *b) {
+    const pa_io_trace_record *ra = a, *rb = b;
+
+    if (ra->usec != rb->usec)
+        return ra->usec < rb->usec ? -1 : 1;
+
+    return ra->thread < rb->thread ? -1 : (ra->thread > rb->thread ? 1 : 0);
+}
+
+static void help(const char *argv0) {
+    printf(_("%s [options] FILE\n\n"
+             "Decode a trace of the IO threads written by the PulseAudio daemon.\n\n"
+             "  -h, --help                            Show this help\n"
+             "      --version                         Show version\n"
+             "  -a, --absolute                        Show monotonic timestamps instead of\n"
+             "                                        the time since the first record\n"
+             "  -e, --event=EVENT                     Only show records of this event\n\n"),
+           argv0);
+}
+
+enum {
+    ARG_VERSION = 256
+};
+
+int main(int argc, char *argv[]) {
+    FILE *f = NULL;
+    int c, ret = 1;
+    bool absolute = false;
+    char *filter = NULL;
+    const char *bn;
+    pa_io_trace_record rec, *records = NULL;
+    size_t i, n_records = 0, n_allocated = 0;
+    uint64_t n_dropped = 0;
+
+    static const struct option long_options[] = {
+        {"absolute",    0, NULL, 'a'},
+        {"event",       1, NULL, 'e'},
+        {"version",     0, NULL, ARG_VERSION},
+        {"help",        0, NULL, 'h'},
+        {NULL,          0, NULL, 0}
+    };
+
+    setlocale(LC_ALL, "");
+#ifdef ENABLE_NLS
+    bindtextdomain(GETTEXT_PACKAGE, PULSE_LOCALEDIR);
+#endif
+
+    bn = pa_path_get_filename(argv[0]);
+
+    while ((c = getopt_long(argc, argv, "ae:h", long_options, NULL)) != -1) {
+        switch (c) {
+            case 'h':
+                help(bn);
+                ret = 0;
+                goto quit;
+
+            case ARG_VERSION:
+                printf(_("pa-io-trace %s\n"), PACKAGE_VERSION);
+                ret = 0;
+                goto quit;
+
+            case 'a':
+                absolute = true;
+                break;
+
+            case 'e':
+                pa_xfree(filter);
+                filter = pa_xstrdup(optarg);
+                break;
+
+            default:
+                goto quit;
+        }
+    }
+
+    if (optind != argc - 1) {
+        help(bn);
+        goto quit;
+    }
+
+    if (!(f = fopen(argv[optind], "r"))) {
+        fprintf(stderr, _("Failed to open %s: %s\n"), argv[optind], strerror(errno));
+        goto quit;
+    }
+
+    if (read_header(f) < 0)
+        goto quit;
+
+    /* The daemon writes the records ring by ring, so they are only in
+     * order per thread */
+    while (fread(&rec, sizeof(rec), 1, f) == 1) {
+
+        /* Written when the ring of the thread is flushed */
+        if (rec.event == PA_IO_TRACE_THREAD) {
+            if (set_thread_name(rec.thread, &rec) < 0)
+                goto quit;
+
+            continue;
+        }
+
+        if (rec.event == PA_IO_TRACE_DROPPED) {
+            n_dropped += (uint64_t) rec.args[0];
+            continue;
+        }
+
+        if (n_records >= n_allocated) {
+            n_allocated = PA_MAX(n_allocated * 2, (size_t) 1024);
+            records = pa_xrealloc(records, n_allocated * sizeof(pa_io_trace_record));
+        }
+
+        records[n_records++] = rec;
+    }
+
+    if (ferror(f)) {
+        fprintf(stderr, _("Failed to read %s: %s\n"), argv[optind], strerror(errno));
+        goto quit;
+    }
+
+    if (n_records > 0)
+        qsort(records, n_records, sizeof(pa_io_trace_record), compare_records);
+
+    for (i = 0; i < n_records; i++) {
+        const pa_io_trace_record *r = &records[i];
+        double msec;
+
+        if (filter && !pa_streq(filter, event_name(r->event)))
+            continue;
+
+        msec = (double) (absolute ? r->usec : r->usec - records[0].usec) / PA_USEC_PER_MSEC;
+
+        printf("%14.3f %-16s %-20s %" PRIi64 " %" PRIi64 " %" PRIi64 " %" PRIi64 "\n",
+               msec, thread_name(r->thread), event_name(r->event),
+               r->args[0], r->args[1], r->args[2], r->args[3]);
+    }
+
+    if (n_dropped > 0)
+        fprintf(stderr, _("%llu records were dropped because the trace couldn't keep up.\n"), (unsigned long long) n_dropped);
+
+    ret = 0;
+
+quit:
+    if (f)
+        fclose(f);
+
+    pa_xfree(filter);
+    pa_xfree(records);
+    pa_xfree(event_names);
+    pa_xfree(thread_names);
+
+    return ret;
+}